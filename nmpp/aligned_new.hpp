@@ -0,0 +1,35 @@
+#ifndef NMPP_ALIGNED_NEW_HPP_
+#define NMPP_ALIGNED_NEW_HPP_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace nmpp
+{
+
+// Base for types declared alignas(alignment) beyond what the global
+// operator new of C++14 guarantees. Gives them a class operator new that
+// really returns memory aligned that way, so `new T` and
+// std::shared_ptr<T>(new T) keep the alignment. std::make_shared and
+// std::allocator still go through the global operator new and must not be
+// used for such types; neither must arrays.
+template <size_t alignment> struct aligned_new
+{
+  static void* operator new(size_t size)
+  {
+    void* p = nullptr;
+    if (posix_memalign(&p, alignment, size) != 0)
+      throw std::bad_alloc();
+    return p;
+  }
+
+  static void operator delete(void* p) noexcept
+  {
+    free(p);
+  }
+};
+
+} // namespace nmpp
+
+#endif // NMPP_ALIGNED_NEW_HPP_
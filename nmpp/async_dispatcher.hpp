@@ -1,19 +1,27 @@
 #ifndef NMPP_ASYNC_DISPATCHER_HPP_
 #define NMPP_ASYNC_DISPATCHER_HPP_
 
-#include <boost/asio.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/system/error_code.hpp>
+#include <memory>
 #include <nmpp/exception.hpp>
+#include <nmpp/fwd.hpp>
+#include <nmpp/trace.hpp>
+#include <system_error>
 
 namespace nmpp
 {
 
-template <typename native_socket_type> class async_dispatcher
+template <typename native_socket_type, typename tracer_type>
+class async_dispatcher
 {
 public:
   async_dispatcher(
       typename native_socket_type::native_handle_type receive_handle,
       typename native_socket_type::native_handle_type send_handle,
       boost::asio::io_service& io) noexcept
+      : receive_handle(receive_handle), send_handle(send_handle)
   {
     if (receive_handle != -1)
       receive_socket =
@@ -28,10 +36,11 @@ public:
     throw_when<std::logic_error>(!receive_socket,
                                  "Receive operation not supported");
 
-    receive_socket->async_read_event([handler =
-                                          std::forward<handler_type>(handler)](
-        const boost::system::error_code&, std::size_t) {
-      handler(std::error_code());
+    receive_socket->async_read_event([
+      fd = receive_handle, handler = std::forward<handler_type>(handler)
+    ](const boost::system::error_code& ec, std::size_t) {
+      tracer_type::record(trace_event::readiness_wakeup, fd);
+      handler(to_error_code(ec));
     });
   }
 
@@ -40,13 +49,27 @@ public:
   {
     throw_when<std::logic_error>(!send_socket, "Send operation not supported");
 
-    send_socket->async_write_event([handler =
-                                        std::forward<handler_type>(handler)](
-        const boost::system::error_code&, std::size_t) {
-      handler(std::error_code());
+    send_socket->async_write_event([
+      fd = send_handle, handler = std::forward<handler_type>(handler)
+    ](const boost::system::error_code& ec, std::size_t) {
+      tracer_type::record(trace_event::readiness_wakeup, fd);
+      handler(to_error_code(ec));
     });
   }
 
+  // Pending handlers complete with std::errc::operation_canceled.
+  void cancel_receive() noexcept
+  {
+    if (receive_socket)
+      receive_socket->cancel();
+  }
+
+  void cancel_send() noexcept
+  {
+    if (send_socket)
+      send_socket->cancel();
+  }
+
   const native_socket_type& get_native_receive_socket()
   {
     return *receive_socket;
@@ -58,6 +81,17 @@ public:
   }
 
 private:
+  static std::error_code to_error_code(const boost::system::error_code& ec)
+  {
+    if (!ec)
+      return std::error_code();
+    if (ec == boost::asio::error::operation_aborted)
+      return std::make_error_code(std::errc::operation_canceled);
+    return std::error_code(ec.value(), std::system_category());
+  }
+
+  typename native_socket_type::native_handle_type receive_handle;
+  typename native_socket_type::native_handle_type send_handle;
   std::unique_ptr<native_socket_type> receive_socket;
   std::unique_ptr<native_socket_type> send_socket;
 };
@@ -0,0 +1,301 @@
+#ifndef NMPP_BATCH_HPP_
+#define NMPP_BATCH_HPP_
+
+#include <algorithm>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <nanomsg/nn.h>
+#include <nmpp/exception.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/socket.hpp>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+namespace nmpp
+{
+
+// A batch is a single nanomsg frame holding consecutive records, each
+// prefixed with its length as a little endian 32 bit integer.
+constexpr size_t batch_record_header_size = 4;
+
+// Packs records into a batch and sends it once it holds max_records or
+// max_bytes, or is older than max_delay. Without an io_service the age is
+// only checked by write() and flush_if_due(), so a caller that stops
+// writing has to poll flush_if_due() to get the last batch out in time.
+// Given one, a timer flushes at the deadline instead.
+template <typename socket_type = socket, typename message_type = message>
+class batch_writer
+{
+public:
+  using clock = std::chrono::steady_clock;
+  using error_handler_type = std::function<void(const std::error_code&)>;
+
+  batch_writer(const batch_writer&) = delete;
+  batch_writer& operator=(const batch_writer&) = delete;
+
+  batch_writer(socket_type& socket, size_t max_bytes, size_t max_records,
+               clock::duration max_delay) noexcept
+      : m_socket(socket),
+        m_max_bytes(max_bytes),
+        m_max_records(max_records),
+        m_max_delay(max_delay),
+        m_buffer(nullptr),
+        m_capacity(0),
+        m_size(0),
+        m_records(0)
+  {
+  }
+
+  // Also flushes every batch at its deadline from a timer on io. The
+  // writer must then only be used from the thread running io. When a timed
+  // flush fails, the batch is dropped and on_error gets the nanomsg error.
+  batch_writer(socket_type& socket, size_t max_bytes, size_t max_records,
+               clock::duration max_delay, boost::asio::io_service& io,
+               error_handler_type on_error = nullptr)
+      : batch_writer(socket, max_bytes, max_records, max_delay)
+  {
+    m_timer.reset(new boost::asio::steady_timer(io));
+    m_on_error = std::move(on_error);
+  }
+
+  ~batch_writer() noexcept
+  {
+    try
+    {
+      flush();
+    }
+    catch (...)
+    {
+      discard();
+    }
+  }
+
+  void write(const char* data, size_t size) throw(std::logic_error,
+                                                   exception)
+  {
+    throw_when<std::logic_error>(size > UINT32_MAX, "Record too large");
+
+    auto record_size = batch_record_header_size + size;
+    if (m_buffer != nullptr && m_size + record_size > m_capacity)
+      flush();
+    if (m_buffer == nullptr)
+      allocate(std::max(m_max_bytes, record_size));
+
+    auto out = m_buffer + m_size;
+    for (int i = 0; i < 4; ++i)
+      out[i] = static_cast<char>((size >> (8 * i)) & 0xff);
+    std::memcpy(out + batch_record_header_size, data, size);
+    m_size += record_size;
+
+    if (++m_records >= m_max_records || m_size >= m_max_bytes ||
+        clock::now() >= m_deadline)
+      flush();
+  }
+
+  bool flush_if_due(clock::time_point now = clock::now()) throw(exception)
+  {
+    if (m_records == 0 || now < m_deadline)
+      return false;
+    flush();
+    return true;
+  }
+
+  void flush() throw(exception)
+  {
+    if (m_records == 0)
+      return;
+
+    auto buffer = reinterpret_cast<char*>(nn_reallocmsg(m_buffer, m_size));
+    throw_when(buffer == nullptr);
+    auto size = m_size;
+    m_buffer = nullptr;
+    m_size = m_records = m_capacity = 0;
+    m_socket.send(*message_type::from_nn(buffer, size));
+  }
+
+  size_t pending_records() const noexcept
+  {
+    return m_records;
+  }
+
+  size_t pending_bytes() const noexcept
+  {
+    return m_size;
+  }
+
+  clock::time_point deadline() const noexcept
+  {
+    return m_deadline;
+  }
+
+private:
+  void allocate(size_t capacity)
+  {
+    m_buffer = reinterpret_cast<char*>(nn_allocmsg(capacity, 0));
+    throw_when(m_buffer == nullptr);
+    m_capacity = capacity;
+    m_deadline = clock::now() + m_max_delay;
+    if (m_timer)
+      arm_timer();
+  }
+
+  // Re-arming cancels the wait for the previous batch.
+  void arm_timer()
+  {
+    m_timer->expires_at(m_deadline);
+    m_timer->async_wait([this](const boost::system::error_code& ec) {
+      if (ec)
+        return;
+      try
+      {
+        flush_if_due();
+      }
+      catch (const exception& e)
+      {
+        discard();
+        if (m_on_error)
+          m_on_error(std::error_code(e.num(), std::system_category()));
+      }
+    });
+  }
+
+  void discard() noexcept
+  {
+    if (m_buffer != nullptr)
+      nn_freemsg(m_buffer);
+    m_buffer = nullptr;
+    m_size = m_records = m_capacity = 0;
+  }
+
+  socket_type& m_socket;
+  size_t m_max_bytes;
+  size_t m_max_records;
+  clock::duration m_max_delay;
+  clock::time_point m_deadline;
+  char* m_buffer;
+  size_t m_capacity;
+  size_t m_size;
+  size_t m_records;
+  std::unique_ptr<boost::asio::steady_timer> m_timer;
+  error_handler_type m_on_error;
+};
+
+class batch_reader
+{
+public:
+  struct record
+  {
+    const char* data;
+    size_t size;
+  };
+
+  class iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = record;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const record*;
+    using reference = const record&;
+
+    iterator(const char* position, const char* end)
+        : m_position(position), m_end(end)
+    {
+      parse();
+    }
+
+    const record& operator*() const noexcept
+    {
+      return m_record;
+    }
+
+    const record* operator->() const noexcept
+    {
+      return &m_record;
+    }
+
+    iterator& operator++()
+    {
+      m_position = m_record.data + m_record.size;
+      parse();
+      return *this;
+    }
+
+    iterator operator++(int)
+    {
+      auto temp = *this;
+      ++*this;
+      return temp;
+    }
+
+    bool operator==(const iterator& rhs) const noexcept
+    {
+      return m_position == rhs.m_position;
+    }
+
+    bool operator!=(const iterator& rhs) const noexcept
+    {
+      return !(*this == rhs);
+    }
+
+  private:
+    void parse()
+    {
+      if (m_position == m_end)
+        return;
+      throw_when<std::runtime_error>(
+          static_cast<size_t>(m_end - m_position) < batch_record_header_size,
+          "Truncated batch record header");
+
+      size_t size = 0;
+      for (int i = 0; i < 4; ++i)
+        size |= static_cast<size_t>(
+                    static_cast<unsigned char>(m_position[i]))
+                << (8 * i);
+      auto data = m_position + batch_record_header_size;
+      throw_when<std::runtime_error>(
+          static_cast<size_t>(m_end - data) < size, "Truncated batch record");
+      m_record = record{data, size};
+    }
+
+    const char* m_position;
+    const char* m_end;
+    record m_record;
+  };
+
+  batch_reader(const char* data, size_t size) noexcept
+      : m_begin(data), m_end(data + size)
+  {
+  }
+
+  template <typename message_type>
+  explicit batch_reader(const message_type& msg) noexcept
+      : batch_reader(msg.data(), msg.size())
+  {
+  }
+
+  iterator begin() const
+  {
+    return iterator(m_begin, m_end);
+  }
+
+  iterator end() const
+  {
+    return iterator(m_end, m_end);
+  }
+
+private:
+  const char* m_begin;
+  const char* m_end;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_BATCH_HPP_
@@ -0,0 +1,88 @@
+#ifndef NMPP_BROADCAST_HPP_
+#define NMPP_BROADCAST_HPP_
+
+#include <memory>
+#include <mutex>
+#include <nmpp/exception.hpp>
+#include <nmpp/socket.hpp>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+namespace nmpp
+{
+
+// Sends one payload to every socket. All sockets but the last get a copy
+// made by nanomsg straight from the payload, the last one takes ownership
+// of the message without copying. Returns the number of sockets sent to.
+template <typename socket_type, typename message_type>
+size_t broadcast(const std::vector<socket_type*>& sockets,
+                 message_type&& msg) throw(std::logic_error, exception)
+{
+  throw_when<std::logic_error>(!msg.valid(), "Invalid message");
+  if (sockets.empty())
+    return 0;
+
+  for (size_t i = 0; i + 1 < sockets.size(); ++i)
+    sockets[i]->send(msg.data(), msg.size());
+  sockets.back()->send(msg);
+  return sockets.size();
+}
+
+// Asynchronous broadcast: sends are issued on all sockets at once and
+// complete independently. handler(ec, sent) runs once after the last send
+// completed, with the first error reported by any of them.
+template <typename socket_type, typename message_type, typename handler_type>
+void async_broadcast(const std::vector<socket_type*>& sockets,
+                     std::unique_ptr<message_type> msg,
+                     handler_type&& handler) throw(std::logic_error,
+                                                   exception)
+{
+  throw_when<std::logic_error>(!msg || !msg->valid(), "Invalid message");
+  if (sockets.empty())
+  {
+    handler(std::error_code(), 0);
+    return;
+  }
+
+  struct state
+  {
+    state(size_t n, handler_type&& h)
+        : remaining(n), sent(0), handler(std::forward<handler_type>(h))
+    {
+    }
+
+    std::mutex lock;
+    size_t remaining;
+    size_t sent;
+    std::error_code error;
+    std::decay_t<handler_type> handler;
+  };
+  auto shared_state = std::make_shared<state>(
+      sockets.size(), std::forward<handler_type>(handler));
+
+  auto completion = [shared_state](const std::error_code& ec, size_t) {
+    std::unique_lock<std::mutex> guard(shared_state->lock);
+    if (ec && !shared_state->error)
+      shared_state->error = ec;
+    if (!ec)
+      ++shared_state->sent;
+    if (--shared_state->remaining != 0)
+      return;
+    guard.unlock();
+    shared_state->handler(shared_state->error, shared_state->sent);
+  };
+
+  std::vector<std::unique_ptr<message_type>> copies;
+  copies.reserve(sockets.size() - 1);
+  for (size_t i = 0; i + 1 < sockets.size(); ++i)
+    copies.push_back(message_type::from(msg->data(), msg->size()));
+
+  for (size_t i = 0; i + 1 < sockets.size(); ++i)
+    sockets[i]->async_send(std::move(copies[i]), completion);
+  sockets.back()->async_send(std::move(msg), completion);
+}
+
+} // namespace nmpp
+
+#endif // NMPP_BROADCAST_HPP_
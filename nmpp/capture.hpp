@@ -0,0 +1,400 @@
+#ifndef NMPP_CAPTURE_HPP_
+#define NMPP_CAPTURE_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <iterator>
+#include <memory>
+#include <nmpp/exception.hpp>
+#include <nmpp/socket.hpp>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+
+namespace nmpp
+{
+
+// Capture file layout, all integers in host byte order:
+//   header: 8 byte magic, 8 byte length of the committed data
+//   record: 8 byte timestamp in nanoseconds, 4 byte payload size,
+//           4 byte padding, payload padded to a multiple of 8 bytes
+namespace capture_format
+{
+constexpr char magic[8] = {'N', 'M', 'P', 'P', 'C', 'A', 'P', '1'};
+constexpr size_t header_size = 16;
+constexpr size_t record_header_size = 16;
+
+inline size_t record_size(size_t payload_size) noexcept
+{
+  return record_header_size + ((payload_size + 7) & ~size_t(7));
+}
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t) &&
+                  ATOMIC_LLONG_LOCK_FREE == 2,
+              "Committed length must be a lock-free 64 bit atomic");
+
+// Committed length in the mapped header. The writer publishes it with a
+// release store after the records it covers, a reader mapping the file
+// meanwhile loads it with acquire and sees those records complete.
+inline std::atomic<uint64_t>& committed_length(const char* header) noexcept
+{
+  return *reinterpret_cast<std::atomic<uint64_t>*>(
+      const_cast<char*>(header) + sizeof(magic));
+}
+} // namespace capture_format
+
+// Appends messages to a memory-mapped capture file. The file grows in
+// chunks and is truncated to the committed length when the writer closes.
+class capture_writer
+{
+public:
+  capture_writer(const capture_writer&) = delete;
+  capture_writer& operator=(const capture_writer&) = delete;
+
+  explicit capture_writer(const std::string& path,
+                          size_t chunk_size = 64 << 20) throw(
+      std::system_error)
+      : m_fd(-1), m_data(nullptr), m_capacity(0),
+        m_length(capture_format::header_size), m_chunk_size(chunk_size)
+  {
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    throw_when<std::system_error>(m_fd == -1, errno, std::system_category(),
+                                  path);
+    try
+    {
+      reserve(m_chunk_size);
+    }
+    catch (...)
+    {
+      ::close(m_fd);
+      throw;
+    }
+    std::memcpy(m_data, capture_format::magic, sizeof(capture_format::magic));
+    commit();
+  }
+
+  ~capture_writer() noexcept
+  {
+    close();
+  }
+
+  void close() noexcept
+  {
+    if (m_fd == -1)
+      return;
+    munmap(m_data, m_capacity);
+    auto status = ftruncate(m_fd, m_length);
+    (void)status;
+    ::close(m_fd);
+    m_fd = -1;
+  }
+
+  void append(const char* data, size_t size,
+              uint64_t timestamp = now()) throw(std::logic_error,
+                                                std::system_error)
+  {
+    throw_when<std::logic_error>(m_fd == -1, "Capture file closed");
+    throw_when<std::logic_error>(size > UINT32_MAX, "Record too large");
+
+    auto record_size = capture_format::record_size(size);
+    if (m_length + record_size > m_capacity)
+      reserve(std::max(m_capacity + m_chunk_size, m_length + record_size));
+
+    auto out = m_data + m_length;
+    auto size32 = static_cast<uint32_t>(size);
+    std::memcpy(out, &timestamp, sizeof(timestamp));
+    std::memcpy(out + 8, &size32, sizeof(size32));
+    std::memset(out + 12, 0, 4);
+    std::memcpy(out + capture_format::record_header_size, data, size);
+    m_length += record_size;
+    commit();
+  }
+
+  template <typename message_type>
+  void append(const message_type& msg) throw(std::logic_error,
+                                             std::system_error)
+  {
+    append(msg.data(), msg.size());
+  }
+
+  size_t length() const noexcept
+  {
+    return m_length;
+  }
+
+  static uint64_t now() noexcept
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+private:
+  void reserve(size_t capacity)
+  {
+    throw_when<std::system_error>(ftruncate(m_fd, capacity) == -1, errno,
+                                  std::system_category(), "ftruncate");
+    auto data =
+        m_data == nullptr
+            ? mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   m_fd, 0)
+            : mremap(m_data, m_capacity, capacity, MREMAP_MAYMOVE);
+    throw_when<std::system_error>(data == MAP_FAILED, errno,
+                                  std::system_category(), "mmap");
+    m_data = static_cast<char*>(data);
+    m_capacity = capacity;
+  }
+
+  void commit() noexcept
+  {
+    capture_format::committed_length(m_data).store(m_length,
+                                                   std::memory_order_release);
+  }
+
+  int m_fd;
+  char* m_data;
+  size_t m_capacity;
+  size_t m_length;
+  size_t m_chunk_size;
+};
+
+// Read-only mapping of a capture file. Records point straight into the
+// mapping and stay valid as long as the reader.
+class capture_reader
+{
+public:
+  struct record
+  {
+    uint64_t timestamp;
+    const char* data;
+    size_t size;
+  };
+
+  class iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = record;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const record*;
+    using reference = const record&;
+
+    iterator(const char* position, const char* end)
+        : m_position(position), m_end(end)
+    {
+      parse();
+    }
+
+    const record& operator*() const noexcept
+    {
+      return m_record;
+    }
+
+    const record* operator->() const noexcept
+    {
+      return &m_record;
+    }
+
+    iterator& operator++()
+    {
+      m_position += capture_format::record_size(m_record.size);
+      parse();
+      return *this;
+    }
+
+    bool operator==(const iterator& rhs) const noexcept
+    {
+      return m_position == rhs.m_position;
+    }
+
+    bool operator!=(const iterator& rhs) const noexcept
+    {
+      return !(*this == rhs);
+    }
+
+  private:
+    void parse()
+    {
+      if (m_position == m_end)
+        return;
+      auto available = static_cast<size_t>(m_end - m_position);
+      throw_when<std::runtime_error>(
+          available < capture_format::record_header_size,
+          "Truncated capture record header");
+
+      uint32_t size;
+      std::memcpy(&m_record.timestamp, m_position, 8);
+      std::memcpy(&size, m_position + 8, sizeof(size));
+      throw_when<std::runtime_error>(
+          available < capture_format::record_size(size),
+          "Truncated capture record");
+      m_record.data = m_position + capture_format::record_header_size;
+      m_record.size = size;
+    }
+
+    const char* m_position;
+    const char* m_end;
+    record m_record;
+  };
+
+  capture_reader(const capture_reader&) = delete;
+  capture_reader& operator=(const capture_reader&) = delete;
+
+  explicit capture_reader(const std::string& path) throw(std::system_error,
+                                                         std::runtime_error)
+      : m_data(nullptr), m_size(0), m_length(0)
+  {
+    auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    throw_when<std::system_error>(fd == -1, errno, std::system_category(),
+                                  path);
+    struct stat info;
+    if (fstat(fd, &info) == -1)
+    {
+      auto err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::system_category(), "fstat");
+    }
+    m_size = static_cast<size_t>(info.st_size);
+    if (m_size >= capture_format::header_size)
+    {
+      auto data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+      auto err = errno;
+      ::close(fd);
+      throw_when<std::system_error>(data == MAP_FAILED, err,
+                                    std::system_category(), "mmap");
+      m_data = static_cast<const char*>(data);
+      madvise(const_cast<char*>(m_data), m_size, MADV_SEQUENTIAL);
+    }
+    else
+      ::close(fd);
+
+    if (m_data == nullptr ||
+        std::memcmp(m_data, capture_format::magic,
+                    sizeof(capture_format::magic)) != 0)
+    {
+      unmap();
+      throw std::runtime_error("Not a capture file");
+    }
+
+    uint64_t length = capture_format::committed_length(m_data).load(
+        std::memory_order_acquire);
+    if (length < capture_format::header_size)
+    {
+      unmap();
+      throw std::runtime_error("Not a capture file");
+    }
+    m_length = std::min<size_t>(length, m_size);
+  }
+
+  ~capture_reader() noexcept
+  {
+    unmap();
+  }
+
+  iterator begin() const
+  {
+    return iterator(m_data + capture_format::header_size, m_data + m_length);
+  }
+
+  iterator end() const
+  {
+    return iterator(m_data + m_length, m_data + m_length);
+  }
+
+private:
+  void unmap() noexcept
+  {
+    if (m_data != nullptr)
+      munmap(const_cast<char*>(m_data), m_size);
+    m_data = nullptr;
+  }
+
+  const char* m_data;
+  size_t m_size;
+  size_t m_length;
+};
+
+// Socket wrapper recording every received message before handing it on.
+template <typename socket_type = socket>
+class recording_socket_impl : public socket_type
+{
+public:
+  template <typename... Args>
+  recording_socket_impl(capture_writer& writer, Args&&... args)
+      : socket_type(std::forward<Args>(args)...), m_writer(writer)
+  {
+  }
+
+  template <typename message_type>
+  auto receive() throw(std::logic_error, std::system_error, exception)
+  {
+    auto msg = socket_type::template receive<message_type>();
+    m_writer.append(*msg);
+    return msg;
+  }
+
+  // Handlers as for async_socket_impl::async_receive. Only received
+  // messages are recorded, errors go straight to error-aware handlers.
+  template <typename message_type, typename handler_type>
+  void async_receive(handler_type&& handler)
+  {
+    socket_type::template async_receive<message_type>(
+        [this, handler](const std::error_code& ec,
+                        std::unique_ptr<message_type> msg) {
+          if (!ec)
+            m_writer.append(*msg);
+          complete_receive(handler, ec, std::move(msg));
+        });
+  }
+
+private:
+  capture_writer& m_writer;
+};
+
+using recording_socket = recording_socket_impl<socket>;
+using recording_async_socket = recording_socket_impl<async_socket>;
+
+enum class replay_pacing
+{
+  original,
+  as_fast_as_possible
+};
+
+// Sends every captured payload through the socket, either spaced like the
+// original capture or back to back. Payloads are passed to nanomsg
+// straight from the mapping. Returns the number of messages sent.
+template <typename socket_type>
+size_t replay(const capture_reader& capture, socket_type& socket,
+              replay_pacing pacing = replay_pacing::original) throw(exception)
+{
+  using clock = std::chrono::steady_clock;
+  auto start = clock::now();
+  uint64_t first = 0;
+  size_t sent = 0;
+
+  for (auto& record : capture)
+  {
+    if (pacing == replay_pacing::original)
+    {
+      if (sent == 0)
+        first = record.timestamp;
+      auto offset = std::max(record.timestamp, first) - first;
+      std::this_thread::sleep_until(start + std::chrono::nanoseconds(offset));
+    }
+    socket.send(record.data, record.size);
+    ++sent;
+  }
+  return sent;
+}
+
+} // namespace nmpp
+
+#endif // NMPP_CAPTURE_HPP_
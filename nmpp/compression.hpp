@@ -0,0 +1,223 @@
+#ifndef NMPP_COMPRESSION_HPP_
+#define NMPP_COMPRESSION_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <nanomsg/nn.h>
+#include <nmpp/exception.hpp>
+#include <nmpp/socket.hpp>
+#include <stdexcept>
+#include <system_error>
+
+namespace nmpp
+{
+
+// Every frame ends with a one byte flag. In compressed frames it is
+// preceded by the original payload length as a little endian 32 bit
+// integer. Keeping it at the end lets raw frames be sent and received in
+// the payload's own chunk, grown or shortened in place.
+namespace compression_trailer
+{
+constexpr unsigned char raw = 0;
+constexpr unsigned char compressed = 1;
+constexpr size_t raw_size = 1;
+constexpr size_t compressed_size = 5;
+} // namespace compression_trailer
+
+// codec_type has to provide:
+//   size_t max_compressed_size(size_t size) const;
+//   size_t compress(const char* src, size_t size,
+//                   char* dst, size_t capacity) const;  // 0 on failure
+//   bool decompress(const char* src, size_t size,
+//                   char* dst, size_t original_size) const;
+template <typename codec_type, typename socket_type = socket>
+class compressed_socket_impl : public socket_type
+{
+public:
+  template <typename... Args>
+  compressed_socket_impl(Args&&... args)
+      : socket_type(std::forward<Args>(args)...), m_threshold(512),
+        m_max_size(1024 * 1024)
+  {
+  }
+
+  void set_compression_threshold(size_t threshold) noexcept
+  {
+    m_threshold = threshold;
+  }
+
+  size_t get_compression_threshold() const noexcept
+  {
+    return m_threshold;
+  }
+
+  // Upper bound for the original length announced by a compressed frame,
+  // larger frames are rejected before anything is allocated. Defaults to
+  // 1 MiB like NN_RCVMAXSIZE.
+  void set_max_decompressed_size(size_t size) noexcept
+  {
+    m_max_size = size;
+  }
+
+  size_t get_max_decompressed_size() const noexcept
+  {
+    return m_max_size;
+  }
+
+  codec_type& get_codec() noexcept
+  {
+    return m_codec;
+  }
+
+  template <typename message_type>
+  void send(message_type&& msg) throw(std::logic_error, exception)
+  {
+    throw_when<std::logic_error>(!msg.valid(), "Invalid message");
+    socket_type::send(*encode<std::decay_t<message_type>>(msg));
+  }
+
+  template <typename message_type>
+  auto receive() throw(std::runtime_error, exception)
+  {
+    return decode(socket_type::template receive<message_type>());
+  }
+
+  template <typename message_type, typename handler_type>
+  void async_send(std::unique_ptr<message_type> msg, handler_type&& handler)
+  {
+    throw_when<std::logic_error>(!msg->valid(), "Invalid message");
+    socket_type::async_send(encode(*msg),
+                            std::forward<handler_type>(handler));
+  }
+
+  // Handlers as for async_socket_impl::async_receive. A frame that cannot
+  // be decoded reaches error-aware handlers as std::errc::bad_message and
+  // is dropped for the others.
+  template <typename message_type, typename handler_type>
+  void async_receive(handler_type&& handler)
+  {
+    socket_type::template async_receive<message_type>(
+        [this, handler](const std::error_code& ec,
+                        std::unique_ptr<message_type> msg) {
+          auto result = ec;
+          if (!ec)
+          {
+            try
+            {
+              msg = decode(std::move(msg));
+            }
+            catch (const std::runtime_error&)
+            {
+              result = std::make_error_code(std::errc::bad_message);
+            }
+            catch (const exception& e)
+            {
+              result = std::error_code(e.num(), std::system_category());
+            }
+          }
+          complete_receive(handler, result, std::move(msg));
+        });
+  }
+
+private:
+  // Takes the payload over. Raw frames keep its chunk, grown by the flag.
+  template <typename message_type>
+  std::unique_ptr<message_type> encode(message_type& msg)
+  {
+    auto size = msg.size();
+    if (size >= m_threshold && size <= UINT32_MAX)
+    {
+      auto capacity = m_codec.max_compressed_size(size);
+      auto buf = allocate(capacity + compression_trailer::compressed_size);
+      auto compressed_size = m_codec.compress(msg.data(), size, buf, capacity);
+      if (compressed_size != 0 && compressed_size < size)
+      {
+        auto trailer = buf + compressed_size;
+        for (int i = 0; i < 4; ++i)
+          trailer[i] = static_cast<char>((size >> (8 * i)) & 0xff);
+        trailer[4] = compression_trailer::compressed;
+        auto total = compressed_size + compression_trailer::compressed_size;
+        auto shrunk = reinterpret_cast<char*>(nn_reallocmsg(buf, total));
+        if (shrunk == nullptr)
+        {
+          nn_freemsg(buf);
+          throw exception();
+        }
+        nn_freemsg(msg.release());
+        return message_type::from_nn(shrunk, total);
+      }
+      nn_freemsg(buf);
+    }
+
+    auto buf = msg.release();
+    auto grown = reinterpret_cast<char*>(
+        nn_reallocmsg(buf, size + compression_trailer::raw_size));
+    if (grown == nullptr)
+    {
+      nn_freemsg(buf);
+      throw exception();
+    }
+    grown[size] = compression_trailer::raw;
+    return message_type::from_nn(grown, size + compression_trailer::raw_size);
+  }
+
+  // Raw frames are shortened in place, compressed ones decompressed into a
+  // new chunk.
+  template <typename message_type>
+  std::unique_ptr<message_type> decode(std::unique_ptr<message_type> msg)
+  {
+    auto size = msg->size();
+    throw_when<std::runtime_error>(size < compression_trailer::raw_size,
+                                   "Missing compression trailer");
+
+    auto data = msg->data();
+    auto flag = data[size - 1];
+    if (flag == compression_trailer::raw)
+      return message_type::from_nn(msg->release(),
+                                   size - compression_trailer::raw_size);
+
+    throw_when<std::runtime_error>(
+        flag != compression_trailer::compressed ||
+            size < compression_trailer::compressed_size,
+        "Malformed compression trailer");
+
+    auto payload_size = size - compression_trailer::compressed_size;
+    size_t original_size = 0;
+    for (int i = 0; i < 4; ++i)
+      original_size |= static_cast<size_t>(static_cast<unsigned char>(
+                           data[payload_size + i]))
+                       << (8 * i);
+    throw_when<std::runtime_error>(original_size > m_max_size,
+                                   "Decompressed payload too large");
+
+    auto buf = allocate(original_size);
+    if (!m_codec.decompress(data, payload_size, buf, original_size))
+    {
+      nn_freemsg(buf);
+      throw std::runtime_error("Payload decompression failed");
+    }
+    return message_type::from_nn(buf, original_size);
+  }
+
+  static char* allocate(size_t size)
+  {
+    auto buf = reinterpret_cast<char*>(nn_allocmsg(size, 0));
+    throw_when(buf == nullptr);
+    return buf;
+  }
+
+  codec_type m_codec;
+  size_t m_threshold;
+  size_t m_max_size;
+};
+
+template <typename codec_type>
+using compressed_socket = compressed_socket_impl<codec_type, socket>;
+
+template <typename codec_type>
+using compressed_async_socket =
+    compressed_socket_impl<codec_type, async_socket>;
+
+} // namespace nmpp
+
+#endif // NMPP_COMPRESSION_HPP_
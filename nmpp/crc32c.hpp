@@ -0,0 +1,390 @@
+#ifndef NMPP_CRC32C_HPP_
+#define NMPP_CRC32C_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+namespace nmpp
+{
+
+namespace crc32c_detail
+{
+
+// Reflected Castagnoli polynomial. All functions below work on the raw
+// CRC register, crc32c() adds the pre- and post-inversion.
+constexpr uint32_t polynomial = 0x82f63b78;
+
+// Hardware CRC is computed over three interleaved streams of these many
+// bytes each, hiding the latency of the CRC instruction.
+constexpr size_t long_block = 8192;
+constexpr size_t short_block = 256;
+
+using shift_table = uint32_t[4][256];
+
+// Product of two polynomials modulo the CRC polynomial.
+inline uint32_t multiply(uint32_t a, uint32_t b) noexcept
+{
+  uint32_t product = 0;
+  for (uint32_t bit = 1u << 31; bit != 0; bit >>= 1)
+  {
+    if (a & bit)
+      product ^= b;
+    b = b & 1 ? (b >> 1) ^ polynomial : b >> 1;
+  }
+  return product;
+}
+
+// x^exponent modulo the CRC polynomial.
+inline uint32_t power(uint64_t exponent) noexcept
+{
+  uint32_t result = 1u << 31;
+  uint32_t square = 1u << 30;
+  for (; exponent != 0; exponent >>= 1)
+  {
+    if (exponent & 1)
+      result = multiply(square, result);
+    square = multiply(square, square);
+  }
+  return result;
+}
+
+// x^(8 * bytes) modulo the CRC polynomial.
+inline uint32_t shift_operator(size_t bytes) noexcept
+{
+  return power(8 * static_cast<uint64_t>(bytes));
+}
+
+struct tables
+{
+  uint32_t slice[8][256];
+  shift_table long_shift;
+  shift_table short_shift;
+};
+
+inline void make_shift_table(shift_table& table, size_t bytes) noexcept
+{
+  auto op = shift_operator(bytes);
+  for (int k = 0; k < 4; ++k)
+    for (uint32_t b = 0; b < 256; ++b)
+      table[k][b] = multiply(op, b << (8 * k));
+}
+
+inline const tables& get_tables() noexcept
+{
+  static const tables t = [] {
+    tables result;
+    for (uint32_t n = 0; n < 256; ++n)
+    {
+      auto crc = n;
+      for (int i = 0; i < 8; ++i)
+        crc = crc & 1 ? (crc >> 1) ^ polynomial : crc >> 1;
+      result.slice[0][n] = crc;
+    }
+    for (uint32_t n = 0; n < 256; ++n)
+      for (int k = 1; k < 8; ++k)
+        result.slice[k][n] = (result.slice[k - 1][n] >> 8) ^
+                             result.slice[0][result.slice[k - 1][n] & 0xff];
+    make_shift_table(result.long_shift, long_block);
+    make_shift_table(result.short_shift, short_block);
+    return result;
+  }();
+  return t;
+}
+
+// Moves crc past bytes zero bytes, see make_shift_table.
+inline uint32_t shift(const shift_table& table, uint32_t crc) noexcept
+{
+  return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^
+         table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+}
+
+inline uint64_t load64(const unsigned char* p) noexcept
+{
+  uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+// Slicing-by-8, for CPUs without CRC instructions.
+inline uint32_t software(uint32_t crc, const unsigned char* p,
+                         size_t size) noexcept
+{
+  auto& t = get_tables().slice;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  for (; size >= 8; p += 8, size -= 8)
+  {
+    auto word = load64(p) ^ crc;
+    crc = t[7][word & 0xff] ^ t[6][(word >> 8) & 0xff] ^
+          t[5][(word >> 16) & 0xff] ^ t[4][(word >> 24) & 0xff] ^
+          t[3][(word >> 32) & 0xff] ^ t[2][(word >> 40) & 0xff] ^
+          t[1][(word >> 48) & 0xff] ^ t[0][word >> 56];
+  }
+#endif
+  for (; size != 0; --size)
+    crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+  return crc;
+}
+
+#if defined(__x86_64__)
+#define NMPP_CRC32C_HARDWARE "sse4.2"
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
+
+inline uint32_t step(uint32_t crc, uint64_t value) noexcept
+{
+  return static_cast<uint32_t>(_mm_crc32_u64(crc, value));
+}
+
+inline uint32_t step(uint32_t crc, unsigned char value) noexcept
+{
+  return _mm_crc32_u8(crc, value);
+}
+
+inline bool hardware_supported() noexcept
+{
+  return __builtin_cpu_supports("sse4.2");
+}
+
+#elif defined(__aarch64__)
+#define NMPP_CRC32C_HARDWARE "armv8-crc"
+#pragma GCC push_options
+#pragma GCC target("+crc")
+
+inline uint32_t step(uint32_t crc, uint64_t value) noexcept
+{
+  return __crc32cd(crc, value);
+}
+
+inline uint32_t step(uint32_t crc, unsigned char value) noexcept
+{
+  return __crc32cb(crc, value);
+}
+
+inline bool hardware_supported() noexcept
+{
+  return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+#endif
+
+#ifdef NMPP_CRC32C_HARDWARE
+inline uint32_t interleave(uint32_t crc, const unsigned char* p,
+                           size_t block, const shift_table& table) noexcept
+{
+  uint32_t crc1 = 0;
+  uint32_t crc2 = 0;
+  for (auto end = p + block; p != end; p += 8)
+  {
+    crc = step(crc, load64(p));
+    crc1 = step(crc1, load64(p + block));
+    crc2 = step(crc2, load64(p + 2 * block));
+  }
+  crc = shift(table, crc) ^ crc1;
+  return shift(table, crc) ^ crc2;
+}
+
+inline uint32_t hardware(uint32_t crc, const unsigned char* p,
+                         size_t size) noexcept
+{
+  auto& t = get_tables();
+  for (; size != 0 && reinterpret_cast<uintptr_t>(p) % 8 != 0; --size)
+    crc = step(crc, *p++);
+  for (; size >= 3 * long_block; p += 3 * long_block, size -= 3 * long_block)
+    crc = interleave(crc, p, long_block, t.long_shift);
+  for (; size >= 3 * short_block;
+       p += 3 * short_block, size -= 3 * short_block)
+    crc = interleave(crc, p, short_block, t.short_shift);
+  for (; size >= 8; p += 8, size -= 8)
+    crc = step(crc, load64(p));
+  for (; size != 0; --size)
+    crc = step(crc, *p++);
+  return crc;
+}
+
+#pragma GCC pop_options
+#endif
+
+#if defined(__x86_64__)
+#define NMPP_CRC32C_FOLDING "avx512-vpclmulqdq"
+#pragma GCC push_options
+#pragma GCC target("sse4.2,pclmul,avx512f,vpclmulqdq")
+
+// Bytes folded per iteration: four 64 byte accumulators, each four
+// independent 16 byte lanes.
+constexpr size_t fold_block = 256;
+
+// Multipliers moving a 16 byte lane forward by bytes: x^(8 * bytes + 63)
+// for its first and x^(8 * bytes - 1) for its second eight bytes, bit
+// reflected like the data. A carry-less multiply of reflected operands
+// carries one extra factor x, hence the -1.
+inline long long fold_first(size_t bytes) noexcept
+{
+  return static_cast<long long>(
+      static_cast<uint64_t>(power(8 * static_cast<uint64_t>(bytes) + 63))
+      << 32);
+}
+
+inline long long fold_second(size_t bytes) noexcept
+{
+  return static_cast<long long>(
+      static_cast<uint64_t>(power(8 * static_cast<uint64_t>(bytes) - 1))
+      << 32);
+}
+
+inline __m512i fold_constant4(size_t bytes) noexcept
+{
+  return _mm512_set4_epi64(fold_second(bytes), fold_first(bytes),
+                           fold_second(bytes), fold_first(bytes));
+}
+
+struct fold_constants
+{
+  __m512i by_block;
+  __m512i by_64;
+  __m128i by_16;
+};
+
+inline const fold_constants& get_fold_constants() noexcept
+{
+  static const fold_constants k{
+      fold_constant4(fold_block), fold_constant4(64),
+      _mm_set_epi64x(fold_second(16), fold_first(16))};
+  return k;
+}
+
+// Moves every lane of lanes forward by the distance k was made for and
+// adds data.
+inline __m512i fold(__m512i lanes, __m512i k, __m512i data) noexcept
+{
+  return _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(lanes, k, 0x00),
+                                   _mm512_clmulepi64_epi128(lanes, k, 0x11),
+                                   data, 0x96);
+}
+
+inline __m128i fold(__m128i lane, __m128i k, __m128i data) noexcept
+{
+  return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(lane, k, 0x00),
+                                     _mm_clmulepi64_si128(lane, k, 0x11)),
+                       data);
+}
+
+// Folds the buffer into 16 bytes congruent to it modulo the polynomial,
+// which the CRC instruction then finishes together with the tail.
+inline uint32_t folding(uint32_t crc, const unsigned char* p,
+                        size_t size) noexcept
+{
+  if (size < fold_block)
+    return hardware(crc, p, size);
+  auto& k = get_fold_constants();
+  __m512i x[4];
+  for (int i = 0; i < 4; ++i)
+    x[i] = _mm512_loadu_si512(p + 64 * i);
+  x[0] = _mm512_xor_si512(
+      x[0], _mm512_zextsi128_si512(_mm_cvtsi32_si128(static_cast<int>(crc))));
+  for (p += fold_block, size -= fold_block; size >= fold_block;
+       p += fold_block, size -= fold_block)
+    for (int i = 0; i < 4; ++i)
+      x[i] = fold(x[i], k.by_block, _mm512_loadu_si512(p + 64 * i));
+
+  auto lanes = fold(fold(fold(x[0], k.by_64, x[1]), k.by_64, x[2]), k.by_64,
+                    x[3]);
+  for (; size >= 64; p += 64, size -= 64)
+    lanes = fold(lanes, k.by_64, _mm512_loadu_si512(p));
+  // Zero-masking extracts, GCC warns about the undefined pass-through
+  // operand of the plain ones.
+  auto lane = fold(_mm512_maskz_extracti32x4_epi32(0xf, lanes, 0), k.by_16,
+                   _mm512_maskz_extracti32x4_epi32(0xf, lanes, 1));
+  lane = fold(lane, k.by_16, _mm512_maskz_extracti32x4_epi32(0xf, lanes, 2));
+  lane = fold(lane, k.by_16, _mm512_maskz_extracti32x4_epi32(0xf, lanes, 3));
+
+  crc = step(0u, static_cast<uint64_t>(_mm_cvtsi128_si64(lane)));
+  crc = step(crc, static_cast<uint64_t>(_mm_extract_epi64(lane, 1)));
+  return hardware(crc, p, size);
+}
+
+inline bool folding_supported() noexcept
+{
+  return __builtin_cpu_supports("sse4.2") &&
+         __builtin_cpu_supports("pclmul") &&
+         __builtin_cpu_supports("avx512f") &&
+         __builtin_cpu_supports("vpclmulqdq");
+}
+
+#pragma GCC pop_options
+#endif
+
+using function_type = uint32_t (*)(uint32_t, const unsigned char*, size_t);
+
+inline function_type select() noexcept
+{
+#ifdef NMPP_CRC32C_FOLDING
+  if (folding_supported())
+    return folding;
+#endif
+#ifdef NMPP_CRC32C_HARDWARE
+  if (hardware_supported())
+    return hardware;
+#endif
+  return software;
+}
+
+inline function_type implementation() noexcept
+{
+  static const auto selected = select();
+  return selected;
+}
+
+} // namespace crc32c_detail
+
+// CRC32C (Castagnoli), as used by iSCSI, SCTP and ext4. Checked once at
+// run time, it uses AVX-512 VPCLMULQDQ folding for buffers of 256 bytes
+// and more when the CPU has it, the SSE4.2 or ARMv8 CRC instructions
+// otherwise, and slicing-by-8 tables without either. Pass a previous
+// result as crc to continue a checksum over several buffers.
+//
+// Small payloads do not meet the goal of negligible overhead at 10 GB/s.
+// On a Xeon with AVX-512 folding reaches 22-29 GB/s from 1 KiB and 15-23
+// GB/s at 256 bytes, but below that the latency of the CRC instruction
+// limits it to about 5-6.5 GB/s at 64 bytes. Without VPCLMULQDQ it is
+// 13-16 GB/s from 1 KiB and about 6 GB/s at 64-256 bytes.
+// nanomsg++-crc32c-bench prints the numbers for a machine.
+inline uint32_t crc32c(const void* data, size_t size,
+                       uint32_t crc = 0) noexcept
+{
+  return ~crc32c_detail::implementation()(
+      ~crc, static_cast<const unsigned char*>(data), size);
+}
+
+// Always the table driven implementation, for tests and benchmarks.
+inline uint32_t crc32c_software(const void* data, size_t size,
+                                uint32_t crc = 0) noexcept
+{
+  return ~crc32c_detail::software(
+      ~crc, static_cast<const unsigned char*>(data), size);
+}
+
+// Name of the implementation crc32c() uses on this CPU.
+inline const char* crc32c_implementation() noexcept
+{
+#ifdef NMPP_CRC32C_FOLDING
+  if (crc32c_detail::implementation() == crc32c_detail::folding)
+    return NMPP_CRC32C_FOLDING;
+#endif
+#ifdef NMPP_CRC32C_HARDWARE
+  if (crc32c_detail::implementation() == crc32c_detail::hardware)
+    return NMPP_CRC32C_HARDWARE;
+#endif
+  return "software";
+}
+
+} // namespace nmpp
+
+#endif // NMPP_CRC32C_HPP_
@@ -0,0 +1,219 @@
+#ifndef NMPP_CREDIT_FLOW_HPP_
+#define NMPP_CREDIT_FLOW_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <nmpp/exception.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/socket.hpp>
+#include <stdexcept>
+#include <vector>
+
+namespace nmpp
+{
+
+// What a worker sends over the credit channel: it can take that many more
+// messages. Host byte order, credit flow stays on one machine or between
+// machines of the same endianness.
+struct credit_grant
+{
+  uint32_t worker;
+  uint32_t credits;
+};
+
+// Producer side of credit based work distribution. Every worker gets its
+// own sending socket (e.g. a PUSH connected only to that worker's PULL)
+// and grants credits through a shared side channel (e.g. a PULL every
+// worker's PUSH connects to). A message goes to the worker with the most
+// credits left, so a slow worker stops receiving work once it has its
+// window queued instead of collecting an ever longer backlog like it does
+// under plain NN_PUSH round-robin. Workers with equal credit take turns.
+// Not thread safe.
+template <typename socket_type = socket, typename message_type = message>
+class credit_dispatcher
+{
+public:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  credit_dispatcher(const credit_dispatcher&) = delete;
+  credit_dispatcher& operator=(const credit_dispatcher&) = delete;
+
+  explicit credit_dispatcher(socket_type& grants) noexcept
+      : m_grants(grants), m_next(0)
+  {
+  }
+
+  // Returns the id the worker has to put into its grants.
+  size_t add_worker(socket_type& work)
+  {
+    m_workers.push_back(worker{&work, 0});
+    return m_workers.size() - 1;
+  }
+
+  // Applies every grant already received, without blocking. Returns the
+  // number of grants applied; malformed ones are ignored.
+  size_t update() throw(exception)
+  {
+    size_t applied = 0;
+    while (auto msg = m_grants.template try_receive<message_type>())
+      applied += apply(*msg);
+    return applied;
+  }
+
+  // Sends msg to the worker with the most credits; if that one pushes
+  // back, to the next worker with credit in round-robin order. Returns the
+  // id of the worker that took it, or npos when no worker with credit
+  // could, in which case msg is left untouched.
+  size_t try_dispatch(message_type& msg) throw(std::logic_error, exception)
+  {
+    update();
+    auto chosen = choose();
+    if (chosen == npos)
+      return npos;
+    if (!m_workers[chosen].socket->try_send(msg))
+      chosen = fall_back(msg, chosen);
+    if (chosen == npos)
+      return npos;
+    --m_workers[chosen].credits;
+    m_next = (chosen + 1) % m_workers.size();
+    return chosen;
+  }
+
+  // As try_dispatch(), but blocks on the credit channel until a worker
+  // can take msg.
+  size_t dispatch(message_type& msg) throw(std::logic_error, exception)
+  {
+    throw_when<std::logic_error>(m_workers.empty(), "No workers");
+    while (true)
+    {
+      auto chosen = try_dispatch(msg);
+      if (chosen != npos)
+        return chosen;
+      apply(*m_grants.template receive<message_type>());
+    }
+  }
+
+  uint32_t credits(size_t worker) const noexcept
+  {
+    return worker < m_workers.size() ? m_workers[worker].credits : 0;
+  }
+
+  size_t workers() const noexcept
+  {
+    return m_workers.size();
+  }
+
+private:
+  struct worker
+  {
+    socket_type* socket;
+    uint32_t credits;
+  };
+
+  size_t apply(const message_type& msg) noexcept
+  {
+    credit_grant grant;
+    if (msg.size() != sizeof(grant))
+      return 0;
+    std::memcpy(&grant, msg.data(), sizeof(grant));
+    if (grant.worker >= m_workers.size())
+      return 0;
+    m_workers[grant.worker].credits += grant.credits;
+    return 1;
+  }
+
+  size_t choose() const noexcept
+  {
+    auto chosen = npos;
+    uint32_t most = 0;
+    for (size_t n = 0; n < m_workers.size(); ++n)
+    {
+      auto i = (m_next + n) % m_workers.size();
+      if (m_workers[i].credits > most)
+      {
+        most = m_workers[i].credits;
+        chosen = i;
+      }
+    }
+    return chosen;
+  }
+
+  // Offers msg to the other workers with credit in round-robin order.
+  // Returns the one that took it, or npos.
+  size_t fall_back(message_type& msg,
+                   size_t refused) throw(std::logic_error, exception)
+  {
+    for (size_t n = 0; n < m_workers.size(); ++n)
+    {
+      auto i = (m_next + n) % m_workers.size();
+      if (i != refused && m_workers[i].credits > 0 &&
+          m_workers[i].socket->try_send(msg))
+        return i;
+    }
+    return npos;
+  }
+
+  socket_type& m_grants;
+  std::vector<worker> m_workers;
+  size_t m_next;
+};
+
+template <typename socket_type, typename message_type>
+constexpr size_t credit_dispatcher<socket_type, message_type>::npos;
+
+// Worker side. Grants the initial window on construction; every completed
+// message earns one credit back, sent once batch of them have been
+// collected so the side channel carries a fraction of the work traffic.
+template <typename socket_type = socket> class credit_worker
+{
+public:
+  credit_worker(const credit_worker&) = delete;
+  credit_worker& operator=(const credit_worker&) = delete;
+
+  credit_worker(socket_type& grants, uint32_t id, uint32_t window,
+                uint32_t batch = 1) throw(std::logic_error, exception)
+      : m_grants(grants), m_id(id), m_batch(batch), m_owed(0)
+  {
+    throw_when<std::logic_error>(window == 0 || batch == 0 || batch > window,
+                                 "Invalid credit window");
+    grant(window);
+  }
+
+  void complete(uint32_t count = 1) throw(exception)
+  {
+    m_owed += count;
+    if (m_owed >= m_batch)
+      flush();
+  }
+
+  // Returns credits collected so far, e.g. before the worker idles.
+  void flush() throw(exception)
+  {
+    if (m_owed == 0)
+      return;
+    grant(m_owed);
+    m_owed = 0;
+  }
+
+  uint32_t owed() const noexcept
+  {
+    return m_owed;
+  }
+
+private:
+  void grant(uint32_t credits) throw(exception)
+  {
+    credit_grant g{m_id, credits};
+    m_grants.send(reinterpret_cast<const char*>(&g), sizeof(g));
+  }
+
+  socket_type& m_grants;
+  uint32_t m_id;
+  uint32_t m_batch;
+  uint32_t m_owed;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_CREDIT_FLOW_HPP_
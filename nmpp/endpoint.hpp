@@ -0,0 +1,186 @@
+#ifndef NMPP_ENDPOINT_HPP_
+#define NMPP_ENDPOINT_HPP_
+
+#include <map>
+#include <nmpp/exception.hpp>
+#include <nmpp/socket.hpp>
+#include <string>
+#include <vector>
+
+namespace nmpp
+{
+
+// Owns one endpoint of a socket and removes it with nn_shutdown on
+// destruction, leaving the socket and its other endpoints untouched.
+template <typename socket_type = socket> class endpoint
+{
+public:
+  endpoint(const endpoint&) = delete;
+  endpoint& operator=(const endpoint&) = delete;
+
+  static endpoint bind(socket_type& socket,
+                       const std::string& address) throw(exception)
+  {
+    return endpoint(socket, socket.bind(address));
+  }
+
+  static endpoint connect(socket_type& socket,
+                          const std::string& address) throw(exception)
+  {
+    return endpoint(socket, socket.connect(address));
+  }
+
+  endpoint(socket_type& socket, int id) noexcept : m_socket(&socket), m_id(id)
+  {
+  }
+
+  endpoint(endpoint&& rhs) noexcept : m_socket(nullptr), m_id(-1)
+  {
+    *this = std::move(rhs);
+  }
+
+  endpoint& operator=(endpoint&& rhs) noexcept
+  {
+    cleanup();
+    m_socket = rhs.m_socket;
+    m_id = rhs.m_id;
+    rhs.m_id = -1;
+    return *this;
+  }
+
+  ~endpoint() noexcept
+  {
+    cleanup();
+  }
+
+  void shutdown() throw(exception)
+  {
+    if (m_id < 0)
+      return;
+    auto id = m_id;
+    m_id = -1;
+    m_socket->shutdown(id);
+  }
+
+  int release() noexcept
+  {
+    auto id = m_id;
+    m_id = -1;
+    return id;
+  }
+
+  int id() const noexcept
+  {
+    return m_id;
+  }
+
+  bool valid() const noexcept
+  {
+    return m_id >= 0;
+  }
+
+private:
+  void cleanup() noexcept
+  {
+    try
+    {
+      shutdown();
+    }
+    catch (...)
+    {
+    }
+  }
+
+  socket_type* m_socket;
+  int m_id;
+};
+
+// Set of endpoints of one socket keyed by address. Addresses can be added
+// and removed at runtime without disturbing the remaining endpoints.
+template <typename socket_type = socket> class endpoint_set
+{
+public:
+  explicit endpoint_set(socket_type& socket) noexcept : m_socket(socket)
+  {
+  }
+
+  bool connect(const std::string& address) throw(exception)
+  {
+    if (contains(address))
+      return false;
+    m_endpoints.emplace(address,
+                        endpoint<socket_type>::connect(m_socket, address));
+    return true;
+  }
+
+  bool bind(const std::string& address) throw(exception)
+  {
+    if (contains(address))
+      return false;
+    m_endpoints.emplace(address,
+                        endpoint<socket_type>::bind(m_socket, address));
+    return true;
+  }
+
+  bool remove(const std::string& address) throw(exception)
+  {
+    auto found = m_endpoints.find(address);
+    if (found == m_endpoints.end())
+      return false;
+    auto ep = std::move(found->second);
+    m_endpoints.erase(found);
+    ep.shutdown();
+    return true;
+  }
+
+  // Connects to every address not connected yet and shuts down endpoints
+  // whose address is not listed anymore.
+  void assign(const std::vector<std::string>& addresses) throw(exception)
+  {
+    std::map<std::string, bool> wanted;
+    for (auto& address : addresses)
+      wanted[address] = true;
+
+    for (auto it = m_endpoints.begin(); it != m_endpoints.end();)
+    {
+      if (wanted.count(it->first))
+      {
+        ++it;
+        continue;
+      }
+      auto ep = std::move(it->second);
+      it = m_endpoints.erase(it);
+      ep.shutdown();
+    }
+
+    for (auto& address : addresses)
+      connect(address);
+  }
+
+  bool contains(const std::string& address) const noexcept
+  {
+    return m_endpoints.count(address) != 0;
+  }
+
+  size_t size() const noexcept
+  {
+    return m_endpoints.size();
+  }
+
+  std::vector<std::string> addresses() const
+  {
+    std::vector<std::string> result;
+    result.reserve(m_endpoints.size());
+    for (auto& entry : m_endpoints)
+      result.push_back(entry.first);
+    return result;
+  }
+
+private:
+  socket_type& m_socket;
+  std::map<std::string, endpoint<socket_type>> m_endpoints;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_ENDPOINT_HPP_
@@ -0,0 +1,192 @@
+#ifndef NMPP_EPOLL_REACTOR_HPP_
+#define NMPP_EPOLL_REACTOR_HPP_
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <nmpp/exception.hpp>
+#include <nmpp/reactor_dispatcher.hpp>
+#include <nmpp/reactor_watch.hpp>
+#include <nmpp/socket.hpp>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+namespace nmpp
+{
+
+// Minimal epoll based reactor. Descriptors are registered edge-triggered
+// and one-shot; re-arming them with EPOLL_CTL_MOD makes the kernel
+// re-evaluate readiness, so the level-signalled nanomsg descriptors do not
+// lose wake-ups between two handlers.
+class epoll_reactor
+{
+public:
+  epoll_reactor(const epoll_reactor&) = delete;
+  epoll_reactor& operator=(const epoll_reactor&) = delete;
+
+  explicit epoll_reactor(size_t max_batch = 64) throw(std::system_error)
+      : m_epoll(-1), m_wakeup(-1), m_events(max_batch), m_ready(0),
+        m_next(0), m_pending(0), m_stopped(false)
+  {
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    throw_when<std::system_error>(m_epoll == -1, errno,
+                                  std::system_category(), "epoll_create1");
+    m_wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_wakeup == -1)
+    {
+      auto err = errno;
+      ::close(m_epoll);
+      throw std::system_error(err, std::system_category(), "eventfd");
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &event) == -1)
+    {
+      auto err = errno;
+      ::close(m_wakeup);
+      ::close(m_epoll);
+      throw std::system_error(err, std::system_category(), "epoll_ctl");
+    }
+  }
+
+  ~epoll_reactor() noexcept
+  {
+    ::close(m_wakeup);
+    ::close(m_epoll);
+  }
+
+  void arm(reactor_watch& watch) throw(std::system_error)
+  {
+    epoll_event event{};
+    event.events = (watch.direction == reactor_watch::read ? EPOLLIN
+                                                           : EPOLLOUT) |
+                   EPOLLET | EPOLLONESHOT;
+    event.data.ptr = &watch;
+    auto op = watch.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    throw_when<std::system_error>(epoll_ctl(m_epoll, op, watch.fd, &event) ==
+                                      -1,
+                                  errno, std::system_category(), "epoll_ctl");
+    watch.registered = true;
+    if (!watch.armed)
+    {
+      watch.armed = true;
+      ++m_pending;
+    }
+  }
+
+  void disarm(reactor_watch& watch) noexcept
+  {
+    if (watch.registered)
+    {
+      epoll_ctl(m_epoll, EPOLL_CTL_DEL, watch.fd, nullptr);
+      watch.registered = false;
+    }
+    if (watch.armed)
+    {
+      watch.armed = false;
+      --m_pending;
+    }
+    for (auto i = m_next; i < m_ready; ++i)
+      if (m_events[i].data.ptr == &watch)
+        m_events[i].data.ptr = nullptr;
+  }
+
+  // Waits at most timeout_ms milliseconds (-1 blocks) and dispatches one
+  // batch of at most max_batch ready handlers. Returns handlers executed.
+  size_t run_one(int timeout_ms = -1) throw(std::system_error)
+  {
+    if (m_stopped.load(std::memory_order_acquire))
+      return 0;
+
+    auto ready = epoll_wait(m_epoll, m_events.data(),
+                            static_cast<int>(m_events.size()), timeout_ms);
+    if (ready == -1 && errno == EINTR)
+      return 0;
+    throw_when<std::system_error>(ready == -1, errno, std::system_category(),
+                                  "epoll_wait");
+
+    size_t executed = 0;
+    m_ready = static_cast<size_t>(ready);
+    for (m_next = 0; m_next < m_ready;)
+    {
+      auto watch = static_cast<reactor_watch*>(m_events[m_next++].data.ptr);
+      if (watch == nullptr)
+      {
+        drain_wakeup();
+        continue;
+      }
+      if (!watch->armed)
+        continue;
+      watch->armed = false;
+      --m_pending;
+      auto handler = watch->take();
+      if (watch->waiting())
+        arm(*watch);
+      handler(std::error_code());
+      ++executed;
+    }
+    m_ready = m_next = 0;
+    return executed;
+  }
+
+  // Dispatches handlers until stop() is called or nothing is armed.
+  size_t run() throw(std::system_error)
+  {
+    size_t executed = 0;
+    while (m_pending > 0 && !m_stopped.load(std::memory_order_acquire))
+      executed += run_one(-1);
+    return executed;
+  }
+
+  // Safe to call from any thread.
+  void stop() noexcept
+  {
+    m_stopped.store(true, std::memory_order_release);
+    uint64_t one = 1;
+    auto status = ::write(m_wakeup, &one, sizeof(one));
+    (void)status;
+  }
+
+  void restart() noexcept
+  {
+    m_stopped.store(false, std::memory_order_release);
+  }
+
+  bool stopped() const noexcept
+  {
+    return m_stopped.load(std::memory_order_acquire);
+  }
+
+  size_t pending() const noexcept
+  {
+    return m_pending;
+  }
+
+private:
+  void drain_wakeup() noexcept
+  {
+    uint64_t value;
+    auto status = ::read(m_wakeup, &value, sizeof(value));
+    (void)status;
+  }
+
+  int m_epoll;
+  int m_wakeup;
+  std::vector<epoll_event> m_events;
+  size_t m_ready;
+  size_t m_next;
+  size_t m_pending;
+  std::atomic<bool> m_stopped;
+};
+
+using epoll_async_socket =
+    async_socket_impl<reactor_dispatcher<epoll_reactor>>;
+
+} // namespace nmpp
+
+#endif // NMPP_EPOLL_REACTOR_HPP_
@@ -14,6 +14,10 @@ public:
   {
   }
 
+  explicit exception(int err) noexcept : m_err(err)
+  {
+  }
+
   int num() const noexcept
   {
     return m_err;
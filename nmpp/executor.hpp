@@ -0,0 +1,132 @@
+#ifndef NMPP_EXECUTOR_HPP_
+#define NMPP_EXECUTOR_HPP_
+
+#include <boost/asio.hpp>
+#include <future>
+#include <memory>
+#include <nmpp/exception.hpp>
+#include <nmpp/thread_affinity.hpp>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace nmpp
+{
+
+struct reactor_thread_config
+{
+  // CPUs the thread may run on. When empty and numa_node is set, the thread
+  // is pinned to all CPUs of that node.
+  std::vector<int> cpus;
+  // Node memory allocated by the thread is bound to, -1 leaves it alone.
+  int numa_node = -1;
+};
+
+// Pool of reactor threads, each driving its own io_service with explicit
+// CPU affinity and NUMA memory placement. Sockets created with
+// get_io_service(i) have all their handlers, and therefore the messages
+// those handlers allocate, on thread i. Received messages are not covered:
+// nanomsg allocates their chunks on its own worker threads, outside any
+// reactor's memory policy, and there is no node-local message pool.
+class executor
+{
+public:
+  executor(const executor&) = delete;
+  executor& operator=(const executor&) = delete;
+
+  explicit executor(const std::vector<reactor_thread_config>& configs) throw(
+      std::logic_error, std::system_error)
+  {
+    m_reactors.reserve(configs.size());
+    try
+    {
+      for (auto& config : configs)
+        start(config);
+    }
+    catch (...)
+    {
+      stop();
+      throw;
+    }
+  }
+
+  ~executor() noexcept
+  {
+    stop();
+  }
+
+  boost::asio::io_service& get_io_service(size_t index) throw(
+      std::out_of_range)
+  {
+    return m_reactors.at(index)->io;
+  }
+
+  size_t size() const noexcept
+  {
+    return m_reactors.size();
+  }
+
+  // Runs the handlers already queued on every reactor, then stops it and
+  // joins its thread. Handlers of operations still pending are not run.
+  void stop() noexcept
+  {
+    for (auto& reactor : m_reactors)
+    {
+      reactor->work.reset();
+      auto& io = reactor->io;
+      io.post([&io]() { io.stop(); });
+    }
+    for (auto& reactor : m_reactors)
+    {
+      if (reactor->thread.joinable())
+        reactor->thread.join();
+    }
+  }
+
+private:
+  struct reactor
+  {
+    reactor() : work(new boost::asio::io_service::work(io))
+    {
+    }
+
+    boost::asio::io_service io;
+    std::unique_ptr<boost::asio::io_service::work> work;
+    std::thread thread;
+  };
+
+  void start(const reactor_thread_config& config)
+  {
+    m_reactors.emplace_back(new reactor);
+    auto& io = m_reactors.back()->io;
+
+    std::promise<void> started;
+    auto result = started.get_future();
+    m_reactors.back()->thread = std::thread([&io, &started, config]() {
+      try
+      {
+        auto cpus = config.cpus;
+        if (cpus.empty() && config.numa_node >= 0)
+          cpus = numa_node_cpus(config.numa_node);
+        if (!cpus.empty())
+          pin_current_thread(cpus);
+        if (config.numa_node >= 0)
+          bind_current_thread_memory(config.numa_node);
+      }
+      catch (...)
+      {
+        started.set_exception(std::current_exception());
+        return;
+      }
+      started.set_value();
+      io.run();
+    });
+    result.get();
+  }
+
+  std::vector<std::unique_ptr<reactor>> m_reactors;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_EXECUTOR_HPP_
@@ -0,0 +1,32 @@
+#ifndef NMPP_FWD_HPP_
+#define NMPP_FWD_HPP_
+
+// Forward declarations of the nmpp socket types, for headers that only
+// pass them around by reference or pointer. Default template arguments
+// live here so the defining headers can be included in any order.
+
+namespace nmpp
+{
+
+struct null_tracer;
+struct nanomsg_backend;
+class message;
+class native_socket;
+
+template <typename tracer_type = null_tracer,
+          typename backend_type = nanomsg_backend>
+class basic_socket;
+using socket = basic_socket<>;
+
+template <typename native_socket_type, typename tracer_type = null_tracer>
+class async_dispatcher;
+
+template <typename async_dispatcher_type, typename tracer_type = null_tracer,
+          typename backend_type = nanomsg_backend>
+class async_socket_impl;
+
+using async_socket = async_socket_impl<async_dispatcher<native_socket>>;
+
+} // namespace nmpp
+
+#endif // NMPP_FWD_HPP_
@@ -0,0 +1,231 @@
+#ifndef NMPP_HASH_ROUTER_HPP_
+#define NMPP_HASH_ROUTER_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <nmpp/exception.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/socket.hpp>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace nmpp
+{
+
+// 64 bit FNV-1a followed by the splitmix64 finaliser, so that keys which
+// differ in a single byte still land far apart on the ring. Stable across
+// processes and platforms, unlike std::hash.
+inline uint64_t ring_hash(const void* data, size_t size) noexcept
+{
+  auto bytes = static_cast<const unsigned char*>(data);
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+  hash ^= hash >> 30;
+  hash *= 0xbf58476d1ce4e5b9ULL;
+  hash ^= hash >> 27;
+  hash *= 0x94d049bb133111ebULL;
+  return hash ^ (hash >> 31);
+}
+
+// Consistent hash ring. Every node is placed at virtual_nodes points
+// derived from its name; a key belongs to the first point at or after its
+// own hash. Adding a node only takes over keys from the points it lands
+// in front of, and removing one only hands its own keys to the following
+// points, so about 1/n of the keys move either way. Lookup is a binary
+// search over the sorted points.
+template <typename node_type> class hash_ring
+{
+public:
+  explicit hash_ring(size_t virtual_nodes = 160) throw(std::logic_error)
+      : m_virtual_nodes(virtual_nodes)
+  {
+    throw_when<std::logic_error>(virtual_nodes == 0,
+                                 "Need at least one virtual node");
+  }
+
+  void add(const std::string& name, node_type node)
+  {
+    for (size_t i = 0; i < m_virtual_nodes; ++i)
+      m_points.push_back(point{point_hash(name, i), node});
+    std::sort(m_points.begin(), m_points.end(),
+              [](const point& a, const point& b) { return a.hash < b.hash; });
+  }
+
+  void remove(const std::string& name)
+  {
+    std::vector<uint64_t> hashes;
+    for (size_t i = 0; i < m_virtual_nodes; ++i)
+      hashes.push_back(point_hash(name, i));
+    std::sort(hashes.begin(), hashes.end());
+    m_points.erase(std::remove_if(m_points.begin(), m_points.end(),
+                                  [&hashes](const point& p) {
+                                    return std::binary_search(
+                                        hashes.begin(), hashes.end(), p.hash);
+                                  }),
+                   m_points.end());
+  }
+
+  const node_type& locate(const void* key, size_t size) const
+      throw(std::logic_error)
+  {
+    throw_when<std::logic_error>(m_points.empty(), "Empty hash ring");
+    auto hash = ring_hash(key, size);
+    auto it = std::lower_bound(
+        m_points.begin(), m_points.end(), hash,
+        [](const point& p, uint64_t value) { return p.hash < value; });
+    return it == m_points.end() ? m_points.front().node : it->node;
+  }
+
+  const node_type& locate(const std::string& key) const
+      throw(std::logic_error)
+  {
+    return locate(key.data(), key.size());
+  }
+
+  bool empty() const noexcept
+  {
+    return m_points.empty();
+  }
+
+private:
+  struct point
+  {
+    uint64_t hash;
+    node_type node;
+  };
+
+  static uint64_t point_hash(const std::string& name, size_t index) noexcept
+  {
+    auto hash = ring_hash(name.data(), name.size()) +
+                (index + 1) * 0x9e3779b97f4a7c15ULL;
+    return ring_hash(&hash, sizeof(hash));
+  }
+
+  size_t m_virtual_nodes;
+  std::vector<point> m_points;
+};
+
+// Routes messages by key over a set of owned per-worker sockets, so every
+// message for one key reaches the same worker while the set of workers is
+// unchanged, and a worker joining or leaving only moves its share of keys.
+// Workers are identified by name (e.g. their address), which fixes their
+// place on the ring across restarts. Not thread safe.
+template <typename socket_type = socket> class hash_router
+{
+public:
+  struct worker_stats
+  {
+    std::string name;
+    uint64_t messages;
+    uint64_t bytes;
+  };
+
+  hash_router(const hash_router&) = delete;
+  hash_router& operator=(const hash_router&) = delete;
+
+  explicit hash_router(size_t virtual_nodes = 160) throw(std::logic_error)
+      : m_ring(virtual_nodes)
+  {
+  }
+
+  socket_type& add_worker(const std::string& name,
+                          std::unique_ptr<socket_type> socket) throw(
+      std::logic_error)
+  {
+    throw_when<std::logic_error>(!socket, "Invalid socket");
+    throw_when<std::logic_error>(m_workers.count(name) != 0,
+                                 "Worker already added: " + name);
+    auto& entry = m_workers[name];
+    entry.reset(new worker{name, std::move(socket), 0, 0});
+    m_ring.add(name, entry.get());
+    return *entry->socket;
+  }
+
+  // Returns the worker's socket, null when there is no such worker.
+  std::unique_ptr<socket_type> remove_worker(const std::string& name)
+  {
+    auto it = m_workers.find(name);
+    if (it == m_workers.end())
+      return nullptr;
+    m_ring.remove(name);
+    auto socket = std::move(it->second->socket);
+    m_workers.erase(it);
+    return socket;
+  }
+
+  const std::string& route(const std::string& key) const
+      throw(std::logic_error)
+  {
+    return m_ring.locate(key)->name;
+  }
+
+  // Returns the name of the worker the message went to.
+  template <typename message_type>
+  const std::string& send(const std::string& key,
+                          message_type&& msg) throw(std::logic_error,
+                                                    exception)
+  {
+    auto target = m_ring.locate(key);
+    auto bytes = msg.size();
+    target->socket->send(std::forward<message_type>(msg));
+    target->count(bytes);
+    return target->name;
+  }
+
+  template <typename message_type>
+  bool try_send(const std::string& key,
+                message_type&& msg) throw(std::logic_error, exception)
+  {
+    auto target = m_ring.locate(key);
+    auto bytes = msg.size();
+    if (!target->socket->try_send(std::forward<message_type>(msg)))
+      return false;
+    target->count(bytes);
+    return true;
+  }
+
+  // Per worker traffic since it was added, ordered by name.
+  std::vector<worker_stats> stats() const
+  {
+    std::vector<worker_stats> result;
+    for (auto& entry : m_workers)
+      result.push_back(worker_stats{entry.first, entry.second->messages,
+                                    entry.second->bytes});
+    return result;
+  }
+
+  size_t workers() const noexcept
+  {
+    return m_workers.size();
+  }
+
+private:
+  struct worker
+  {
+    void count(size_t size) noexcept
+    {
+      ++messages;
+      bytes += size;
+    }
+
+    std::string name;
+    std::unique_ptr<socket_type> socket;
+    uint64_t messages;
+    uint64_t bytes;
+  };
+
+  std::map<std::string, std::unique_ptr<worker>> m_workers;
+  hash_ring<worker*> m_ring;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_HASH_ROUTER_HPP_
@@ -0,0 +1,143 @@
+#ifndef NMPP_INTEGRITY_HPP_
+#define NMPP_INTEGRITY_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <nanomsg/nn.h>
+#include <nmpp/crc32c.hpp>
+#include <nmpp/exception.hpp>
+#include <nmpp/socket.hpp>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+namespace nmpp
+{
+
+// Every frame ends with the CRC32C of the payload before it as a little
+// endian 32 bit integer.
+constexpr size_t crc32c_trailer_size = 4;
+
+// Thrown by receive() when a frame fails verification.
+class integrity_error : public std::runtime_error
+{
+public:
+  explicit integrity_error(const std::string& what) : std::runtime_error(what)
+  {
+  }
+};
+
+// Appends a CRC32C trailer to outgoing messages and verifies and strips it
+// on receive, to catch corruption that got past the transport. The trailer
+// is written by growing the message chunk in place and stripped by
+// shortening the received message, so payloads are not copied. Both ends
+// have to use it.
+template <typename socket_type = socket>
+class checksummed_socket_impl : public socket_type
+{
+public:
+  template <typename... Args>
+  checksummed_socket_impl(Args&&... args)
+      : socket_type(std::forward<Args>(args)...), m_corrupted(0)
+  {
+  }
+
+  template <typename message_type>
+  void send(message_type&& msg) throw(std::logic_error, exception)
+  {
+    throw_when<std::logic_error>(!msg.valid(), "Invalid message");
+    socket_type::send(*seal<std::decay_t<message_type>>(msg));
+  }
+
+  template <typename message_type>
+  auto receive() throw(integrity_error, exception)
+  {
+    auto msg = socket_type::template receive<message_type>();
+    auto verified = open(std::move(msg));
+    if (!verified)
+      throw integrity_error("CRC32C mismatch");
+    return verified;
+  }
+
+  template <typename message_type, typename handler_type>
+  void async_send(std::unique_ptr<message_type> msg, handler_type&& handler)
+  {
+    throw_when<std::logic_error>(!msg->valid(), "Invalid message");
+    socket_type::async_send(seal<message_type>(*msg),
+                            std::forward<handler_type>(handler));
+  }
+
+  // Handlers as for async_socket_impl::async_receive. A corrupted message
+  // reaches error-aware handlers as std::errc::bad_message and is dropped
+  // for the others.
+  template <typename message_type, typename handler_type>
+  void async_receive(handler_type&& handler)
+  {
+    socket_type::template async_receive<message_type>(
+        [this, handler](const std::error_code& ec,
+                        std::unique_ptr<message_type> msg) {
+          auto result = ec;
+          if (!ec)
+          {
+            msg = open(std::move(msg));
+            if (!msg)
+              result = std::make_error_code(std::errc::bad_message);
+          }
+          complete_receive(handler, result, std::move(msg));
+        });
+  }
+
+  // Number of received frames that failed verification.
+  uint64_t corrupted() const noexcept
+  {
+    return m_corrupted.load(std::memory_order_relaxed);
+  }
+
+private:
+  template <typename message_type>
+  std::unique_ptr<message_type> seal(message_type& msg)
+  {
+    auto size = msg.size();
+    auto crc = crc32c(msg.data(), size);
+    auto buf = msg.release();
+    auto sealed = reinterpret_cast<char*>(
+        nn_reallocmsg(buf, size + crc32c_trailer_size));
+    if (sealed == nullptr)
+    {
+      nn_freemsg(buf);
+      throw exception();
+    }
+    for (size_t i = 0; i < crc32c_trailer_size; ++i)
+      sealed[size + i] = static_cast<char>((crc >> (8 * i)) & 0xff);
+    return message_type::from_nn(sealed, size + crc32c_trailer_size);
+  }
+
+  // Null when the trailer is missing or does not match.
+  template <typename message_type>
+  std::unique_ptr<message_type> open(std::unique_ptr<message_type> msg)
+  {
+    if (msg->size() >= crc32c_trailer_size)
+    {
+      auto size = msg->size() - crc32c_trailer_size;
+      uint32_t expected = 0;
+      for (size_t i = 0; i < crc32c_trailer_size; ++i)
+        expected |= static_cast<uint32_t>(
+                        static_cast<unsigned char>(msg->data()[size + i]))
+                    << (8 * i);
+      if (crc32c(msg->data(), size) == expected)
+        return message_type::from_nn(msg->release(), size);
+    }
+    m_corrupted.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  std::atomic<uint64_t> m_corrupted;
+};
+
+using checksummed_socket = checksummed_socket_impl<socket>;
+using checksummed_async_socket = checksummed_socket_impl<async_socket>;
+
+} // namespace nmpp
+
+#endif // NMPP_INTEGRITY_HPP_
@@ -0,0 +1,776 @@
+#ifndef NMPP_LOOPBACK_BACKEND_HPP_
+#define NMPP_LOOPBACK_BACKEND_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <nanomsg/nn.h>
+#include <nanomsg/pair.h>
+#include <nanomsg/pipeline.h>
+#include <nmpp/aligned_new.hpp>
+#include <nmpp/mpsc_queue.hpp>
+#include <nmpp/socket.hpp>
+#include <poll.h>
+#include <string>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace nmpp
+{
+
+namespace loopback_detail
+{
+
+constexpr int max_sockets = 512;
+constexpr size_t max_peers = 64;
+constexpr size_t queue_capacity = 1024;
+
+using clock_type = std::chrono::steady_clock;
+
+struct frame
+{
+  char* chunk;
+  size_t size;
+};
+
+// An eventfd that is readable while set.
+class level_fd
+{
+public:
+  level_fd(const level_fd&) = delete;
+  level_fd& operator=(const level_fd&) = delete;
+
+  level_fd() noexcept : m_fd(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+  {
+  }
+
+  ~level_fd() noexcept
+  {
+    if (m_fd != -1)
+      ::close(m_fd);
+  }
+
+  void set() noexcept
+  {
+    uint64_t one = 1;
+    if (::write(m_fd, &one, sizeof(one)) < 0)
+    {
+    }
+  }
+
+  void clear() noexcept
+  {
+    uint64_t value;
+    if (::read(m_fd, &value, sizeof(value)) < 0)
+    {
+    }
+  }
+
+  // False on timeout, timeout in milliseconds or -1. Interrupted waits
+  // return true, callers check their condition again anyway.
+  bool wait(int timeout) const noexcept
+  {
+    pollfd pfd{m_fd, POLLIN, 0};
+    return ::poll(&pfd, 1, timeout) != 0;
+  }
+
+  int fd() const noexcept
+  {
+    return m_fd;
+  }
+
+private:
+  int m_fd;
+};
+
+struct socket_state;
+
+// Receiving side of a socket, fed by any number of peers and drained by
+// the owner. Messages go through the lock-free queue; the lock is only
+// taken on the empty/non-empty edges to keep the descriptor readable
+// exactly while messages are queued. Senders that found it full ask for
+// room and are woken by the next pop. Created with new rather than
+// std::make_shared, which would lose the queue's alignment.
+class inbox : public aligned_new<64>
+{
+public:
+  inbox() : m_queue(queue_capacity), m_signalled(false), m_wanted(false)
+  {
+  }
+
+  ~inbox() noexcept
+  {
+    frame f;
+    while (m_queue.try_pop(f))
+      nn_freemsg(f.chunk);
+  }
+
+  // Leaves f untouched and returns false when full.
+  bool push(frame& f) noexcept
+  {
+    if (!m_queue.try_push(std::move(f)))
+      return false;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!m_signalled.load(std::memory_order_relaxed))
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_signalled.load(std::memory_order_relaxed) && !m_queue.empty())
+        raise();
+    }
+    return true;
+  }
+
+  bool pop(frame& f) noexcept
+  {
+    if (!m_queue.try_pop(f))
+      return false;
+    if (m_queue.empty())
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_signalled.load(std::memory_order_relaxed) && m_queue.empty())
+      {
+        m_readable.clear();
+        m_signalled.store(false, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!m_queue.empty())
+          raise();
+      }
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_wanted.load(std::memory_order_relaxed) && m_wanted.exchange(false))
+      wake_senders();
+    return true;
+  }
+
+  bool has_room() const noexcept
+  {
+    return m_queue.size() < m_queue.capacity();
+  }
+
+  // Makes the next pop wake the subscribed senders. Pairs with the fence
+  // in pop(): either the caller sees the room freed by a pop, or that pop
+  // sees the request.
+  void want_room() noexcept
+  {
+    m_wanted.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  void subscribe(socket_state* sender)
+  {
+    std::lock_guard<std::mutex> lock(m_senders_mutex);
+    if (std::find(m_senders.begin(), m_senders.end(), sender) ==
+        m_senders.end())
+      m_senders.push_back(sender);
+  }
+
+  void unsubscribe(socket_state* sender) noexcept
+  {
+    std::lock_guard<std::mutex> lock(m_senders_mutex);
+    m_senders.erase(std::remove(m_senders.begin(), m_senders.end(), sender),
+                    m_senders.end());
+  }
+
+  const level_fd& readable() const noexcept
+  {
+    return m_readable;
+  }
+
+private:
+  void raise() noexcept
+  {
+    m_readable.set();
+    m_signalled.store(true, std::memory_order_relaxed);
+  }
+
+  void wake_senders() noexcept;
+
+  mpsc_queue<frame> m_queue;
+  level_fd m_readable;
+  std::atomic<bool> m_signalled;
+  std::atomic<bool> m_wanted;
+  std::mutex m_mutex;
+
+  // Sockets routing into this inbox, unsubscribed before they are freed.
+  std::vector<socket_state*> m_senders;
+  std::mutex m_senders_mutex;
+};
+
+// Connection between a bound and a connected endpoint. Keeps both inboxes
+// alive for peers still holding routes into them.
+struct link
+{
+  std::shared_ptr<inbox> inboxes[2];
+  int sockets[2];
+  std::atomic<bool> active;
+};
+
+struct route
+{
+  std::shared_ptr<link> connection;
+  inbox* target;
+};
+
+struct socket_state
+{
+  socket_state(int protocol)
+      : protocol(protocol),
+        in(protocol == NN_PUSH ? nullptr : std::shared_ptr<inbox>(new inbox)),
+        route_count(0), next(0), send_timeout(-1), receive_timeout(-1)
+  {
+    for (auto& r : routes)
+      r.store(nullptr, std::memory_order_relaxed);
+  }
+
+  bool can_send() const noexcept
+  {
+    return protocol != NN_PULL;
+  }
+
+  bool can_receive() const noexcept
+  {
+    return protocol != NN_PUSH;
+  }
+
+  void want_room() noexcept
+  {
+    auto count = route_count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i)
+    {
+      auto r = routes[i].load(std::memory_order_acquire);
+      if (r->connection->active.load(std::memory_order_acquire))
+        r->target->want_room();
+    }
+  }
+
+  bool has_room() const noexcept
+  {
+    auto count = route_count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i)
+    {
+      auto r = routes[i].load(std::memory_order_acquire);
+      if (r->connection->active.load(std::memory_order_acquire) &&
+          r->target->has_room())
+        return true;
+    }
+    return false;
+  }
+
+  // Keeps the send descriptor readable exactly while an active route has
+  // queue room. Before dropping it the full targets are asked to wake this
+  // socket on their next pop, and checked again in case one popped in the
+  // meantime. Serialised, so concurrent refreshes leave the last state.
+  void refresh_sendable() noexcept
+  {
+    std::lock_guard<std::mutex> lock(send_mutex);
+    auto room = has_room();
+    if (!room)
+    {
+      want_room();
+      room = has_room();
+    }
+    if (room && !writable)
+      sendable.set();
+    else if (!room && writable)
+      sendable.clear();
+    writable = room;
+  }
+
+  const int protocol;
+  const std::shared_ptr<inbox> in;
+  level_fd sendable;
+  std::mutex send_mutex;
+  bool writable = false; // Guarded by send_mutex.
+
+  // Read by senders without locking. Slots are only ever replaced, and
+  // replaced routes stay in owned_routes until the socket is closed.
+  std::atomic<route*> routes[max_peers];
+  std::atomic<size_t> route_count;
+  std::atomic<size_t> next;
+  std::atomic<int> send_timeout;
+  std::atomic<int> receive_timeout;
+
+  // Guarded by the registry mutex.
+  std::vector<std::unique_ptr<route>> owned_routes;
+  std::vector<std::pair<int, std::shared_ptr<link>>> links;
+  int next_endpoint = 1;
+  bool has_peer = false;
+};
+
+inline void inbox::wake_senders() noexcept
+{
+  std::lock_guard<std::mutex> lock(m_senders_mutex);
+  for (auto sender : m_senders)
+    sender->refresh_sendable();
+}
+
+class registry
+{
+public:
+  static registry& instance()
+  {
+    static registry r;
+    return r;
+  }
+
+  socket_state* find(int s) const noexcept
+  {
+    if (s < 0 || s >= max_sockets)
+      return nullptr;
+    return m_sockets[s].load(std::memory_order_acquire);
+  }
+
+  int open(int protocol) noexcept
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int s = 0; s < max_sockets; ++s)
+    {
+      if (m_owned[s])
+        continue;
+      std::unique_ptr<socket_state> state;
+      try
+      {
+        state.reset(new socket_state(protocol));
+      }
+      catch (const std::bad_alloc&)
+      {
+        return fail(ENOMEM);
+      }
+      if (state->sendable.fd() == -1 ||
+          (state->in && state->in->readable().fd() == -1))
+        return fail(EMFILE);
+      m_sockets[s].store(state.get(), std::memory_order_release);
+      m_owned[s] = std::move(state);
+      return s;
+    }
+    return fail(EMFILE);
+  }
+
+  int close(int s) noexcept
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto state = find(s);
+    if (!state)
+      return fail(EBADF);
+    for (auto it = m_bound.begin(); it != m_bound.end();)
+      it = it->second.first == s ? m_bound.erase(it) : std::next(it);
+    for (auto it = m_connects.begin(); it != m_connects.end();)
+      it = it->second.first == s ? m_connects.erase(it) : std::next(it);
+    for (auto& l : state->links)
+      disconnect(*l.second);
+    for (auto& r : state->owned_routes)
+      r->target->unsubscribe(state);
+    m_sockets[s].store(nullptr, std::memory_order_release);
+    m_owned[s].reset();
+    return 0;
+  }
+
+  int bind(int s, const std::string& address) noexcept
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto state = find(s);
+    if (!state)
+      return fail(EBADF);
+    if (m_bound.count(address) != 0)
+      return fail(EADDRINUSE);
+    auto endpoint = state->next_endpoint++;
+    m_bound[address] = {s, endpoint};
+    auto range = m_connects.equal_range(address);
+    for (auto it = range.first; it != range.second; ++it)
+      connect(s, endpoint, it->second.first, it->second.second);
+    return endpoint;
+  }
+
+  // Like nanomsg, the connection is made once the address is bound and
+  // made again whenever it is bound anew.
+  int connect(int s, const std::string& address) noexcept
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto state = find(s);
+    if (!state)
+      return fail(EBADF);
+    auto endpoint = state->next_endpoint++;
+    m_connects.emplace(address, std::make_pair(s, endpoint));
+    auto bound = m_bound.find(address);
+    if (bound != m_bound.end())
+      connect(bound->second.first, bound->second.second, s, endpoint);
+    return endpoint;
+  }
+
+  int shutdown(int s, int endpoint) noexcept
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto state = find(s);
+    if (!state)
+      return fail(EBADF);
+    auto found = false;
+    auto matches = [s, endpoint](const std::pair<int, int>& e) {
+      return e.first == s && e.second == endpoint;
+    };
+    for (auto it = m_bound.begin(); it != m_bound.end();)
+    {
+      found |= matches(it->second);
+      it = matches(it->second) ? m_bound.erase(it) : std::next(it);
+    }
+    for (auto it = m_connects.begin(); it != m_connects.end();)
+    {
+      found |= matches(it->second);
+      it = matches(it->second) ? m_connects.erase(it) : std::next(it);
+    }
+    if (!found)
+      return fail(EINVAL);
+    for (auto& l : state->links)
+      if (l.first == endpoint)
+        disconnect(*l.second);
+    return 0;
+  }
+
+  static int fail(int err) noexcept
+  {
+    errno = err;
+    return -1;
+  }
+
+private:
+  registry()
+  {
+    for (auto& s : m_sockets)
+      s.store(nullptr, std::memory_order_relaxed);
+  }
+
+  static bool compatible(int a, int b) noexcept
+  {
+    return (a == NN_PUSH && b == NN_PULL) || (a == NN_PULL && b == NN_PUSH) ||
+           (a == NN_PAIR && b == NN_PAIR);
+  }
+
+  static bool has_slot(const socket_state& state) noexcept
+  {
+    if (!state.can_send())
+      return true;
+    auto count = state.route_count.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i)
+      if (!state.routes[i].load()->connection->active.load())
+        return true;
+    return count < max_peers;
+  }
+
+  void connect(int bound_socket, int bound_endpoint, int connected_socket,
+               int connected_endpoint) noexcept
+  {
+    auto bound = find(bound_socket);
+    auto connected = find(connected_socket);
+    if (!compatible(bound->protocol, connected->protocol) ||
+        !has_slot(*bound) || !has_slot(*connected))
+      return;
+    if (bound->protocol == NN_PAIR && (bound->has_peer || connected->has_peer))
+      return;
+    prune(*bound);
+    prune(*connected);
+    try
+    {
+      auto l = std::make_shared<link>();
+      l->inboxes[0] = bound->in;
+      l->inboxes[1] = connected->in;
+      l->sockets[0] = bound_socket;
+      l->sockets[1] = connected_socket;
+      l->active.store(true);
+      bound->links.emplace_back(bound_endpoint, l);
+      connected->links.emplace_back(connected_endpoint, l);
+      add_route(*bound, l, connected->in.get());
+      add_route(*connected, l, bound->in.get());
+    }
+    catch (const std::bad_alloc&)
+    {
+      return;
+    }
+    update(*bound);
+    update(*connected);
+  }
+
+  void add_route(socket_state& state, const std::shared_ptr<link>& l,
+                 inbox* target)
+  {
+    if (!state.can_send())
+      return;
+    state.owned_routes.emplace_back(new route{l, target});
+    target->subscribe(&state);
+    auto r = state.owned_routes.back().get();
+    auto count = state.route_count.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i)
+    {
+      if (!state.routes[i].load()->connection->active.load())
+      {
+        state.routes[i].store(r, std::memory_order_release);
+        return;
+      }
+    }
+    state.routes[count].store(r, std::memory_order_release);
+    state.route_count.store(count + 1, std::memory_order_release);
+  }
+
+  static void prune(socket_state& state) noexcept
+  {
+    auto& links = state.links;
+    links.erase(std::remove_if(links.begin(), links.end(),
+                               [](const std::pair<int, std::shared_ptr<link>>&
+                                      l) { return !l.second->active.load(); }),
+                links.end());
+  }
+
+  void disconnect(link& l) noexcept
+  {
+    if (!l.active.exchange(false))
+      return;
+    for (auto s : l.sockets)
+      if (auto state = find(s))
+        update(*state);
+  }
+
+  static void update(socket_state& state) noexcept
+  {
+    auto has_peer = false;
+    for (auto& l : state.links)
+      has_peer |= l.second->active.load();
+    state.has_peer = has_peer;
+    if (state.can_send())
+      state.refresh_sendable();
+  }
+
+  std::mutex m_mutex;
+  std::atomic<socket_state*> m_sockets[max_sockets];
+  std::unique_ptr<socket_state> m_owned[max_sockets];
+  std::map<std::string, std::pair<int, int>> m_bound;
+  std::multimap<std::string, std::pair<int, int>> m_connects;
+};
+
+// Milliseconds left until deadline for poll(), -1 without a deadline.
+inline int remaining(int timeout, clock_type::time_point start) noexcept
+{
+  if (timeout < 0)
+    return -1;
+  auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  start + std::chrono::milliseconds(timeout) -
+                  clock_type::now())
+                  .count();
+  return left > 0 ? static_cast<int>(left) : 0;
+}
+
+// Returns the inbox that took the frame, nullptr when every route is full.
+inline inbox* try_route(socket_state& state, frame& f) noexcept
+{
+  auto count = state.route_count.load(std::memory_order_acquire);
+  if (count == 0)
+    return nullptr;
+  auto first = state.next.fetch_add(1, std::memory_order_relaxed);
+  for (size_t i = 0; i < count; ++i)
+  {
+    auto r = state.routes[(first + i) % count].load(std::memory_order_acquire);
+    if (r->connection->active.load(std::memory_order_acquire) &&
+        r->target->push(f))
+      return r->target;
+  }
+  return nullptr;
+}
+
+inline int send_frame(int s, frame& f, int flags) noexcept
+{
+  auto state = registry::instance().find(s);
+  if (!state)
+    return registry::fail(EBADF);
+  if (!state->can_send())
+    return registry::fail(ENOTSUP);
+  auto timeout = state->send_timeout.load(std::memory_order_relaxed);
+  auto start = clock_type::now();
+  inbox* target;
+  while ((target = try_route(*state, f)) == nullptr)
+  {
+    state->refresh_sendable();
+    if (flags & NN_DONTWAIT)
+      return registry::fail(EAGAIN);
+    auto left = remaining(timeout, start);
+    if (left == 0)
+      return registry::fail(ETIMEDOUT);
+    // Blocks until a peer connects or a full peer pops.
+    state->sendable.wait(left);
+  }
+  // Drops the send descriptor as soon as the last room is taken, so async
+  // senders wait instead of blocking in the next send.
+  if (!target->has_room())
+    state->refresh_sendable();
+  return static_cast<int>(f.size);
+}
+
+} // namespace loopback_detail
+
+// In-process transport for PUSH/PULL and PAIR sockets that never touches
+// nanomsg's sockets or threads, for measuring nmpp's own overhead and for
+// high-volume tests. Messages are passed between sockets as nn_allocmsg()
+// chunks through bounded lock-free queues, so sending a message does not
+// copy it.
+//
+// Follows nanomsg's semantics: PUSH round-robins over its peers with free
+// queue space, PULL fair-queues, PAIR takes a single peer, connects may
+// precede the bind and are re-established when the address is bound
+// again, and NN_SNDTIMEO, NN_RCVTIMEO and NN_DONTWAIT behave as usual.
+// NN_RCVFD is an eventfd readable exactly while messages are queued;
+// NN_SNDFD is readable exactly while a peer has queue room. Addresses are plain
+// names whatever their scheme. Any number of threads may send on a
+// socket, but only one at a time may receive.
+struct loopback_backend
+{
+  static int socket(int domain, int protocol) noexcept
+  {
+    if (domain != AF_SP)
+      return loopback_detail::registry::fail(EAFNOSUPPORT);
+    if (protocol != NN_PUSH && protocol != NN_PULL && protocol != NN_PAIR)
+      return loopback_detail::registry::fail(EINVAL);
+    return loopback_detail::registry::instance().open(protocol);
+  }
+
+  static int close(int s) noexcept
+  {
+    return loopback_detail::registry::instance().close(s);
+  }
+
+  static int bind(int s, const char* address) noexcept
+  {
+    return loopback_detail::registry::instance().bind(s, address);
+  }
+
+  static int connect(int s, const char* address) noexcept
+  {
+    return loopback_detail::registry::instance().connect(s, address);
+  }
+
+  static int shutdown(int s, int endpoint) noexcept
+  {
+    return loopback_detail::registry::instance().shutdown(s, endpoint);
+  }
+
+  static int setsockopt(int s, int level, int option, const void* value,
+                        size_t size) noexcept
+  {
+    auto state = loopback_detail::registry::instance().find(s);
+    if (!state)
+      return loopback_detail::registry::fail(EBADF);
+    if (level != NN_SOL_SOCKET)
+      return loopback_detail::registry::fail(ENOPROTOOPT);
+    if (option != NN_SNDTIMEO && option != NN_RCVTIMEO)
+      return 0;
+    if (size != sizeof(int))
+      return loopback_detail::registry::fail(EINVAL);
+    int timeout;
+    std::memcpy(&timeout, value, sizeof(timeout));
+    (option == NN_SNDTIMEO ? state->send_timeout : state->receive_timeout)
+        .store(timeout, std::memory_order_relaxed);
+    return 0;
+  }
+
+  static int getsockopt(int s, int level, int option, void* value,
+                        size_t* size) noexcept
+  {
+    auto state = loopback_detail::registry::instance().find(s);
+    if (!state)
+      return loopback_detail::registry::fail(EBADF);
+    if (level != NN_SOL_SOCKET)
+      return loopback_detail::registry::fail(ENOPROTOOPT);
+    int result;
+    switch (option)
+    {
+    case NN_DOMAIN:
+      result = AF_SP;
+      break;
+    case NN_PROTOCOL:
+      result = state->protocol;
+      break;
+    case NN_SNDTIMEO:
+      result = state->send_timeout.load(std::memory_order_relaxed);
+      break;
+    case NN_RCVTIMEO:
+      result = state->receive_timeout.load(std::memory_order_relaxed);
+      break;
+    case NN_SNDFD:
+      if (!state->can_send())
+        return loopback_detail::registry::fail(ENOPROTOOPT);
+      result = state->sendable.fd();
+      break;
+    case NN_RCVFD:
+      if (!state->can_receive())
+        return loopback_detail::registry::fail(ENOPROTOOPT);
+      result = state->in->readable().fd();
+      break;
+    default:
+      return loopback_detail::registry::fail(ENOPROTOOPT);
+    }
+    std::memcpy(value, &result, std::min(*size, sizeof(result)));
+    *size = sizeof(result);
+    return 0;
+  }
+
+  static int send(int s, const char* data, size_t size, int flags) noexcept
+  {
+    auto chunk = static_cast<char*>(nn_allocmsg(size, 0));
+    if (chunk == nullptr)
+      return loopback_detail::registry::fail(ENOMEM);
+    std::memcpy(chunk, data, size);
+    auto result = send_chunk(s, chunk, size, flags);
+    if (result == -1)
+    {
+      auto err = errno;
+      nn_freemsg(chunk);
+      errno = err;
+    }
+    return result;
+  }
+
+  static int send_chunk(int s, char* chunk, size_t size, int flags) noexcept
+  {
+    loopback_detail::frame f{chunk, size};
+    return loopback_detail::send_frame(s, f, flags);
+  }
+
+  static int receive_chunk(int s, char** chunk, int flags) noexcept
+  {
+    auto state = loopback_detail::registry::instance().find(s);
+    if (!state)
+      return loopback_detail::registry::fail(EBADF);
+    if (!state->can_receive())
+      return loopback_detail::registry::fail(ENOTSUP);
+    auto timeout = state->receive_timeout.load(std::memory_order_relaxed);
+    auto start = loopback_detail::clock_type::now();
+    loopback_detail::frame f;
+    while (!state->in->pop(f))
+    {
+      if (flags & NN_DONTWAIT)
+        return loopback_detail::registry::fail(EAGAIN);
+      auto left = loopback_detail::remaining(timeout, start);
+      if (left == 0 || !state->in->readable().wait(left))
+        return loopback_detail::registry::fail(ETIMEDOUT);
+    }
+    *chunk = f.chunk;
+    return static_cast<int>(f.size);
+  }
+
+  static int error() noexcept
+  {
+    return errno;
+  }
+};
+
+using loopback_socket = basic_socket<null_tracer, loopback_backend>;
+using loopback_async_socket =
+    async_socket_impl<async_dispatcher<native_socket>, null_tracer,
+                      loopback_backend>;
+
+} // namespace nmpp
+
+#endif // NMPP_LOOPBACK_BACKEND_HPP_
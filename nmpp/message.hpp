@@ -4,6 +4,7 @@
 #include <memory>
 #include <nanomsg/nn.h>
 #include <nmpp/exception.hpp>
+#include <stdexcept>
 
 namespace nmpp
 {
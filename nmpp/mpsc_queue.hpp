@@ -0,0 +1,134 @@
+#ifndef NMPP_MPSC_QUEUE_HPP_
+#define NMPP_MPSC_QUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <nmpp/aligned_new.hpp>
+#include <nmpp/exception.hpp>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace nmpp
+{
+
+// Bounded lock-free ring for any number of producer threads and a single
+// consumer. Every cell carries a sequence number telling whether it is
+// free for the producer claiming that position or holds a value for the
+// consumer, so producers only contend on one compare-and-swap of the tail
+// and never wait for each other to finish writing. The capacity is rounded
+// up to a power of two. Allocated with new, the queue gets cache-line
+// aligned memory from aligned_new.
+template <typename value_type>
+class mpsc_queue : public aligned_new<64>
+{
+  static constexpr size_t cache_line = 64;
+
+public:
+  mpsc_queue(const mpsc_queue&) = delete;
+  mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+  explicit mpsc_queue(size_t capacity) throw(std::logic_error)
+      : m_mask(round_up(capacity) - 1), m_cells(new cell[m_mask + 1])
+  {
+    throw_when<std::logic_error>(capacity == 0, "Queue capacity must be > 0");
+    for (size_t i = 0; i <= m_mask; ++i)
+      m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    m_tail.index.store(0, std::memory_order_relaxed);
+    m_head.index.store(0, std::memory_order_relaxed);
+  }
+
+  // Any thread. Leaves value untouched and returns false when full.
+  bool try_push(value_type&& value) noexcept(
+      std::is_nothrow_move_assignable<value_type>::value)
+  {
+    auto pos = m_tail.index.load(std::memory_order_relaxed);
+    cell* target;
+    while (true)
+    {
+      target = &m_cells[pos & m_mask];
+      auto sequence = target->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+      if (diff == 0)
+      {
+        if (m_tail.index.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+        return false;
+      else
+        pos = m_tail.index.load(std::memory_order_relaxed);
+    }
+    target->value = std::move(value);
+    target->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer thread only. Returns false when empty, or when the oldest
+  // claimed cell is still being written.
+  bool try_pop(value_type& value) noexcept(
+      std::is_nothrow_move_assignable<value_type>::value)
+  {
+    auto pos = m_head.index.load(std::memory_order_relaxed);
+    auto& source = m_cells[pos & m_mask];
+    if (source.sequence.load(std::memory_order_acquire) != pos + 1)
+      return false;
+    value = std::move(source.value);
+    source.sequence.store(pos + m_mask + 1, std::memory_order_release);
+    m_head.index.store(pos + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Approximate when called while producers are active.
+  size_t size() const noexcept
+  {
+    auto head = m_head.index.load(std::memory_order_relaxed);
+    auto tail = m_tail.index.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+  bool empty() const noexcept
+  {
+    return size() == 0;
+  }
+
+  size_t capacity() const noexcept
+  {
+    return m_mask + 1;
+  }
+
+private:
+  struct cell
+  {
+    std::atomic<size_t> sequence;
+    value_type value;
+  };
+
+  struct alignas(cache_line) side
+  {
+    std::atomic<size_t> index;
+  };
+
+  static size_t round_up(size_t capacity) noexcept
+  {
+    size_t rounded = 1;
+    while (rounded < capacity)
+      rounded <<= 1;
+    return rounded;
+  }
+
+  side m_tail;
+  side m_head;
+  size_t m_mask;
+  std::unique_ptr<cell[]> m_cells;
+};
+
+template <typename value_type>
+constexpr size_t mpsc_queue<value_type>::cache_line;
+
+} // namespace nmpp
+
+#endif // NMPP_MPSC_QUEUE_HPP_
@@ -0,0 +1,79 @@
+#ifndef NMPP_NANOMSG_BACKEND_HPP_
+#define NMPP_NANOMSG_BACKEND_HPP_
+
+#include <cstddef>
+#include <nanomsg/nn.h>
+
+namespace nmpp
+{
+
+// Transport backend of basic_socket, forwarding to libnanomsg. A backend
+// mirrors the nn_* socket calls: every function returns -1 on failure and
+// error() gives the reason. Messages are always nn_allocmsg() chunks, so
+// nmpp::message can own whatever a backend hands out.
+struct nanomsg_backend
+{
+  static int socket(int domain, int protocol) noexcept
+  {
+    return nn_socket(domain, protocol);
+  }
+
+  static int close(int s) noexcept
+  {
+    return nn_close(s);
+  }
+
+  static int bind(int s, const char* address) noexcept
+  {
+    return nn_bind(s, address);
+  }
+
+  static int connect(int s, const char* address) noexcept
+  {
+    return nn_connect(s, address);
+  }
+
+  static int shutdown(int s, int endpoint) noexcept
+  {
+    return nn_shutdown(s, endpoint);
+  }
+
+  static int setsockopt(int s, int level, int option, const void* value,
+                        size_t size) noexcept
+  {
+    return nn_setsockopt(s, level, option, value, size);
+  }
+
+  static int getsockopt(int s, int level, int option, void* value,
+                        size_t* size) noexcept
+  {
+    return nn_getsockopt(s, level, option, value, size);
+  }
+
+  // Sends a copy of the buffer.
+  static int send(int s, const char* data, size_t size, int flags) noexcept
+  {
+    return nn_send(s, data, size, flags);
+  }
+
+  // Sends a chunk of size bytes, taking ownership of it on success.
+  static int send_chunk(int s, char* chunk, size_t, int flags) noexcept
+  {
+    return nn_send(s, &chunk, NN_MSG, flags);
+  }
+
+  // Stores a chunk the caller has to free in chunk, returns its size.
+  static int receive_chunk(int s, char** chunk, int flags) noexcept
+  {
+    return nn_recv(s, chunk, NN_MSG, flags);
+  }
+
+  static int error() noexcept
+  {
+    return nn_errno();
+  }
+};
+
+} // namespace nmpp
+
+#endif // NMPP_NANOMSG_BACKEND_HPP_
@@ -1,8 +1,9 @@
 #ifndef NMPP_NATIVE_SOCKET_HPP
 #define NMPP_NATIVE_SOCKET_HPP
 
-#include <boost/asio.hpp>
-#include <boost/function.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
 
 namespace nmpp
 {
@@ -41,6 +42,13 @@ public:
                             std::forward<handler_type>(handler));
   }
 
+  // Completes pending waits with boost::asio::error::operation_aborted.
+  void cancel()
+  {
+    boost::system::error_code ignored;
+    socket.cancel(ignored);
+  }
+
   native_handle_type native_handle()
   {
     return socket.native_handle();
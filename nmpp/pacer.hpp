@@ -0,0 +1,294 @@
+#ifndef NMPP_PACER_HPP_
+#define NMPP_PACER_HPP_
+
+#include <algorithm>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <nmpp/exception.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/socket.hpp>
+#include <stdexcept>
+#include <system_error>
+
+namespace nmpp
+{
+
+// Rates are per second, a rate of zero leaves that dimension unlimited.
+// A full bucket lets burst messages or bytes out back to back.
+struct pacer_limits
+{
+  double messages_per_second;
+  double message_burst;
+  double bytes_per_second;
+  double byte_burst;
+};
+
+struct pacer_stats
+{
+  uint64_t sent;
+  uint64_t bytes;
+  // Messages that reached the head of the queue while the bucket was
+  // short and had to wait for tokens.
+  uint64_t delayed;
+  size_t pending;
+  double message_tokens;
+  double byte_tokens;
+};
+
+// Paces an async socket with a token bucket for messages and one for
+// bytes, instead of sending as fast as the socket is writable. Uses a
+// single timer: while the bucket is short it is set for the moment the
+// message at the head of the queue may go, otherwise the pacer waits for
+// the socket to be writable and sends with try_send() as far as the
+// tokens allow. A message larger than the byte burst goes out once the
+// bucket is full and leaves it in debt. Not thread safe, use from the
+// thread running the dispatcher. Destroying the pacer drops its queued
+// messages without running their handlers; a writable wait still pending
+// finishes later and does nothing.
+template <typename async_socket_type, typename message_type = message,
+          typename clock_type = std::chrono::steady_clock,
+          typename timer_type = boost::asio::basic_waitable_timer<clock_type>>
+class pacer
+{
+public:
+  using handler_type = std::function<void(const std::error_code&, size_t)>;
+  using duration = typename clock_type::duration;
+  using time_point = typename clock_type::time_point;
+
+  pacer(const pacer&) = delete;
+  pacer& operator=(const pacer&) = delete;
+
+  pacer(async_socket_type& socket, boost::asio::io_service& io,
+        const pacer_limits& limits) throw(std::logic_error)
+      : m_socket(socket),
+        m_timer(io),
+        m_limits(limits),
+        m_message_tokens(limits.message_burst),
+        m_byte_tokens(limits.byte_burst),
+        m_last(clock_type::now()),
+        m_state(state::idle),
+        m_sent(0),
+        m_bytes(0),
+        m_delayed(0),
+        m_alive(std::make_shared<bool>(true))
+  {
+    throw_when<std::logic_error>(
+        limits.messages_per_second < 0 || limits.bytes_per_second < 0,
+        "Rates must be >= 0");
+    throw_when<std::logic_error>(limits.messages_per_second > 0 &&
+                                     limits.message_burst < 1,
+                                 "Message burst must be >= 1");
+    throw_when<std::logic_error>(
+        limits.bytes_per_second > 0 && limits.byte_burst <= 0,
+        "Byte burst must be > 0");
+  }
+
+  ~pacer() noexcept
+  {
+    *m_alive = false;
+  }
+
+  // handler(ec, bytes) runs once the message went out or failed.
+  void async_send(std::unique_ptr<message_type> msg,
+                  handler_type handler) throw(std::logic_error)
+  {
+    throw_when<std::logic_error>(!msg || !msg->valid(), "Invalid message");
+    m_queue.push_back(entry{std::move(msg), std::move(handler), false});
+    if (m_state == state::idle)
+      pump();
+  }
+
+  size_t pending() const noexcept
+  {
+    return m_queue.size();
+  }
+
+  // Token levels as of now.
+  pacer_stats stats() const
+  {
+    auto seconds = elapsed(clock_type::now());
+    return pacer_stats{
+        m_sent,
+        m_bytes,
+        m_delayed,
+        m_queue.size(),
+        level(m_message_tokens, m_limits.messages_per_second,
+              m_limits.message_burst, seconds),
+        level(m_byte_tokens, m_limits.bytes_per_second, m_limits.byte_burst,
+              seconds)};
+  }
+
+private:
+  enum class state
+  {
+    idle,
+    writable,
+    timer
+  };
+
+  struct entry
+  {
+    std::unique_ptr<message_type> msg;
+    handler_type handler;
+    bool delayed;
+  };
+
+  // Arms the timer or the writable wait for the head of the queue.
+  void pump()
+  {
+    m_state = state::idle;
+    if (m_queue.empty())
+      return;
+    refill(clock_type::now());
+    auto wait = shortfall(m_queue.front().msg->size());
+    if (wait > duration::zero())
+    {
+      if (!m_queue.front().delayed)
+      {
+        m_queue.front().delayed = true;
+        ++m_delayed;
+      }
+      m_state = state::timer;
+      m_timer.expires_at(m_last + wait);
+      // Only cancelled by the timer's destructor, an error means this
+      // object is gone.
+      m_timer.async_wait([this](const boost::system::error_code& ec) {
+        if (!ec)
+          pump();
+      });
+      return;
+    }
+    m_state = state::writable;
+    wait_writable();
+  }
+
+  // The wait may complete after this object is gone, see the destructor.
+  void wait_writable()
+  {
+    m_socket.async_wait_send(
+        [this, alive = m_alive](const std::error_code& ec) {
+          if (*alive)
+            on_writable(ec);
+        });
+  }
+
+  void on_writable(const std::error_code& ec)
+  {
+    if (ec)
+    {
+      fail_all(ec);
+      return;
+    }
+    refill(clock_type::now());
+    while (!m_queue.empty() &&
+           shortfall(m_queue.front().msg->size()) == duration::zero())
+    {
+      auto bytes = m_queue.front().msg->size();
+      std::error_code result;
+      try
+      {
+        if (!m_socket.try_send(*m_queue.front().msg))
+        {
+          wait_writable();
+          return;
+        }
+        take(bytes);
+      }
+      catch (const exception& e)
+      {
+        result = std::error_code(e.num(), std::system_category());
+        bytes = 0;
+      }
+
+      auto done = std::move(m_queue.front());
+      m_queue.pop_front();
+      done.handler(result, bytes);
+    }
+    pump();
+  }
+
+  void take(size_t bytes) noexcept
+  {
+    if (m_limits.messages_per_second > 0)
+      m_message_tokens -= 1;
+    if (m_limits.bytes_per_second > 0)
+      m_byte_tokens -= bytes;
+    ++m_sent;
+    m_bytes += bytes;
+  }
+
+  // Time until a message of size bytes may go, zero if it may go now.
+  duration shortfall(size_t size) const noexcept
+  {
+    double seconds = 0;
+    if (m_limits.messages_per_second > 0 && m_message_tokens < 1)
+      seconds = (1 - m_message_tokens) / m_limits.messages_per_second;
+    if (m_limits.bytes_per_second > 0)
+    {
+      auto needed = std::min(static_cast<double>(size), m_limits.byte_burst);
+      if (m_byte_tokens < needed)
+        seconds = std::max(seconds, (needed - m_byte_tokens) /
+                                        m_limits.bytes_per_second);
+    }
+    if (seconds == 0)
+      return duration::zero();
+    // Rounded up, so the bucket is full enough once the timer fires.
+    return std::chrono::duration_cast<duration>(
+               std::chrono::duration<double>(seconds)) +
+           duration(1);
+  }
+
+  void refill(time_point now) noexcept
+  {
+    auto seconds = elapsed(now);
+    m_message_tokens = level(m_message_tokens, m_limits.messages_per_second,
+                             m_limits.message_burst, seconds);
+    m_byte_tokens = level(m_byte_tokens, m_limits.bytes_per_second,
+                          m_limits.byte_burst, seconds);
+    m_last = std::max(m_last, now);
+  }
+
+  double elapsed(time_point now) const noexcept
+  {
+    return now > m_last ? std::chrono::duration<double>(now - m_last).count()
+                        : 0;
+  }
+
+  static double level(double tokens, double rate, double burst,
+                      double seconds) noexcept
+  {
+    return rate > 0 ? std::min(burst, tokens + rate * seconds) : tokens;
+  }
+
+  // Handlers may queue new messages, those are paced as usual.
+  void fail_all(const std::error_code& ec)
+  {
+    std::deque<entry> failed;
+    failed.swap(m_queue);
+    m_state = state::idle;
+    for (auto& done : failed)
+      done.handler(ec, 0);
+  }
+
+  async_socket_type& m_socket;
+  timer_type m_timer;
+  pacer_limits m_limits;
+  double m_message_tokens;
+  double m_byte_tokens;
+  time_point m_last;
+  state m_state;
+  std::deque<entry> m_queue;
+  uint64_t m_sent;
+  uint64_t m_bytes;
+  uint64_t m_delayed;
+  std::shared_ptr<bool> m_alive;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_PACER_HPP_
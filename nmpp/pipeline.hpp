@@ -0,0 +1,350 @@
+#ifndef NMPP_PIPELINE_HPP_
+#define NMPP_PIPELINE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <nmpp/exception.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/socket.hpp>
+#include <nmpp/spin_receiver.hpp>
+#include <nmpp/spsc_queue.hpp>
+#include <nmpp/thread_affinity.hpp>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace nmpp
+{
+
+// Counters of one pipeline stage. The source has no input queue.
+struct stage_stats
+{
+  std::string name;
+  uint64_t processed;
+  uint64_t dropped;
+  double rate;
+  size_t queued;
+  size_t capacity;
+};
+
+// Source socket -> user stages -> sink socket, every step on its own,
+// optionally pinned thread. Neighbouring steps are linked by bounded
+// spsc_queues carrying std::unique_ptr<message_type>, so a message travels
+// the whole pipeline without being copied or locked. A full queue pushes
+// back on the step feeding it, and eventually on the source socket.
+//
+// A stage takes a message and returns the one to pass on, which may be the
+// same one modified in place; returning null drops it. The first exception
+// thrown by a stage or a socket stops the whole pipeline and is rethrown
+// by stop() or abort().
+template <typename socket_type = socket, typename message_type = message,
+          typename backoff_type = pause_backoff>
+class pipeline
+{
+public:
+  using message_ptr = std::unique_ptr<message_type>;
+  using stage_type = std::function<message_ptr(message_ptr)>;
+
+  pipeline(const pipeline&) = delete;
+  pipeline& operator=(const pipeline&) = delete;
+
+  pipeline(socket_type& source, socket_type& sink,
+           size_t queue_capacity = 1024,
+           backoff_type backoff = backoff_type()) noexcept
+      : m_source(source),
+        m_sink(sink),
+        m_queue_capacity(queue_capacity),
+        m_backoff(backoff),
+        m_stopping(false),
+        m_aborted(false)
+  {
+  }
+
+  ~pipeline() noexcept
+  {
+    m_aborted.store(true, std::memory_order_relaxed);
+    join();
+  }
+
+  // Appends a stage before the sink. Only before start().
+  pipeline& add_stage(std::string name, stage_type stage,
+                      int cpu = -1) throw(std::logic_error)
+  {
+    throw_when<std::logic_error>(!m_threads.empty(), "Already started");
+    throw_when<std::logic_error>(!stage, "Empty stage");
+    m_stages.push_back(step{std::move(name), std::move(stage), cpu});
+    return *this;
+  }
+
+  // Starts the source, every stage and the sink. Throws when pinning one
+  // of the threads fails, in which case nothing keeps running.
+  void start(int source_cpu = -1, int sink_cpu = -1) throw(std::logic_error,
+                                                          std::system_error)
+  {
+    throw_when<std::logic_error>(!m_threads.empty(), "Already started");
+
+    m_queues.clear();
+    m_nodes.clear();
+    for (size_t i = 0; i <= m_stages.size(); ++i)
+      m_queues.emplace_back(new queue_type(m_queue_capacity));
+    for (size_t i = 0; i < m_stages.size() + 2; ++i)
+      m_nodes.emplace_back(new node);
+    m_stopping.store(false, std::memory_order_relaxed);
+    m_aborted.store(false, std::memory_order_relaxed);
+    m_error = nullptr;
+    m_started = std::chrono::steady_clock::now();
+
+    try
+    {
+      launch(source_cpu, [this] { run_source(); });
+      for (size_t i = 0; i < m_stages.size(); ++i)
+        launch(m_stages[i].cpu, [this, i] { run_stage(i); });
+      launch(sink_cpu, [this] { run_sink(); });
+    }
+    catch (...)
+    {
+      m_aborted.store(true, std::memory_order_relaxed);
+      join();
+      throw;
+    }
+  }
+
+  // Stops receiving, lets every queued message go through the remaining
+  // stages and out of the sink, then joins all threads. Blocks for as long
+  // as the sink cannot send.
+  void stop()
+  {
+    m_stopping.store(true, std::memory_order_relaxed);
+    finish();
+  }
+
+  // Stops every thread as soon as possible, discarding queued messages.
+  void abort()
+  {
+    m_aborted.store(true, std::memory_order_relaxed);
+    finish();
+  }
+
+  bool running() const noexcept
+  {
+    return !m_threads.empty() && !m_aborted.load(std::memory_order_relaxed);
+  }
+
+  // Source first, sink last. Rates are per second since start(), queue
+  // occupancy is sampled while the pipeline runs.
+  std::vector<stage_stats> stats() const
+  {
+    std::vector<stage_stats> result;
+    auto end = m_nodes.empty() || !m_threads.empty()
+                   ? std::chrono::steady_clock::now()
+                   : m_stopped;
+    auto seconds = std::chrono::duration<double>(end - m_started).count();
+    for (size_t i = 0; i < m_nodes.size(); ++i)
+    {
+      stage_stats s;
+      s.name = i == 0 ? "source"
+                      : i == m_nodes.size() - 1 ? "sink" : m_stages[i - 1].name;
+      s.processed = m_nodes[i]->processed.load(std::memory_order_relaxed);
+      s.dropped = m_nodes[i]->dropped.load(std::memory_order_relaxed);
+      s.rate = seconds > 0 ? s.processed / seconds : 0;
+      s.queued = i == 0 ? 0 : m_queues[i - 1]->size();
+      s.capacity = i == 0 ? 0 : m_queues[i - 1]->capacity();
+      result.push_back(std::move(s));
+    }
+    return result;
+  }
+
+private:
+  using queue_type = spsc_queue<message_ptr>;
+
+  struct step
+  {
+    std::string name;
+    stage_type stage;
+    int cpu;
+  };
+
+  // Written by one thread only; finished tells the next step that its
+  // input queue will not grow any more.
+  struct node
+  {
+    std::atomic<uint64_t> processed{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> finished{false};
+  };
+
+  template <typename body_type> void launch(int cpu, body_type body)
+  {
+    std::promise<void> started;
+    auto result = started.get_future();
+    auto index = m_threads.size();
+    m_threads.emplace_back([this, cpu, index, &started, body]() {
+      try
+      {
+        if (cpu >= 0)
+          pin_current_thread(cpu);
+      }
+      catch (...)
+      {
+        m_nodes[index]->finished.store(true, std::memory_order_release);
+        started.set_exception(std::current_exception());
+        return;
+      }
+      started.set_value();
+      try
+      {
+        body();
+      }
+      catch (...)
+      {
+        fail(std::current_exception());
+      }
+      m_nodes[index]->finished.store(true, std::memory_order_release);
+    });
+    result.get();
+  }
+
+  void run_source()
+  {
+    auto backoff = m_backoff;
+    auto& out = *m_queues.front();
+    auto& stats = *m_nodes.front();
+    while (!m_stopping.load(std::memory_order_relaxed) &&
+           !m_aborted.load(std::memory_order_relaxed))
+    {
+      auto msg = m_source.template try_receive<message_type>();
+      if (!msg)
+      {
+        backoff.idle();
+        continue;
+      }
+      backoff.reset();
+      stats.processed.fetch_add(1, std::memory_order_relaxed);
+      if (!push(out, std::move(msg), backoff))
+        return;
+    }
+  }
+
+  void run_stage(size_t index)
+  {
+    auto backoff = m_backoff;
+    auto& stage = m_stages[index].stage;
+    auto& out = *m_queues[index + 1];
+    auto& stats = *m_nodes[index + 1];
+    message_ptr msg;
+    while (pop(index, msg, backoff))
+    {
+      msg = stage(std::move(msg));
+      if (!msg)
+      {
+        stats.dropped.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      stats.processed.fetch_add(1, std::memory_order_relaxed);
+      if (!push(out, std::move(msg), backoff))
+        return;
+    }
+  }
+
+  void run_sink()
+  {
+    auto backoff = m_backoff;
+    auto& stats = *m_nodes.back();
+    message_ptr msg;
+    while (pop(m_stages.size(), msg, backoff))
+    {
+      while (!m_sink.try_send(*msg))
+      {
+        if (m_aborted.load(std::memory_order_relaxed))
+          return;
+        backoff.idle();
+      }
+      backoff.reset();
+      stats.processed.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  bool push(queue_type& out, message_ptr msg, backoff_type& backoff)
+  {
+    while (!out.try_push(std::move(msg)))
+    {
+      if (m_aborted.load(std::memory_order_relaxed))
+        return false;
+      backoff.idle();
+    }
+    return true;
+  }
+
+  // Waits for the next message from queue index. Returns false once the
+  // step feeding it has finished and the queue is drained, or on abort.
+  bool pop(size_t index, message_ptr& msg, backoff_type& backoff)
+  {
+    auto& in = *m_queues[index];
+    auto& upstream = *m_nodes[index];
+    while (!m_aborted.load(std::memory_order_relaxed))
+    {
+      if (in.try_pop(msg))
+      {
+        backoff.reset();
+        return true;
+      }
+      if (upstream.finished.load(std::memory_order_acquire))
+        return in.try_pop(msg);
+      backoff.idle();
+    }
+    return false;
+  }
+
+  void fail(std::exception_ptr error) noexcept
+  {
+    std::lock_guard<std::mutex> lock(m_error_mutex);
+    if (!m_error)
+      m_error = error;
+    m_aborted.store(true, std::memory_order_relaxed);
+  }
+
+  void join() noexcept
+  {
+    for (auto& thread : m_threads)
+      if (thread.joinable())
+        thread.join();
+    if (!m_threads.empty())
+      m_stopped = std::chrono::steady_clock::now();
+    m_threads.clear();
+  }
+
+  void finish()
+  {
+    join();
+    if (m_error)
+      std::rethrow_exception(std::exchange(m_error, nullptr));
+  }
+
+  socket_type& m_source;
+  socket_type& m_sink;
+  size_t m_queue_capacity;
+  backoff_type m_backoff;
+  std::vector<step> m_stages;
+  std::vector<std::unique_ptr<queue_type>> m_queues;
+  std::vector<std::unique_ptr<node>> m_nodes;
+  std::vector<std::thread> m_threads;
+  std::atomic<bool> m_stopping;
+  std::atomic<bool> m_aborted;
+  std::mutex m_error_mutex;
+  std::exception_ptr m_error;
+  std::chrono::steady_clock::time_point m_started;
+  std::chrono::steady_clock::time_point m_stopped;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_PIPELINE_HPP_
@@ -0,0 +1,130 @@
+#ifndef NMPP_POLLER_HPP_
+#define NMPP_POLLER_HPP_
+
+#include <algorithm>
+#include <nanomsg/nn.h>
+#include <nmpp/exception.hpp>
+#include <nmpp/socket.hpp>
+#include <stdexcept>
+#include <vector>
+
+namespace nmpp
+{
+
+// Synchronous readiness poller over many sockets built on nn_poll. All
+// storage is reserved when sockets are added, wait() does not allocate.
+template <typename socket_type = socket> class poller
+{
+public:
+  enum event_type : short
+  {
+    in = NN_POLLIN,
+    out = NN_POLLOUT
+  };
+
+  struct ready_entry
+  {
+    socket_type* socket;
+    short events;
+
+    bool readable() const noexcept
+    {
+      return events & NN_POLLIN;
+    }
+
+    bool writable() const noexcept
+    {
+      return events & NN_POLLOUT;
+    }
+  };
+
+  void add(socket_type& socket, short events) throw(std::logic_error)
+  {
+    throw_when<std::logic_error>(find(socket) != m_sockets.size(),
+                                 "Socket already registered");
+    m_fds.push_back(nn_pollfd{socket.native_handle(), events, 0});
+    m_sockets.push_back(&socket);
+    m_ready.reserve(m_sockets.size());
+  }
+
+  void modify(socket_type& socket, short events) throw(std::logic_error)
+  {
+    auto index = find(socket);
+    throw_when<std::logic_error>(index == m_sockets.size(),
+                                 "Socket not registered");
+    m_fds[index].events = events;
+  }
+
+  void remove(socket_type& socket) noexcept
+  {
+    auto index = find(socket);
+    if (index == m_sockets.size())
+      return;
+    m_fds[index] = m_fds.back();
+    m_fds.pop_back();
+    m_sockets[index] = m_sockets.back();
+    m_sockets.pop_back();
+  }
+
+  size_t size() const noexcept
+  {
+    return m_sockets.size();
+  }
+
+  // Waits at most timeout_ms milliseconds (-1 blocks) for any registered
+  // socket to become ready and returns the number of ready sockets.
+  size_t wait(int timeout_ms) throw(exception)
+  {
+    m_ready.clear();
+    if (m_fds.empty())
+      return 0;
+
+    auto result = nn_poll(m_fds.data(), static_cast<int>(m_fds.size()),
+                          timeout_ms);
+    throw_when(result == -1);
+
+    for (size_t i = 0; i < m_fds.size() && m_ready.size() < size_t(result);
+         ++i)
+      if (m_fds[i].revents != 0)
+        m_ready.push_back(ready_entry{m_sockets[i], m_fds[i].revents});
+    return m_ready.size();
+  }
+
+  const std::vector<ready_entry>& ready() const noexcept
+  {
+    return m_ready;
+  }
+
+private:
+  size_t find(const socket_type& socket) const noexcept
+  {
+    return std::find(m_sockets.begin(), m_sockets.end(), &socket) -
+           m_sockets.begin();
+  }
+
+  std::vector<nn_pollfd> m_fds;
+  std::vector<socket_type*> m_sockets;
+  std::vector<ready_entry> m_ready;
+};
+
+// Receives up to max_messages queued messages without blocking and passes
+// each to handler. Returns the number of messages received.
+template <typename message_type, typename socket_type, typename handler_type>
+size_t drain(socket_type& socket, handler_type&& handler,
+             size_t max_messages) throw(exception)
+{
+  size_t received = 0;
+  while (received < max_messages)
+  {
+    auto msg = socket.template try_receive<message_type>();
+    if (!msg)
+      break;
+    ++received;
+    handler(*msg);
+  }
+  return received;
+}
+
+} // namespace nmpp
+
+#endif // NMPP_POLLER_HPP_
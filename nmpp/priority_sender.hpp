@@ -0,0 +1,192 @@
+#ifndef NMPP_PRIORITY_SENDER_HPP_
+#define NMPP_PRIORITY_SENDER_HPP_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <nanomsg/nn.h>
+#include <nmpp/exception.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/socket.hpp>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace nmpp
+{
+
+// Connects with the given NN_SNDPRIO (1 highest, 16 lowest). nanomsg
+// sends to the highest priority endpoint able to take a message, so a
+// lane can be given its own upstream. Returns the endpoint id.
+template <typename socket_type>
+int connect_with_priority(socket_type& socket, const std::string& address,
+                          int priority) throw(exception)
+{
+  socket.set_option(NN_SOL_SOCKET, NN_SNDPRIO, priority);
+  return socket.connect(address);
+}
+
+// Several send queues over one async socket. Lane 0 is the most urgent.
+// On every writable event the queues are drained with non-blocking sends
+// until the socket pushes back: the most urgent non-empty lane that still
+// has credit goes first, and credits are refilled from the lane weights
+// once every non-empty lane has used its share. Urgent messages therefore
+// overtake queued bulk data, while lower lanes still get weight[i] sends
+// per round. Not thread safe, use from the thread running the dispatcher.
+// Destroying the sender drops its queued messages without running their
+// handlers; a writable wait still pending finishes later and does nothing.
+template <typename async_socket_type, typename message_type = message>
+class priority_sender
+{
+public:
+  using handler_type = std::function<void(const std::error_code&, size_t)>;
+
+  priority_sender(const priority_sender&) = delete;
+  priority_sender& operator=(const priority_sender&) = delete;
+
+  priority_sender(async_socket_type& socket, std::vector<unsigned> weights,
+                  size_t max_burst = 64) throw(std::logic_error)
+      : m_socket(socket),
+        m_weights(std::move(weights)),
+        m_credits(m_weights),
+        m_lanes(m_weights.size()),
+        m_max_burst(max_burst),
+        m_waiting(false),
+        m_alive(std::make_shared<bool>(true))
+  {
+    throw_when<std::logic_error>(m_weights.empty(), "No lanes");
+    for (auto weight : m_weights)
+      throw_when<std::logic_error>(weight == 0, "Lane weight must be > 0");
+  }
+
+  ~priority_sender() noexcept
+  {
+    *m_alive = false;
+  }
+
+  // handler(ec, bytes) runs once the message went out or failed.
+  void async_send(size_t lane, std::unique_ptr<message_type> msg,
+                  handler_type handler) throw(std::logic_error)
+  {
+    throw_when<std::logic_error>(lane >= m_lanes.size(), "Invalid lane");
+    throw_when<std::logic_error>(!msg || !msg->valid(), "Invalid message");
+    m_lanes[lane].push_back(entry{std::move(msg), std::move(handler)});
+    arm();
+  }
+
+  size_t pending(size_t lane) const noexcept
+  {
+    return lane < m_lanes.size() ? m_lanes[lane].size() : 0;
+  }
+
+  size_t pending() const noexcept
+  {
+    size_t total = 0;
+    for (auto& lane : m_lanes)
+      total += lane.size();
+    return total;
+  }
+
+private:
+  struct entry
+  {
+    std::unique_ptr<message_type> msg;
+    handler_type handler;
+  };
+
+  void arm()
+  {
+    if (m_waiting)
+      return;
+    m_waiting = true;
+    // The wait may complete after this object is gone, see the destructor.
+    m_socket.async_wait_send(
+        [this, alive = m_alive](const std::error_code& ec) {
+          if (*alive)
+            on_writable(ec);
+        });
+  }
+
+  void on_writable(const std::error_code& ec)
+  {
+    m_waiting = false;
+    if (ec)
+      fail_all(ec);
+    else
+      drain();
+    if (pending() > 0)
+      arm();
+  }
+
+  void drain()
+  {
+    for (size_t sent = 0; sent < m_max_burst; ++sent)
+    {
+      auto lane = next_lane();
+      if (lane == m_lanes.size())
+        return;
+
+      auto& queue = m_lanes[lane];
+      auto bytes = queue.front().msg->size();
+      std::error_code result;
+      try
+      {
+        if (!m_socket.try_send(*queue.front().msg))
+          return;
+      }
+      catch (const exception& e)
+      {
+        result = std::error_code(e.num(), std::system_category());
+        bytes = 0;
+      }
+
+      auto done = std::move(queue.front());
+      queue.pop_front();
+      --m_credits[lane];
+      done.handler(result, bytes);
+    }
+  }
+
+  size_t next_lane() noexcept
+  {
+    for (auto pass = 0; pass < 2; ++pass)
+    {
+      auto any = false;
+      for (size_t lane = 0; lane < m_lanes.size(); ++lane)
+      {
+        if (m_lanes[lane].empty())
+          continue;
+        any = true;
+        if (m_credits[lane] > 0)
+          return lane;
+      }
+      if (!any)
+        break;
+      m_credits = m_weights;
+    }
+    return m_lanes.size();
+  }
+
+  // Handlers may queue new messages, those wait for the next event.
+  void fail_all(const std::error_code& ec)
+  {
+    std::vector<std::deque<entry>> failed(m_lanes.size());
+    failed.swap(m_lanes);
+    for (auto& queue : failed)
+      for (auto& done : queue)
+        done.handler(ec, 0);
+  }
+
+  async_socket_type& m_socket;
+  std::vector<unsigned> m_weights;
+  std::vector<unsigned> m_credits;
+  std::vector<std::deque<entry>> m_lanes;
+  size_t m_max_burst;
+  bool m_waiting;
+  std::shared_ptr<bool> m_alive;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_PRIORITY_SENDER_HPP_
@@ -0,0 +1,91 @@
+#ifndef NMPP_REACTOR_DISPATCHER_HPP_
+#define NMPP_REACTOR_DISPATCHER_HPP_
+
+#include <nmpp/exception.hpp>
+#include <nmpp/reactor_watch.hpp>
+#include <stdexcept>
+#include <system_error>
+
+namespace nmpp
+{
+
+// async_dispatcher replacement driven by a plain reactor instead of an
+// Asio io_service. reactor_type has to provide arm(reactor_watch&) and
+// disarm(reactor_watch&).
+template <typename reactor_type> class reactor_dispatcher
+{
+public:
+  reactor_dispatcher(const reactor_dispatcher&) = delete;
+  reactor_dispatcher& operator=(const reactor_dispatcher&) = delete;
+
+  reactor_dispatcher(int receive_handle, int send_handle,
+                     reactor_type& reactor) noexcept
+      : m_reactor(reactor),
+        m_receive_watch(receive_handle, reactor_watch::read),
+        m_send_watch(send_handle, reactor_watch::write)
+  {
+  }
+
+  ~reactor_dispatcher() noexcept
+  {
+    m_reactor.disarm(m_receive_watch);
+    m_reactor.disarm(m_send_watch);
+  }
+
+  template <typename handler_type>
+  void on_receive_event(handler_type&& handler) throw(std::logic_error,
+                                                      std::system_error)
+  {
+    throw_when<std::logic_error>(m_receive_watch.fd == -1,
+                                 "Receive operation not supported");
+    m_receive_watch.handlers.emplace_back(std::forward<handler_type>(handler));
+    m_reactor.arm(m_receive_watch);
+  }
+
+  template <typename handler_type>
+  void on_send_event(handler_type&& handler) throw(std::logic_error,
+                                                   std::system_error)
+  {
+    throw_when<std::logic_error>(m_send_watch.fd == -1,
+                                 "Send operation not supported");
+    m_send_watch.handlers.emplace_back(std::forward<handler_type>(handler));
+    m_reactor.arm(m_send_watch);
+  }
+
+  // All pending handlers of the direction complete inline, in the order
+  // they were queued, with std::errc::operation_canceled.
+  void cancel_receive()
+  {
+    cancel(m_receive_watch);
+  }
+
+  void cancel_send()
+  {
+    cancel(m_send_watch);
+  }
+
+  reactor_type& get_reactor() noexcept
+  {
+    return m_reactor;
+  }
+
+private:
+  void cancel(reactor_watch& watch)
+  {
+    if (!watch.waiting())
+      return;
+    m_reactor.disarm(watch);
+    auto handlers = std::move(watch.handlers);
+    watch.handlers.clear();
+    for (auto& handler : handlers)
+      handler(std::make_error_code(std::errc::operation_canceled));
+  }
+
+  reactor_type& m_reactor;
+  reactor_watch m_receive_watch;
+  reactor_watch m_send_watch;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_REACTOR_DISPATCHER_HPP_
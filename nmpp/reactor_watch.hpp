@@ -0,0 +1,55 @@
+#ifndef NMPP_REACTOR_WATCH_HPP_
+#define NMPP_REACTOR_WATCH_HPP_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <system_error>
+
+namespace nmpp
+{
+
+// Single readiness interest of one descriptor, owned by a dispatcher and
+// armed in a reactor. Waits queue up like Asio null-buffers waits and
+// complete one per readiness event in FIFO order: the reactor disarms the
+// watch, takes the oldest handler and re-arms for the rest before running
+// it, since the handler may destroy the watch.
+struct reactor_watch
+{
+  enum direction_type
+  {
+    read,
+    write
+  };
+
+  using handler_type = std::function<void(const std::error_code&)>;
+
+  reactor_watch(int handle, direction_type dir) noexcept
+      : fd(handle), direction(dir), registered(false), armed(false),
+        token(0)
+  {
+  }
+
+  bool waiting() const noexcept
+  {
+    return !handlers.empty();
+  }
+
+  handler_type take()
+  {
+    auto handler = std::move(handlers.front());
+    handlers.pop_front();
+    return handler;
+  }
+
+  int fd;
+  direction_type direction;
+  bool registered;
+  bool armed;
+  uint64_t token;
+  std::deque<handler_type> handlers;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_REACTOR_WATCH_HPP_
@@ -0,0 +1,183 @@
+#ifndef NMPP_RING_TRACER_HPP_
+#define NMPP_RING_TRACER_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <nmpp/trace.hpp>
+#include <ostream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace nmpp
+{
+
+// Ticks of read_tsc() per microsecond, measured once against
+// steady_clock.
+inline double tsc_ticks_per_us()
+{
+  static const double ticks = [] {
+    auto start = std::chrono::steady_clock::now();
+    auto start_tsc = read_tsc();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    auto elapsed = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start);
+    return (read_tsc() - start_tsc) / elapsed.count();
+  }();
+  return ticks;
+}
+
+// Tracing policy writing into a ring per thread. Recording is wait-free
+// for the owning thread; once a ring is full the oldest events are
+// overwritten. dump() is meant to be called once the traced threads are
+// quiescent, events recorded concurrently may be torn.
+template <size_t capacity = (1 << 16)> class ring_tracer
+{
+public:
+  struct event
+  {
+    uint64_t tsc;
+    int descriptor;
+    trace_event type;
+  };
+
+  static void record(trace_event type, int descriptor) noexcept
+  {
+    auto& ring = local_ring();
+    auto head = ring.head.load(std::memory_order_relaxed);
+    ring.events[head % capacity] = event{read_tsc(), descriptor, type};
+    ring.head.store(head + 1, std::memory_order_release);
+  }
+
+  // Events recorded by the calling thread, oldest first.
+  static std::vector<event> local_events()
+  {
+    return snapshot(local_ring());
+  }
+
+  static void dump(std::ostream& out)
+  {
+    auto& reg = get_registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    std::vector<std::pair<unsigned, std::vector<event>>> threads;
+    auto origin = std::numeric_limits<uint64_t>::max();
+    for (auto& ring : reg.rings)
+    {
+      threads.emplace_back(ring->tid, snapshot(*ring));
+      if (!threads.back().second.empty())
+        origin = std::min(origin, threads.back().second.front().tsc);
+    }
+
+    auto ticks = tsc_ticks_per_us();
+    auto pid = getpid();
+    auto first = true;
+    out << "{\"traceEvents\":[";
+    for (auto& thread : threads)
+    {
+      for (auto& e : thread.second)
+      {
+        out << (first ? "" : ",") << "{\"name\":\"" << name(e.type)
+            << "\",\"ph\":\"" << phase(e.type) << "\",\"ts\":"
+            << (e.tsc - origin) / ticks << ",\"pid\":" << pid
+            << ",\"tid\":" << thread.first;
+        if (e.type == trace_event::readiness_wakeup)
+          out << ",\"s\":\"t\"";
+        out << ",\"args\":{\"descriptor\":" << e.descriptor << "}}";
+        first = false;
+      }
+    }
+    out << "]}";
+  }
+
+private:
+  struct ring
+  {
+    explicit ring(unsigned tid) : tid(tid), head(0)
+    {
+    }
+
+    unsigned tid;
+    std::atomic<uint64_t> head;
+    std::array<event, capacity> events;
+  };
+
+  struct registry
+  {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ring>> rings;
+  };
+
+  static registry& get_registry()
+  {
+    static registry reg;
+    return reg;
+  }
+
+  static ring& local_ring()
+  {
+    thread_local std::shared_ptr<ring> local = attach();
+    return *local;
+  }
+
+  // Rings outlive their threads so events can be dumped after a join.
+  static std::shared_ptr<ring> attach()
+  {
+    auto& reg = get_registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.rings.push_back(std::make_shared<ring>(reg.rings.size() + 1));
+    return reg.rings.back();
+  }
+
+  static std::vector<event> snapshot(const ring& r)
+  {
+    auto head = r.head.load(std::memory_order_acquire);
+    auto begin = head > capacity ? head - capacity : 0;
+    std::vector<event> events;
+    events.reserve(head - begin);
+    for (auto i = begin; i < head; ++i)
+      events.push_back(r.events[i % capacity]);
+    return events;
+  }
+
+  static const char* name(trace_event type) noexcept
+  {
+    switch (type)
+    {
+    case trace_event::readiness_wakeup:
+      return "readiness";
+    case trace_event::send_begin:
+    case trace_event::send_end:
+      return "nn_send";
+    case trace_event::receive_begin:
+    case trace_event::receive_end:
+      return "nn_recv";
+    default:
+      return "handler";
+    }
+  }
+
+  static const char* phase(trace_event type) noexcept
+  {
+    switch (type)
+    {
+    case trace_event::readiness_wakeup:
+      return "i";
+    case trace_event::send_begin:
+    case trace_event::receive_begin:
+    case trace_event::handler_begin:
+      return "B";
+    default:
+      return "E";
+    }
+  }
+};
+
+} // namespace nmpp
+
+#endif // NMPP_RING_TRACER_HPP_
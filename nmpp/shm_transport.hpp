@@ -0,0 +1,499 @@
+#ifndef NMPP_SHM_TRANSPORT_HPP_
+#define NMPP_SHM_TRANSPORT_HPP_
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <nanomsg/nn.h>
+#include <nmpp/exception.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/socket.hpp>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace nmpp
+{
+
+// POSIX shared memory segment split into fixed size slots. One process
+// creates it, the peer on the same host opens it by name.
+//
+// A slot goes free -> filling -> sent -> attached -> free. The sender
+// fills it and publishes it with a lease before sending its descriptor;
+// the receiver attaches to it when the descriptor arrives and frees it
+// with the payload view. A descriptor that never gets attached, e.g.
+// dropped by a PUB socket without subscribers, left in a closed
+// receiver's queue or rejected by attach(), leaves its slot sent; once
+// the lease is over, acquire() reclaims it. Every acquire starts a new
+// generation, so a descriptor arriving after its slot was reclaimed is
+// rejected as stale. Attached slots have no lease, a receiver holds them
+// for as long as it keeps the view.
+class shm_segment
+{
+  static constexpr uint64_t magic = 0x4e4d505053484d32ULL;
+  static constexpr size_t alignment = 64;
+
+  enum state : uint32_t
+  {
+    free_slot = 0,
+    filling = 1,
+    sent = 2,
+    attached = 3
+  };
+
+  struct header
+  {
+    uint64_t magic;
+    uint32_t slot_count;
+    uint32_t slot_capacity;
+    std::atomic<uint32_t> cursor;
+  };
+
+public:
+  using clock = std::chrono::steady_clock;
+
+  struct slot
+  {
+    // Generation in the upper 32 bits, state in the lower ones.
+    std::atomic<uint64_t> word;
+    // clock time in nanoseconds after which a sent slot may be reclaimed.
+    std::atomic<int64_t> lease;
+    uint64_t size;
+
+    char* data() noexcept
+    {
+      return reinterpret_cast<char*>(this) + alignment;
+    }
+
+    uint32_t generation() const noexcept
+    {
+      return static_cast<uint32_t>(word.load(std::memory_order_acquire) >>
+                                   32);
+    }
+  };
+
+  shm_segment(const shm_segment&) = delete;
+  shm_segment& operator=(const shm_segment&) = delete;
+
+  static std::unique_ptr<shm_segment>
+  create(const std::string& name, uint32_t slot_count,
+         uint32_t slot_capacity) throw(std::logic_error, std::system_error)
+  {
+    throw_when<std::logic_error>(slot_count == 0, "No slots requested");
+    auto fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    throw_when<std::system_error>(fd == -1, errno, std::system_category(),
+                                  name);
+
+    auto stride = slot_stride(slot_capacity);
+    auto size = alignment + stride * slot_count;
+    if (ftruncate(fd, size) == -1)
+    {
+      auto err = errno;
+      ::close(fd);
+      shm_unlink(name.c_str());
+      throw std::system_error(err, std::system_category(), "ftruncate");
+    }
+
+    std::unique_ptr<shm_segment> segment(new shm_segment(name, true));
+    segment->map(fd, size);
+    auto head = segment->get_header();
+    head->slot_count = slot_count;
+    head->slot_capacity = slot_capacity;
+    head->cursor.store(0, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < slot_count; ++i)
+    {
+      auto s = segment->get_slot(i);
+      s->word.store(make_word(0, free_slot), std::memory_order_relaxed);
+      s->lease.store(0, std::memory_order_relaxed);
+      s->size = 0;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    head->magic = magic;
+    return segment;
+  }
+
+  static std::unique_ptr<shm_segment>
+  open(const std::string& name) throw(std::runtime_error, std::system_error)
+  {
+    auto fd = shm_open(name.c_str(), O_RDWR, 0600);
+    throw_when<std::system_error>(fd == -1, errno, std::system_category(),
+                                  name);
+    struct stat info;
+    if (fstat(fd, &info) == -1)
+    {
+      auto err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::system_category(), "fstat");
+    }
+
+    std::unique_ptr<shm_segment> segment(new shm_segment(name, false));
+    segment->map(fd, static_cast<size_t>(info.st_size));
+    auto head = segment->get_header();
+    throw_when<std::runtime_error>(
+        segment->m_size < alignment || head->magic != magic ||
+            segment->m_size < alignment + slot_stride(head->slot_capacity) *
+                                              head->slot_count,
+        "Not an nmpp shared memory segment");
+    return segment;
+  }
+
+  ~shm_segment() noexcept
+  {
+    if (m_data != nullptr)
+      munmap(m_data, m_size);
+    if (m_owner)
+      shm_unlink(m_name.c_str());
+  }
+
+  uint32_t slot_count() const noexcept
+  {
+    return get_header()->slot_count;
+  }
+
+  uint32_t slot_capacity() const noexcept
+  {
+    return get_header()->slot_capacity;
+  }
+
+  // Claims a free slot, or a sent one whose lease is over, for filling.
+  // Returns nullptr when all slots are in use.
+  slot* acquire(uint32_t& index, clock::time_point now = clock::now()) noexcept
+  {
+    auto head = get_header();
+    for (uint32_t attempt = 0; attempt < head->slot_count; ++attempt)
+    {
+      index = head->cursor.fetch_add(1, std::memory_order_relaxed) %
+              head->slot_count;
+      auto s = get_slot(index);
+      auto word = s->word.load(std::memory_order_acquire);
+      // The lease read after seeing the slot sent is at least as new as
+      // the one published with it.
+      auto reclaimable = state_of(word) == sent &&
+                         s->lease.load(std::memory_order_relaxed) <=
+                             nanoseconds(now);
+      if ((state_of(word) == free_slot || reclaimable) &&
+          s->word.compare_exchange_strong(
+              word, make_word(generation_of(word) + 1, filling),
+              std::memory_order_acquire, std::memory_order_relaxed))
+        return s;
+    }
+    return nullptr;
+  }
+
+  // Hands a filled slot over to its descriptor, reclaimable after lease.
+  static void publish(slot* s, clock::duration lease) noexcept
+  {
+    s->lease.store(nanoseconds(clock::now() + lease),
+                   std::memory_order_relaxed);
+    auto word = s->word.load(std::memory_order_relaxed);
+    s->word.store(make_word(generation_of(word), sent),
+                  std::memory_order_release);
+  }
+
+  // Frees a published slot whose descriptor could not be sent, unless it
+  // was reclaimed meanwhile.
+  static void withdraw(slot* s, uint32_t generation) noexcept
+  {
+    auto expected = make_word(generation, sent);
+    s->word.compare_exchange_strong(expected,
+                                    make_word(generation, free_slot),
+                                    std::memory_order_release,
+                                    std::memory_order_relaxed);
+  }
+
+  // Claims a sent slot for the receiver. False when the descriptor is
+  // stale: the slot was reclaimed, or attached already.
+  static bool attach(slot* s, uint32_t generation) noexcept
+  {
+    auto expected = make_word(generation, sent);
+    return s->word.compare_exchange_strong(
+        expected, make_word(generation, attached), std::memory_order_acquire,
+        std::memory_order_relaxed);
+  }
+
+  slot* get_slot(uint32_t index) const noexcept
+  {
+    return reinterpret_cast<slot*>(
+        m_data + alignment + slot_stride(get_header()->slot_capacity) * index);
+  }
+
+  // Frees a slot held by its filler or by the receiver.
+  static void release(slot* s) noexcept
+  {
+    auto word = s->word.load(std::memory_order_relaxed);
+    s->word.store(make_word(generation_of(word), free_slot),
+                  std::memory_order_release);
+  }
+
+private:
+  shm_segment(const std::string& name, bool owner)
+      : m_name(name), m_owner(owner), m_data(nullptr), m_size(0)
+  {
+  }
+
+  static uint64_t make_word(uint32_t generation, state st) noexcept
+  {
+    return (static_cast<uint64_t>(generation) << 32) | st;
+  }
+
+  static uint32_t generation_of(uint64_t word) noexcept
+  {
+    return static_cast<uint32_t>(word >> 32);
+  }
+
+  static uint32_t state_of(uint64_t word) noexcept
+  {
+    return static_cast<uint32_t>(word);
+  }
+
+  static int64_t nanoseconds(clock::time_point t) noexcept
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               t.time_since_epoch())
+        .count();
+  }
+
+  static size_t slot_stride(uint32_t capacity) noexcept
+  {
+    return alignment + ((capacity + alignment - 1) & ~(alignment - 1));
+  }
+
+  void map(int fd, size_t size)
+  {
+    auto data =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    auto err = errno;
+    ::close(fd);
+    throw_when<std::system_error>(data == MAP_FAILED, err,
+                                  std::system_category(), "mmap");
+    m_data = static_cast<char*>(data);
+    m_size = size;
+  }
+
+  header* get_header() const noexcept
+  {
+    return reinterpret_cast<header*>(m_data);
+  }
+
+  std::string m_name;
+  bool m_owner;
+  char* m_data;
+  size_t m_size;
+};
+
+// Frame sent over the nanomsg socket. Small payloads travel inline,
+// large ones as a descriptor of the slot holding them.
+namespace shm_frame
+{
+constexpr char inline_payload = 0;
+constexpr char slot_descriptor = 1;
+constexpr size_t inline_header_size = 1;
+constexpr size_t descriptor_size = 1 + 4 + 4 + 8;
+} // namespace shm_frame
+
+// Slots whose descriptor was not attached within lease are reclaimed, so
+// lease has to cover the longest the receiver may take to get to a frame.
+template <typename socket_type = socket> class shm_sender
+{
+public:
+  shm_sender(socket_type& socket, shm_segment& segment,
+             size_t threshold = 64 << 10,
+             shm_segment::clock::duration lease = std::chrono::seconds(1))
+      noexcept : m_socket(socket),
+                 m_segment(segment),
+                 m_threshold(threshold),
+                 m_lease(lease)
+  {
+  }
+
+  // Returns false, without sending, when the payload needs a slot and all
+  // slots are still held by the receiver or leased to descriptors.
+  bool try_send(const char* data, size_t size) throw(std::logic_error,
+                                                     exception)
+  {
+    if (size < m_threshold)
+    {
+      auto buf = allocate(shm_frame::inline_header_size + size);
+      buf[0] = shm_frame::inline_payload;
+      std::memcpy(buf + shm_frame::inline_header_size, data, size);
+      m_socket.send(
+          *message::from_nn(buf, shm_frame::inline_header_size + size));
+      return true;
+    }
+
+    throw_when<std::logic_error>(size > m_segment.slot_capacity(),
+                                 "Payload exceeds slot capacity");
+    uint32_t index;
+    auto slot = m_segment.acquire(index);
+    if (slot == nullptr)
+      return false;
+    char* buf = nullptr;
+    try
+    {
+      buf = allocate(shm_frame::descriptor_size);
+    }
+    catch (...)
+    {
+      shm_segment::release(slot);
+      throw;
+    }
+    std::memcpy(slot->data(), data, size);
+    slot->size = size;
+
+    auto generation = slot->generation();
+    uint64_t size64 = size;
+    buf[0] = shm_frame::slot_descriptor;
+    std::memcpy(buf + 1, &index, 4);
+    std::memcpy(buf + 5, &generation, 4);
+    std::memcpy(buf + 9, &size64, 8);
+    shm_segment::publish(slot, m_lease);
+    try
+    {
+      m_socket.send(*message::from_nn(buf, shm_frame::descriptor_size));
+    }
+    catch (...)
+    {
+      shm_segment::withdraw(slot, generation);
+      throw;
+    }
+    return true;
+  }
+
+  template <typename message_type>
+  bool try_send(const message_type& msg) throw(std::logic_error, exception)
+  {
+    return try_send(msg.data(), msg.size());
+  }
+
+private:
+  static char* allocate(size_t size)
+  {
+    auto buf = reinterpret_cast<char*>(nn_allocmsg(size, 0));
+    throw_when(buf == nullptr);
+    return buf;
+  }
+
+  socket_type& m_socket;
+  shm_segment& m_segment;
+  size_t m_threshold;
+  shm_segment::clock::duration m_lease;
+};
+
+// Payload view returned by shm_receiver. Large payloads are read in place
+// from the shared segment; the slot is handed back to the sender when the
+// view is destroyed.
+class shm_message
+{
+public:
+  shm_message(const shm_message&) = delete;
+  shm_message& operator=(const shm_message&) = delete;
+
+  shm_message(std::unique_ptr<message> frame) noexcept
+      : m_frame(std::move(frame)), m_slot(nullptr)
+  {
+  }
+
+  shm_message(std::unique_ptr<message> frame,
+              shm_segment::slot* slot) noexcept
+      : m_frame(std::move(frame)), m_slot(slot)
+  {
+  }
+
+  ~shm_message() noexcept
+  {
+    if (m_slot != nullptr)
+      shm_segment::release(m_slot);
+  }
+
+  const char* data() const noexcept
+  {
+    return m_slot != nullptr
+               ? m_slot->data()
+               : m_frame->data() + shm_frame::inline_header_size;
+  }
+
+  size_t size() const noexcept
+  {
+    return m_slot != nullptr
+               ? m_slot->size
+               : m_frame->size() - shm_frame::inline_header_size;
+  }
+
+  bool valid() const noexcept
+  {
+    return m_slot != nullptr || (m_frame && m_frame->valid());
+  }
+
+  bool in_shared_memory() const noexcept
+  {
+    return m_slot != nullptr;
+  }
+
+private:
+  std::unique_ptr<message> m_frame;
+  shm_segment::slot* m_slot;
+};
+
+template <typename socket_type = socket> class shm_receiver
+{
+public:
+  shm_receiver(socket_type& socket, shm_segment& segment) noexcept
+      : m_socket(socket), m_segment(segment)
+  {
+  }
+
+  std::unique_ptr<shm_message> receive() throw(std::runtime_error,
+                                               exception)
+  {
+    return attach(m_socket.template receive<message>());
+  }
+
+  // Turns a frame received by other means, e.g. async_receive, into a
+  // payload view.
+  std::unique_ptr<shm_message>
+  attach(std::unique_ptr<message> frame) throw(std::runtime_error)
+  {
+    throw_when<std::runtime_error>(frame->size() == 0, "Empty shm frame");
+    auto data = frame->data();
+    if (data[0] == shm_frame::inline_payload)
+      return std::make_unique<shm_message>(std::move(frame));
+
+    throw_when<std::runtime_error>(
+        data[0] != shm_frame::slot_descriptor ||
+            frame->size() != shm_frame::descriptor_size,
+        "Malformed shm frame");
+    uint32_t index;
+    uint32_t generation;
+    uint64_t size;
+    std::memcpy(&index, data + 1, 4);
+    std::memcpy(&generation, data + 5, 4);
+    std::memcpy(&size, data + 9, 8);
+    throw_when<std::runtime_error>(index >= m_segment.slot_count(),
+                                   "Slot index out of range");
+
+    auto slot = m_segment.get_slot(index);
+    throw_when<std::runtime_error>(!shm_segment::attach(slot, generation),
+                                   "Stale shm slot descriptor");
+    if (slot->size != size)
+    {
+      shm_segment::release(slot);
+      throw std::runtime_error("Malformed shm frame");
+    }
+    return std::make_unique<shm_message>(std::move(frame), slot);
+  }
+
+private:
+  socket_type& m_socket;
+  shm_segment& m_segment;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_SHM_TRANSPORT_HPP_
@@ -13,30 +13,40 @@
 #include <nanomsg/tcp.h>
 #include <nanomsg/ws.h>
 #include <nmpp/exception.hpp>
+#include <nmpp/fwd.hpp>
+#include <nmpp/nanomsg_backend.hpp>
+#include <nmpp/timer_id.hpp>
+#include <nmpp/trace.hpp>
 
-#include <boost/asio.hpp>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <system_error>
+#include <type_traits>
 
 namespace nmpp
 {
 
-class socket
+// backend_type provides the transport, see nanomsg_backend.
+template <typename tracer_type, typename backend_type> class basic_socket
 {
 public:
-  socket(const socket&) = delete;
-  socket& operator=(const socket&) = delete;
+  basic_socket(const basic_socket&) = delete;
+  basic_socket& operator=(const basic_socket&) = delete;
 
-  socket(int domain, int proto) throw(exception) : m_sock(-1)
+  basic_socket(int domain, int proto) throw(exception) : m_sock(-1)
   {
-    m_sock = nn_socket(domain, proto);
-    throw_when(m_sock < 0);
+    m_sock = backend_type::socket(domain, proto);
+    check(m_sock < 0);
   }
 
-  socket(socket&& rhs) noexcept : m_sock(-1)
+  basic_socket(basic_socket&& rhs) noexcept : m_sock(-1)
   {
     *this = std::move(rhs);
   }
 
-  socket& operator=(socket&& rhs) noexcept
+  basic_socket& operator=(basic_socket&& rhs) noexcept
   {
     cleanup();
     this->m_sock = rhs.m_sock;
@@ -44,7 +54,7 @@ public:
     return *this;
   }
 
-  ~socket() noexcept
+  ~basic_socket() noexcept
   {
     cleanup();
   }
@@ -53,41 +63,116 @@ public:
   {
     if (m_sock < 0)
       return;
-    auto status = nn_close(m_sock);
+    auto status = backend_type::close(m_sock);
     m_sock = -1;
-    throw_when(status == -1);
+    check(status == -1);
   }
 
-  void bind(const std::string& address) throw(exception)
+  int bind(const std::string& address) throw(exception)
   {
-    throw_when(nn_bind(m_sock, address.c_str()) == -1);
+    auto endpoint = backend_type::bind(m_sock, address.c_str());
+    check(endpoint == -1);
+    return endpoint;
   }
 
-  void connect(const std::string& address) throw(exception)
+  int connect(const std::string& address) throw(exception)
   {
-    throw_when(nn_connect(m_sock, address.c_str()) == -1);
+    auto endpoint = backend_type::connect(m_sock, address.c_str());
+    check(endpoint == -1);
+    return endpoint;
+  }
+
+  void shutdown(int endpoint) throw(exception)
+  {
+    check(backend_type::shutdown(m_sock, endpoint) == -1);
+  }
+
+  template <typename value_type>
+  void set_option(int level, int option,
+                  const value_type& value) throw(exception)
+  {
+    check(backend_type::setsockopt(m_sock, level, option, &value,
+                                   sizeof(value)) == -1);
   }
 
   template <typename message_type>
   void send(message_type&& msg) throw(std::logic_error, exception)
   {
     throw_when<std::logic_error>(!msg.valid(), "Invalid message");
-    send(msg.release());
+    auto size = msg.size();
+    send_chunk(msg.release(), size);
   }
 
   template <typename message_type> auto receive() throw(exception)
   {
     char* buf = nullptr;
-    size_t bytes_received = nn_recv(m_sock, &buf, NN_MSG, 0);
-    throw_when(bytes_received == -1);
+    tracer_type::record(trace_event::receive_begin, m_sock);
+    size_t bytes_received = backend_type::receive_chunk(m_sock, &buf, 0);
+    tracer_type::record(trace_event::receive_end, m_sock);
+    check(bytes_received == -1);
+    return message_type::from_nn(buf, bytes_received);
+  }
+
+  // Sends a copy of the buffer, nanomsg copies it into its own message.
+  size_t send(const char* data, size_t size) throw(exception)
+  {
+    tracer_type::record(trace_event::send_begin, m_sock);
+    auto bytes_transferred = backend_type::send(m_sock, data, size, 0);
+    tracer_type::record(trace_event::send_end, m_sock);
+    check(bytes_transferred == -1);
+    return bytes_transferred;
+  }
+
+  template <typename message_type>
+  bool try_send(message_type&& msg) throw(std::logic_error, exception)
+  {
+    throw_when<std::logic_error>(!msg.valid(), "Invalid message");
+    auto buf = const_cast<char*>(msg.data());
+    tracer_type::record(trace_event::send_begin, m_sock);
+    auto status =
+        backend_type::send_chunk(m_sock, buf, msg.size(), NN_DONTWAIT);
+    tracer_type::record(trace_event::send_end, m_sock);
+    if (status == -1)
+    {
+      auto err = backend_type::error();
+      if (err == EAGAIN)
+        return false;
+      throw exception(err);
+    }
+    msg.release();
+    return true;
+  }
+
+  template <typename message_type>
+  std::unique_ptr<message_type> try_receive() throw(exception)
+  {
+    char* buf = nullptr;
+    tracer_type::record(trace_event::receive_begin, m_sock);
+    auto bytes_received =
+        backend_type::receive_chunk(m_sock, &buf, NN_DONTWAIT);
+    tracer_type::record(trace_event::receive_end, m_sock);
+    if (bytes_received == -1)
+    {
+      auto err = backend_type::error();
+      if (err == EAGAIN)
+        return nullptr;
+      throw exception(err);
+    }
     return message_type::from_nn(buf, bytes_received);
   }
 
+  int native_handle() const noexcept
+  {
+    return m_sock;
+  }
+
 protected:
-  size_t send(char* buf) throw(exception)
+  size_t send_chunk(char* buf, size_t size) throw(exception)
   {
-    auto bytes_transferred = nn_send(m_sock, &buf, NN_MSG, 0);
-    throw_when(bytes_transferred == -1);
+    tracer_type::record(trace_event::send_begin, m_sock);
+    auto bytes_transferred = backend_type::send_chunk(m_sock, buf, size, 0);
+    tracer_type::record(trace_event::send_end, m_sock);
+    check(bytes_transferred == -1);
     return bytes_transferred;
   }
 
@@ -105,10 +190,17 @@ protected:
   {
     int sock = -1;
     size_t sock_size = sizeof(sock);
-    nn_getsockopt(m_sock, NN_SOL_SOCKET, direction, &sock, &sock_size);
+    backend_type::getsockopt(m_sock, NN_SOL_SOCKET, direction, &sock,
+                             &sock_size);
     return sock;
   }
 
+  static void check(bool failed) throw(exception)
+  {
+    if (failed)
+      throw exception(backend_type::error());
+  }
+
   void cleanup() noexcept
   {
     try
@@ -123,14 +215,56 @@ protected:
   int m_sock;
 };
 
-template <typename async_dispatcher_type>
-class async_socket_impl : public socket
+// Receive handlers are either handler(const message_type&), not called
+// when the receive fails, or handler(const std::error_code&,
+// std::unique_ptr<message_type>), which gets a null message on failure.
+template <typename handler_type, typename message_type, typename = void>
+struct receive_handler_takes_error : std::false_type
+{
+};
+
+template <typename handler_type, typename message_type>
+struct receive_handler_takes_error<
+    handler_type, message_type,
+    decltype(void(std::declval<const std::decay_t<handler_type>&>()(
+        std::declval<const std::error_code&>(),
+        std::declval<std::unique_ptr<message_type>>())))> : std::true_type
+{
+};
+
+template <typename handler_type, typename message_type>
+void complete_receive(const handler_type& handler, const std::error_code& ec,
+                      std::unique_ptr<message_type> msg, std::true_type)
+{
+  handler(ec, std::move(msg));
+}
+
+template <typename handler_type, typename message_type>
+void complete_receive(const handler_type& handler, const std::error_code& ec,
+                      std::unique_ptr<message_type> msg, std::false_type)
+{
+  if (!ec)
+    handler(*msg);
+}
+
+template <typename handler_type, typename message_type>
+void complete_receive(const handler_type& handler, const std::error_code& ec,
+                      std::unique_ptr<message_type> msg)
+{
+  complete_receive(handler, ec, std::move(msg),
+                   receive_handler_takes_error<handler_type, message_type>());
+}
+
+template <typename async_dispatcher_type, typename tracer_type,
+          typename backend_type>
+class async_socket_impl : public basic_socket<tracer_type, backend_type>
 {
 public:
   template <typename... Args>
   async_socket_impl(int domain, int proto, Args&&... args) throw(exception)
-      : socket(domain, proto),
-        async_dispatcher(get_receive_descriptor(), get_send_descriptor(),
+      : basic_socket<tracer_type, backend_type>(domain, proto),
+        async_dispatcher(this->get_receive_descriptor(),
+                         this->get_send_descriptor(),
                          std::forward<Args>(args)...)
   {
   }
@@ -140,30 +274,279 @@ public:
     return async_dispatcher;
   }
 
+  // Sends are queued in call order and attempted without blocking once the
+  // socket is writable. Readiness is only a hint, a send that finds the
+  // peer full waits for the next one instead of blocking the event loop.
+  // Send failures complete handler with the nanomsg error number in the
+  // system category.
   template <typename message_type, typename handler_type>
   void async_send(std::unique_ptr<message_type> msg, handler_type&& handler)
   {
     throw_when<std::logic_error>(!msg->valid(), "Invalid message");
-    std::shared_ptr<message_type> shared_msg(std::move(msg));
-    async_dispatcher.on_send_event(
-        [this, handler, shared_msg](const std::error_code& ec) {
-          auto bytes = send(shared_msg->release());
-          handler(ec, bytes);
-        });
+    queue_send(std::move(msg), std::forward<handler_type>(handler), nullptr);
   }
 
+  // As above, but once timeout elapses the send leaves the queue, the
+  // message is dropped unsent and handler gets std::errc::timed_out. Other
+  // pending sends are unaffected. timers_type is e.g. asio_timer_wheel;
+  // the socket and timers must outlive the operation.
+  template <typename message_type, typename handler_type,
+            typename timers_type>
+  void async_send(std::unique_ptr<message_type> msg, handler_type&& handler,
+                  timers_type& timers, typename timers_type::duration timeout)
+  {
+    throw_when<std::logic_error>(!msg->valid(), "Invalid message");
+    auto op = std::make_shared<deadline_state>();
+    op->timer = timers.expires_after(timeout, [op, handler] {
+      op->expire();
+      handler(std::make_error_code(std::errc::timed_out), 0);
+    });
+    queue_send(std::move(msg),
+               [op, &timers, handler](const std::error_code& ec,
+                                      size_t bytes) {
+                 timers.cancel(op->timer);
+                 handler(ec, bytes);
+               },
+               op);
+  }
+
+  // Receives are queued in call order and served one per readiness event.
+  // See receive_handler_takes_error for the accepted handler forms.
   template <typename message_type, typename handler_type>
   void async_receive(handler_type&& handler)
   {
-    async_dispatcher.on_receive_event(
-        [this, handler](const std::error_code& ec) {
-          auto&& msg = receive<message_type>();
-          handler(*msg);
-        });
+    queue_receive<message_type>(std::forward<handler_type>(handler),
+                                nullptr);
+  }
+
+  // Receive with a deadline, handler must take the error code. Expiry
+  // completes only this receive, see async_send.
+  template <typename message_type, typename handler_type,
+            typename timers_type>
+  void async_receive(handler_type&& handler, timers_type& timers,
+                     typename timers_type::duration timeout)
+  {
+    auto op = std::make_shared<deadline_state>();
+    op->timer = timers.expires_after(timeout, [op, handler] {
+      op->expire();
+      handler(std::make_error_code(std::errc::timed_out),
+              std::unique_ptr<message_type>());
+    });
+    queue_receive<message_type>(
+        [op, &timers, handler](const std::error_code& ec,
+                               std::unique_ptr<message_type> msg) {
+          timers.cancel(op->timer);
+          handler(ec, std::move(msg));
+        },
+        op);
+  }
+
+  // Runs handler(ec) once the socket is writable, without sending
+  // anything. For senders that drain their own queues with try_send().
+  template <typename handler_type> void async_wait_send(handler_type&& handler)
+  {
+    async_dispatcher.on_send_event(std::forward<handler_type>(handler));
+  }
+
+  // Runs handler(ec) once a message can be received, without receiving.
+  template <typename handler_type>
+  void async_wait_receive(handler_type&& handler)
+  {
+    async_dispatcher.on_receive_event(std::forward<handler_type>(handler));
+  }
+
+  // Completes all pending operations of one direction with
+  // std::errc::operation_canceled.
+  void cancel_receive()
+  {
+    async_dispatcher.cancel_receive();
+  }
+
+  void cancel_send()
+  {
+    async_dispatcher.cancel_send();
   }
 
 private:
+  struct deadline_state;
+
+  // A queued send or receive. Returns false when it has to wait for the
+  // next readiness event.
+  struct operation
+  {
+    std::function<bool(const std::error_code&)> run;
+    std::shared_ptr<deadline_state> deadline;
+  };
+
+  using operation_queue = std::list<operation>;
+
+  // Shared by a deadline operation and its timer. Tracks where the
+  // operation is queued, so that expiry can take it out of the queue.
+  struct deadline_state
+  {
+    timer_id timer = invalid_timer;
+    operation_queue* queue = nullptr;
+    typename operation_queue::iterator position;
+
+    void expire()
+    {
+      if (queue != nullptr)
+        queue->erase(position);
+      queue = nullptr;
+    }
+  };
+
+  // Queues a send, see async_send.
+  template <typename message_type, typename handler_type>
+  void queue_send(std::unique_ptr<message_type> msg, handler_type&& handler,
+                  std::shared_ptr<deadline_state> op)
+  {
+    std::shared_ptr<message_type> shared_msg(std::move(msg));
+    push_back(m_sends, [this, handler, shared_msg](const std::error_code& ec) {
+      size_t bytes = 0;
+      auto result = ec;
+      if (!result)
+      {
+        auto sent = this->try_send_chunk(*shared_msg);
+        if (sent == -1)
+        {
+          auto err = backend_type::error();
+          if (err == EAGAIN)
+            return false;
+          result = std::error_code(err, std::system_category());
+        }
+        else
+          bytes = sent;
+      }
+      tracer_type::record(trace_event::handler_begin, this->native_handle());
+      handler(result, bytes);
+      tracer_type::record(trace_event::handler_end, this->native_handle());
+      return true;
+    }, std::move(op));
+    if (!m_send_waiting)
+      wait_send();
+  }
+
+  // Queues a receive, see async_receive.
+  template <typename message_type, typename handler_type>
+  void queue_receive(handler_type&& handler, std::shared_ptr<deadline_state> op)
+  {
+    push_back(m_receives, [this, handler](const std::error_code& ec) {
+      std::unique_ptr<message_type> msg;
+      if (!ec)
+        msg = this->template receive<message_type>();
+      tracer_type::record(trace_event::handler_begin, this->native_handle());
+      complete_receive(handler, ec, std::move(msg));
+      tracer_type::record(trace_event::handler_end, this->native_handle());
+      return true;
+    }, std::move(op));
+    if (!m_receive_waiting)
+      wait_receive();
+  }
+
+  template <typename run_type>
+  static void push_back(operation_queue& queue, run_type&& run,
+                        std::shared_ptr<deadline_state> deadline)
+  {
+    queue.push_back(operation{std::forward<run_type>(run), deadline});
+    if (deadline)
+    {
+      deadline->queue = &queue;
+      deadline->position = std::prev(queue.end());
+    }
+  }
+
+  static operation pop_front(operation_queue& queue)
+  {
+    auto op = std::move(queue.front());
+    queue.pop_front();
+    if (op.deadline)
+      op.deadline->queue = nullptr;
+    return op;
+  }
+
+  static void push_front(operation_queue& queue, operation op)
+  {
+    queue.push_front(std::move(op));
+    auto& deadline = queue.front().deadline;
+    if (deadline)
+    {
+      deadline->queue = &queue;
+      deadline->position = queue.begin();
+    }
+  }
+
+  // Non-blocking send of a whole message, releases it on success.
+  template <typename message_type> int try_send_chunk(message_type& msg)
+  {
+    auto buf = const_cast<char*>(msg.data());
+    tracer_type::record(trace_event::send_begin, this->native_handle());
+    int status = backend_type::send_chunk(this->native_handle(), buf,
+                                          msg.size(), NN_DONTWAIT);
+    tracer_type::record(trace_event::send_end, this->native_handle());
+    if (status != -1)
+      msg.release();
+    return status;
+  }
+
+  // One readiness wait serves the whole send queue, so sends complete in
+  // order whatever the dispatcher does with concurrent waits.
+  void wait_send()
+  {
+    m_send_waiting = true;
+    async_dispatcher.on_send_event(
+        [this](const std::error_code& ec) { flush_sends(ec); });
+  }
+
+  // Runs the sends queued before this readiness event, stops at the first
+  // one the peer has no room for. On error every one of them completes.
+  void flush_sends(const std::error_code& ec)
+  {
+    m_send_waiting = false;
+    for (auto pending = m_sends.size(); pending > 0 && !m_sends.empty();
+         --pending)
+    {
+      auto send = pop_front(m_sends);
+      if (!send.run(ec))
+      {
+        push_front(m_sends, std::move(send));
+        break;
+      }
+    }
+    if (!m_sends.empty() && !m_send_waiting)
+      wait_send();
+  }
+
+  // Like wait_send, for the receive queue.
+  void wait_receive()
+  {
+    m_receive_waiting = true;
+    async_dispatcher.on_receive_event(
+        [this](const std::error_code& ec) { flush_receives(ec); });
+  }
+
+  // Readiness promises one message, so one receive runs per event. On
+  // error every receive queued before it completes. The next wait is set
+  // before running a receive, so a throwing handler leaves the rest
+  // queued.
+  void flush_receives(const std::error_code& ec)
+  {
+    m_receive_waiting = false;
+    for (auto pending = ec ? m_receives.size() : 1;
+         pending > 0 && !m_receives.empty(); --pending)
+    {
+      auto receive = pop_front(m_receives);
+      if (!m_receives.empty() && !m_receive_waiting)
+        wait_receive();
+      receive.run(ec);
+    }
+  }
+
   async_dispatcher_type async_dispatcher;
+  operation_queue m_sends;
+  operation_queue m_receives;
+  bool m_send_waiting = false;
+  bool m_receive_waiting = false;
 };
 
 } // namespace nmpp
@@ -173,7 +556,26 @@ private:
 
 namespace nmpp
 {
-using async_socket = async_socket_impl<async_dispatcher<native_socket>>;
+template <typename tracer_type>
+using traced_async_socket =
+    async_socket_impl<async_dispatcher<native_socket, tracer_type>,
+                      tracer_type>;
+
+// Defined by the compiled nmpp library, see src/nmpp.cpp.
+#ifdef NMPP_EXTERN_TEMPLATES
+extern template class basic_socket<null_tracer>;
+extern template class async_dispatcher<native_socket>;
+extern template class async_socket_impl<async_dispatcher<native_socket>>;
+
+extern template void basic_socket<null_tracer>::send<message&>(message&);
+extern template void basic_socket<null_tracer>::send<message>(message&&);
+extern template bool basic_socket<null_tracer>::try_send<message&>(message&);
+extern template std::unique_ptr<message>
+basic_socket<null_tracer>::try_receive<message>();
+
+extern template async_socket_impl<async_dispatcher<native_socket>>::
+    async_socket_impl(int, int, boost::asio::io_service&);
+#endif
 } // namespace nmpp
 
 #endif // NMPP_SOCKET_HPP_
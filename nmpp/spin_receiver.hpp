@@ -0,0 +1,193 @@
+#ifndef NMPP_SPIN_RECEIVER_HPP_
+#define NMPP_SPIN_RECEIVER_HPP_
+
+#include <atomic>
+#include <exception>
+#include <future>
+#include <memory>
+#include <nmpp/exception.hpp>
+#include <nmpp/socket.hpp>
+#include <nmpp/thread_affinity.hpp>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+namespace nmpp
+{
+
+// Spins on the CPU without ever giving it up.
+struct spin_backoff
+{
+  void idle() noexcept
+  {
+    cpu_relax();
+  }
+
+  void reset() noexcept
+  {
+  }
+};
+
+// Spins for a number of empty polls, then yields the CPU on every further
+// empty poll until a message arrives.
+class pause_backoff
+{
+public:
+  explicit pause_backoff(unsigned spins = 4096) noexcept
+      : m_spins(spins), m_idle(0)
+  {
+  }
+
+  void idle() noexcept
+  {
+    if (m_idle < m_spins)
+    {
+      ++m_idle;
+      cpu_relax();
+    }
+    else
+      std::this_thread::yield();
+  }
+
+  void reset() noexcept
+  {
+    m_idle = 0;
+  }
+
+private:
+  unsigned m_spins;
+  unsigned m_idle;
+};
+
+// Receives on a dedicated, optionally pinned thread by polling
+// nn_recv(..., NN_DONTWAIT) in a tight loop. Handlers take the same
+// arguments as for async_socket_impl::async_receive and run inline on the
+// receiving thread, once per message until stop() is called. A receive
+// error ends the loop; a handler taking the error code gets it, otherwise
+// stop() rethrows it.
+template <typename socket_type = socket, typename backoff_type = pause_backoff>
+class spin_receiver
+{
+public:
+  spin_receiver(const spin_receiver&) = delete;
+  spin_receiver& operator=(const spin_receiver&) = delete;
+
+  explicit spin_receiver(socket_type& socket, int cpu = -1,
+                         backoff_type backoff = backoff_type()) noexcept
+      : m_socket(socket), m_cpu(cpu), m_backoff(backoff), m_running(false)
+  {
+  }
+
+  ~spin_receiver() noexcept
+  {
+    m_running.store(false, std::memory_order_relaxed);
+    if (m_thread.joinable())
+      m_thread.join();
+  }
+
+  template <typename message_type, typename handler_type>
+  void start(handler_type&& handler) throw(std::logic_error,
+                                           std::system_error)
+  {
+    throw_when<std::logic_error>(m_thread.joinable(), "Already started");
+
+    std::promise<void> started;
+    auto result = started.get_future();
+    m_error = nullptr;
+    m_running.store(true, std::memory_order_relaxed);
+    m_thread = std::thread([
+      this, &started, handler = std::forward<handler_type>(handler)
+    ]() mutable {
+      try
+      {
+        if (m_cpu >= 0)
+          pin_current_thread(m_cpu);
+      }
+      catch (...)
+      {
+        m_running.store(false, std::memory_order_relaxed);
+        started.set_exception(std::current_exception());
+        return;
+      }
+      started.set_value();
+      loop<message_type>(handler);
+    });
+
+    try
+    {
+      result.get();
+    }
+    catch (...)
+    {
+      m_thread.join();
+      throw;
+    }
+  }
+
+  // Stops and joins the receiving thread. Rethrows the exception which
+  // terminated it, if any.
+  void stop()
+  {
+    m_running.store(false, std::memory_order_relaxed);
+    if (m_thread.joinable())
+      m_thread.join();
+    if (m_error)
+      std::rethrow_exception(std::exchange(m_error, nullptr));
+  }
+
+  bool running() const noexcept
+  {
+    return m_running.load(std::memory_order_relaxed);
+  }
+
+private:
+  template <typename message_type, typename handler_type>
+  void loop(handler_type& handler) noexcept
+  {
+    try
+    {
+      while (m_running.load(std::memory_order_relaxed))
+      {
+        std::unique_ptr<message_type> msg;
+        try
+        {
+          msg = m_socket.template try_receive<message_type>();
+        }
+        catch (const exception& e)
+        {
+          if (!receive_handler_takes_error<handler_type, message_type>::value)
+            throw;
+          m_running.store(false, std::memory_order_relaxed);
+          complete_receive(handler,
+                           std::error_code(e.num(), std::system_category()),
+                           std::move(msg));
+          return;
+        }
+        if (!msg)
+        {
+          m_backoff.idle();
+          continue;
+        }
+        m_backoff.reset();
+        complete_receive(handler, std::error_code(), std::move(msg));
+      }
+    }
+    catch (...)
+    {
+      m_error = std::current_exception();
+      m_running.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  socket_type& m_socket;
+  int m_cpu;
+  backoff_type m_backoff;
+  std::atomic<bool> m_running;
+  std::exception_ptr m_error;
+  std::thread m_thread;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_SPIN_RECEIVER_HPP_
@@ -0,0 +1,118 @@
+#ifndef NMPP_SPSC_QUEUE_HPP_
+#define NMPP_SPSC_QUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <nmpp/aligned_new.hpp>
+#include <nmpp/exception.hpp>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace nmpp
+{
+
+// Bounded lock-free ring for exactly one producer and one consumer thread.
+// The capacity is rounded up to a power of two. Each side keeps its index
+// on its own cache line together with a cached copy of the other side's
+// index, so the shared line is only read when the ring looks full or
+// empty. Values are moved in and out, which for std::unique_ptr hands over
+// the message without touching its payload. Allocated with new, the queue
+// gets cache-line aligned memory from aligned_new.
+template <typename value_type>
+class spsc_queue : public aligned_new<64>
+{
+  static constexpr size_t cache_line = 64;
+
+public:
+  spsc_queue(const spsc_queue&) = delete;
+  spsc_queue& operator=(const spsc_queue&) = delete;
+
+  explicit spsc_queue(size_t capacity) throw(std::logic_error)
+      : m_mask(round_up(capacity) - 1), m_slots(new value_type[m_mask + 1])
+  {
+    throw_when<std::logic_error>(capacity == 0, "Queue capacity must be > 0");
+    m_producer.index.store(0, std::memory_order_relaxed);
+    m_producer.cached = 0;
+    m_consumer.index.store(0, std::memory_order_relaxed);
+    m_consumer.cached = 0;
+  }
+
+  // Producer side. Leaves value untouched and returns false when full.
+  bool try_push(value_type&& value) noexcept(
+      std::is_nothrow_move_assignable<value_type>::value)
+  {
+    auto tail = m_producer.index.load(std::memory_order_relaxed);
+    if (tail - m_producer.cached > m_mask)
+    {
+      m_producer.cached = m_consumer.index.load(std::memory_order_acquire);
+      if (tail - m_producer.cached > m_mask)
+        return false;
+    }
+    m_slots[tail & m_mask] = std::move(value);
+    m_producer.index.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false when empty.
+  bool try_pop(value_type& value) noexcept(
+      std::is_nothrow_move_assignable<value_type>::value)
+  {
+    auto head = m_consumer.index.load(std::memory_order_relaxed);
+    if (head == m_consumer.cached)
+    {
+      m_consumer.cached = m_producer.index.load(std::memory_order_acquire);
+      if (head == m_consumer.cached)
+        return false;
+    }
+    value = std::move(m_slots[head & m_mask]);
+    m_consumer.index.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate when called while either side is active.
+  size_t size() const noexcept
+  {
+    auto head = m_consumer.index.load(std::memory_order_acquire);
+    auto tail = m_producer.index.load(std::memory_order_acquire);
+    return tail - head;
+  }
+
+  bool empty() const noexcept
+  {
+    return size() == 0;
+  }
+
+  size_t capacity() const noexcept
+  {
+    return m_mask + 1;
+  }
+
+private:
+  struct alignas(cache_line) side
+  {
+    std::atomic<size_t> index;
+    size_t cached;
+  };
+
+  static size_t round_up(size_t capacity) noexcept
+  {
+    size_t rounded = 1;
+    while (rounded < capacity)
+      rounded <<= 1;
+    return rounded;
+  }
+
+  side m_producer;
+  side m_consumer;
+  size_t m_mask;
+  std::unique_ptr<value_type[]> m_slots;
+};
+
+template <typename value_type>
+constexpr size_t spsc_queue<value_type>::cache_line;
+
+} // namespace nmpp
+
+#endif // NMPP_SPSC_QUEUE_HPP_
@@ -0,0 +1,244 @@
+#ifndef NMPP_SUBMISSION_QUEUE_HPP_
+#define NMPP_SUBMISSION_QUEUE_HPP_
+
+#include <atomic>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <nmpp/aligned_new.hpp>
+#include <nmpp/exception.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/mpsc_queue.hpp>
+#include <nmpp/socket.hpp>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+namespace nmpp
+{
+
+// Wakes the io thread with io_service::post.
+class posted_wakeup
+{
+public:
+  explicit posted_wakeup(boost::asio::io_service& io) noexcept : m_io(io)
+  {
+  }
+
+  void start(std::function<void()> handler)
+  {
+    m_handler = std::move(handler);
+  }
+
+  void notify()
+  {
+    m_io.post(m_handler);
+  }
+
+private:
+  boost::asio::io_service& m_io;
+  std::function<void()> m_handler;
+};
+
+// Wakes the io thread through an eventfd it keeps waiting on. Notifying is
+// a single write(2), without allocating or taking the io_service lock, and
+// several notifications before the io thread gets to run collapse into one
+// wake-up.
+class eventfd_wakeup
+{
+public:
+  eventfd_wakeup(const eventfd_wakeup&) = delete;
+  eventfd_wakeup& operator=(const eventfd_wakeup&) = delete;
+
+  explicit eventfd_wakeup(boost::asio::io_service& io) throw(std::system_error)
+      : m_descriptor(io)
+  {
+    auto fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    throw_when<std::system_error>(fd == -1, errno, std::system_category(),
+                                  "eventfd");
+    m_descriptor.assign(fd);
+  }
+
+  void start(std::function<void()> handler)
+  {
+    m_handler = std::move(handler);
+    wait();
+  }
+
+  void notify() noexcept
+  {
+    uint64_t one = 1;
+    auto ignored = ::write(m_descriptor.native_handle(), &one, sizeof(one));
+    (void)ignored;
+  }
+
+private:
+  // Closing the descriptor aborts the wait, the handler then returns
+  // without touching this object.
+  void wait()
+  {
+    m_descriptor.async_read_some(
+        boost::asio::null_buffers(),
+        [this](const boost::system::error_code& ec, size_t) {
+          if (ec)
+            return;
+          uint64_t count;
+          auto ignored =
+              ::read(m_descriptor.native_handle(), &count, sizeof(count));
+          (void)ignored;
+          m_handler();
+          wait();
+        });
+  }
+
+  boost::asio::posix::stream_descriptor m_descriptor;
+  std::function<void()> m_handler;
+};
+
+// Lets any number of threads send through one async socket. Producers push
+// messages into a bounded lock-free mpsc_queue; only the first submission
+// after the queue was drained wakes the io thread, which then waits until
+// the socket is writable and sends up to max_batch messages per writable
+// event with non-blocking sends. Messages from one producer keep their
+// order.
+//
+// try_submit() may be called from any thread, everything else runs on the
+// thread(s) running the io_service. Failed sends are reported to the error
+// handler together with the message. The queue must outlive the waits and
+// wake-ups it queued on the io_service.
+template <typename async_socket_type, typename message_type = message,
+          typename wakeup_type = posted_wakeup>
+class submission_queue : public aligned_new<64>
+{
+public:
+  using error_handler_type = std::function<void(
+      const std::error_code&, std::unique_ptr<message_type>)>;
+
+  submission_queue(const submission_queue&) = delete;
+  submission_queue& operator=(const submission_queue&) = delete;
+
+  submission_queue(async_socket_type& socket, boost::asio::io_service& io,
+                   size_t capacity = 4096, size_t max_batch = 64,
+                   error_handler_type on_error = nullptr)
+      : m_socket(socket),
+        m_wakeup(io),
+        m_queue(capacity),
+        m_max_batch(max_batch),
+        m_on_error(std::move(on_error)),
+        m_signalled(false),
+        m_waiting(false)
+  {
+    m_wakeup.start([this] { arm(); });
+  }
+
+  // Returns false, leaving msg untouched, when the queue is full.
+  bool try_submit(std::unique_ptr<message_type>&& msg) throw(std::logic_error)
+  {
+    throw_when<std::logic_error>(!msg || !msg->valid(), "Invalid message");
+    if (!m_queue.try_push(std::move(msg)))
+      return false;
+    if (!m_signalled.exchange(true, std::memory_order_acq_rel))
+      m_wakeup.notify();
+    return true;
+  }
+
+  // From the io thread, approximate while producers are active.
+  size_t pending() const noexcept
+  {
+    return m_queue.size() + (m_head ? 1 : 0);
+  }
+
+  size_t capacity() const noexcept
+  {
+    return m_queue.capacity();
+  }
+
+  wakeup_type& get_wakeup() noexcept
+  {
+    return m_wakeup;
+  }
+
+private:
+  void arm()
+  {
+    if (m_waiting)
+      return;
+    m_waiting = true;
+    m_socket.async_wait_send(
+        [this](const std::error_code& ec) { on_writable(ec); });
+  }
+
+  void on_writable(const std::error_code& ec)
+  {
+    m_waiting = false;
+    if (ec ? fail_all(ec) : drain())
+      arm();
+    else
+      rest();
+  }
+
+  // Returns true when more should be sent on the next writable event.
+  bool drain()
+  {
+    for (size_t sent = 0; sent < m_max_batch; ++sent)
+    {
+      if (!m_head && !m_queue.try_pop(m_head))
+        return false;
+      try
+      {
+        if (!m_socket.try_send(*m_head))
+          return true;
+      }
+      catch (const exception& e)
+      {
+        fail(std::error_code(e.num(), std::system_category()));
+        continue;
+      }
+      m_head.reset();
+    }
+    return true;
+  }
+
+  bool fail_all(const std::error_code& ec)
+  {
+    do
+      fail(ec);
+    while (m_queue.try_pop(m_head));
+    return false;
+  }
+
+  void fail(const std::error_code& ec)
+  {
+    auto msg = std::move(m_head);
+    if (msg && m_on_error)
+      m_on_error(ec, std::move(msg));
+  }
+
+  // The queue looked empty. A producer which pushed before the flag was
+  // cleared did not notify, so look once more.
+  void rest()
+  {
+    m_signalled.exchange(false, std::memory_order_acq_rel);
+    if (!m_queue.empty() &&
+        !m_signalled.exchange(true, std::memory_order_acq_rel))
+      arm();
+  }
+
+  async_socket_type& m_socket;
+  wakeup_type m_wakeup;
+  mpsc_queue<std::unique_ptr<message_type>> m_queue;
+  size_t m_max_batch;
+  error_handler_type m_on_error;
+  std::unique_ptr<message_type> m_head;
+  std::atomic<bool> m_signalled;
+  bool m_waiting;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_SUBMISSION_QUEUE_HPP_
@@ -0,0 +1,205 @@
+#ifndef NMPP_SUBSCRIPTION_HPP_
+#define NMPP_SUBSCRIPTION_HPP_
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <nmpp/exception.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/socket.hpp>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+namespace nmpp
+{
+
+// Persistent receive: the handler is registered once and runs for every
+// message until the subscription is stopped or destroyed. Each readiness
+// event drains up to max_batch queued messages with non-blocking receives
+// before the wait is re-armed, and the handler itself is stored once
+// instead of in a fresh closure per message. Handlers take the same forms
+// as for async_socket_impl::async_receive; an error-aware handler is told
+// about a failed wait or receive, which also ends the subscription.
+//
+// The subscription owns the receive side of the socket: stopping it
+// cancels every receive wait pending on that socket.
+template <typename async_socket_type, typename message_type = message>
+class subscription
+{
+public:
+  subscription(const subscription&) = delete;
+  subscription& operator=(const subscription&) = delete;
+
+  template <typename handler_type>
+  subscription(async_socket_type& socket, handler_type&& handler,
+               size_t max_batch = 64)
+      : m_state(std::make_shared<state_impl<std::decay_t<handler_type>>>(
+            socket, std::forward<handler_type>(handler), max_batch))
+  {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    m_state->arm(m_state);
+  }
+
+  ~subscription() noexcept
+  {
+    stop();
+  }
+
+  // No handler starts after stop() returns, and a handler running on
+  // another thread has finished. May be called from within the handler,
+  // which then simply is not called again.
+  void stop() noexcept
+  {
+    bool was_stopped;
+    {
+      std::lock_guard<std::mutex> lock(m_state->mutex);
+      was_stopped = m_state->stopped;
+      m_state->stopped = true;
+    }
+    if (!was_stopped)
+    {
+      try
+      {
+        m_state->socket.cancel_receive();
+      }
+      catch (...)
+      {
+      }
+    }
+    wait_idle();
+  }
+
+  bool active() const noexcept
+  {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    return !m_state->stopped;
+  }
+
+private:
+  struct state
+  {
+    state(async_socket_type& s, size_t batch)
+        : socket(s), max_batch(batch), stopped(false), running(false)
+    {
+    }
+
+    virtual ~state() = default;
+
+    virtual void deliver(const std::error_code& ec,
+                         std::unique_ptr<message_type> msg) = 0;
+
+    // Called with the mutex held, so stop() either sees the new wait and
+    // cancels it or prevents it.
+    void arm(const std::shared_ptr<state>& self)
+    {
+      socket.async_wait_receive(
+          [self](const std::error_code& ec) { self->on_readable(self, ec); });
+    }
+
+    void on_readable(const std::shared_ptr<state>& self,
+                     const std::error_code& ec)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopped)
+          return;
+        running = true;
+        runner = std::this_thread::get_id();
+      }
+
+      auto failed = ec;
+      try
+      {
+        if (!failed)
+          failed = drain();
+        else
+          deliver(failed, nullptr);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+        stopped = true;
+        idle.notify_all();
+        throw;
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      running = false;
+      idle.notify_all();
+      if (failed)
+        stopped = true;
+      else if (!stopped)
+        arm(self);
+    }
+
+    std::error_code drain()
+    {
+      for (size_t n = 0; n < max_batch && !is_stopped(); ++n)
+      {
+        std::unique_ptr<message_type> msg;
+        try
+        {
+          msg = socket.template try_receive<message_type>();
+        }
+        catch (const exception& e)
+        {
+          std::error_code ec(e.num(), std::system_category());
+          deliver(ec, nullptr);
+          return ec;
+        }
+        if (!msg)
+          break;
+        deliver(std::error_code(), std::move(msg));
+      }
+      return std::error_code();
+    }
+
+    bool is_stopped()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return stopped;
+    }
+
+    async_socket_type& socket;
+    size_t max_batch;
+    std::mutex mutex;
+    std::condition_variable idle;
+    bool stopped;
+    bool running;
+    std::thread::id runner;
+  };
+
+  template <typename handler_type> struct state_impl : state
+  {
+    template <typename handler_arg>
+    state_impl(async_socket_type& socket, handler_arg&& h, size_t batch)
+        : state(socket, batch), handler(std::forward<handler_arg>(h))
+    {
+    }
+
+    void deliver(const std::error_code& ec,
+                 std::unique_ptr<message_type> msg) override
+    {
+      complete_receive(handler, ec, std::move(msg));
+    }
+
+    handler_type handler;
+  };
+
+  void wait_idle() noexcept
+  {
+    std::unique_lock<std::mutex> lock(m_state->mutex);
+    m_state->idle.wait(lock, [this] {
+      return !m_state->running ||
+             m_state->runner == std::this_thread::get_id();
+    });
+  }
+
+  std::shared_ptr<state> m_state;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_SUBSCRIPTION_HPP_
@@ -0,0 +1,261 @@
+#ifndef NMPP_SURVEY_HPP_
+#define NMPP_SURVEY_HPP_
+
+#include <algorithm>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <nanomsg/survey.h>
+#include <nmpp/exception.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/socket.hpp>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+namespace nmpp
+{
+
+// Replies to one survey, in arrival order, and how long each took from
+// the moment the survey went out.
+template <typename message_type, typename duration_type>
+struct survey_result
+{
+  std::vector<std::unique_ptr<message_type>> responses;
+  std::vector<duration_type> latencies;
+  // Replies that arrived after the result set was full.
+  size_t dropped;
+  duration_type elapsed;
+  duration_type min_latency;
+  duration_type mean_latency;
+  duration_type max_latency;
+};
+
+// Runs surveys on an NN_SURVEYOR async socket without blocking receives:
+// the survey is sent, replies are collected with non-blocking receives as
+// they become readable, and the survey completes at its deadline or as
+// soon as quorum replies are in. The result set is allocated once for
+// max_responses replies and reused by every survey.
+//
+// The handler gets the result and no error once the quorum is reached,
+// or at the deadline when the quorum is zero. A survey that ends at the
+// deadline short of its quorum completes with std::errc::timed_out and
+// the replies collected so far. Starting a survey while another one is
+// running completes that one with std::errc::operation_canceled, as
+// nanomsg drops its replies anyway. The surveyor owns the receive side
+// of the socket and must outlive its surveys. Not thread safe, use from
+// the thread running the dispatcher.
+template <typename async_socket_type, typename message_type = message,
+          typename clock_type = std::chrono::steady_clock,
+          typename timer_type = boost::asio::basic_waitable_timer<clock_type>>
+class surveyor
+{
+public:
+  using duration = typename clock_type::duration;
+  using time_point = typename clock_type::time_point;
+  using result_type = survey_result<message_type, duration>;
+  using handler_type =
+      std::function<void(const std::error_code&, result_type&)>;
+
+  surveyor(const surveyor&) = delete;
+  surveyor& operator=(const surveyor&) = delete;
+
+  surveyor(async_socket_type& socket, boost::asio::io_service& io,
+           size_t max_responses) throw(std::logic_error)
+      : m_socket(socket),
+        m_timer(io),
+        m_max_responses(max_responses),
+        m_generation(0),
+        m_running(false),
+        m_listening(false),
+        m_deadline_ms(-1),
+        m_quorum(0)
+  {
+    throw_when<std::logic_error>(max_responses == 0,
+                                 "Need room for at least one response");
+    m_result.responses.reserve(max_responses);
+    m_result.latencies.reserve(max_responses);
+    reset();
+  }
+
+  void async_survey(std::unique_ptr<message_type> question, duration deadline,
+                    size_t quorum,
+                    handler_type handler) throw(std::logic_error, exception)
+  {
+    throw_when<std::logic_error>(!question || !question->valid(),
+                                 "Invalid message");
+    throw_when<std::logic_error>(deadline <= duration::zero(),
+                                 "Deadline must be > 0");
+    throw_when<std::logic_error>(quorum > m_max_responses,
+                                 "Quorum exceeds the result set");
+    if (m_running)
+      complete(std::make_error_code(std::errc::operation_canceled));
+
+    // nanomsg's own deadline is kept just past ours, so replies end with
+    // our timer rather than with ETIMEDOUT from the socket.
+    auto deadline_ms = static_cast<int>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(deadline)
+            .count() +
+        2);
+    if (deadline_ms != m_deadline_ms)
+    {
+      m_socket.set_option(NN_SURVEYOR, NN_SURVEYOR_DEADLINE, deadline_ms);
+      m_deadline_ms = deadline_ms;
+    }
+
+    reset();
+    auto generation = ++m_generation;
+    m_running = true;
+    m_quorum = quorum;
+    m_handler = std::move(handler);
+    m_socket.async_send(
+        std::move(question), [this, generation, deadline](
+                                 const std::error_code& ec, size_t) {
+          if (generation != m_generation)
+            return;
+          if (ec)
+            complete(ec);
+          else
+            start(generation, deadline);
+        });
+  }
+
+  // Completes a running survey with std::errc::operation_canceled.
+  void cancel()
+  {
+    if (m_running)
+      complete(std::make_error_code(std::errc::operation_canceled));
+  }
+
+  bool running() const noexcept
+  {
+    return m_running;
+  }
+
+private:
+  void start(uint64_t generation, duration deadline)
+  {
+    m_started = clock_type::now();
+    m_listening = true;
+    m_timer.expires_at(m_started + deadline);
+    // Only cancelled when the survey completes, an error means it is over.
+    m_timer.async_wait(
+        [this, generation](const boost::system::error_code& ec) {
+          if (!ec && generation == m_generation)
+            complete(m_result.responses.size() >= m_quorum
+                         ? std::error_code()
+                         : std::make_error_code(std::errc::timed_out));
+        });
+    arm(generation);
+  }
+
+  void arm(uint64_t generation)
+  {
+    m_socket.async_wait_receive(
+        [this, generation](const std::error_code& ec) {
+          if (generation == m_generation)
+            on_readable(generation, ec);
+        });
+  }
+
+  void on_readable(uint64_t generation, const std::error_code& ec)
+  {
+    if (ec)
+    {
+      complete(ec);
+      return;
+    }
+    try
+    {
+      while (auto reply = m_socket.template try_receive<message_type>())
+      {
+        collect(std::move(reply));
+        if (m_quorum > 0 && m_result.responses.size() >= m_quorum)
+        {
+          complete(std::error_code());
+          return;
+        }
+      }
+    }
+    catch (const exception& e)
+    {
+      // The socket's deadline passed before our timer fired.
+      if (e.num() == ETIMEDOUT || e.num() == EFSM)
+        complete(m_result.responses.size() >= m_quorum
+                     ? std::error_code()
+                     : std::make_error_code(std::errc::timed_out));
+      else
+        complete(std::error_code(e.num(), std::system_category()));
+      return;
+    }
+    arm(generation);
+  }
+
+  void collect(std::unique_ptr<message_type> reply)
+  {
+    if (m_result.responses.size() == m_max_responses)
+    {
+      ++m_result.dropped;
+      return;
+    }
+    m_result.latencies.push_back(clock_type::now() - m_started);
+    m_result.responses.push_back(std::move(reply));
+  }
+
+  void complete(const std::error_code& ec)
+  {
+    m_running = false;
+    ++m_generation;
+    m_timer.cancel();
+    m_socket.cancel_receive();
+
+    auto& latencies = m_result.latencies;
+    if (m_listening)
+      m_result.elapsed = clock_type::now() - m_started;
+    if (!latencies.empty())
+    {
+      auto range = std::minmax_element(latencies.begin(), latencies.end());
+      m_result.min_latency = *range.first;
+      m_result.max_latency = *range.second;
+      duration total = duration::zero();
+      for (auto latency : latencies)
+        total += latency;
+      m_result.mean_latency = total / latencies.size();
+    }
+
+    auto handler = std::move(m_handler);
+    m_handler = nullptr;
+    handler(ec, m_result);
+  }
+
+  void reset() noexcept
+  {
+    m_result.responses.clear();
+    m_result.latencies.clear();
+    m_result.dropped = 0;
+    m_result.elapsed = m_result.min_latency = m_result.mean_latency =
+        m_result.max_latency = duration::zero();
+    m_listening = false;
+  }
+
+  async_socket_type& m_socket;
+  timer_type m_timer;
+  size_t m_max_responses;
+  uint64_t m_generation;
+  bool m_running;
+  // The survey went out and its replies are being collected.
+  bool m_listening;
+  int m_deadline_ms;
+  size_t m_quorum;
+  time_point m_started;
+  handler_type m_handler;
+  result_type m_result;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_SURVEY_HPP_
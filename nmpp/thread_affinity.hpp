@@ -0,0 +1,100 @@
+#ifndef NMPP_THREAD_AFFINITY_HPP_
+#define NMPP_THREAD_AFFINITY_HPP_
+
+#include <cerrno>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <nmpp/exception.hpp>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/syscall.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace nmpp
+{
+
+// Throws std::logic_error for a CPU number cpu_set_t cannot hold.
+inline void pin_current_thread(const std::vector<int>& cpus) throw(
+    std::logic_error, std::system_error)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus)
+  {
+    throw_when<std::logic_error>(cpu < 0 || cpu >= CPU_SETSIZE,
+                                 "CPU number out of range");
+    CPU_SET(cpu, &set);
+  }
+  auto status = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  throw_when<std::system_error>(status != 0, status, std::system_category(),
+                                "pthread_setaffinity_np");
+}
+
+inline void pin_current_thread(int cpu) throw(std::logic_error,
+                                              std::system_error)
+{
+  pin_current_thread(std::vector<int>{cpu});
+}
+
+// CPUs of a NUMA node, as listed in sysfs. Throws std::system_error when
+// the node does not exist.
+inline std::vector<int> numa_node_cpus(int node) throw(std::system_error)
+{
+  std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) +
+                     "/cpulist");
+  throw_when<std::system_error>(!file, ENOENT, std::system_category(),
+                                "numa node " + std::to_string(node));
+
+  std::vector<int> cpus;
+  std::string range;
+  while (std::getline(file, range, ','))
+  {
+    int first = 0;
+    int last = 0;
+    char dash = 0;
+    std::istringstream stream(range);
+    if (!(stream >> first))
+      continue;
+    last = stream >> dash >> last ? last : first;
+    for (auto cpu = first; cpu <= last; ++cpu)
+      cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+// Makes the calling thread prefer memory of the given NUMA node for every
+// page it touches first, which includes heap allocations and nn_allocmsg
+// chunks filled on this thread. Chunks nanomsg fills on its own threads,
+// such as received messages, are not affected.
+inline void bind_current_thread_memory(int node) throw(std::system_error)
+{
+  throw_when<std::system_error>(node < 0 || node >= 64, EINVAL,
+                                std::system_category(), "set_mempolicy");
+  unsigned long mask = 1UL << node;
+  auto status = syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask,
+                        sizeof(mask) * 8);
+  throw_when<std::system_error>(status != 0, errno, std::system_category(),
+                                "set_mempolicy");
+}
+
+inline void cpu_relax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+} // namespace nmpp
+
+#endif // NMPP_THREAD_AFFINITY_HPP_
@@ -0,0 +1,16 @@
+#ifndef NMPP_TIMER_ID_HPP_
+#define NMPP_TIMER_ID_HPP_
+
+#include <cstdint>
+
+namespace nmpp
+{
+
+// Handle of a scheduled timer, see timer_wheel. Never equal to
+// invalid_timer.
+using timer_id = uint64_t;
+constexpr timer_id invalid_timer = 0;
+
+} // namespace nmpp
+
+#endif // NMPP_TIMER_ID_HPP_
@@ -0,0 +1,320 @@
+#ifndef NMPP_TIMER_WHEEL_HPP_
+#define NMPP_TIMER_WHEEL_HPP_
+
+#include <algorithm>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <nmpp/exception.hpp>
+#include <nmpp/timer_id.hpp>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace nmpp
+{
+
+// Hashed timer wheel. Deadlines are rounded up to whole ticks of the
+// given resolution; scheduling and cancelling are constant time and
+// advancing costs one slot per elapsed tick, regardless of how many timers
+// are pending. Nodes are recycled, so a steady load does not allocate
+// beyond what the callbacks themselves need.
+template <typename clock_type = std::chrono::steady_clock> class timer_wheel
+{
+public:
+  using clock = clock_type;
+  using duration = typename clock::duration;
+  using time_point = typename clock::time_point;
+  using callback_type = std::function<void()>;
+
+  timer_wheel(const timer_wheel&) = delete;
+  timer_wheel& operator=(const timer_wheel&) = delete;
+
+  timer_wheel(duration resolution, size_t slots,
+              time_point origin = clock::now()) throw(std::logic_error)
+      : m_resolution(resolution),
+        m_origin(origin),
+        m_tick(0),
+        m_size(0),
+        m_free(npos),
+        m_slots(slots, npos)
+  {
+    throw_when<std::logic_error>(resolution <= duration::zero() || slots == 0,
+                                 "Invalid timer wheel geometry");
+  }
+
+  timer_id schedule(time_point deadline, callback_type callback)
+  {
+    auto tick = m_tick + 1;
+    if (deadline > m_origin)
+    {
+      auto elapsed = deadline - m_origin;
+      auto ticks = static_cast<uint64_t>(
+          (elapsed + m_resolution - duration(1)) / m_resolution);
+      tick = std::max(tick, ticks);
+    }
+
+    auto index = allocate();
+    auto& n = m_nodes[index];
+    n.tick = tick;
+    n.callback = std::move(callback);
+    link(index, tick % m_slots.size());
+    ++m_size;
+    return make_id(index, n.generation);
+  }
+
+  // Returns false when the timer already fired or was cancelled.
+  bool cancel(timer_id id) noexcept
+  {
+    auto index = static_cast<uint32_t>(id);
+    auto generation = static_cast<uint32_t>(id >> 32);
+    if (index >= m_nodes.size() || m_nodes[index].generation != generation ||
+        !m_nodes[index].active)
+      return false;
+    unlink(index);
+    release(index);
+    return true;
+  }
+
+  // Runs callbacks of all timers whose deadline is at or before now.
+  // Callbacks may schedule and cancel timers. Returns the number of
+  // callbacks run.
+  size_t advance(time_point now)
+  {
+    if (now < m_origin)
+      return 0;
+    auto target = static_cast<uint64_t>((now - m_origin) / m_resolution);
+    size_t fired = 0;
+    if (target - std::min(target, m_tick) > m_slots.size())
+    {
+      for (size_t slot = 0; slot < m_slots.size(); ++slot)
+        fired += expire(slot, target);
+      m_tick = target;
+    }
+    while (m_tick < target)
+    {
+      ++m_tick;
+      fired += expire(m_tick % m_slots.size(), m_tick);
+    }
+    return fired;
+  }
+
+  // Time at which advance() fires the earliest pending timer, max() when
+  // none is pending. Visits each slot at most once.
+  time_point next_expiry() const noexcept
+  {
+    if (m_size == 0)
+      return time_point::max();
+    auto earliest = std::numeric_limits<uint64_t>::max();
+    for (size_t ahead = 1; ahead <= m_slots.size(); ++ahead)
+    {
+      auto tick = m_tick + ahead;
+      for (auto index = m_slots[tick % m_slots.size()]; index != npos;
+           index = m_nodes[index].next)
+        earliest = std::min(earliest, m_nodes[index].tick);
+      // Later slots only hold ticks after this one.
+      if (earliest <= tick)
+        break;
+    }
+    return m_origin + m_resolution * earliest;
+  }
+
+  bool empty() const noexcept
+  {
+    return m_size == 0;
+  }
+
+  size_t size() const noexcept
+  {
+    return m_size;
+  }
+
+  duration resolution() const noexcept
+  {
+    return m_resolution;
+  }
+
+private:
+  static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+  struct node
+  {
+    uint64_t tick = 0;
+    uint32_t generation = 1;
+    uint32_t slot = npos;
+    uint32_t prev = npos;
+    uint32_t next = npos;
+    bool active = false;
+    callback_type callback;
+  };
+
+  static timer_id make_id(uint32_t index, uint32_t generation) noexcept
+  {
+    return (static_cast<uint64_t>(generation) << 32) | index;
+  }
+
+  uint32_t allocate()
+  {
+    if (m_free == npos)
+    {
+      m_nodes.emplace_back();
+      m_free = static_cast<uint32_t>(m_nodes.size() - 1);
+    }
+    auto index = m_free;
+    m_free = m_nodes[index].next;
+    m_nodes[index].active = true;
+    return index;
+  }
+
+  void release(uint32_t index) noexcept
+  {
+    auto& n = m_nodes[index];
+    n.active = false;
+    n.callback = nullptr;
+    if (++n.generation == 0)
+      n.generation = 1;
+    n.next = m_free;
+    m_free = index;
+    --m_size;
+  }
+
+  void link(uint32_t index, size_t slot) noexcept
+  {
+    auto& n = m_nodes[index];
+    n.slot = static_cast<uint32_t>(slot);
+    n.prev = npos;
+    n.next = m_slots[slot];
+    if (n.next != npos)
+      m_nodes[n.next].prev = index;
+    m_slots[slot] = index;
+  }
+
+  void unlink(uint32_t index) noexcept
+  {
+    auto& n = m_nodes[index];
+    if (n.prev != npos)
+      m_nodes[n.prev].next = n.next;
+    else
+      m_slots[n.slot] = n.next;
+    if (n.next != npos)
+      m_nodes[n.next].prev = n.prev;
+    n.slot = n.prev = n.next = npos;
+  }
+
+  // A callback may cancel the node that was going to be visited next, so
+  // the walk restarts from the slot head whenever that happened.
+  size_t expire(size_t slot, uint64_t limit)
+  {
+    size_t fired = 0;
+    auto index = m_slots[slot];
+    while (index != npos)
+    {
+      auto next = m_nodes[index].next;
+      if (m_nodes[index].tick > limit)
+      {
+        index = next;
+        continue;
+      }
+
+      auto next_generation =
+          next != npos ? m_nodes[next].generation : uint32_t(0);
+      auto callback = std::move(m_nodes[index].callback);
+      unlink(index);
+      release(index);
+      callback();
+      ++fired;
+
+      if (next != npos && (m_nodes[next].generation != next_generation ||
+                           m_nodes[next].slot != slot))
+        next = m_slots[slot];
+      index = next;
+    }
+    return fired;
+  }
+
+  duration m_resolution;
+  time_point m_origin;
+  uint64_t m_tick;
+  size_t m_size;
+  uint32_t m_free;
+  std::vector<uint32_t> m_slots;
+  std::vector<node> m_nodes;
+};
+
+template <typename clock_type>
+constexpr uint32_t timer_wheel<clock_type>::npos;
+
+// Drives a timer_wheel from an io_service with a single steady_timer, set
+// for the earliest pending deadline rather than ticking at the wheel's
+// resolution. Cancelling leaves the timer set, it then fires once without
+// anything due and moves on to the next deadline. Must be used from the
+// thread(s) running the io_service.
+class asio_timer_wheel
+{
+public:
+  using clock = std::chrono::steady_clock;
+  using duration = clock::duration;
+  using callback_type = timer_wheel<clock>::callback_type;
+
+  asio_timer_wheel(const asio_timer_wheel&) = delete;
+  asio_timer_wheel& operator=(const asio_timer_wheel&) = delete;
+
+  explicit asio_timer_wheel(
+      boost::asio::io_service& io,
+      duration resolution = std::chrono::milliseconds(1),
+      size_t slots = 4096)
+      : m_timer(io), m_wheel(resolution, slots), m_armed(false)
+  {
+  }
+
+  timer_id expires_after(duration timeout, callback_type callback)
+  {
+    auto id = m_wheel.schedule(clock::now() + timeout, std::move(callback));
+    arm();
+    return id;
+  }
+
+  bool cancel(timer_id id) noexcept
+  {
+    return m_wheel.cancel(id);
+  }
+
+  size_t size() const noexcept
+  {
+    return m_wheel.size();
+  }
+
+private:
+  // Moves the timer earlier when the next deadline is before the one it
+  // is set for.
+  void arm()
+  {
+    auto expiry = m_wheel.next_expiry();
+    if (m_wheel.empty() || (m_armed && m_expiry <= expiry))
+      return;
+    m_armed = true;
+    m_expiry = expiry;
+    m_timer.expires_at(expiry);
+    // The timer is cancelled by being re-armed, which already waits again,
+    // or by its destructor, after which this object is gone.
+    m_timer.async_wait([this](const boost::system::error_code& ec) {
+      if (ec)
+        return;
+      m_armed = false;
+      m_wheel.advance(clock::now());
+      arm();
+    });
+  }
+
+  boost::asio::steady_timer m_timer;
+  timer_wheel<clock> m_wheel;
+  clock::time_point m_expiry;
+  bool m_armed;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_TIMER_WHEEL_HPP_
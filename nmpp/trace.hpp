@@ -0,0 +1,49 @@
+#ifndef NMPP_TRACE_HPP_
+#define NMPP_TRACE_HPP_
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace nmpp
+{
+
+enum class trace_event : uint8_t
+{
+  readiness_wakeup,
+  send_begin,
+  send_end,
+  receive_begin,
+  receive_end,
+  handler_begin,
+  handler_end
+};
+
+inline uint64_t read_tsc() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Default tracing policy. A policy is a type with a static
+// record(trace_event, int descriptor) function; this one compiles away.
+struct null_tracer
+{
+  static void record(trace_event, int) noexcept
+  {
+  }
+};
+
+} // namespace nmpp
+
+#endif // NMPP_TRACE_HPP_
@@ -0,0 +1,385 @@
+#ifndef NMPP_URING_REACTOR_HPP_
+#define NMPP_URING_REACTOR_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <memory>
+#include <nmpp/epoll_reactor.hpp>
+#include <nmpp/exception.hpp>
+#include <nmpp/reactor_dispatcher.hpp>
+#include <nmpp/reactor_watch.hpp>
+#include <nmpp/socket.hpp>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <system_error>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace nmpp
+{
+
+// Reactor submitting IORING_OP_POLL_ADD requests for the armed watches.
+// Re-arm submissions are queued and handed to the kernel by the same
+// io_uring_enter that waits for completions, so a whole batch of handlers
+// costs a single system call. Polls are one-shot: nanomsg keeps its
+// descriptors signalled while messages are queued without signalling them
+// again, which a multishot poll would never report.
+//
+// When io_uring is not available, e.g. on old kernels or under seccomp, all
+// calls are forwarded to an epoll_reactor.
+class uring_reactor
+{
+public:
+  uring_reactor(const uring_reactor&) = delete;
+  uring_reactor& operator=(const uring_reactor&) = delete;
+
+  explicit uring_reactor(unsigned entries = 256,
+                         size_t max_batch = 64) throw(std::system_error)
+      : m_ring(-1), m_wakeup(-1), m_max_batch(max_batch), m_to_submit(0),
+        m_next_token(first_watch_token), m_wakeup_armed(false),
+        m_stopped(false)
+  {
+    if (!setup(entries))
+    {
+      m_fallback = std::make_unique<epoll_reactor>(max_batch);
+      return;
+    }
+
+    m_wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_wakeup == -1)
+    {
+      auto err = errno;
+      teardown();
+      throw std::system_error(err, std::system_category(), "eventfd");
+    }
+  }
+
+  ~uring_reactor() noexcept
+  {
+    if (m_fallback)
+      return;
+    ::close(m_wakeup);
+    teardown();
+  }
+
+  bool uses_io_uring() const noexcept
+  {
+    return !m_fallback;
+  }
+
+  void arm(reactor_watch& watch) throw(std::system_error)
+  {
+    if (m_fallback)
+      return m_fallback->arm(watch);
+
+    if (watch.armed)
+      return;
+    watch.token = m_next_token++;
+    auto sqe = next_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = watch.fd;
+    sqe->poll32_events =
+        watch.direction == reactor_watch::read ? POLLIN : POLLOUT;
+    sqe->user_data = watch.token;
+    m_watches[watch.token] = &watch;
+    watch.armed = true;
+  }
+
+  void disarm(reactor_watch& watch) noexcept
+  {
+    if (m_fallback)
+      return m_fallback->disarm(watch);
+
+    if (!watch.armed)
+      return;
+    watch.armed = false;
+    m_watches.erase(watch.token);
+    try
+    {
+      auto sqe = next_sqe();
+      sqe->opcode = IORING_OP_POLL_REMOVE;
+      sqe->fd = -1;
+      sqe->addr = watch.token;
+      sqe->user_data = ignored_token;
+    }
+    catch (...)
+    {
+    }
+  }
+
+  // Waits at most timeout_ms milliseconds (-1 blocks) and dispatches one
+  // batch of at most max_batch ready handlers. Returns handlers executed.
+  size_t run_one(int timeout_ms = -1) throw(std::system_error)
+  {
+    if (m_fallback)
+      return m_fallback->run_one(timeout_ms);
+    if (m_stopped.load(std::memory_order_acquire))
+      return 0;
+
+    if (!m_wakeup_armed)
+    {
+      auto sqe = next_sqe();
+      sqe->opcode = IORING_OP_POLL_ADD;
+      sqe->fd = m_wakeup;
+      sqe->poll32_events = POLLIN;
+      sqe->user_data = wakeup_token;
+      m_wakeup_armed = true;
+    }
+
+    unsigned flags = 0;
+    unsigned wait_for = 0;
+    if (!completions_ready() && timeout_ms != 0)
+    {
+      flags = IORING_ENTER_GETEVENTS;
+      wait_for = 1;
+      if (timeout_ms > 0)
+      {
+        m_timeout.tv_sec = timeout_ms / 1000;
+        m_timeout.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+        auto sqe = next_sqe();
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<uint64_t>(&m_timeout);
+        sqe->len = 1;
+        sqe->off = 1;
+        sqe->user_data = ignored_token;
+      }
+    }
+    enter(wait_for, flags);
+    return reap();
+  }
+
+  // Dispatches handlers until stop() is called or nothing is armed.
+  size_t run() throw(std::system_error)
+  {
+    if (m_fallback)
+      return m_fallback->run();
+
+    size_t executed = 0;
+    while (!m_watches.empty() && !m_stopped.load(std::memory_order_acquire))
+      executed += run_one(-1);
+    return executed;
+  }
+
+  // Safe to call from any thread.
+  void stop() noexcept
+  {
+    if (m_fallback)
+      return m_fallback->stop();
+
+    m_stopped.store(true, std::memory_order_release);
+    uint64_t one = 1;
+    auto status = ::write(m_wakeup, &one, sizeof(one));
+    (void)status;
+  }
+
+  void restart() noexcept
+  {
+    if (m_fallback)
+      return m_fallback->restart();
+    m_stopped.store(false, std::memory_order_release);
+  }
+
+  bool stopped() const noexcept
+  {
+    if (m_fallback)
+      return m_fallback->stopped();
+    return m_stopped.load(std::memory_order_acquire);
+  }
+
+  size_t pending() const noexcept
+  {
+    if (m_fallback)
+      return m_fallback->pending();
+    return m_watches.size();
+  }
+
+private:
+  static constexpr uint64_t ignored_token = 0;
+  static constexpr uint64_t wakeup_token = 1;
+  static constexpr uint64_t first_watch_token = 2;
+
+  bool setup(unsigned entries)
+  {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    m_ring = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (m_ring == -1)
+      return false;
+
+    m_sq_ring_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+      m_sq_ring_size = m_cq_ring_size =
+          std::max(m_sq_ring_size, m_cq_ring_size);
+
+    m_sq_ring = map(m_sq_ring_size, IORING_OFF_SQ_RING);
+    m_cq_ring = single_mmap ? m_sq_ring : map(m_cq_ring_size,
+                                              IORING_OFF_CQ_RING);
+    m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqes = reinterpret_cast<io_uring_sqe*>(
+        map(m_sqes_size, IORING_OFF_SQES));
+    if (m_sq_ring == MAP_FAILED || m_cq_ring == MAP_FAILED ||
+        m_sqes == MAP_FAILED)
+    {
+      teardown();
+      return false;
+    }
+
+    auto sq = static_cast<char*>(m_sq_ring);
+    m_sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    m_sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    m_sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    m_sq_entries = params.sq_entries;
+    m_sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+    auto cq = static_cast<char*>(m_cq_ring);
+    m_cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    m_cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    m_cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+  }
+
+  void* map(size_t size, off_t offset) noexcept
+  {
+    return mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, m_ring, offset);
+  }
+
+  void teardown() noexcept
+  {
+    if (m_sqes != nullptr && m_sqes != MAP_FAILED)
+      munmap(m_sqes, m_sqes_size);
+    if (m_cq_ring != nullptr && m_cq_ring != MAP_FAILED &&
+        m_cq_ring != m_sq_ring)
+      munmap(m_cq_ring, m_cq_ring_size);
+    if (m_sq_ring != nullptr && m_sq_ring != MAP_FAILED)
+      munmap(m_sq_ring, m_sq_ring_size);
+    if (m_ring != -1)
+      ::close(m_ring);
+    m_ring = -1;
+  }
+
+  io_uring_sqe* next_sqe()
+  {
+    auto tail = *m_sq_tail;
+    if (tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) == m_sq_entries)
+    {
+      enter(0, 0);
+      tail = *m_sq_tail;
+    }
+    auto index = tail & m_sq_mask;
+    auto sqe = &m_sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    m_sq_array[index] = index;
+    __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++m_to_submit;
+    return sqe;
+  }
+
+  void enter(unsigned wait_for, unsigned flags)
+  {
+    for (;;)
+    {
+      auto submitted = syscall(__NR_io_uring_enter, m_ring, m_to_submit,
+                               wait_for, flags, nullptr, 0);
+      if (submitted >= 0)
+      {
+        m_to_submit -= static_cast<unsigned>(submitted);
+        return;
+      }
+      if (errno == EINTR)
+      {
+        if (wait_for == 0)
+          continue;
+        return;
+      }
+      throw std::system_error(errno, std::system_category(),
+                              "io_uring_enter");
+    }
+  }
+
+  bool completions_ready() const noexcept
+  {
+    return *m_cq_head != __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+  }
+
+  size_t reap()
+  {
+    size_t executed = 0;
+    auto head = *m_cq_head;
+    while (executed < m_max_batch &&
+           head != __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE))
+    {
+      auto cqe = m_cqes[head & m_cq_mask];
+      __atomic_store_n(m_cq_head, ++head, __ATOMIC_RELEASE);
+
+      if (cqe.user_data == wakeup_token)
+      {
+        uint64_t value;
+        auto status = ::read(m_wakeup, &value, sizeof(value));
+        (void)status;
+        m_wakeup_armed = false;
+        continue;
+      }
+
+      auto found = m_watches.find(cqe.user_data);
+      if (found == m_watches.end())
+        continue;
+      auto watch = found->second;
+      m_watches.erase(found);
+      watch->armed = false;
+      auto handler = watch->take();
+      if (watch->waiting())
+        arm(*watch);
+      handler(cqe.res < 0 ? std::error_code(-cqe.res, std::system_category())
+                          : std::error_code());
+      ++executed;
+    }
+    return executed;
+  }
+
+  int m_ring;
+  int m_wakeup;
+  size_t m_max_batch;
+  unsigned m_to_submit;
+  uint64_t m_next_token;
+  bool m_wakeup_armed;
+  std::atomic<bool> m_stopped;
+  std::unique_ptr<epoll_reactor> m_fallback;
+  std::unordered_map<uint64_t, reactor_watch*> m_watches;
+  __kernel_timespec m_timeout;
+
+  void* m_sq_ring = nullptr;
+  void* m_cq_ring = nullptr;
+  io_uring_sqe* m_sqes = nullptr;
+  size_t m_sq_ring_size = 0;
+  size_t m_cq_ring_size = 0;
+  size_t m_sqes_size = 0;
+  unsigned* m_sq_head = nullptr;
+  unsigned* m_sq_tail = nullptr;
+  unsigned* m_sq_array = nullptr;
+  unsigned m_sq_mask = 0;
+  unsigned m_sq_entries = 0;
+  unsigned* m_cq_head = nullptr;
+  unsigned* m_cq_tail = nullptr;
+  io_uring_cqe* m_cqes = nullptr;
+  unsigned m_cq_mask = 0;
+};
+
+using uring_async_socket =
+    async_socket_impl<reactor_dispatcher<uring_reactor>>;
+
+} // namespace nmpp
+
+#endif // NMPP_URING_REACTOR_HPP_
@@ -0,0 +1,53 @@
+#ifndef NMPP_ZLIB_CODEC_HPP_
+#define NMPP_ZLIB_CODEC_HPP_
+
+#include <cstddef>
+#include <zlib.h>
+
+namespace nmpp
+{
+
+// Codec for compressed_socket_impl, requires linking against zlib.
+class zlib_codec
+{
+public:
+  explicit zlib_codec(int level = Z_BEST_SPEED) noexcept : m_level(level)
+  {
+  }
+
+  void set_level(int level) noexcept
+  {
+    m_level = level;
+  }
+
+  size_t max_compressed_size(size_t size) const noexcept
+  {
+    return compressBound(size);
+  }
+
+  size_t compress(const char* src, size_t size, char* dst,
+                  size_t capacity) const noexcept
+  {
+    uLongf length = capacity;
+    auto status =
+        compress2(reinterpret_cast<Bytef*>(dst), &length,
+                  reinterpret_cast<const Bytef*>(src), size, m_level);
+    return status == Z_OK ? length : 0;
+  }
+
+  bool decompress(const char* src, size_t size, char* dst,
+                  size_t original_size) const noexcept
+  {
+    uLongf length = original_size;
+    auto status = uncompress(reinterpret_cast<Bytef*>(dst), &length,
+                             reinterpret_cast<const Bytef*>(src), size);
+    return status == Z_OK && length == original_size;
+  }
+
+private:
+  int m_level;
+};
+
+} // namespace nmpp
+
+#endif // NMPP_ZLIB_CODEC_HPP_
@@ -0,0 +1,26 @@
+// Out-of-line instantiations of the common socket types. Users linking
+// against the nmpp library get NMPP_EXTERN_TEMPLATES defined, so their
+// translation units reference these instead of instantiating them again.
+
+#include <nmpp/async_dispatcher.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/native_socket.hpp>
+#include <nmpp/socket.hpp>
+
+namespace nmpp
+{
+
+template class basic_socket<null_tracer>;
+template class async_dispatcher<native_socket>;
+template class async_socket_impl<async_dispatcher<native_socket>>;
+
+template void basic_socket<null_tracer>::send<message&>(message&);
+template void basic_socket<null_tracer>::send<message>(message&&);
+template bool basic_socket<null_tracer>::try_send<message&>(message&);
+template std::unique_ptr<message>
+basic_socket<null_tracer>::try_receive<message>();
+
+template async_socket_impl<async_dispatcher<native_socket>>::
+    async_socket_impl(int, int, boost::asio::io_service&);
+
+} // namespace nmpp
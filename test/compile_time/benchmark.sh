@@ -0,0 +1,53 @@
+#!/bin/bash
+# Compares build time and object size of many translation units using the
+# common socket types, instantiated in every unit versus declared extern
+# and taken from the compiled nmpp library.
+#
+# Usage: benchmark.sh [units] [extra compiler flags...]
+
+set -e
+
+UNITS=${1:-50}
+shift || true
+CXX=${CXX:-c++}
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+for i in $(seq 1 "$UNITS"); do
+  cat > "$WORK/unit$i.cpp" <<UNIT
+#include <nmpp/message.hpp>
+#include <nmpp/socket.hpp>
+
+void unit$i(boost::asio::io_service& io)
+{
+  nmpp::async_socket socket(AF_SP, NN_PUSH, io);
+  socket.connect("inproc://unit$i");
+  socket.send(*nmpp::message::from("unit$i", 5));
+  socket.try_send(*nmpp::message::from("unit$i", 5));
+  socket.try_receive<nmpp::message>();
+}
+UNIT
+done
+
+build()
+{
+  local dir=$1
+  shift
+  mkdir -p "$dir"
+  local start=$(date +%s.%N)
+  for i in $(seq 1 "$UNITS"); do
+    "$CXX" -std=c++14 -w -O2 -I"$ROOT" "$@" -c "$WORK/unit$i.cpp" \
+      -o "$dir/unit$i.o" &
+    if (( i % $(nproc) == 0 )); then wait; fi
+  done
+  wait
+  local end=$(date +%s.%N)
+  local size=$(cat "$dir"/*.o | wc -c)
+  printf "%-10s %8.2f s %10d bytes of objects\n" "$(basename "$dir")" \
+    "$(awk "BEGIN { print $end - $start }")" "$size"
+}
+
+echo "$UNITS translation units"
+build "$WORK/inline" "$@"
+build "$WORK/extern" -DNMPP_EXTERN_TEMPLATES "$@"
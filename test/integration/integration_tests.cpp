@@ -1,11 +1,14 @@
 #include <functional>
 #include <gmock/gmock.h>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include <nmpp/async_dispatcher.hpp>
 #include <nmpp/message.hpp>
 #include <nmpp/native_socket.hpp>
 #include <nmpp/socket.hpp>
+#include <nmpp/subscription.hpp>
 
 using namespace ::testing;
 
@@ -23,45 +26,53 @@ std::string random_string(size_t length)
   return str;
 }
 
-void send_handler(nmpp::async_socket& socket, const std::error_code ec,
-                  size_t bytes)
+struct integration_test : Test
 {
-  auto data = random_string(31);
-  auto msg = nmpp::message::from(data.c_str(), data.size() + 1);
-  socket.async_send(std::move(msg),
-                    [&socket](const std::error_code ec, size_t bytes) {
-                      send_handler(socket, ec, bytes);
-                    });
-}
+  void send_next()
+  {
+    if (sent.size() == count)
+      return;
+    sent.push_back(random_string(31));
+    auto& data = sent.back();
+    push_socket.async_send(
+        nmpp::message::from(data.c_str(), data.size() + 1),
+        [this](const std::error_code ec, size_t bytes) {
+          ASSERT_FALSE(ec);
+          ASSERT_THAT(bytes, Eq(32u));
+          send_next();
+        });
+  }
 
-void receive_handler(nmpp::async_socket& socket, const nmpp::message& msg)
-{
-  socket.async_receive<nmpp::message>(
-      [&socket](const nmpp::message& msg) { receive_handler(socket, msg); });
-}
-
-TEST(integration_test, create_socket)
-{
+  const size_t count = 10000;
   boost::asio::io_service io;
+  nmpp::async_socket pull_socket{AF_SP, NN_PULL, io};
+  nmpp::async_socket push_socket{AF_SP, NN_PUSH, io};
+  std::vector<std::string> sent;
+  std::vector<std::string> received;
+};
 
-  nmpp::async_socket pull_socket(AF_SP, NN_PULL, io);
+TEST_F(integration_test, delivers_all_messages_in_order)
+{
   pull_socket.bind("tcp://127.0.0.1:5555");
-
-  nmpp::async_socket push_socket(AF_SP, NN_PUSH, io);
   push_socket.connect("tcp://127.0.0.1:5555");
 
-  auto data = random_string(31);
-  auto msg = nmpp::message::from(data.c_str(), data.size() + 1);
-  push_socket.async_send(
-      std::move(msg), [&push_socket](const std::error_code ec, size_t bytes) {
-        send_handler(push_socket, ec, bytes);
-      });
+  boost::asio::steady_timer watchdog(io, std::chrono::seconds(10));
+  watchdog.async_wait([this](const boost::system::error_code& ec) {
+    if (!ec)
+      io.stop();
+  });
 
-  pull_socket.async_receive<nmpp::message>([&pull_socket](
-      const nmpp::message& msg) { receive_handler(pull_socket, msg); });
+  nmpp::subscription<nmpp::async_socket> subscription(
+      pull_socket, [this](const nmpp::message& msg) {
+        received.emplace_back(msg.data());
+        if (received.size() == count)
+          io.stop();
+      });
+  send_next();
 
-  std::thread t1([&io]() { io.run(); });
-  std::this_thread::sleep_for(std::chrono::seconds(1));
-  io.stop();
+  std::thread t1([this]() { io.run(); });
   t1.join();
+
+  ASSERT_THAT(received.size(), Eq(count));
+  ASSERT_THAT(received, ContainerEq(sent));
 }
@@ -0,0 +1,142 @@
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <nmpp/compression.hpp>
+#include <nmpp/zlib_codec.hpp>
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+struct result
+{
+  double compress_us;
+  double decompress_us;
+  size_t wire_bytes;
+};
+
+// Log lines with a few varying fields, compresses roughly like typical
+// text or JSON traffic.
+std::string text_payload(size_t size)
+{
+  std::string payload;
+  for (uint32_t i = 0; payload.size() < size; ++i)
+    payload += "{\"seq\":" + std::to_string(i) + ",\"level\":\"info\"," +
+               "\"value\":" + std::to_string(i * 2654435761u % 10007) + "}\n";
+  payload.resize(size);
+  return payload;
+}
+
+// Pseudo random bytes, the codec cannot shrink them.
+std::string random_payload(size_t size)
+{
+  std::string payload(size, '\0');
+  uint32_t state = 2463534242u;
+  for (auto& c : payload)
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    c = static_cast<char>(state);
+  }
+  return payload;
+}
+
+// Mean time per payload over about the given duration, and the bytes the
+// frame takes on the wire including the compression trailer. Mirrors what
+// compressed_socket_impl does: frames that do not shrink are sent raw.
+result measure(const nmpp::zlib_codec& codec, const std::string& payload,
+               std::chrono::milliseconds duration)
+{
+  std::vector<char> compressed(codec.max_compressed_size(payload.size()));
+  std::string restored(payload.size(), '\0');
+
+  size_t size = 0;
+  size_t rounds = 0;
+  auto start = clock_type::now();
+  auto now = start;
+  while (now < start + duration)
+  {
+    size = codec.compress(payload.data(), payload.size(), compressed.data(),
+                          compressed.size());
+    ++rounds;
+    now = clock_type::now();
+  }
+  auto compress_us =
+      std::chrono::duration<double, std::micro>(now - start).count() / rounds;
+
+  bool shrunk = size != 0 && size < payload.size();
+  if (!shrunk)
+    return {compress_us, 0.0,
+            nmpp::compression_trailer::raw_size + payload.size()};
+
+  rounds = 0;
+  start = clock_type::now();
+  now = start;
+  while (now < start + duration)
+  {
+    if (!codec.decompress(compressed.data(), size, &restored[0],
+                          restored.size()))
+      throw std::runtime_error("Payload decompression failed");
+    ++rounds;
+    now = clock_type::now();
+  }
+  auto decompress_us =
+      std::chrono::duration<double, std::micro>(now - start).count() / rounds;
+
+  return {compress_us, decompress_us,
+          nmpp::compression_trailer::compressed_size + size};
+}
+
+} // namespace
+
+// Usage: nanomsg++-compression-bench [MILLISECONDS_PER_CASE]
+//
+// Prints the CPU time the zlib codec spends per payload against the bytes
+// it saves on the wire, per payload kind, size and compression level. Use
+// it to pick set_compression_threshold() and the codec level for a link.
+int main(int argc, char** argv)
+{
+  std::chrono::milliseconds duration(argc > 1 ? std::stoul(argv[1]) : 100);
+
+  std::cout << std::setw(8) << "payload" << std::setw(10) << "bytes"
+            << std::setw(7) << "level" << std::setw(10) << "wire"
+            << std::setw(9) << "ratio" << std::setw(13) << "compress"
+            << std::setw(13) << "decompress" << std::setw(14) << "us/KB saved"
+            << std::endl;
+
+  for (auto kind : {"text", "random"})
+  {
+    for (size_t size = 256; size <= 1024 * 1024; size *= 8)
+    {
+      auto payload = std::string(kind) == "text" ? text_payload(size)
+                                                 : random_payload(size);
+      for (int level : {Z_BEST_SPEED, Z_DEFAULT_COMPRESSION,
+                        Z_BEST_COMPRESSION})
+      {
+        nmpp::zlib_codec codec(level);
+        auto r = measure(codec, payload, duration);
+        auto raw_wire = nmpp::compression_trailer::raw_size + size;
+        std::cout << std::setw(8) << kind << std::setw(10) << size
+                  << std::setw(7) << level << std::setw(10) << r.wire_bytes
+                  << std::fixed << std::setprecision(3) << std::setw(9)
+                  << static_cast<double>(r.wire_bytes) / raw_wire
+                  << std::setprecision(1) << std::setw(13) << r.compress_us
+                  << std::setw(13) << r.decompress_us;
+        if (r.wire_bytes < raw_wire)
+          std::cout << std::setprecision(2) << std::setw(14)
+                    << (r.compress_us + r.decompress_us) * 1024 /
+                           (raw_wire - r.wire_bytes);
+        else
+          std::cout << std::setw(14) << "-";
+        std::cout << std::endl;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,77 @@
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <nmpp/crc32c.hpp>
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+// Keeps the checksums from being optimised away.
+volatile uint32_t checksum_sink;
+
+// Checksums the buffer in payload sized pieces for about the given time
+// and returns GB/s.
+template <typename function_type>
+double throughput(function_type checksum, const std::vector<char>& buffer,
+                  size_t size, std::chrono::milliseconds duration)
+{
+  uint32_t crc = 0;
+  size_t bytes = 0;
+  auto start = clock_type::now();
+  auto deadline = start + duration;
+  auto now = start;
+  while (now < deadline)
+  {
+    for (size_t offset = 0; offset + size <= buffer.size(); offset += size)
+    {
+      crc ^= checksum(buffer.data() + offset, size);
+      bytes += size;
+    }
+    now = clock_type::now();
+  }
+  checksum_sink = crc;
+  return bytes / std::chrono::duration<double>(now - start).count() / 1e9;
+}
+
+} // namespace
+
+// Usage: nanomsg++-crc32c-bench [MILLISECONDS_PER_SIZE]
+//
+// Prints CRC32C throughput per payload size for the implementation the
+// integrity trailer uses on this CPU and for the portable fallback.
+int main(int argc, char** argv)
+{
+  std::chrono::milliseconds duration(argc > 1 ? std::stoul(argv[1]) : 200);
+  std::vector<char> buffer(4 * 1024 * 1024);
+  for (size_t i = 0; i < buffer.size(); ++i)
+    buffer[i] = static_cast<char>(i * 2654435761u >> 24);
+
+  auto selected = [](const char* data, size_t size) {
+    return nmpp::crc32c(data, size);
+  };
+  auto software = [](const char* data, size_t size) {
+    return nmpp::crc32c_software(data, size);
+  };
+
+  std::cout << "implementation: " << nmpp::crc32c_implementation()
+            << std::endl;
+  std::cout << std::setw(10) << "bytes" << std::setw(20)
+            << nmpp::crc32c_implementation() << std::setw(20) << "software"
+            << "  (GB/s)" << std::endl;
+  for (size_t size = 64; size <= 1024 * 1024; size *= 4)
+  {
+    std::cout << std::setw(10) << size << std::fixed << std::setprecision(2)
+              << std::setw(20)
+              << throughput(selected, buffer, size, duration)
+              << std::setw(20)
+              << throughput(software, buffer, size, duration)
+              << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nmpp/credit_flow.hpp>
+#include <nmpp/loopback_backend.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/socket.hpp>
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+struct options
+{
+  unsigned workers = 4;
+  unsigned slow = 1;
+  std::chrono::microseconds fast_cost{200};
+  std::chrono::microseconds slow_cost{2000};
+  unsigned batch = 200;
+  unsigned rounds = 5;
+  uint32_t window = 2;
+  std::string backend = "nanomsg";
+};
+
+struct result
+{
+  std::vector<double> latencies;
+  std::vector<double> makespans;
+
+  double percentile(double p) const
+  {
+    if (latencies.empty())
+      return 0;
+    auto sorted = latencies;
+    std::sort(sorted.begin(), sorted.end());
+    auto index = static_cast<size_t>(p * (sorted.size() - 1));
+    return sorted[index];
+  }
+
+  double mean_makespan() const
+  {
+    double total = 0;
+    for (auto m : makespans)
+      total += m;
+    return makespans.empty() ? 0 : total / makespans.size();
+  }
+};
+
+std::string address(const std::string& name, unsigned index = 0)
+{
+  std::ostringstream out;
+  out << "inproc://nmpp-credit-bench-" << name << "-" << index;
+  return out.str();
+}
+
+// Workers simulate work by sleeping and echo the task id back on the
+// results channel. With credits set they return one credit per task.
+template <typename socket_type>
+void work(socket_type& tasks, socket_type& results,
+          nmpp::credit_worker<socket_type>* credits,
+          std::chrono::microseconds cost, const std::atomic<bool>& stopping)
+{
+  while (!stopping.load())
+  {
+    std::unique_ptr<nmpp::message> task;
+    try
+    {
+      task = tasks.template receive<nmpp::message>();
+    }
+    catch (const nmpp::exception& e)
+    {
+      if (e.num() == ETIMEDOUT)
+        continue;
+      throw;
+    }
+    std::this_thread::sleep_for(cost);
+    results.send(task->data(), task->size());
+    if (credits)
+      credits->complete();
+  }
+}
+
+// Sends rounds of batch tasks at once and waits for every one of them.
+// Latency is measured from the start of the round to each completion.
+template <typename socket_type, typename dispatch_type>
+void drive(const options& opts, socket_type& results, dispatch_type dispatch,
+           result& res)
+{
+  for (auto round = 0u; round < opts.rounds; ++round)
+  {
+    auto start = clock_type::now();
+    for (uint32_t id = 0; id < opts.batch; ++id)
+    {
+      auto task = nmpp::message::from(reinterpret_cast<const char*>(&id),
+                                      sizeof(id));
+      dispatch(*task);
+    }
+    for (auto done = 0u; done < opts.batch; ++done)
+    {
+      results.template receive<nmpp::message>();
+      res.latencies.push_back(std::chrono::duration<double, std::milli>(
+                                  clock_type::now() - start)
+                                  .count());
+    }
+    res.makespans.push_back(
+        std::chrono::duration<double, std::milli>(clock_type::now() - start)
+            .count());
+  }
+}
+
+std::chrono::microseconds cost(const options& opts, unsigned worker)
+{
+  return worker < opts.slow ? opts.slow_cost : opts.fast_cost;
+}
+
+template <typename socket_type> void set_receive_timeout(socket_type& socket)
+{
+  int timeout = 100;
+  socket.set_option(NN_SOL_SOCKET, NN_RCVTIMEO, timeout);
+}
+
+// Plain NN_PUSH round-robin over every worker.
+template <typename socket_type> result run_push(const options& opts)
+{
+  socket_type results(AF_SP, NN_PULL);
+  results.bind(address("push-results"));
+  socket_type tasks(AF_SP, NN_PUSH);
+  tasks.bind(address("push-tasks"));
+
+  std::atomic<bool> stopping(false);
+  std::vector<std::unique_ptr<socket_type>> sockets;
+  std::vector<std::thread> workers;
+  for (auto i = 0u; i < opts.workers; ++i)
+  {
+    sockets.emplace_back(new socket_type(AF_SP, NN_PULL));
+    auto& in = *sockets.back();
+    set_receive_timeout(in);
+    in.connect(address("push-tasks"));
+    sockets.emplace_back(new socket_type(AF_SP, NN_PUSH));
+    auto& out = *sockets.back();
+    out.connect(address("push-results"));
+    workers.emplace_back([&opts, &stopping, i, &in, &out] {
+      work<socket_type>(in, out, nullptr, cost(opts, i), stopping);
+    });
+  }
+
+  result res;
+  drive(opts, results, [&](nmpp::message& task) { tasks.send(task); }, res);
+  stopping = true;
+  for (auto& t : workers)
+    t.join();
+  return res;
+}
+
+// One PUSH per worker, dispatched by credit.
+template <typename socket_type> result run_credit(const options& opts)
+{
+  socket_type results(AF_SP, NN_PULL);
+  results.bind(address("credit-results"));
+  socket_type grants(AF_SP, NN_PULL);
+  grants.bind(address("credit-grants"));
+  nmpp::credit_dispatcher<socket_type> dispatcher(grants);
+
+  std::atomic<bool> stopping(false);
+  std::vector<std::unique_ptr<socket_type>> sockets;
+  std::vector<std::thread> workers;
+  for (auto i = 0u; i < opts.workers; ++i)
+  {
+    sockets.emplace_back(new socket_type(AF_SP, NN_PUSH));
+    auto& tasks = *sockets.back();
+    tasks.bind(address("credit-tasks", i));
+    dispatcher.add_worker(tasks);
+
+    sockets.emplace_back(new socket_type(AF_SP, NN_PULL));
+    auto& in = *sockets.back();
+    set_receive_timeout(in);
+    in.connect(address("credit-tasks", i));
+    sockets.emplace_back(new socket_type(AF_SP, NN_PUSH));
+    auto& out = *sockets.back();
+    out.connect(address("credit-results"));
+    sockets.emplace_back(new socket_type(AF_SP, NN_PUSH));
+    auto& credit_out = *sockets.back();
+    credit_out.connect(address("credit-grants"));
+
+    workers.emplace_back([&opts, &stopping, i, &in, &out, &credit_out] {
+      nmpp::credit_worker<socket_type> credits(credit_out, i, opts.window);
+      work(in, out, &credits, cost(opts, i), stopping);
+    });
+  }
+
+  result res;
+  drive(opts, results,
+        [&](nmpp::message& task) { dispatcher.dispatch(task); }, res);
+  stopping = true;
+  for (auto& t : workers)
+    t.join();
+  return res;
+}
+
+void print(const std::string& name, const result& res)
+{
+  std::cout << std::left << std::setw(8) << name << std::right << std::fixed
+            << std::setprecision(2) << " p50 " << res.percentile(0.5)
+            << " ms p99 " << res.percentile(0.99) << " ms max "
+            << res.percentile(1.0) << " ms | batch " << res.mean_makespan()
+            << " ms" << std::endl;
+}
+
+template <typename socket_type> void run(const options& opts)
+{
+  print("push", run_push<socket_type>(opts));
+  print("credit", run_credit<socket_type>(opts));
+}
+
+options parse(int argc, char** argv)
+{
+  options opts;
+  for (auto i = 1; i < argc; ++i)
+  {
+    std::string arg(argv[i]);
+    auto eq = arg.find('=');
+    auto name = arg.substr(0, eq);
+    auto value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+    if (name == "--workers")
+      opts.workers = std::stoul(value);
+    else if (name == "--slow")
+      opts.slow = std::stoul(value);
+    else if (name == "--fast-us")
+      opts.fast_cost = std::chrono::microseconds(std::stoul(value));
+    else if (name == "--slow-us")
+      opts.slow_cost = std::chrono::microseconds(std::stoul(value));
+    else if (name == "--batch")
+      opts.batch = std::stoul(value);
+    else if (name == "--rounds")
+      opts.rounds = std::stoul(value);
+    else if (name == "--window")
+      opts.window = std::stoul(value);
+    else if (name == "--backend")
+      opts.backend = value;
+    else
+      throw std::invalid_argument("Unknown option: " + arg);
+  }
+  if (opts.workers == 0 || opts.window == 0)
+    throw std::invalid_argument("Need at least one worker and credit");
+  if (opts.backend != "nanomsg" && opts.backend != "loopback")
+    throw std::invalid_argument("Unknown backend: " + opts.backend);
+  return opts;
+}
+
+} // namespace
+
+// Usage: nanomsg++-credit-bench [--workers=N] [--slow=N] [--fast-us=US]
+//   [--slow-us=US] [--batch=N] [--rounds=N] [--window=N]
+//   [--backend=nanomsg|loopback]
+//
+// Compares the batch latency of plain NN_PUSH with credit based dispatch
+// when some workers are much slower than the others. The loopback backend
+// has the same PUSH round-robin and runs without libnanomsg.
+//
+// Defaults with --backend=loopback, optimised gcc 12 build on a 1-CPU
+// Xeon, three runs:
+//   push     p50 8.65-9.20 ms   p99 100.3-101.1 ms   batch 104.0-104.5 ms
+//   credit   p50 16.6-16.9 ms   p99 17.1-17.6 ms     batch 19.5-20.8 ms
+// Credit cuts p99 and the batch time about fivefold because the slow
+// worker no longer gets a quarter of the batch. p50 doubles because
+// tasks wait for credit instead of going straight into a fast worker's
+// queue. Not yet measured against libnanomsg's inproc transport.
+int main(int argc, char** argv)
+{
+  options opts;
+  try
+  {
+    opts = parse(argc, argv);
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 2;
+  }
+
+  std::cout << opts.workers << " workers, " << opts.slow << " at "
+            << opts.slow_cost.count() << " us, the rest at "
+            << opts.fast_cost.count() << " us per task, " << opts.rounds
+            << " batches of " << opts.batch << std::endl;
+  try
+  {
+    if (opts.backend == "loopback")
+      run<nmpp::loopback_socket>(opts);
+    else
+      run<nmpp::socket>(opts);
+  }
+  catch (const std::exception& e)
+  {
+    std::cout << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nmpp/loopback_backend.hpp>
+#include <nmpp/message.hpp>
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+using backend = nmpp::loopback_backend;
+
+// Messages in flight per round, below the loopback queue capacity so that
+// single threaded rounds never block.
+constexpr size_t batch = 512;
+
+double elapsed_ns(clock_type::time_point start)
+{
+  return std::chrono::duration<double, std::nano>(clock_type::now() - start)
+      .count();
+}
+
+// The loopback transport on its own: chunks allocated up front go
+// straight through the backend functions.
+double raw(const std::string& address, size_t size, size_t messages)
+{
+  auto rx = backend::socket(AF_SP, NN_PULL);
+  auto tx = backend::socket(AF_SP, NN_PUSH);
+  backend::bind(rx, address.c_str());
+  backend::connect(tx, address.c_str());
+
+  std::vector<char*> chunks(batch);
+  for (auto& chunk : chunks)
+    chunk = static_cast<char*>(nn_allocmsg(size, 0));
+  auto start = clock_type::now();
+  for (size_t done = 0; done < messages; done += batch)
+  {
+    for (auto chunk : chunks)
+      backend::send_chunk(tx, chunk, size, 0);
+    for (auto& chunk : chunks)
+      backend::receive_chunk(rx, &chunk, 0);
+  }
+  auto ns = elapsed_ns(start) / messages;
+  for (auto chunk : chunks)
+    nn_freemsg(chunk);
+  backend::close(tx);
+  backend::close(rx);
+  return ns;
+}
+
+// The same traffic through nmpp::message and basic_socket.
+double wrapped(const std::string& address, size_t size, size_t messages)
+{
+  nmpp::loopback_socket rx(AF_SP, NN_PULL);
+  nmpp::loopback_socket tx(AF_SP, NN_PUSH);
+  rx.bind(address);
+  tx.connect(address);
+
+  std::vector<char> payload(size, 'x');
+  auto start = clock_type::now();
+  for (size_t done = 0; done < messages; done += batch)
+  {
+    for (size_t i = 0; i < batch; ++i)
+      tx.send(*nmpp::message::from(payload.data(), size));
+    for (size_t i = 0; i < batch; ++i)
+      rx.receive<nmpp::message>();
+  }
+  return elapsed_ns(start) / messages;
+}
+
+// Wrapped sockets with the sender and receiver on their own threads.
+double threaded(const std::string& address, size_t size, size_t messages)
+{
+  nmpp::loopback_socket rx(AF_SP, NN_PULL);
+  nmpp::loopback_socket tx(AF_SP, NN_PUSH);
+  rx.bind(address);
+  tx.connect(address);
+
+  std::vector<char> payload(size, 'x');
+  auto start = clock_type::now();
+  std::thread sender([&] {
+    for (size_t i = 0; i < messages; ++i)
+      tx.send(*nmpp::message::from(payload.data(), size));
+  });
+  for (size_t i = 0; i < messages; ++i)
+    rx.receive<nmpp::message>();
+  sender.join();
+  return elapsed_ns(start) / messages;
+}
+
+} // namespace
+
+// Usage: nanomsg++-loopback-bench [MESSAGES_PER_SIZE]
+//
+// Prints the cost per message of the loopback transport alone, of the
+// same traffic through nmpp's message and socket wrappers, and of the
+// wrapped sockets across two threads. The difference between the first
+// two columns is nmpp's own per-message overhead, including copying the
+// payload into a new message.
+int main(int argc, char** argv)
+{
+  size_t messages = argc > 1 ? std::stoul(argv[1]) : 1000000;
+  messages = (messages + batch - 1) / batch * batch;
+
+  std::cout << std::setw(10) << "bytes" << std::setw(12) << "raw"
+            << std::setw(12) << "wrapped" << std::setw(12) << "overhead"
+            << std::setw(12) << "threaded"
+            << "  (ns/message)" << std::endl;
+  for (size_t size = 16; size <= 64 * 1024; size *= 16)
+  {
+    auto suffix = std::to_string(size);
+    auto r = raw("inproc://raw-" + suffix, size, messages);
+    auto w = wrapped("inproc://wrapped-" + suffix, size, messages);
+    auto t = threaded("inproc://threaded-" + suffix, size, messages);
+    std::cout << std::setw(10) << size << std::fixed << std::setprecision(1)
+              << std::setw(12) << r << std::setw(12) << w << std::setw(12)
+              << w - r << std::setw(12) << t << std::endl;
+  }
+  return 0;
+}
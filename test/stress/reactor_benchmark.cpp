@@ -0,0 +1,154 @@
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <nmpp/epoll_reactor.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/socket.hpp>
+#include <nmpp/uring_reactor.hpp>
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+double elapsed_ns(clock_type::time_point start)
+{
+  return std::chrono::duration<double, std::nano>(clock_type::now() - start)
+      .count();
+}
+
+// Receives remaining messages and answers each one, the last one only
+// with reply_to_last. Every receive is a fresh wait on the dispatcher.
+template <typename socket_type>
+void echo(socket_type& sock, size_t& remaining,
+          const std::vector<char>& payload, bool reply_to_last)
+{
+  sock.template async_receive<nmpp::message>(
+      [&sock, &remaining, &payload, reply_to_last](const nmpp::message&) {
+        if (--remaining > 0 || reply_to_last)
+          sock.send(*nmpp::message::from(payload.data(), payload.size()));
+        if (remaining > 0)
+          echo(sock, remaining, payload, reply_to_last);
+      });
+}
+
+// Receives remaining messages without answering.
+template <typename socket_type>
+void drain(socket_type& sock, size_t& remaining)
+{
+  sock.template async_receive<nmpp::message>(
+      [&sock, &remaining](const nmpp::message&) {
+        if (--remaining > 0)
+          drain(sock, remaining);
+      });
+}
+
+// Round trips between two PAIR sockets served by the same event loop.
+// Measures wake-up latency: one readiness wait per message.
+template <typename socket_type, typename context_type>
+double ping_pong(context_type& context, const std::string& address,
+                 size_t size, size_t round_trips)
+{
+  socket_type a(AF_SP, NN_PAIR, context);
+  socket_type b(AF_SP, NN_PAIR, context);
+  a.bind(address);
+  b.connect(address);
+
+  std::vector<char> payload(size, 'x');
+  size_t a_remaining = round_trips;
+  size_t b_remaining = round_trips;
+  echo(a, a_remaining, payload, false);
+  echo(b, b_remaining, payload, true);
+
+  auto start = clock_type::now();
+  a.send(*nmpp::message::from(payload.data(), size));
+  context.run();
+  return elapsed_ns(start) / round_trips;
+}
+
+// A sender thread streams messages into a PULL socket drained by the
+// event loop. Measures dispatch cost per message under load.
+template <typename socket_type, typename context_type>
+double stream(context_type& context, const std::string& address, size_t size,
+              size_t messages)
+{
+  socket_type rx(AF_SP, NN_PULL, context);
+  nmpp::socket tx(AF_SP, NN_PUSH);
+  rx.bind(address);
+  tx.connect(address);
+
+  std::vector<char> payload(size, 'x');
+  size_t remaining = messages;
+  drain(rx, remaining);
+
+  auto start = clock_type::now();
+  std::thread sender([&] {
+    for (size_t i = 0; i < messages; ++i)
+      tx.send(*nmpp::message::from(payload.data(), size));
+  });
+  context.run();
+  sender.join();
+  return elapsed_ns(start) / messages;
+}
+
+// Runs both measurements on a fresh event loop of one backend.
+template <typename socket_type, typename context_type>
+void report(const std::string& name, size_t size, size_t messages)
+{
+  auto suffix = name + "-" + std::to_string(size);
+  double latency, throughput;
+  {
+    context_type context;
+    latency = ping_pong<socket_type>(context, "inproc://nmpp-reactor-ping-" +
+                                                  suffix,
+                                     size, messages);
+  }
+  {
+    context_type context;
+    throughput = stream<socket_type>(
+        context, "inproc://nmpp-reactor-stream-" + suffix, size, messages);
+  }
+  std::cout << std::setw(10) << size << std::setw(10) << name << std::fixed
+            << std::setprecision(1) << std::setw(16) << latency
+            << std::setw(16) << throughput << std::endl;
+}
+
+} // namespace
+
+// Usage: nanomsg++-reactor-bench [MESSAGES_PER_CASE]
+//
+// Compares the dispatcher backends on the same nanomsg sockets: the Asio
+// native_socket path, the epoll reactor and the io_uring reactor. Prints
+// the round trip time between two sockets sharing one event loop and the
+// cost per message of draining a stream from another thread.
+int main(int argc, char** argv)
+{
+  size_t messages = argc > 1 ? std::stoul(argv[1]) : 100000;
+
+  {
+    nmpp::uring_reactor probe;
+    std::cout << "io_uring: "
+              << (probe.uses_io_uring() ? "available"
+                                        : "unavailable, epoll fallback")
+              << std::endl;
+  }
+  std::cout << std::setw(10) << "bytes" << std::setw(10) << "backend"
+            << std::setw(16) << "round trip" << std::setw(16) << "stream"
+            << "  (ns)" << std::endl;
+  for (size_t size = 16; size <= 16 * 1024; size *= 32)
+  {
+    report<nmpp::async_socket, boost::asio::io_service>("asio", size,
+                                                        messages);
+    report<nmpp::epoll_async_socket, nmpp::epoll_reactor>("epoll", size,
+                                                          messages);
+    report<nmpp::uring_async_socket, nmpp::uring_reactor>("io_uring", size,
+                                                          messages);
+  }
+  return 0;
+}
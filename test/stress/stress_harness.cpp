@@ -0,0 +1,530 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <nmpp/loopback_backend.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/socket.hpp>
+
+namespace
+{
+
+std::atomic<uint64_t> allocations(0);
+
+struct options
+{
+  std::chrono::milliseconds duration{std::chrono::seconds(5)};
+  std::chrono::milliseconds drain{std::chrono::seconds(5)};
+  unsigned producers = 4;
+  unsigned consumers = 4;
+  size_t size = 64;
+  std::vector<std::string> transports{"inproc", "ipc", "tcp", "ws",
+                                      "loopback"};
+  std::string baseline;
+  double tolerance = 0.2;
+  bool update_baseline = false;
+};
+
+// Each message carries its origin and a per-producer sequence number
+// starting at 1, the rest of the payload is derived from both.
+struct header
+{
+  uint32_t producer;
+  uint32_t size;
+  uint64_t sequence;
+};
+
+struct result
+{
+  uint64_t sent = 0;
+  uint64_t received = 0;
+  uint64_t corrupted = 0;
+  uint64_t reordered = 0;
+  uint64_t allocations = 0;
+  double seconds = 0;
+
+  double rate() const
+  {
+    return seconds > 0 ? received / seconds : 0;
+  }
+
+  double allocations_per_message() const
+  {
+    return received > 0 ? double(allocations) / received : 0;
+  }
+};
+
+struct baseline_entry
+{
+  double min_rate;
+  double max_allocations_per_message;
+};
+
+char pattern(uint32_t producer, uint64_t sequence, size_t offset)
+{
+  return static_cast<char>((producer * 31 + sequence * 7 + offset) & 0xff);
+}
+
+void fill(std::vector<char>& payload, uint32_t producer, uint64_t sequence)
+{
+  header h{producer, static_cast<uint32_t>(payload.size()), sequence};
+  std::memcpy(payload.data(), &h, sizeof(h));
+  for (auto i = sizeof(h); i < payload.size(); ++i)
+    payload[i] = pattern(producer, sequence, i);
+}
+
+bool verify(const nmpp::message& msg, header& h)
+{
+  if (msg.size() < sizeof(h))
+    return false;
+  std::memcpy(&h, msg.data(), sizeof(h));
+  if (h.size != msg.size())
+    return false;
+  for (auto i = sizeof(h); i < msg.size(); ++i)
+    if (msg.data()[i] != pattern(h.producer, h.sequence, i))
+      return false;
+  return true;
+}
+
+std::string address(const std::string& transport, unsigned index)
+{
+  static const auto port_base = 15000 + getpid() % 20000;
+  std::ostringstream out;
+  if (transport == "inproc" || transport == "loopback")
+    out << "inproc://nmpp-stress-" << index;
+  else if (transport == "ipc")
+    out << "ipc:///tmp/nmpp-stress-" << getpid() << "-" << index << ".ipc";
+  else if (transport == "tcp")
+    out << "tcp://127.0.0.1:" << port_base + index;
+  else if (transport == "ws")
+    out << "ws://127.0.0.1:" << port_base + 100 + index;
+  else
+    throw std::invalid_argument("Unknown transport: " + transport);
+  return out.str();
+}
+
+// Runs PUSH producers against PULL consumers, every producer connects to
+// every consumer. PUSH keeps per-connection order, so each consumer must
+// see strictly increasing sequence numbers from any single producer.
+template <typename socket_type>
+result run(const std::string& transport, const options& opts)
+{
+  std::vector<std::unique_ptr<socket_type>> pulls;
+  for (auto i = 0u; i < opts.consumers; ++i)
+  {
+    pulls.emplace_back(new socket_type(AF_SP, NN_PULL));
+    pulls.back()->bind(address(transport, i));
+  }
+
+  std::vector<std::unique_ptr<socket_type>> pushes;
+  for (auto i = 0u; i < opts.producers; ++i)
+  {
+    pushes.emplace_back(new socket_type(AF_SP, NN_PUSH));
+    for (auto j = 0u; j < opts.consumers; ++j)
+      pushes.back()->connect(address(transport, j));
+  }
+
+  result res;
+  std::atomic<bool> producing(true);
+  std::atomic<uint64_t> sent(0);
+  std::atomic<bool> sent_known(false);
+  std::atomic<uint64_t> received(0);
+  std::atomic<uint64_t> corrupted(0);
+  std::atomic<uint64_t> reordered(0);
+  std::mutex sums_mutex;
+  std::vector<uint64_t> sequence_sums(opts.producers, 0);
+  std::vector<uint64_t> last_sequences(opts.producers, 0);
+
+  auto allocations_before = allocations.load();
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> consumers;
+  for (auto i = 0u; i < opts.consumers; ++i)
+  {
+    consumers.emplace_back([&, i] {
+      std::vector<uint64_t> last(opts.producers, 0);
+      std::vector<uint64_t> sums(opts.producers, 0);
+      std::chrono::steady_clock::time_point drain_deadline;
+      while (true)
+      {
+        auto msg = pulls[i]->template try_receive<nmpp::message>();
+        if (!msg)
+        {
+          if (sent_known.load() && received.load() >= sent.load())
+            break;
+          if (sent_known.load())
+          {
+            auto now = std::chrono::steady_clock::now();
+            if (drain_deadline == decltype(drain_deadline)())
+              drain_deadline = now + opts.drain;
+            else if (now > drain_deadline)
+              break;
+          }
+          std::this_thread::yield();
+          continue;
+        }
+        header h;
+        if (!verify(*msg, h) || h.producer >= opts.producers)
+          ++corrupted;
+        else
+        {
+          if (h.sequence <= last[h.producer])
+            ++reordered;
+          last[h.producer] = h.sequence;
+          sums[h.producer] += h.sequence;
+        }
+        ++received;
+      }
+      std::lock_guard<std::mutex> lock(sums_mutex);
+      for (auto p = 0u; p < opts.producers; ++p)
+        sequence_sums[p] += sums[p];
+    });
+  }
+
+  std::vector<std::thread> producers;
+  for (auto i = 0u; i < opts.producers; ++i)
+  {
+    producers.emplace_back([&, i] {
+      std::vector<char> payload(std::max(opts.size, sizeof(header)));
+      uint64_t sequence = 0;
+      while (producing.load(std::memory_order_relaxed))
+      {
+        fill(payload, i, ++sequence);
+        pushes[i]->send(payload.data(), payload.size());
+      }
+      last_sequences[i] = sequence;
+      sent += sequence;
+    });
+  }
+
+  std::this_thread::sleep_for(opts.duration);
+  producing = false;
+  for (auto& t : producers)
+    t.join();
+  sent_known = true;
+  for (auto& t : consumers)
+    t.join();
+
+  res.seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  res.allocations = allocations.load() - allocations_before;
+  res.sent = sent;
+  res.received = received;
+  res.corrupted = corrupted;
+  res.reordered = reordered;
+
+  // Any loss or duplication shows up in the per-producer sequence sums.
+  for (auto p = 0u; p < opts.producers; ++p)
+  {
+    auto n = last_sequences[p];
+    if (sequence_sums[p] != n * (n + 1) / 2)
+      ++res.corrupted;
+  }
+  return res;
+}
+
+// "loopback" runs the nanomsg-free loopback_backend over inproc names.
+result run(const std::string& transport, const options& opts)
+{
+  if (transport == "loopback")
+    return run<nmpp::loopback_socket>(transport, opts);
+  return run<nmpp::socket>(transport, opts);
+}
+
+std::string config(const options& opts)
+{
+  std::ostringstream out;
+  out << "--duration=" << opts.duration.count() / 1000.0
+      << " --producers=" << opts.producers
+      << " --consumers=" << opts.consumers << " --size=" << opts.size;
+  return out.str();
+}
+
+const std::string config_prefix = "# config: ";
+
+// Also returns the configuration the baseline was recorded with.
+std::map<std::string, baseline_entry> read_baseline(const std::string& path,
+                                                    std::string& recorded)
+{
+  std::map<std::string, baseline_entry> entries;
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line))
+  {
+    if (line.compare(0, config_prefix.size(), config_prefix) == 0)
+      recorded = line.substr(config_prefix.size());
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream fields(line);
+    std::string transport;
+    baseline_entry entry;
+    if (fields >> transport >> entry.min_rate >>
+        entry.max_allocations_per_message)
+      entries[transport] = entry;
+  }
+  return entries;
+}
+
+std::string cpu_model()
+{
+  std::ifstream in("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(in, line))
+    if (line.compare(0, 10, "model name") == 0)
+      return line.substr(line.find(':') + 2);
+  return "unknown cpu";
+}
+
+#if defined(__clang__)
+constexpr const char* compiler = __VERSION__;
+#else
+constexpr const char* compiler = "gcc " __VERSION__;
+#endif
+#ifdef __OPTIMIZE__
+constexpr const char* optimisation = "optimised";
+#else
+constexpr const char* optimisation = "unoptimised";
+#endif
+
+// The numbers only compare against runs on the same kind of machine and
+// build with the same options, so all three are recorded above them.
+void write_baseline(const std::string& path, const options& opts,
+                    const std::map<std::string, result>& results)
+{
+  utsname system;
+  uname(&system);
+  std::ofstream out(path);
+  out << "# machine: " << cpu_model() << ", "
+      << std::thread::hardware_concurrency() << " cpus, " << system.sysname
+      << " " << system.release << "\n";
+  out << "# build: " << compiler << ", " << optimisation << "\n";
+  out << config_prefix << config(opts) << "\n";
+  out << "# transport messages_per_second allocations_per_message\n";
+  for (auto& r : results)
+    out << r.first << " " << std::fixed << std::setprecision(0)
+        << r.second.rate() << " " << std::setprecision(3)
+        << r.second.allocations_per_message() << "\n";
+}
+
+long max_rss_kb()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+std::vector<std::string> split(const std::string& value)
+{
+  std::vector<std::string> parts;
+  std::istringstream in(value);
+  std::string part;
+  while (std::getline(in, part, ','))
+    parts.push_back(part);
+  return parts;
+}
+
+options parse(int argc, char** argv)
+{
+  options opts;
+  for (auto i = 1; i < argc; ++i)
+  {
+    std::string arg(argv[i]);
+    auto eq = arg.find('=');
+    auto name = arg.substr(0, eq);
+    auto value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+    if (name == "--duration")
+      opts.duration = std::chrono::milliseconds(
+          static_cast<long>(std::stod(value) * 1000));
+    else if (name == "--producers")
+      opts.producers = std::stoul(value);
+    else if (name == "--consumers")
+      opts.consumers = std::stoul(value);
+    else if (name == "--size")
+      opts.size = std::stoul(value);
+    else if (name == "--transports")
+      opts.transports = split(value);
+    else if (name == "--baseline")
+      opts.baseline = value;
+    else if (name == "--tolerance")
+      opts.tolerance = std::stod(value);
+    else if (name == "--update-baseline")
+      opts.update_baseline = true;
+    else
+      throw std::invalid_argument("Unknown option: " + arg);
+  }
+  return opts;
+}
+
+} // namespace
+
+// Allocations are counted at the C allocator, which the executable
+// interposes for every shared object in the process: operator new,
+// nn_allocmsg and libnanomsg's own buffers all end up here. glibc exports
+// the functions these forward to.
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+  return memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+  if (alignment % sizeof(void*) != 0 ||
+      (alignment & (alignment - 1)) != 0)
+    return EINVAL;
+  auto p = memalign(alignment, size);
+  if (p == nullptr)
+    return ENOMEM;
+  *ptr = p;
+  return 0;
+}
+
+void free(void* ptr)
+{
+  __libc_free(ptr);
+}
+
+} // extern "C"
+
+// Usage: nanomsg++-stress [--duration=SECONDS] [--producers=N]
+//   [--consumers=N] [--size=BYTES]
+//   [--transports=inproc,ipc,tcp,ws,loopback]
+//   [--baseline=FILE [--tolerance=FRACTION] [--update-baseline]]
+int main(int argc, char** argv)
+{
+  options opts;
+  try
+  {
+    opts = parse(argc, argv);
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 2;
+  }
+
+  std::map<std::string, baseline_entry> baseline;
+  if (!opts.baseline.empty() && !opts.update_baseline)
+  {
+    std::string recorded;
+    baseline = read_baseline(opts.baseline, recorded);
+    // Rates from shorter or differently shaped runs do not compare.
+    if (!baseline.empty() && recorded != config(opts))
+    {
+      std::cerr << "Baseline was recorded with " << recorded
+                << ", this run uses " << config(opts) << std::endl;
+      return 2;
+    }
+  }
+  std::map<std::string, result> results;
+  auto failed = false;
+
+  for (auto& transport : opts.transports)
+  {
+    result res;
+    try
+    {
+      res = run(transport, opts);
+    }
+    catch (const nmpp::exception& e)
+    {
+      std::cout << transport << ": " << e.what() << std::endl;
+      failed = true;
+      continue;
+    }
+    catch (const std::exception& e)
+    {
+      std::cout << transport << ": " << e.what() << std::endl;
+      failed = true;
+      continue;
+    }
+    results[transport] = res;
+
+    std::cout << std::left << std::setw(8) << transport << std::right
+              << " sent " << res.sent << " received " << res.received
+              << " corrupted " << res.corrupted << " reordered "
+              << res.reordered << " | " << std::fixed << std::setprecision(0)
+              << res.rate() << " msg/s " << std::setprecision(1)
+              << res.rate() * opts.size / (1024 * 1024) << " MiB/s "
+              << std::setprecision(3) << res.allocations_per_message()
+              << " allocs/msg (" << res.allocations << ") max rss "
+              << max_rss_kb() << " KiB" << std::endl;
+
+    if (res.received != res.sent || res.corrupted || res.reordered)
+    {
+      std::cout << transport << ": delivery check failed" << std::endl;
+      failed = true;
+    }
+
+    auto entry = baseline.find(transport);
+    if (entry == baseline.end())
+      continue;
+    if (res.rate() < entry->second.min_rate * (1 - opts.tolerance))
+    {
+      std::cout << transport << ": throughput regressed below baseline "
+                << entry->second.min_rate << " msg/s" << std::endl;
+      failed = true;
+    }
+    if (res.allocations_per_message() >
+        entry->second.max_allocations_per_message * (1 + opts.tolerance))
+    {
+      std::cout << transport << ": allocations regressed above baseline "
+                << entry->second.max_allocations_per_message << " per msg"
+                << std::endl;
+      failed = true;
+    }
+  }
+
+  if (opts.update_baseline && !opts.baseline.empty() && !failed)
+    write_baseline(opts.baseline, opts, results);
+
+  return failed ? 1 : 0;
+}
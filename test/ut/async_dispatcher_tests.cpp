@@ -75,3 +75,28 @@ TEST_F(async_dispatcher_tests, registers_write_handler)
   EXPECT_CALL(handler, handle(_));
   native_handler(boost::system::error_code(), 0);
 }
+
+TEST_F(async_dispatcher_tests, reports_aborted_wait_as_operation_canceled)
+{
+  nmpp::async_dispatcher<native_socket_mock> async_dispatcher(5, 6, io);
+  auto& native_socket = async_dispatcher.get_native_receive_socket();
+  native_socket_mock::handler native_handler;
+  EXPECT_CALL(native_socket, async_read_event(_))
+      .WillOnce(SaveArg<0>(&native_handler));
+  async_dispatcher.on_receive_event(std::bind(
+      &EventHandlerMock::handle, std::ref(handler), std::placeholders::_1));
+
+  EXPECT_CALL(native_socket, cancel());
+  async_dispatcher.cancel_receive();
+  EXPECT_CALL(handler,
+              handle(Eq(std::make_error_code(std::errc::operation_canceled))));
+  native_handler(boost::asio::error::operation_aborted, 0);
+}
+
+TEST_F(async_dispatcher_tests, cancel_send_cancels_native_send_socket)
+{
+  nmpp::async_dispatcher<native_socket_mock> async_dispatcher(5, 6, io);
+  EXPECT_CALL(async_dispatcher.get_native_send_socket(), cancel());
+  EXPECT_CALL(async_dispatcher.get_native_receive_socket(), cancel()).Times(0);
+  async_dispatcher.cancel_send();
+}
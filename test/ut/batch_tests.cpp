@@ -0,0 +1,160 @@
+#include "mocks/nanomsg_heap.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include <boost/asio.hpp>
+#include <gtest/gtest.h>
+#include <nmpp/batch.hpp>
+#include <string>
+
+using namespace ::testing;
+
+struct batch_writer_test : Test
+{
+  void SetUp()
+  {
+    EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(1));
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto)).WillOnce(Return(1));
+    EXPECT_CALL(nanomsg, nn_close(1)).WillOnce(Return(0));
+    socket.reset(new nmpp::socket(domain, proto));
+  }
+
+  void TearDown()
+  {
+    socket.reset();
+    ASSERT_THAT(heap.allocations, IsEmpty());
+  }
+
+  void write(nmpp::batch_writer<>& writer, const std::string& record)
+  {
+    writer.write(record.data(), record.size());
+  }
+
+  int domain = 0;
+  int proto = 0;
+  nanomsg_mock nanomsg;
+  nanomsg_heap heap{nanomsg};
+  std::unique_ptr<nmpp::socket> socket;
+};
+
+TEST_F(batch_writer_test, packs_records_with_length_prefix)
+{
+  nmpp::batch_writer<> writer(*socket, 64, 2, std::chrono::seconds(10));
+  write(writer, "ab");
+  write(writer, "cde");
+  ASSERT_THAT(heap.sent,
+              ElementsAre(std::string("\2\0\0\0ab\3\0\0\0cde", 13)));
+}
+
+TEST_F(batch_writer_test, flushes_when_record_count_is_reached)
+{
+  nmpp::batch_writer<> writer(*socket, 64, 3, std::chrono::seconds(10));
+  write(writer, "a");
+  write(writer, "b");
+  ASSERT_THAT(heap.sent, IsEmpty());
+  ASSERT_THAT(writer.pending_records(), Eq(2u));
+  write(writer, "c");
+  ASSERT_THAT(heap.sent, SizeIs(1));
+  ASSERT_THAT(writer.pending_records(), Eq(0u));
+}
+
+TEST_F(batch_writer_test, flushes_before_record_exceeds_size_limit)
+{
+  nmpp::batch_writer<> writer(*socket, 12, 100, std::chrono::seconds(10));
+  write(writer, "abcd");
+  write(writer, "efgh");
+  ASSERT_THAT(heap.sent, ElementsAre(std::string("\4\0\0\0abcd", 8)));
+  ASSERT_THAT(writer.pending_bytes(), Eq(8u));
+}
+
+TEST_F(batch_writer_test, sends_oversized_record_in_own_batch)
+{
+  nmpp::batch_writer<> writer(*socket, 4, 100, std::chrono::seconds(10));
+  write(writer, "abcdefgh");
+  ASSERT_THAT(heap.sent, ElementsAre(std::string("\x8\0\0\0abcdefgh", 12)));
+}
+
+TEST_F(batch_writer_test, flushes_when_deadline_expires)
+{
+  nmpp::batch_writer<> writer(*socket, 64, 100, std::chrono::seconds(10));
+  write(writer, "a");
+  ASSERT_FALSE(writer.flush_if_due());
+  ASSERT_TRUE(writer.flush_if_due(writer.deadline()));
+  ASSERT_THAT(heap.sent, SizeIs(1));
+}
+
+TEST_F(batch_writer_test, timer_flushes_at_deadline_without_polling)
+{
+  boost::asio::io_service io;
+  nmpp::batch_writer<> writer(*socket, 64, 100,
+                              std::chrono::milliseconds(1), io);
+  write(writer, "a");
+  ASSERT_THAT(heap.sent, IsEmpty());
+  io.run();
+  ASSERT_THAT(heap.sent, ElementsAre(std::string("\1\0\0\0a", 5)));
+  ASSERT_THAT(writer.pending_records(), Eq(0u));
+}
+
+TEST_F(batch_writer_test, timer_reports_failed_flush)
+{
+  boost::asio::io_service io;
+  std::error_code error;
+  nmpp::batch_writer<> writer(*socket, 64, 100,
+                              std::chrono::milliseconds(1), io,
+                              [&](const std::error_code& ec) { error = ec; });
+  write(writer, "a");
+  EXPECT_CALL(nanomsg, nn_reallocmsg(_, _)).WillOnce(Return(nullptr));
+  io.run();
+  ASSERT_THAT(error.value(), Eq(1));
+  ASSERT_THAT(heap.sent, IsEmpty());
+  ASSERT_THAT(writer.pending_records(), Eq(0u));
+}
+
+TEST_F(batch_writer_test, flushes_pending_records_on_destruction)
+{
+  {
+    nmpp::batch_writer<> writer(*socket, 64, 100, std::chrono::seconds(10));
+    write(writer, "a");
+  }
+  ASSERT_THAT(heap.sent, ElementsAre(std::string("\1\0\0\0a", 5)));
+}
+
+TEST_F(batch_writer_test, does_not_send_empty_batch)
+{
+  nmpp::batch_writer<> writer(*socket, 64, 100, std::chrono::seconds(10));
+  writer.flush();
+  ASSERT_THAT(heap.sent, IsEmpty());
+}
+
+TEST(batch_reader_test, iterates_records_without_copying)
+{
+  std::string batch("\2\0\0\0ab\0\0\0\0\3\0\0\0cde", 17);
+  nmpp::batch_reader reader(batch.data(), batch.size());
+  std::vector<std::string> records;
+  for (auto& record : reader)
+  {
+    ASSERT_THAT(record.data, AllOf(Ge(batch.data()),
+                                   Lt(batch.data() + batch.size())));
+    records.emplace_back(record.data, record.size);
+  }
+  ASSERT_THAT(records, ElementsAre("ab", "", "cde"));
+}
+
+TEST(batch_reader_test, empty_batch_has_no_records)
+{
+  nmpp::batch_reader reader(nullptr, 0);
+  ASSERT_TRUE(reader.begin() == reader.end());
+}
+
+TEST(batch_reader_test, throws_on_truncated_record)
+{
+  std::string batch("\5\0\0\0ab", 6);
+  nmpp::batch_reader reader(batch.data(), batch.size());
+  ASSERT_THROW(reader.begin(), std::runtime_error);
+}
+
+TEST(batch_reader_test, throws_on_truncated_header)
+{
+  std::string batch("\1\0\0\0a\1\0", 7);
+  nmpp::batch_reader reader(batch.data(), batch.size());
+  auto it = reader.begin();
+  ASSERT_THROW(++it, std::runtime_error);
+}
@@ -0,0 +1,143 @@
+#include "mocks/async_dispatcher_mock.hpp"
+#include "mocks/nanomsg_heap.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include <boost/asio.hpp>
+#include <gtest/gtest.h>
+#include <nmpp/broadcast.hpp>
+#include <nmpp/message.hpp>
+
+using namespace ::testing;
+
+struct broadcast_test : Test
+{
+  void SetUp()
+  {
+    EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(1));
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto))
+        .WillOnce(Return(1))
+        .WillOnce(Return(2))
+        .WillOnce(Return(3));
+    EXPECT_CALL(nanomsg, nn_close(_)).Times(3).WillRepeatedly(Return(0));
+  }
+
+  int domain = 0;
+  int proto = 0;
+  nanomsg_mock nanomsg;
+  nanomsg_heap heap{nanomsg};
+};
+
+TEST_F(broadcast_test, copies_for_all_but_last_socket)
+{
+  nmpp::socket first(domain, proto);
+  nmpp::socket second(domain, proto);
+  nmpp::socket third(domain, proto);
+  auto msg = nmpp::message::from("abc", 3);
+  auto payload = msg->data();
+
+  EXPECT_CALL(nanomsg, nn_send(1, payload, 3, 0)).WillOnce(Return(3));
+  EXPECT_CALL(nanomsg, nn_send(2, payload, 3, 0)).WillOnce(Return(3));
+  ASSERT_THAT(nmpp::broadcast<nmpp::socket>({&first, &second, &third}, *msg),
+              Eq(3u));
+  ASSERT_FALSE(msg->valid());
+  ASSERT_THAT(heap.sent, ElementsAre("abc"));
+}
+
+TEST_F(broadcast_test, keeps_message_when_copy_fails)
+{
+  nmpp::socket first(domain, proto);
+  nmpp::socket second(domain, proto);
+  nmpp::socket third(domain, proto);
+  auto msg = nmpp::message::from("abc", 3);
+
+  EXPECT_CALL(nanomsg, nn_send(1, _, 3, 0)).WillOnce(Return(-1));
+  ASSERT_THROW(
+      nmpp::broadcast<nmpp::socket>({&first, &second, &third}, *msg),
+      nmpp::exception);
+  ASSERT_TRUE(msg->valid());
+}
+
+TEST_F(broadcast_test, throws_for_invalid_message)
+{
+  nmpp::socket first(domain, proto);
+  nmpp::socket second(domain, proto);
+  nmpp::socket third(domain, proto);
+  auto msg = nmpp::message::from_nn(nullptr, 0);
+  ASSERT_THROW(nmpp::broadcast<nmpp::socket>({&first}, *msg),
+               std::logic_error);
+}
+
+ACTION_P(SetArgVoidPointee, p)
+{
+  *reinterpret_cast<int*>(arg3) = p;
+}
+
+struct async_broadcast_test : broadcast_test
+{
+  using async_socket = nmpp::async_socket_impl<async_dispatcher_mock>;
+
+  void SetUp()
+  {
+    broadcast_test::SetUp();
+    EXPECT_CALL(nanomsg, nn_getsockopt(_, NN_SOL_SOCKET, _, _, _))
+        .WillRepeatedly(DoAll(SetArgVoidPointee(100), Return(0)));
+    for (int i = 0; i < 3; ++i)
+    {
+      sockets.emplace_back(new async_socket(domain, proto, io_service));
+      EXPECT_CALL(sockets.back()->get_async_dispatcher(), on_send_event(_))
+          .WillOnce(Invoke([this](async_dispatcher_mock::handler handler) {
+            handlers.push_back(handler);
+          }));
+    }
+  }
+
+  std::vector<async_socket*> pointers()
+  {
+    std::vector<async_socket*> result;
+    for (auto& socket : sockets)
+      result.push_back(socket.get());
+    return result;
+  }
+
+  boost::asio::io_service io_service;
+  std::vector<std::unique_ptr<async_socket>> sockets;
+  std::vector<async_dispatcher_mock::handler> handlers;
+};
+
+TEST_F(async_broadcast_test, completes_once_after_all_sends)
+{
+  int calls = 0;
+  size_t sent = 0;
+  nmpp::async_broadcast(pointers(), nmpp::message::from("abc", 3),
+                        [&](const std::error_code& ec, size_t n) {
+                          ++calls;
+                          sent = n;
+                          EXPECT_FALSE(ec);
+                        });
+  ASSERT_THAT(handlers, SizeIs(3));
+
+  handlers[1](std::error_code());
+  handlers[0](std::error_code());
+  ASSERT_THAT(calls, Eq(0));
+  handlers[2](std::error_code());
+  ASSERT_THAT(calls, Eq(1));
+  ASSERT_THAT(sent, Eq(3u));
+  ASSERT_THAT(heap.sent, ElementsAre("abc", "abc", "abc"));
+}
+
+TEST_F(async_broadcast_test, reports_first_error)
+{
+  std::error_code result;
+  size_t sent = 0;
+  nmpp::async_broadcast(pointers(), nmpp::message::from("abc", 3),
+                        [&](const std::error_code& ec, size_t n) {
+                          result = ec;
+                          sent = n;
+                        });
+
+  auto aborted = std::make_error_code(std::errc::operation_canceled);
+  handlers[0](std::error_code());
+  handlers[1](aborted);
+  handlers[2](std::error_code());
+  ASSERT_THAT(result, Eq(aborted));
+  ASSERT_THAT(sent, Eq(2u));
+}
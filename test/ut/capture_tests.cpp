@@ -0,0 +1,231 @@
+#include "mocks/async_dispatcher_mock.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include <boost/asio.hpp>
+#include <chrono>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <nmpp/capture.hpp>
+#include <nmpp/message.hpp>
+#include <unistd.h>
+
+using namespace ::testing;
+
+struct capture_test : Test
+{
+  void SetUp()
+  {
+    char name[] = "/tmp/nmpp-capture-XXXXXX";
+    auto fd = mkstemp(name);
+    ASSERT_THAT(fd, Ne(-1));
+    ::close(fd);
+    path = name;
+  }
+
+  void TearDown()
+  {
+    ::unlink(path.c_str());
+  }
+
+  std::vector<std::string> payloads(const nmpp::capture_reader& reader)
+  {
+    std::vector<std::string> result;
+    for (auto& record : reader)
+      result.emplace_back(record.data, record.size);
+    return result;
+  }
+
+  std::string path;
+};
+
+TEST_F(capture_test, reads_back_appended_records)
+{
+  {
+    nmpp::capture_writer writer(path);
+    writer.append("abc", 3, 100);
+    writer.append("", 0, 200);
+    writer.append("0123456789", 10, 300);
+  }
+  nmpp::capture_reader reader(path);
+  ASSERT_THAT(payloads(reader), ElementsAre("abc", "", "0123456789"));
+
+  std::vector<uint64_t> timestamps;
+  for (auto& record : reader)
+    timestamps.push_back(record.timestamp);
+  ASSERT_THAT(timestamps, ElementsAre(100u, 200u, 300u));
+}
+
+TEST_F(capture_test, grows_file_beyond_initial_chunk)
+{
+  std::string payload(1000, 'x');
+  {
+    nmpp::capture_writer writer(path, 4096);
+    for (int i = 0; i < 100; ++i)
+      writer.append(payload.data(), payload.size());
+  }
+  nmpp::capture_reader reader(path);
+  auto records = payloads(reader);
+  ASSERT_THAT(records, SizeIs(100));
+  ASSERT_THAT(records, Each(Eq(payload)));
+}
+
+TEST_F(capture_test, committed_records_are_readable_while_writing)
+{
+  nmpp::capture_writer writer(path);
+  writer.append("abc", 3);
+  nmpp::capture_reader reader(path);
+  ASSERT_THAT(payloads(reader), ElementsAre("abc"));
+}
+
+TEST_F(capture_test, truncates_file_to_committed_length_on_close)
+{
+  size_t length;
+  {
+    nmpp::capture_writer writer(path);
+    writer.append("abc", 3);
+    length = writer.length();
+  }
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  ASSERT_THAT(static_cast<size_t>(file.tellg()), Eq(length));
+}
+
+TEST_F(capture_test, throws_when_file_is_not_a_capture)
+{
+  std::ofstream(path) << "definitely not a capture file";
+  ASSERT_THROW(nmpp::capture_reader reader(path), std::runtime_error);
+}
+
+TEST_F(capture_test, throws_when_header_length_is_below_header_size)
+{
+  {
+    nmpp::capture_writer writer(path);
+    writer.append("abc", 3);
+  }
+  {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    uint64_t length = nmpp::capture_format::header_size - 1;
+    file.seekp(sizeof(nmpp::capture_format::magic));
+    file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+  }
+  ASSERT_THROW(nmpp::capture_reader reader(path), std::runtime_error);
+}
+
+TEST_F(capture_test, throws_when_file_does_not_exist)
+{
+  ASSERT_THROW(nmpp::capture_reader reader(path + ".missing"),
+               std::system_error);
+}
+
+struct capture_socket_test : capture_test
+{
+  void SetUp()
+  {
+    capture_test::SetUp();
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto)).WillOnce(Return(1));
+    EXPECT_CALL(nanomsg, nn_close(1)).WillOnce(Return(0));
+  }
+
+  int domain = 0;
+  int proto = 0;
+  nanomsg_mock nanomsg;
+  char data[3] = {'a', 'b', 'c'};
+};
+
+ACTION_P(SetArgVoidPointer, ptr)
+{
+  *reinterpret_cast<void**>(arg1) = ptr;
+}
+
+TEST_F(capture_socket_test, records_received_messages)
+{
+  {
+    nmpp::capture_writer writer(path);
+    nmpp::recording_socket socket(writer, domain, proto);
+    EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, 0))
+        .WillOnce(DoAll(SetArgVoidPointer(data), Return(3)));
+    auto received = socket.receive<nmpp::message>();
+    ASSERT_THAT(received->size(), Eq(3u));
+    received->release();
+  }
+  nmpp::capture_reader reader(path);
+  ASSERT_THAT(payloads(reader), ElementsAre("abc"));
+}
+
+TEST_F(capture_socket_test, async_receive_records_messages_and_passes_errors)
+{
+  using recording_socket = nmpp::recording_socket_impl<
+      nmpp::async_socket_impl<async_dispatcher_mock>>;
+  boost::asio::io_service io;
+  EXPECT_CALL(nanomsg, nn_getsockopt(1, NN_SOL_SOCKET, _, _, _))
+      .WillRepeatedly(Return(0));
+  {
+    nmpp::capture_writer writer(path);
+    recording_socket socket(writer, domain, proto, io);
+    async_dispatcher_mock::handler readable;
+    EXPECT_CALL(socket.get_async_dispatcher(), on_receive_event(_))
+        .WillRepeatedly(SaveArg<0>(&readable));
+
+    std::vector<std::string> received;
+    std::error_code error;
+    auto handler = [&](const std::error_code& ec,
+                       std::unique_ptr<nmpp::message> msg) {
+      error = ec;
+      if (msg)
+      {
+        received.emplace_back(msg->data(), msg->size());
+        msg->release();
+      }
+    };
+
+    socket.async_receive<nmpp::message>(handler);
+    EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, 0))
+        .WillOnce(DoAll(SetArgVoidPointer(data), Return(3)));
+    readable(std::error_code());
+    ASSERT_THAT(received, ElementsAre("abc"));
+
+    socket.async_receive<nmpp::message>(handler);
+    readable(std::make_error_code(std::errc::operation_canceled));
+    ASSERT_THAT(error, Eq(std::errc::operation_canceled));
+    ASSERT_THAT(received.size(), Eq(1u));
+  }
+  nmpp::capture_reader reader(path);
+  ASSERT_THAT(payloads(reader), ElementsAre("abc"));
+}
+
+TEST_F(capture_socket_test, replays_payloads_from_mapping)
+{
+  {
+    nmpp::capture_writer writer(path);
+    writer.append("abc", 3, 1000);
+    writer.append("de", 2, 2000);
+  }
+  nmpp::capture_reader reader(path);
+  nmpp::socket socket(domain, proto);
+
+  std::vector<std::string> sent;
+  EXPECT_CALL(nanomsg, nn_send(1, _, _, 0))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](int, const void* buf, size_t size, int) {
+        sent.emplace_back(static_cast<const char*>(buf), size);
+        return static_cast<int>(size);
+      }));
+  ASSERT_THAT(nmpp::replay(reader, socket), Eq(2u));
+  ASSERT_THAT(sent, ElementsAre("abc", "de"));
+  ASSERT_THAT(reader.begin()->data, Ne(nullptr));
+}
+
+TEST_F(capture_socket_test, replays_with_original_pacing)
+{
+  {
+    nmpp::capture_writer writer(path);
+    writer.append("a", 1, 0);
+    writer.append("b", 1, 20000000);
+  }
+  nmpp::capture_reader reader(path);
+  nmpp::socket socket(domain, proto);
+  EXPECT_CALL(nanomsg, nn_send(1, _, 1, 0)).WillRepeatedly(Return(1));
+
+  auto start = std::chrono::steady_clock::now();
+  nmpp::replay(reader, socket, nmpp::replay_pacing::original);
+  ASSERT_THAT(std::chrono::steady_clock::now() - start,
+              Ge(std::chrono::milliseconds(20)));
+}
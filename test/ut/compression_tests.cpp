@@ -0,0 +1,233 @@
+#include "mocks/async_dispatcher_mock.hpp"
+#include "mocks/nanomsg_heap.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include <boost/asio.hpp>
+#include <gtest/gtest.h>
+#include <nmpp/compression.hpp>
+#include <nmpp/message.hpp>
+#include <string>
+
+using namespace ::testing;
+
+struct uniform_codec
+{
+  size_t max_compressed_size(size_t) const
+  {
+    return 1;
+  }
+
+  size_t compress(const char* src, size_t size, char* dst, size_t) const
+  {
+    if (std::string(src, size).find_first_not_of(src[0]) != std::string::npos)
+      return 0;
+    dst[0] = src[0];
+    return 1;
+  }
+
+  bool decompress(const char* src, size_t size, char* dst,
+                  size_t original_size) const
+  {
+    if (size != 1)
+      return false;
+    std::fill(dst, dst + original_size, src[0]);
+    return true;
+  }
+};
+
+struct compression_test : Test
+{
+  void SetUp()
+  {
+    EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(1));
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto)).WillOnce(Return(1));
+    EXPECT_CALL(nanomsg, nn_close(1)).WillOnce(Return(0));
+    socket.reset(new compressed_socket(domain, proto));
+    socket->set_compression_threshold(8);
+  }
+
+  void TearDown()
+  {
+    socket.reset();
+    ASSERT_THAT(heap.allocations, IsEmpty());
+  }
+
+  void expect_receive(const std::string& frame)
+  {
+    EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, 0))
+        .WillOnce(Invoke([this, frame](int, void* buf, size_t, int) {
+          *reinterpret_cast<void**>(buf) = heap.allocate(frame);
+          return static_cast<int>(frame.size());
+        }));
+  }
+
+  using compressed_socket = nmpp::compressed_socket<uniform_codec>;
+
+  int domain = 0;
+  int proto = 0;
+  nanomsg_mock nanomsg;
+  nanomsg_heap heap{nanomsg};
+  std::unique_ptr<compressed_socket> socket;
+};
+
+TEST_F(compression_test, sends_payload_below_threshold_uncompressed)
+{
+  auto msg = nmpp::message::from("abc", 3);
+  socket->send(*msg);
+  ASSERT_THAT(heap.sent, ElementsAre(std::string("abc\0", 4)));
+}
+
+TEST_F(compression_test, sends_payload_above_threshold_compressed)
+{
+  std::string payload(300, 'x');
+  auto msg = nmpp::message::from(payload.data(), payload.size());
+  socket->send(*msg);
+  ASSERT_THAT(heap.sent, ElementsAre(std::string("x\x2c\1\0\0\1", 6)));
+}
+
+TEST_F(compression_test, sends_incompressible_payload_uncompressed)
+{
+  std::string payload = "0123456789";
+  auto msg = nmpp::message::from(payload.data(), payload.size());
+  socket->send(*msg);
+  ASSERT_THAT(heap.sent, ElementsAre(payload + std::string(1, '\0')));
+}
+
+TEST_F(compression_test, releases_sent_message)
+{
+  auto msg = nmpp::message::from("abc", 3);
+  socket->send(*msg);
+  ASSERT_FALSE(msg->valid());
+}
+
+TEST_F(compression_test, receives_uncompressed_payload)
+{
+  expect_receive(std::string("abc\0", 4));
+  auto msg = socket->receive<nmpp::message>();
+  ASSERT_THAT(std::string(msg->data(), msg->size()), Eq("abc"));
+}
+
+TEST_F(compression_test, receives_compressed_payload)
+{
+  expect_receive(std::string("x\x2c\1\0\0\1", 6));
+  auto msg = socket->receive<nmpp::message>();
+  ASSERT_THAT(std::string(msg->data(), msg->size()),
+              Eq(std::string(300, 'x')));
+}
+
+TEST_F(compression_test, sends_raw_frame_in_payload_chunk)
+{
+  auto msg = nmpp::message::from("abc", 3);
+  EXPECT_CALL(nanomsg, nn_allocmsg(_, _)).Times(0);
+  socket->send(*msg);
+  ASSERT_THAT(heap.sent, ElementsAre(std::string("abc\0", 4)));
+}
+
+TEST_F(compression_test, receives_raw_frame_in_place)
+{
+  expect_receive(std::string("abc\0", 4));
+  EXPECT_CALL(nanomsg, nn_allocmsg(_, _)).Times(0);
+  auto msg = socket->receive<nmpp::message>();
+  ASSERT_THAT(std::string(msg->data(), msg->size()), Eq("abc"));
+  ASSERT_THAT(heap.allocations.count(const_cast<char*>(msg->data())), Eq(1u));
+}
+
+TEST_F(compression_test, throws_on_unknown_trailer)
+{
+  expect_receive("abc\7");
+  ASSERT_THROW(socket->receive<nmpp::message>(), std::runtime_error);
+}
+
+TEST_F(compression_test, throws_on_failed_decompression)
+{
+  expect_receive(std::string("xy\x2c\1\0\0\1", 7));
+  ASSERT_THROW(socket->receive<nmpp::message>(), std::runtime_error);
+}
+
+TEST_F(compression_test, throws_on_original_size_above_limit)
+{
+  socket->set_max_decompressed_size(299);
+  expect_receive(std::string("x\x2c\1\0\0\1", 6));
+  ASSERT_THROW(socket->receive<nmpp::message>(), std::runtime_error);
+}
+
+TEST_F(compression_test, rejects_huge_original_size_without_allocating)
+{
+  expect_receive(std::string("x\xff\xff\xff\xff\1", 6));
+  ASSERT_THROW(socket->receive<nmpp::message>(), std::runtime_error);
+}
+
+struct compression_async_test : Test
+{
+  using compressed_socket = nmpp::compressed_socket_impl<
+      uniform_codec, nmpp::async_socket_impl<async_dispatcher_mock>>;
+
+  void SetUp()
+  {
+    EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(1));
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto)).WillOnce(Return(1));
+    EXPECT_CALL(nanomsg, nn_getsockopt(1, NN_SOL_SOCKET, _, _, _))
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(nanomsg, nn_close(1)).WillOnce(Return(0));
+    socket.reset(new compressed_socket(domain, proto, io));
+    socket->set_compression_threshold(8);
+    EXPECT_CALL(socket->get_async_dispatcher(), on_receive_event(_))
+        .WillRepeatedly(SaveArg<0>(&readable));
+  }
+
+  void TearDown()
+  {
+    socket.reset();
+    ASSERT_THAT(heap.allocations, IsEmpty());
+  }
+
+  void expect_receive(const std::string& frame)
+  {
+    EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, 0))
+        .WillOnce(Invoke([this, frame](int, void* buf, size_t, int) {
+          *reinterpret_cast<void**>(buf) = heap.allocate(frame);
+          return static_cast<int>(frame.size());
+        }));
+  }
+
+  int domain = 0;
+  int proto = 0;
+  nanomsg_mock nanomsg;
+  nanomsg_heap heap{nanomsg};
+  boost::asio::io_service io;
+  std::unique_ptr<compressed_socket> socket;
+  async_dispatcher_mock::handler readable;
+};
+
+TEST_F(compression_async_test, reports_undecodable_frame_as_bad_message)
+{
+  std::vector<std::string> received;
+  std::error_code error;
+  auto handler = [&](const std::error_code& ec,
+                     std::unique_ptr<nmpp::message> msg) {
+    error = ec;
+    if (msg)
+      received.emplace_back(msg->data(), msg->size());
+  };
+
+  socket->async_receive<nmpp::message>(handler);
+  expect_receive(std::string("x\x2c\1\0\0\1", 6));
+  readable(std::error_code());
+  ASSERT_FALSE(error);
+  ASSERT_THAT(received, ElementsAre(std::string(300, 'x')));
+
+  socket->async_receive<nmpp::message>(handler);
+  expect_receive("abc\7");
+  readable(std::error_code());
+  ASSERT_THAT(error, Eq(std::errc::bad_message));
+  ASSERT_THAT(received.size(), Eq(1u));
+}
+
+TEST_F(compression_async_test, drops_undecodable_frame_for_plain_handlers)
+{
+  auto called = false;
+  socket->async_receive<nmpp::message>(
+      [&](const nmpp::message&) { called = true; });
+  expect_receive("abc\7");
+  readable(std::error_code());
+  ASSERT_FALSE(called);
+}
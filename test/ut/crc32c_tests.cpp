@@ -0,0 +1,56 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nmpp/crc32c.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace ::testing;
+
+TEST(crc32c_test, matches_reference_check_values)
+{
+  ASSERT_THAT(nmpp::crc32c("123456789", 9), Eq(0xe3069283u));
+  ASSERT_THAT(nmpp::crc32c_software("123456789", 9), Eq(0xe3069283u));
+  ASSERT_THAT(nmpp::crc32c("", 0), Eq(0u));
+
+  std::string zeros(32, '\0');
+  ASSERT_THAT(nmpp::crc32c(zeros.data(), zeros.size()), Eq(0x8a9136aau));
+  std::string ones(32, '\xff');
+  ASSERT_THAT(nmpp::crc32c(ones.data(), ones.size()), Eq(0x62a8ab43u));
+}
+
+// Covers the unaligned head, both interleaved block sizes, the folding
+// block and lane reductions and the tail.
+TEST(crc32c_test, selected_implementation_matches_software)
+{
+  std::mt19937 random(7);
+  std::vector<unsigned char> data(3 * 3 * 8192 + 64);
+  for (auto& byte : data)
+    byte = static_cast<unsigned char>(random());
+
+  for (size_t size : {1u, 7u, 8u, 63u, 255u, 256u, 257u, 320u, 335u, 511u,
+                      512u, 767u, 768u, 769u, 5000u, 24575u, 24576u, 24577u,
+                      3u * 3 * 8192})
+    for (size_t offset = 0; offset < 8; ++offset)
+      ASSERT_THAT(nmpp::crc32c(data.data() + offset, size),
+                  Eq(nmpp::crc32c_software(data.data() + offset, size)))
+          << "size " << size << " offset " << offset;
+}
+
+TEST(crc32c_test, continues_over_several_buffers)
+{
+  std::string payload(50000, 'a');
+  for (size_t i = 0; i < payload.size(); ++i)
+    payload[i] = static_cast<char>(i * 31);
+
+  auto crc = nmpp::crc32c(payload.data(), 1000);
+  crc = nmpp::crc32c(payload.data() + 1000, payload.size() - 1000, crc);
+  ASSERT_THAT(crc, Eq(nmpp::crc32c(payload.data(), payload.size())));
+}
+
+TEST(crc32c_test, names_implementation)
+{
+  std::string name = nmpp::crc32c_implementation();
+  ASSERT_THAT(name, AnyOf(Eq("avx512-vpclmulqdq"), Eq("sse4.2"),
+                               Eq("armv8-crc"), Eq("software")));
+}
@@ -0,0 +1,185 @@
+#include "mocks/nanomsg_heap.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include <cstring>
+#include <gtest/gtest.h>
+#include <nmpp/credit_flow.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/socket.hpp>
+#include <string>
+#include <vector>
+
+using namespace ::testing;
+
+struct credit_flow_test : Test
+{
+  using dispatcher = nmpp::credit_dispatcher<>;
+
+  void SetUp()
+  {
+    EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(EAGAIN));
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto))
+        .WillOnce(Return(1))
+        .WillOnce(Return(2))
+        .WillOnce(Return(3));
+    EXPECT_CALL(nanomsg, nn_close(_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, NN_DONTWAIT))
+        .WillRepeatedly(Invoke([this](int, void* buf, size_t, int) {
+          return next_grant(buf);
+        }));
+    EXPECT_CALL(nanomsg, nn_send(_, _, NN_MSG, NN_DONTWAIT))
+        .WillRepeatedly(Invoke([this](int sock, const void* buf, size_t, int) {
+          auto chunk = *reinterpret_cast<char* const*>(buf);
+          sent.push_back(sock);
+          heap.release(chunk);
+          return 1;
+        }));
+    grants.reset(new nmpp::socket(domain, proto));
+    fast.reset(new nmpp::socket(domain, proto));
+    slow.reset(new nmpp::socket(domain, proto));
+  }
+
+  int next_grant(void* buf)
+  {
+    if (queued.empty())
+      return -1;
+    auto grant = queued.front();
+    queued.erase(queued.begin());
+    auto chunk = heap.allocate(sizeof(grant));
+    std::memcpy(chunk, &grant, sizeof(grant));
+    *reinterpret_cast<void**>(buf) = chunk;
+    return sizeof(grant);
+  }
+
+  std::unique_ptr<nmpp::message> task()
+  {
+    return nmpp::message::from("task", 4);
+  }
+
+  int domain = 0;
+  int proto = 0;
+  nanomsg_mock nanomsg;
+  nanomsg_heap heap{nanomsg};
+  std::unique_ptr<nmpp::socket> grants;
+  std::unique_ptr<nmpp::socket> fast;
+  std::unique_ptr<nmpp::socket> slow;
+  std::vector<nmpp::credit_grant> queued;
+  std::vector<int> sent;
+};
+
+TEST_F(credit_flow_test, dispatches_only_to_workers_with_credit)
+{
+  dispatcher d(*grants);
+  ASSERT_THAT(d.add_worker(*fast), Eq(0u));
+  ASSERT_THAT(d.add_worker(*slow), Eq(1u));
+
+  auto msg = task();
+  ASSERT_THAT(d.try_dispatch(*msg), Eq(dispatcher::npos));
+  ASSERT_TRUE(msg->valid());
+
+  queued = {{0, 2}, {1, 1}};
+  for (auto i = 0; i < 3; ++i)
+  {
+    msg = task();
+    ASSERT_THAT(d.try_dispatch(*msg), Ne(dispatcher::npos));
+  }
+  msg = task();
+  ASSERT_THAT(d.try_dispatch(*msg), Eq(dispatcher::npos));
+  ASSERT_THAT(sent, ElementsAre(2, 3, 2));
+  ASSERT_THAT(d.credits(0), Eq(0u));
+  ASSERT_THAT(d.credits(1), Eq(0u));
+}
+
+TEST_F(credit_flow_test, workers_with_equal_credit_take_turns)
+{
+  dispatcher d(*grants);
+  d.add_worker(*fast);
+  d.add_worker(*slow);
+  queued = {{0, 2}, {1, 2}};
+
+  for (auto i = 0; i < 4; ++i)
+  {
+    auto msg = task();
+    d.try_dispatch(*msg);
+  }
+  ASSERT_THAT(sent, ElementsAre(2, 3, 2, 3));
+}
+
+TEST_F(credit_flow_test, ignores_malformed_grants)
+{
+  dispatcher d(*grants);
+  d.add_worker(*fast);
+  queued = {{7, 5}, {0, 1}};
+
+  ASSERT_THAT(d.update(), Eq(1u));
+  ASSERT_THAT(d.credits(0), Eq(1u));
+  ASSERT_THAT(d.credits(7), Eq(0u));
+}
+
+TEST_F(credit_flow_test, dispatch_blocks_for_a_grant)
+{
+  dispatcher d(*grants);
+  d.add_worker(*fast);
+  d.add_worker(*slow);
+  EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, 0))
+      .WillOnce(Invoke([this](int, void* buf, size_t, int) {
+        queued = {{1, 1}};
+        return next_grant(buf);
+      }));
+
+  auto msg = task();
+  ASSERT_THAT(d.dispatch(*msg), Eq(1u));
+  ASSERT_THAT(sent, ElementsAre(3));
+}
+
+TEST_F(credit_flow_test, falls_back_when_richest_worker_pushes_back)
+{
+  dispatcher d(*grants);
+  d.add_worker(*fast);
+  d.add_worker(*slow);
+  queued = {{0, 5}, {1, 1}};
+  EXPECT_CALL(nanomsg, nn_send(2, _, NN_MSG, NN_DONTWAIT))
+      .WillRepeatedly(Return(-1));
+  EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, 0)).Times(0);
+
+  auto msg = task();
+  ASSERT_THAT(d.dispatch(*msg), Eq(1u));
+  ASSERT_THAT(sent, ElementsAre(3));
+  ASSERT_THAT(d.credits(0), Eq(5u));
+  ASSERT_THAT(d.credits(1), Eq(0u));
+
+  msg = task();
+  ASSERT_THAT(d.try_dispatch(*msg), Eq(dispatcher::npos));
+  ASSERT_TRUE(msg->valid());
+}
+
+TEST_F(credit_flow_test, worker_grants_window_then_batches_credits)
+{
+  std::vector<nmpp::credit_grant> granted;
+  EXPECT_CALL(nanomsg, nn_send(1, _, sizeof(nmpp::credit_grant), 0))
+      .WillRepeatedly(Invoke([&](int, const void* buf, size_t size, int) {
+        nmpp::credit_grant grant;
+        std::memcpy(&grant, buf, sizeof(grant));
+        granted.push_back(grant);
+        return static_cast<int>(size);
+      }));
+
+  nmpp::credit_worker<> worker(*grants, 3, 8, 2);
+  ASSERT_THAT(granted.size(), Eq(1u));
+  ASSERT_THAT(granted[0].worker, Eq(3u));
+  ASSERT_THAT(granted[0].credits, Eq(8u));
+
+  worker.complete();
+  ASSERT_THAT(granted.size(), Eq(1u));
+  ASSERT_THAT(worker.owed(), Eq(1u));
+  worker.complete();
+  ASSERT_THAT(granted.size(), Eq(2u));
+  ASSERT_THAT(granted[1].credits, Eq(2u));
+
+  worker.complete();
+  worker.flush();
+  ASSERT_THAT(granted.size(), Eq(3u));
+  ASSERT_THAT(granted[2].credits, Eq(1u));
+  ASSERT_THAT(worker.owed(), Eq(0u));
+
+  ASSERT_THROW(nmpp::credit_worker<>(*grants, 0, 2, 4), std::logic_error);
+}
@@ -0,0 +1,106 @@
+#include "mocks/nanomsg_mock.hpp"
+#include <gtest/gtest.h>
+#include <nmpp/endpoint.hpp>
+
+using namespace ::testing;
+
+struct endpoint_test : Test
+{
+  void SetUp()
+  {
+    EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(1));
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto)).WillOnce(Return(1));
+    EXPECT_CALL(nanomsg, nn_close(1)).WillOnce(Return(0));
+    socket.reset(new nmpp::socket(domain, proto));
+  }
+
+  int domain = 0;
+  int proto = 0;
+  nanomsg_mock nanomsg;
+  std::unique_ptr<nmpp::socket> socket;
+};
+
+TEST_F(endpoint_test, shuts_down_endpoint_on_destruction)
+{
+  EXPECT_CALL(nanomsg, nn_connect(1, StrEq("tcp://a:1"))).WillOnce(Return(7));
+  EXPECT_CALL(nanomsg, nn_shutdown(1, 7)).WillOnce(Return(0));
+  auto ep = nmpp::endpoint<>::connect(*socket, "tcp://a:1");
+  ASSERT_THAT(ep.id(), Eq(7));
+}
+
+TEST_F(endpoint_test, binds_endpoint)
+{
+  EXPECT_CALL(nanomsg, nn_bind(1, StrEq("tcp://*:1"))).WillOnce(Return(2));
+  EXPECT_CALL(nanomsg, nn_shutdown(1, 2)).WillOnce(Return(0));
+  auto ep = nmpp::endpoint<>::bind(*socket, "tcp://*:1");
+  ASSERT_TRUE(ep.valid());
+}
+
+TEST_F(endpoint_test, moved_endpoint_is_shut_down_once)
+{
+  EXPECT_CALL(nanomsg, nn_shutdown(1, 7)).Times(1).WillOnce(Return(0));
+  nmpp::endpoint<> ep(*socket, 7);
+  nmpp::endpoint<> moved(std::move(ep));
+  ASSERT_FALSE(ep.valid());
+}
+
+TEST_F(endpoint_test, released_endpoint_is_not_shut_down)
+{
+  EXPECT_CALL(nanomsg, nn_shutdown(_, _)).Times(0);
+  nmpp::endpoint<> ep(*socket, 7);
+  ASSERT_THAT(ep.release(), Eq(7));
+}
+
+TEST_F(endpoint_test, explicit_shutdown_reports_failure)
+{
+  EXPECT_CALL(nanomsg, nn_shutdown(1, 7)).WillOnce(Return(-1));
+  nmpp::endpoint<> ep(*socket, 7);
+  ASSERT_THROW(ep.shutdown(), nmpp::exception);
+  ASSERT_FALSE(ep.valid());
+}
+
+TEST_F(endpoint_test, does_not_throw_on_destruction_for_failed_shutdown)
+{
+  EXPECT_CALL(nanomsg, nn_shutdown(1, 7)).WillOnce(Return(-1));
+  ASSERT_NO_THROW(nmpp::endpoint<>(*socket, 7));
+}
+
+TEST_F(endpoint_test, endpoint_set_connects_each_address_once)
+{
+  EXPECT_CALL(nanomsg, nn_connect(1, StrEq("tcp://a:1"))).WillOnce(Return(1));
+  EXPECT_CALL(nanomsg, nn_shutdown(1, 1)).WillOnce(Return(0));
+  nmpp::endpoint_set<> endpoints(*socket);
+  ASSERT_TRUE(endpoints.connect("tcp://a:1"));
+  ASSERT_FALSE(endpoints.connect("tcp://a:1"));
+  ASSERT_THAT(endpoints.size(), Eq(1u));
+}
+
+TEST_F(endpoint_test, endpoint_set_removes_only_given_address)
+{
+  EXPECT_CALL(nanomsg, nn_connect(1, StrEq("tcp://a:1"))).WillOnce(Return(1));
+  EXPECT_CALL(nanomsg, nn_connect(1, StrEq("tcp://b:1"))).WillOnce(Return(2));
+  nmpp::endpoint_set<> endpoints(*socket);
+  endpoints.connect("tcp://a:1");
+  endpoints.connect("tcp://b:1");
+
+  EXPECT_CALL(nanomsg, nn_shutdown(1, 1)).WillOnce(Return(0));
+  ASSERT_TRUE(endpoints.remove("tcp://a:1"));
+  ASSERT_FALSE(endpoints.remove("tcp://a:1"));
+  ASSERT_THAT(endpoints.addresses(), ElementsAre("tcp://b:1"));
+  EXPECT_CALL(nanomsg, nn_shutdown(1, 2)).WillOnce(Return(0));
+}
+
+TEST_F(endpoint_test, endpoint_set_assigns_new_address_list)
+{
+  EXPECT_CALL(nanomsg, nn_connect(1, StrEq("tcp://a:1"))).WillOnce(Return(1));
+  EXPECT_CALL(nanomsg, nn_connect(1, StrEq("tcp://b:1"))).WillOnce(Return(2));
+  nmpp::endpoint_set<> endpoints(*socket);
+  endpoints.assign({"tcp://a:1", "tcp://b:1"});
+
+  EXPECT_CALL(nanomsg, nn_shutdown(1, 1)).WillOnce(Return(0));
+  EXPECT_CALL(nanomsg, nn_connect(1, StrEq("tcp://c:1"))).WillOnce(Return(3));
+  endpoints.assign({"tcp://b:1", "tcp://c:1"});
+  ASSERT_THAT(endpoints.addresses(), ElementsAre("tcp://b:1", "tcp://c:1"));
+  EXPECT_CALL(nanomsg, nn_shutdown(1, 2)).WillOnce(Return(0));
+  EXPECT_CALL(nanomsg, nn_shutdown(1, 3)).WillOnce(Return(0));
+}
@@ -0,0 +1,182 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nmpp/epoll_reactor.hpp>
+#include <nmpp/reactor_dispatcher.hpp>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace ::testing;
+
+struct epoll_reactor_test : Test
+{
+  void SetUp()
+  {
+    receive_fd = eventfd(0, EFD_NONBLOCK);
+    send_fd = eventfd(0, EFD_NONBLOCK);
+  }
+
+  void TearDown()
+  {
+    ::close(receive_fd);
+    ::close(send_fd);
+  }
+
+  void signal(int fd)
+  {
+    uint64_t one = 1;
+    ASSERT_THAT(::write(fd, &one, sizeof(one)), Eq(8));
+  }
+
+  using dispatcher = nmpp::reactor_dispatcher<nmpp::epoll_reactor>;
+
+  nmpp::epoll_reactor reactor;
+  int receive_fd;
+  int send_fd;
+  int calls = 0;
+};
+
+TEST_F(epoll_reactor_test, runs_receive_handler_when_descriptor_is_readable)
+{
+  dispatcher async_dispatcher(receive_fd, send_fd, reactor);
+  async_dispatcher.on_receive_event([this](const std::error_code&) {
+    ++calls;
+  });
+  ASSERT_THAT(reactor.run_one(0), Eq(0u));
+  signal(receive_fd);
+  ASSERT_THAT(reactor.run_one(0), Eq(1u));
+  ASSERT_THAT(calls, Eq(1));
+}
+
+TEST_F(epoll_reactor_test, runs_send_handler_when_descriptor_is_writable)
+{
+  dispatcher async_dispatcher(receive_fd, send_fd, reactor);
+  async_dispatcher.on_send_event([this](const std::error_code&) { ++calls; });
+  ASSERT_THAT(reactor.run_one(0), Eq(1u));
+  ASSERT_THAT(calls, Eq(1));
+}
+
+TEST_F(epoll_reactor_test, handler_runs_once_per_registration)
+{
+  dispatcher async_dispatcher(receive_fd, send_fd, reactor);
+  signal(receive_fd);
+  async_dispatcher.on_receive_event([this](const std::error_code&) {
+    ++calls;
+  });
+  ASSERT_THAT(reactor.run_one(0), Eq(1u));
+  ASSERT_THAT(reactor.run_one(0), Eq(0u));
+  ASSERT_THAT(calls, Eq(1));
+}
+
+TEST_F(epoll_reactor_test, rearming_still_readable_descriptor_fires_again)
+{
+  dispatcher async_dispatcher(receive_fd, send_fd, reactor);
+  signal(receive_fd);
+  for (int i = 0; i < 3; ++i)
+  {
+    async_dispatcher.on_receive_event([this](const std::error_code&) {
+      ++calls;
+    });
+    ASSERT_THAT(reactor.run_one(0), Eq(1u));
+  }
+  ASSERT_THAT(calls, Eq(3));
+}
+
+TEST_F(epoll_reactor_test, queued_handlers_run_in_order)
+{
+  dispatcher async_dispatcher(receive_fd, send_fd, reactor);
+  std::vector<int> order;
+  for (int i = 0; i < 3; ++i)
+    async_dispatcher.on_send_event(
+        [&order, i](const std::error_code&) { order.push_back(i); });
+  ASSERT_THAT(reactor.pending(), Eq(1u));
+  ASSERT_THAT(reactor.run_one(0), Eq(1u));
+  ASSERT_THAT(order, ElementsAre(0));
+  ASSERT_THAT(reactor.run(), Eq(2u));
+  ASSERT_THAT(order, ElementsAre(0, 1, 2));
+}
+
+TEST_F(epoll_reactor_test, cancel_completes_every_queued_handler)
+{
+  dispatcher async_dispatcher(receive_fd, send_fd, reactor);
+  std::vector<std::error_code> errors;
+  for (int i = 0; i < 2; ++i)
+    async_dispatcher.on_receive_event(
+        [&errors](const std::error_code& ec) { errors.push_back(ec); });
+  async_dispatcher.cancel_receive();
+  ASSERT_THAT(errors,
+              ElementsAre(std::make_error_code(std::errc::operation_canceled),
+                          std::make_error_code(std::errc::operation_canceled)));
+  ASSERT_THAT(reactor.pending(), Eq(0u));
+}
+
+TEST_F(epoll_reactor_test, run_returns_when_no_handler_is_pending)
+{
+  dispatcher async_dispatcher(receive_fd, send_fd, reactor);
+  signal(receive_fd);
+  async_dispatcher.on_receive_event([&](const std::error_code&) {
+    if (++calls < 5)
+      async_dispatcher.on_receive_event([this](const std::error_code&) {
+        ++calls;
+      });
+  });
+  ASSERT_THAT(reactor.run(), Eq(2u));
+  ASSERT_THAT(reactor.pending(), Eq(0u));
+}
+
+TEST_F(epoll_reactor_test, dispatches_bounded_batches)
+{
+  nmpp::epoll_reactor small_reactor(1);
+  dispatcher async_dispatcher(receive_fd, send_fd, small_reactor);
+  signal(receive_fd);
+  async_dispatcher.on_receive_event([this](const std::error_code&) {
+    ++calls;
+  });
+  async_dispatcher.on_send_event([this](const std::error_code&) { ++calls; });
+  ASSERT_THAT(small_reactor.run_one(0), Eq(1u));
+  ASSERT_THAT(small_reactor.run_one(0), Eq(1u));
+  ASSERT_THAT(calls, Eq(2));
+}
+
+TEST_F(epoll_reactor_test, stop_interrupts_run_from_other_thread)
+{
+  dispatcher async_dispatcher(receive_fd, send_fd, reactor);
+  async_dispatcher.on_receive_event([this](const std::error_code&) {
+    ++calls;
+  });
+  std::thread t([this]() { reactor.run(); });
+  reactor.stop();
+  t.join();
+  ASSERT_TRUE(reactor.stopped());
+  ASSERT_THAT(calls, Eq(0));
+}
+
+TEST_F(epoll_reactor_test, destroyed_dispatcher_does_not_run_handlers)
+{
+  {
+    dispatcher async_dispatcher(receive_fd, send_fd, reactor);
+    async_dispatcher.on_receive_event([this](const std::error_code&) {
+      ++calls;
+    });
+  }
+  signal(receive_fd);
+  ASSERT_THAT(reactor.pending(), Eq(0u));
+  ASSERT_THAT(reactor.run_one(0), Eq(0u));
+  ASSERT_THAT(calls, Eq(0));
+}
+
+TEST_F(epoll_reactor_test, throws_when_receive_on_invalid_descriptor)
+{
+  dispatcher async_dispatcher(-1, send_fd, reactor);
+  ASSERT_THROW(
+      async_dispatcher.on_receive_event([](const std::error_code&) {}),
+      std::logic_error);
+}
+
+TEST_F(epoll_reactor_test, throws_when_send_on_invalid_descriptor)
+{
+  dispatcher async_dispatcher(receive_fd, -1, reactor);
+  ASSERT_THROW(async_dispatcher.on_send_event([](const std::error_code&) {}),
+               std::logic_error);
+}
@@ -0,0 +1,86 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nmpp/executor.hpp>
+#include <sched.h>
+
+using namespace ::testing;
+
+struct executor_test : Test
+{
+  template <typename function_type>
+  auto run_on(nmpp::executor& executor, size_t index, function_type f)
+  {
+    std::promise<decltype(f())> result;
+    executor.get_io_service(index).post(
+        [&result, &f]() { result.set_value(f()); });
+    return result.get_future().get();
+  }
+};
+
+TEST_F(executor_test, runs_handlers_on_separate_threads)
+{
+  nmpp::executor executor({{}, {}});
+  ASSERT_THAT(executor.size(), Eq(2u));
+  auto thread_id = []() { return std::this_thread::get_id(); };
+  auto first = run_on(executor, 0, thread_id);
+  auto second = run_on(executor, 1, thread_id);
+  ASSERT_THAT(first, Ne(second));
+  ASSERT_THAT(first, Ne(std::this_thread::get_id()));
+}
+
+TEST_F(executor_test, pins_reactor_thread_to_configured_cpus)
+{
+  nmpp::executor executor({{{0}, -1}});
+  auto cpus = run_on(executor, 0, []() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+    return CPU_COUNT(&set) == 1 && CPU_ISSET(0, &set);
+  });
+  ASSERT_TRUE(cpus);
+}
+
+TEST_F(executor_test, pins_reactor_thread_to_numa_node_cpus)
+{
+  nmpp::executor executor({{{}, 0}});
+  auto expected = nmpp::numa_node_cpus(0);
+  auto cpus = run_on(executor, 0, []() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+    return CPU_COUNT(&set);
+  });
+  ASSERT_THAT(cpus, Eq(static_cast<int>(expected.size())));
+}
+
+TEST_F(executor_test, throws_for_unknown_numa_node)
+{
+  ASSERT_THROW(nmpp::executor({{{}, 4095}}), std::system_error);
+}
+
+TEST_F(executor_test, throws_for_invalid_cpu)
+{
+  ASSERT_THROW(nmpp::executor({{{CPU_SETSIZE - 1}, -1}}), std::system_error);
+  ASSERT_THROW(nmpp::executor({{{CPU_SETSIZE + 1}, -1}}), std::logic_error);
+}
+
+TEST_F(executor_test, stop_runs_handlers_already_queued)
+{
+  std::atomic<int> ran{0};
+  nmpp::executor executor(std::vector<nmpp::reactor_thread_config>(1));
+  auto& io = executor.get_io_service(0);
+  io.post([]() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); });
+  for (auto i = 0; i < 100; ++i)
+    io.post([&ran]() { ++ran; });
+  executor.stop();
+  ASSERT_THAT(ran.load(), Eq(100));
+}
+
+TEST_F(executor_test, throws_for_unknown_reactor)
+{
+  nmpp::executor executor(std::vector<nmpp::reactor_thread_config>(1));
+  ASSERT_THROW(executor.get_io_service(1), std::out_of_range);
+}
@@ -0,0 +1,232 @@
+#include "mocks/nanomsg_heap.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <map>
+#include <nmpp/hash_router.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/socket.hpp>
+#include <string>
+#include <vector>
+
+using namespace ::testing;
+
+namespace
+{
+
+std::vector<std::string> make_keys(size_t count)
+{
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < count; ++i)
+    keys.push_back("user-" + std::to_string(i));
+  return keys;
+}
+
+std::map<std::string, std::string>
+assign(const nmpp::hash_ring<std::string>& ring,
+       const std::vector<std::string>& keys)
+{
+  std::map<std::string, std::string> owners;
+  for (auto& key : keys)
+    owners[key] = ring.locate(key);
+  return owners;
+}
+
+} // namespace
+
+TEST(hash_ring_test, empty_ring_throws)
+{
+  nmpp::hash_ring<std::string> ring;
+  ASSERT_TRUE(ring.empty());
+  ASSERT_THROW(ring.locate("key"), std::logic_error);
+  ASSERT_THROW(nmpp::hash_ring<std::string>(0), std::logic_error);
+}
+
+TEST(hash_ring_test, spreads_keys_evenly)
+{
+  nmpp::hash_ring<std::string> ring;
+  for (auto name : {"a", "b", "c", "d"})
+    ring.add(name, name);
+
+  std::map<std::string, size_t> load;
+  for (auto& owner : assign(ring, make_keys(20000)))
+    ++load[owner.second];
+
+  ASSERT_THAT(load.size(), Eq(4u));
+  for (auto& node : load)
+    ASSERT_THAT(node.second, AllOf(Gt(3500u), Lt(6500u))) << node.first;
+}
+
+TEST(hash_ring_test, adding_a_node_only_moves_keys_to_it)
+{
+  nmpp::hash_ring<std::string> ring;
+  for (auto name : {"a", "b", "c", "d"})
+    ring.add(name, name);
+  auto keys = make_keys(20000);
+  auto before = assign(ring, keys);
+
+  ring.add("e", "e");
+  auto after = assign(ring, keys);
+
+  size_t moved = 0;
+  for (auto& key : keys)
+  {
+    if (before[key] == after[key])
+      continue;
+    ASSERT_THAT(after[key], Eq("e"));
+    ++moved;
+  }
+  ASSERT_THAT(moved, AllOf(Gt(keys.size() / 10), Lt(keys.size() * 3 / 10)));
+}
+
+TEST(hash_ring_test, removing_a_node_only_moves_its_keys)
+{
+  nmpp::hash_ring<std::string> ring;
+  for (auto name : {"a", "b", "c", "d"})
+    ring.add(name, name);
+  auto keys = make_keys(20000);
+  auto before = assign(ring, keys);
+
+  ring.remove("b");
+  auto after = assign(ring, keys);
+
+  for (auto& key : keys)
+  {
+    if (before[key] == "b")
+      ASSERT_THAT(after[key], Ne("b"));
+    else
+      ASSERT_THAT(after[key], Eq(before[key]));
+  }
+
+  ring.add("b", "b");
+  ASSERT_THAT(assign(ring, keys), Eq(before));
+}
+
+TEST(hash_ring_test, placement_does_not_depend_on_insertion_order)
+{
+  nmpp::hash_ring<std::string> forward;
+  nmpp::hash_ring<std::string> backward;
+  for (auto name : {"a", "b", "c"})
+    forward.add(name, name);
+  for (auto name : {"c", "b", "a"})
+    backward.add(name, name);
+
+  auto keys = make_keys(1000);
+  ASSERT_THAT(assign(forward, keys), Eq(assign(backward, keys)));
+}
+
+struct hash_router_test : Test
+{
+  using router = nmpp::hash_router<>;
+
+  void SetUp()
+  {
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto))
+        .WillRepeatedly(Invoke([this](int, int) { return ++next_socket; }));
+    EXPECT_CALL(nanomsg, nn_close(_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(nanomsg, nn_send(_, _, NN_MSG, _))
+        .WillRepeatedly(Invoke([this](int sock, const void* buf, size_t, int) {
+          auto chunk = *reinterpret_cast<char* const*>(buf);
+          auto size = heap.allocations[chunk];
+          sent.push_back(sock);
+          heap.release(chunk);
+          return static_cast<int>(size);
+        }));
+  }
+
+  std::unique_ptr<nmpp::socket> make_socket()
+  {
+    return std::unique_ptr<nmpp::socket>(new nmpp::socket(domain, proto));
+  }
+
+  int domain = 0;
+  int proto = 0;
+  int next_socket = 0;
+  nanomsg_mock nanomsg;
+  nanomsg_heap heap{nanomsg};
+  std::vector<int> sent;
+};
+
+TEST_F(hash_router_test, sends_every_message_for_a_key_to_one_worker)
+{
+  router r;
+  std::map<std::string, int> sockets;
+  for (auto name : {"tcp://a:1", "tcp://b:1", "tcp://c:1"})
+    sockets[name] = r.add_worker(name, make_socket()).native_handle();
+  ASSERT_THAT(r.workers(), Eq(3u));
+
+  for (auto& key : make_keys(50))
+  {
+    auto& worker = r.route(key);
+    for (auto i = 0; i < 3; ++i)
+    {
+      ASSERT_THAT(r.send(key, *nmpp::message::from("payload", 7)), Eq(worker));
+      ASSERT_THAT(sent.back(), Eq(sockets[worker]));
+    }
+  }
+}
+
+TEST_F(hash_router_test, counts_traffic_per_worker)
+{
+  router r;
+  r.add_worker("a", make_socket());
+  r.add_worker("b", make_socket());
+
+  std::map<std::string, uint64_t> expected;
+  for (auto& key : make_keys(20))
+  {
+    r.send(key, *nmpp::message::from("12345", 5));
+    ++expected[r.route(key)];
+  }
+
+  auto stats = r.stats();
+  ASSERT_THAT(stats.size(), Eq(2u));
+  uint64_t total = 0;
+  for (auto& s : stats)
+  {
+    ASSERT_THAT(s.messages, Eq(expected[s.name]));
+    ASSERT_THAT(s.bytes, Eq(5 * s.messages));
+    total += s.messages;
+  }
+  ASSERT_THAT(total, Eq(20u));
+  ASSERT_THAT(stats[0].name, Eq("a"));
+  ASSERT_THAT(stats[1].name, Eq("b"));
+}
+
+TEST_F(hash_router_test, try_send_does_not_count_refused_messages)
+{
+  router r;
+  r.add_worker("a", make_socket());
+  EXPECT_CALL(nanomsg, nn_send(_, _, NN_MSG, NN_DONTWAIT))
+      .WillOnce(Return(-1));
+  EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(EAGAIN));
+
+  auto msg = nmpp::message::from("payload", 7);
+  ASSERT_FALSE(r.try_send("key", *msg));
+  ASSERT_TRUE(msg->valid());
+  ASSERT_THAT(r.stats()[0].messages, Eq(0u));
+}
+
+TEST_F(hash_router_test, removed_worker_hands_back_its_socket)
+{
+  router r;
+  r.add_worker("a", make_socket());
+  auto fd = r.add_worker("b", make_socket()).native_handle();
+
+  auto socket = r.remove_worker("b");
+  ASSERT_TRUE(socket);
+  ASSERT_THAT(socket->native_handle(), Eq(fd));
+  ASSERT_FALSE(r.remove_worker("b"));
+  ASSERT_THAT(r.workers(), Eq(1u));
+  for (auto& key : make_keys(50))
+    ASSERT_THAT(r.route(key), Eq("a"));
+}
+
+TEST_F(hash_router_test, rejects_duplicates_and_routing_without_workers)
+{
+  router r;
+  ASSERT_THROW(r.route("key"), std::logic_error);
+  r.add_worker("a", make_socket());
+  ASSERT_THROW(r.add_worker("a", make_socket()), std::logic_error);
+  ASSERT_THROW(r.add_worker("b", nullptr), std::logic_error);
+}
@@ -0,0 +1,146 @@
+#include "mocks/async_dispatcher_mock.hpp"
+#include "mocks/nanomsg_heap.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include <boost/asio.hpp>
+#include <gtest/gtest.h>
+#include <nmpp/integrity.hpp>
+#include <nmpp/message.hpp>
+#include <string>
+
+using namespace ::testing;
+
+struct integrity_test : Test
+{
+  using checksummed_socket = nmpp::checksummed_socket;
+  using checksummed_async_socket = nmpp::checksummed_socket_impl<
+      nmpp::async_socket_impl<async_dispatcher_mock>>;
+
+  void SetUp()
+  {
+    EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(1));
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto)).WillOnce(Return(1));
+    EXPECT_CALL(nanomsg, nn_getsockopt(1, NN_SOL_SOCKET, _, _, _))
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(nanomsg, nn_close(1)).WillOnce(Return(0));
+  }
+
+  void TearDown()
+  {
+    ASSERT_THAT(heap.allocations, IsEmpty());
+  }
+
+  void expect_receive(const std::string& frame)
+  {
+    EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, 0))
+        .WillOnce(Invoke([this, frame](int, void* buf, size_t, int) {
+          *reinterpret_cast<void**>(buf) = heap.allocate(frame);
+          return static_cast<int>(frame.size());
+        }));
+  }
+
+  // "abc" followed by its CRC32C, little endian.
+  const std::string sealed = std::string("abc\xb7\x3f\x4b\x36", 7);
+
+  int domain = 0;
+  int proto = 0;
+  nanomsg_mock nanomsg;
+  nanomsg_heap heap{nanomsg};
+  boost::asio::io_service io;
+};
+
+TEST_F(integrity_test, appends_crc32c_trailer)
+{
+  checksummed_socket socket(domain, proto);
+  auto msg = nmpp::message::from("abc", 3);
+  socket.send(*msg);
+  ASSERT_FALSE(msg->valid());
+  ASSERT_THAT(heap.sent, ElementsAre(sealed));
+}
+
+TEST_F(integrity_test, strips_verified_trailer)
+{
+  checksummed_socket socket(domain, proto);
+  expect_receive(sealed);
+  auto msg = socket.receive<nmpp::message>();
+  ASSERT_THAT(std::string(msg->data(), msg->size()), Eq("abc"));
+  ASSERT_THAT(socket.corrupted(), Eq(0u));
+}
+
+TEST_F(integrity_test, throws_on_corrupted_payload)
+{
+  checksummed_socket socket(domain, proto);
+  auto corrupted = sealed;
+  corrupted[1] ^= 0x10;
+  expect_receive(corrupted);
+  ASSERT_THROW(socket.receive<nmpp::message>(), nmpp::integrity_error);
+  ASSERT_THAT(socket.corrupted(), Eq(1u));
+}
+
+TEST_F(integrity_test, throws_on_missing_trailer)
+{
+  checksummed_socket socket(domain, proto);
+  expect_receive("ab");
+  ASSERT_THROW(socket.receive<nmpp::message>(), nmpp::integrity_error);
+}
+
+TEST_F(integrity_test, async_send_appends_trailer)
+{
+  checksummed_async_socket socket(domain, proto, io);
+  async_dispatcher_mock::handler writable;
+  EXPECT_CALL(socket.get_async_dispatcher(), on_send_event(_))
+      .WillOnce(SaveArg<0>(&writable));
+
+  size_t sent = 0;
+  socket.async_send(nmpp::message::from("abc", 3),
+                    [&](const std::error_code&, size_t bytes) {
+                      sent = bytes;
+                    });
+  writable(std::error_code());
+  ASSERT_THAT(sent, Eq(7u));
+  ASSERT_THAT(heap.sent, ElementsAre(sealed));
+}
+
+TEST_F(integrity_test, async_receive_reports_corruption_as_bad_message)
+{
+  checksummed_async_socket socket(domain, proto, io);
+  async_dispatcher_mock::handler readable;
+  EXPECT_CALL(socket.get_async_dispatcher(), on_receive_event(_))
+      .WillRepeatedly(SaveArg<0>(&readable));
+
+  std::vector<std::string> received;
+  std::error_code error;
+  auto handler = [&](const std::error_code& ec,
+                     std::unique_ptr<nmpp::message> msg) {
+    error = ec;
+    if (msg)
+      received.emplace_back(msg->data(), msg->size());
+  };
+
+  socket.async_receive<nmpp::message>(handler);
+  expect_receive(sealed);
+  readable(std::error_code());
+  ASSERT_FALSE(error);
+  ASSERT_THAT(received, ElementsAre("abc"));
+
+  socket.async_receive<nmpp::message>(handler);
+  expect_receive(std::string("abc\0\0\0\0", 7));
+  readable(std::error_code());
+  ASSERT_THAT(error, Eq(std::errc::bad_message));
+  ASSERT_THAT(received.size(), Eq(1u));
+}
+
+TEST_F(integrity_test, async_receive_drops_corruption_for_plain_handlers)
+{
+  checksummed_async_socket socket(domain, proto, io);
+  async_dispatcher_mock::handler readable;
+  EXPECT_CALL(socket.get_async_dispatcher(), on_receive_event(_))
+      .WillOnce(SaveArg<0>(&readable));
+
+  auto called = false;
+  socket.async_receive<nmpp::message>(
+      [&](const nmpp::message&) { called = true; });
+  expect_receive("xyz1234");
+  readable(std::error_code());
+  ASSERT_FALSE(called);
+  ASSERT_THAT(socket.corrupted(), Eq(1u));
+}
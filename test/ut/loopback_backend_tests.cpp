@@ -0,0 +1,367 @@
+#include "mocks/nanomsg_heap.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include <atomic>
+#include <boost/asio/io_service.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nmpp/loopback_backend.hpp>
+#include <nmpp/message.hpp>
+#include <poll.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ::testing;
+
+struct loopback_backend_test : Test
+{
+  void SetUp()
+  {
+    EXPECT_CALL(nanomsg, nn_socket(_, _)).Times(0);
+    EXPECT_CALL(nanomsg, nn_send(_, _, _, _)).Times(0);
+    EXPECT_CALL(nanomsg, nn_recv(_, _, _, _)).Times(0);
+  }
+
+  void TearDown()
+  {
+    ASSERT_THAT(heap.allocations, IsEmpty());
+  }
+
+  static std::string text(const nmpp::message& msg)
+  {
+    return std::string(msg.data(), msg.size());
+  }
+
+  static bool readable(int fd)
+  {
+    pollfd pfd{fd, POLLIN, 0};
+    return ::poll(&pfd, 1, 0) == 1;
+  }
+
+  nanomsg_mock nanomsg;
+  nanomsg_heap heap{nanomsg};
+};
+
+TEST_F(loopback_backend_test, push_pull_passes_messages_in_order_without_copy)
+{
+  nmpp::loopback_socket rx(AF_SP, NN_PULL);
+  rx.bind("inproc://a");
+  nmpp::loopback_socket tx(AF_SP, NN_PUSH);
+  tx.connect("inproc://a");
+
+  auto first = nmpp::message::from("first", 5);
+  auto chunk = first->data();
+  tx.send(*first);
+  tx.send("second", 6);
+
+  auto msg = rx.receive<nmpp::message>();
+  ASSERT_THAT(msg->data(), Eq(chunk));
+  ASSERT_THAT(text(*msg), Eq("first"));
+  ASSERT_THAT(text(*rx.receive<nmpp::message>()), Eq("second"));
+  ASSERT_FALSE(rx.try_receive<nmpp::message>());
+}
+
+TEST_F(loopback_backend_test, push_round_robins_over_peers)
+{
+  nmpp::loopback_socket tx(AF_SP, NN_PUSH);
+  tx.bind("inproc://a");
+  nmpp::loopback_socket rx1(AF_SP, NN_PULL);
+  nmpp::loopback_socket rx2(AF_SP, NN_PULL);
+  rx1.connect("inproc://a");
+  rx2.connect("inproc://a");
+
+  for (auto i = 0; i < 4; ++i)
+    tx.send(std::to_string(i).c_str(), 1);
+
+  std::string got1, got2;
+  while (auto msg = rx1.try_receive<nmpp::message>())
+    got1 += text(*msg);
+  while (auto msg = rx2.try_receive<nmpp::message>())
+    got2 += text(*msg);
+  ASSERT_THAT(got1.size(), Eq(2u));
+  ASSERT_THAT(got2.size(), Eq(2u));
+  ASSERT_THAT(got1[0] + 1, Eq(got2[0]));
+}
+
+TEST_F(loopback_backend_test, pair_is_bidirectional_and_takes_one_peer)
+{
+  nmpp::loopback_socket a(AF_SP, NN_PAIR);
+  a.bind("inproc://pair");
+  nmpp::loopback_socket b(AF_SP, NN_PAIR);
+  b.connect("inproc://pair");
+  nmpp::loopback_socket c(AF_SP, NN_PAIR);
+  c.connect("inproc://pair");
+
+  a.send("ping", 4);
+  ASSERT_THAT(text(*b.receive<nmpp::message>()), Eq("ping"));
+  b.send("pong", 4);
+  ASSERT_THAT(text(*a.receive<nmpp::message>()), Eq("pong"));
+  ASSERT_FALSE(c.try_send(*nmpp::message::from("x", 1)));
+}
+
+TEST_F(loopback_backend_test, connect_may_precede_bind_and_survives_rebind)
+{
+  nmpp::loopback_socket tx(AF_SP, NN_PUSH);
+  tx.connect("inproc://late");
+  ASSERT_FALSE(tx.try_send(*nmpp::message::from("x", 1)));
+
+  {
+    nmpp::loopback_socket rx(AF_SP, NN_PULL);
+    rx.bind("inproc://late");
+    tx.send("one", 3);
+    ASSERT_THAT(text(*rx.receive<nmpp::message>()), Eq("one"));
+  }
+  ASSERT_FALSE(tx.try_send(*nmpp::message::from("x", 1)));
+
+  nmpp::loopback_socket rx(AF_SP, NN_PULL);
+  rx.bind("inproc://late");
+  tx.send("two", 3);
+  ASSERT_THAT(text(*rx.receive<nmpp::message>()), Eq("two"));
+}
+
+TEST_F(loopback_backend_test, shutdown_drops_the_connection)
+{
+  nmpp::loopback_socket rx(AF_SP, NN_PULL);
+  rx.bind("inproc://a");
+  nmpp::loopback_socket tx(AF_SP, NN_PUSH);
+  auto endpoint = tx.connect("inproc://a");
+
+  tx.shutdown(endpoint);
+  ASSERT_FALSE(tx.try_send(*nmpp::message::from("x", 1)));
+  ASSERT_THROW(tx.shutdown(endpoint), nmpp::exception);
+}
+
+TEST_F(loopback_backend_test, honours_timeouts)
+{
+  nmpp::loopback_socket rx(AF_SP, NN_PULL);
+  rx.bind("inproc://a");
+  nmpp::loopback_socket tx(AF_SP, NN_PUSH);
+  rx.set_option(NN_SOL_SOCKET, NN_RCVTIMEO, 10);
+  tx.set_option(NN_SOL_SOCKET, NN_SNDTIMEO, 10);
+
+  try
+  {
+    rx.receive<nmpp::message>();
+    FAIL();
+  }
+  catch (const nmpp::exception& e)
+  {
+    ASSERT_THAT(e.num(), Eq(ETIMEDOUT));
+  }
+  try
+  {
+    tx.send("x", 1);
+    FAIL();
+  }
+  catch (const nmpp::exception& e)
+  {
+    ASSERT_THAT(e.num(), Eq(ETIMEDOUT));
+  }
+}
+
+TEST_F(loopback_backend_test, full_peer_pushes_back)
+{
+  nmpp::loopback_socket rx(AF_SP, NN_PULL);
+  rx.bind("inproc://a");
+  nmpp::loopback_socket tx(AF_SP, NN_PUSH);
+  tx.connect("inproc://a");
+
+  size_t sent = 0;
+  while (tx.try_send(*nmpp::message::from("x", 1)))
+    ++sent;
+  ASSERT_THAT(sent, Eq(nmpp::loopback_detail::queue_capacity));
+  ASSERT_TRUE(rx.try_receive<nmpp::message>());
+  ASSERT_TRUE(tx.try_send(*nmpp::message::from("x", 1)));
+}
+
+TEST_F(loopback_backend_test, receive_descriptor_is_readable_while_queued)
+{
+  nmpp::loopback_socket rx(AF_SP, NN_PULL);
+  rx.bind("inproc://a");
+  nmpp::loopback_socket tx(AF_SP, NN_PUSH);
+  tx.connect("inproc://a");
+
+  int fd = -1;
+  size_t size = sizeof(fd);
+  ASSERT_THAT(nmpp::loopback_backend::getsockopt(
+                  rx.native_handle(), NN_SOL_SOCKET, NN_RCVFD, &fd, &size),
+              Eq(0));
+  ASSERT_FALSE(readable(fd));
+  tx.send("a", 1);
+  tx.send("b", 1);
+  ASSERT_TRUE(readable(fd));
+  rx.receive<nmpp::message>();
+  ASSERT_TRUE(readable(fd));
+  rx.receive<nmpp::message>();
+  ASSERT_FALSE(readable(fd));
+}
+
+TEST_F(loopback_backend_test, send_descriptor_is_readable_while_peer_has_room)
+{
+  nmpp::loopback_socket tx(AF_SP, NN_PUSH);
+  int fd = -1;
+  size_t size = sizeof(fd);
+  ASSERT_THAT(nmpp::loopback_backend::getsockopt(
+                  tx.native_handle(), NN_SOL_SOCKET, NN_SNDFD, &fd, &size),
+              Eq(0));
+  ASSERT_FALSE(readable(fd));
+
+  nmpp::loopback_socket rx(AF_SP, NN_PULL);
+  rx.bind("inproc://a");
+  tx.connect("inproc://a");
+  ASSERT_TRUE(readable(fd));
+
+  size_t sent = 0;
+  while (readable(fd))
+  {
+    ASSERT_TRUE(tx.try_send(*nmpp::message::from("x", 1)));
+    ++sent;
+  }
+  ASSERT_THAT(sent, Eq(nmpp::loopback_detail::queue_capacity));
+  ASSERT_FALSE(tx.try_send(*nmpp::message::from("x", 1)));
+  rx.receive<nmpp::message>();
+  ASSERT_TRUE(readable(fd));
+  tx.send("x", 1);
+  ASSERT_FALSE(readable(fd));
+}
+
+TEST_F(loopback_backend_test, rejects_unsupported_use)
+{
+  ASSERT_THROW(nmpp::loopback_socket(AF_SP, NN_PUB), nmpp::exception);
+  ASSERT_THROW(nmpp::loopback_socket(AF_SP_RAW, NN_PAIR), nmpp::exception);
+
+  nmpp::loopback_socket rx(AF_SP, NN_PULL);
+  rx.bind("inproc://a");
+  nmpp::loopback_socket other(AF_SP, NN_PULL);
+  ASSERT_THROW(other.bind("inproc://a"), nmpp::exception);
+  ASSERT_THROW(rx.send("x", 1), nmpp::exception);
+
+  nmpp::loopback_socket tx(AF_SP, NN_PUSH);
+  try
+  {
+    tx.receive<nmpp::message>();
+    FAIL();
+  }
+  catch (const nmpp::exception& e)
+  {
+    ASSERT_THAT(e.num(), Eq(ENOTSUP));
+  }
+}
+
+TEST_F(loopback_backend_test, closing_frees_queued_messages)
+{
+  nmpp::loopback_socket rx(AF_SP, NN_PULL);
+  rx.bind("inproc://a");
+  nmpp::loopback_socket tx(AF_SP, NN_PUSH);
+  tx.connect("inproc://a");
+  tx.send("a", 1);
+  tx.send("b", 1);
+  rx.close();
+  tx.close();
+}
+
+TEST_F(loopback_backend_test, drives_async_socket)
+{
+  boost::asio::io_service io;
+  nmpp::loopback_async_socket rx(AF_SP, NN_PULL, io);
+  rx.bind("inproc://a");
+  nmpp::loopback_async_socket tx(AF_SP, NN_PUSH, io);
+  tx.connect("inproc://a");
+
+  std::string received;
+  rx.async_receive<nmpp::message>(
+      [&](const nmpp::message& msg) { received = text(msg); });
+  size_t sent = 0;
+  tx.async_send(nmpp::message::from("hello", 5),
+                [&](const std::error_code&, size_t bytes) { sent = bytes; });
+  io.run();
+
+  ASSERT_THAT(sent, Eq(5u));
+  ASSERT_THAT(received, Eq("hello"));
+}
+
+TEST_F(loopback_backend_test, async_sender_fills_peer_on_single_io_thread)
+{
+  EXPECT_CALL(nanomsg, nn_allocmsg(_, 0))
+      .WillRepeatedly(
+          Invoke([](size_t size, int) { return std::malloc(size); }));
+  EXPECT_CALL(nanomsg, nn_freemsg(_)).WillRepeatedly(Invoke([](void* buf) {
+    std::free(buf);
+    return 0;
+  }));
+
+  boost::asio::io_service io;
+  nmpp::loopback_async_socket rx(AF_SP, NN_PULL, io);
+  rx.bind("inproc://a");
+  nmpp::loopback_async_socket tx(AF_SP, NN_PUSH, io);
+  tx.connect("inproc://a");
+
+  const size_t count = nmpp::loopback_detail::queue_capacity + 500;
+  size_t sent = 0;
+  size_t received = 0;
+  for (size_t i = 0; i < count; ++i)
+    tx.async_send(nmpp::message::from("x", 1),
+                  [&](const std::error_code& ec, size_t) { sent += !ec; });
+  std::function<void(const nmpp::message&)> on_receive =
+      [&](const nmpp::message&) {
+        if (++received < count)
+          rx.async_receive<nmpp::message>(on_receive);
+      };
+  rx.async_receive<nmpp::message>(on_receive);
+
+  std::atomic<bool> finished(false);
+  std::thread watchdog([&] {
+    for (int i = 0; i < 500 && !finished.load(); ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    io.stop();
+  });
+  io.run();
+  finished = true;
+  watchdog.join();
+
+  ASSERT_THAT(sent, Eq(count));
+  ASSERT_THAT(received, Eq(count));
+}
+
+TEST_F(loopback_backend_test, keeps_per_sender_order_under_concurrency)
+{
+  EXPECT_CALL(nanomsg, nn_allocmsg(_, 0))
+      .WillRepeatedly(
+          Invoke([](size_t size, int) { return std::malloc(size); }));
+  EXPECT_CALL(nanomsg, nn_freemsg(_)).WillRepeatedly(Invoke([](void* buf) {
+    std::free(buf);
+    return 0;
+  }));
+
+  const int senders = 4;
+  const uint32_t count = 20000;
+  nmpp::loopback_socket rx(AF_SP, NN_PULL);
+  rx.bind("inproc://fan-in");
+  std::vector<std::thread> threads;
+  for (auto id = 0; id < senders; ++id)
+  {
+    threads.emplace_back([id, count] {
+      nmpp::loopback_socket tx(AF_SP, NN_PUSH);
+      tx.connect("inproc://fan-in");
+      for (uint32_t i = 0; i < count; ++i)
+      {
+        uint32_t payload[2] = {static_cast<uint32_t>(id), i};
+        tx.send(reinterpret_cast<const char*>(payload), sizeof(payload));
+      }
+    });
+  }
+
+  std::vector<uint32_t> next(senders, 0);
+  for (auto received = 0u; received < senders * count; ++received)
+  {
+    auto msg = rx.receive<nmpp::message>();
+    ASSERT_THAT(msg->size(), Eq(2 * sizeof(uint32_t)));
+    auto payload = reinterpret_cast<const uint32_t*>(msg->data());
+    ASSERT_THAT(payload[1], Eq(next[payload[0]]++));
+  }
+  for (auto& t : threads)
+    t.join();
+}
@@ -18,6 +18,8 @@ struct async_dispatcher_mock
   using handler = std::function<void(const std::error_code&)>;
   MOCK_CONST_METHOD1(on_receive_event, void(handler));
   MOCK_CONST_METHOD1(on_send_event, void(handler));
+  MOCK_CONST_METHOD0(cancel_receive, void());
+  MOCK_CONST_METHOD0(cancel_send, void());
 
   int m_receive_sock;
   int m_send_sock;
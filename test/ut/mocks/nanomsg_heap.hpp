@@ -0,0 +1,66 @@
+#ifndef NANOMSG_HEAP_HPP_
+#define NANOMSG_HEAP_HPP_
+
+#include "nanomsg_mock.hpp"
+#include <cstdlib>
+#include <map>
+#include <nanomsg/nn.h>
+#include <string>
+
+// Backs nn_allocmsg/nn_reallocmsg/nn_freemsg of a nanomsg_mock with real
+// memory and records every nn_send(..., NN_MSG, ...) payload.
+struct nanomsg_heap
+{
+  explicit nanomsg_heap(nanomsg_mock& nanomsg)
+  {
+    using namespace ::testing;
+    EXPECT_CALL(nanomsg, nn_allocmsg(_, 0))
+        .WillRepeatedly(Invoke([this](size_t size, int) {
+          return allocate(size);
+        }));
+    EXPECT_CALL(nanomsg, nn_reallocmsg(_, _))
+        .WillRepeatedly(Invoke([this](void* buf, size_t size) {
+          allocations.erase(buf);
+          buf = std::realloc(buf, size);
+          allocations[buf] = size;
+          return buf;
+        }));
+    EXPECT_CALL(nanomsg, nn_freemsg(_))
+        .WillRepeatedly(Invoke([this](void* buf) {
+          release(buf);
+          return 0;
+        }));
+    EXPECT_CALL(nanomsg, nn_send(_, _, NN_MSG, _))
+        .WillRepeatedly(Invoke([this](int, const void* buf, size_t, int) {
+          auto chunk = *reinterpret_cast<char* const*>(buf);
+          sent.emplace_back(chunk, allocations[chunk]);
+          release(chunk);
+          return static_cast<int>(sent.back().size());
+        }));
+  }
+
+  void* allocate(size_t size)
+  {
+    auto buf = std::malloc(size);
+    allocations[buf] = size;
+    return buf;
+  }
+
+  void* allocate(const std::string& payload)
+  {
+    auto buf = allocate(payload.size());
+    std::copy(payload.begin(), payload.end(), reinterpret_cast<char*>(buf));
+    return buf;
+  }
+
+  void release(void* buf)
+  {
+    allocations.erase(buf);
+    std::free(buf);
+  }
+
+  std::map<void*, size_t> allocations;
+  std::vector<std::string> sent;
+};
+
+#endif // NANOMSG_HEAP_HPP_
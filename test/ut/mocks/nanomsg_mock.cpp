@@ -12,11 +12,15 @@ std::function<const char*(int)> nn_strerror_cb;
 std::function<int(int)> nn_close_cb;
 std::function<int(int, const char*)> nn_bind_cb;
 std::function<int(int, const char*)> nn_connect_cb;
+std::function<int(int, int)> nn_shutdown_cb;
 std::function<void*(size_t, int)> nn_allocmsg_cb;
+std::function<void*(void*, size_t)> nn_reallocmsg_cb;
 std::function<int(void*)> nn_freemsg_cb;
 std::function<int(int, const void*, size_t, int)> nn_send_cb;
 std::function<int(int, int, int, void*, size_t*)> nn_getsockopt_cb;
+std::function<int(int, int, int, const void*, size_t)> nn_setsockopt_cb;
 std::function<int(int, void*, size_t, int)> nn_recv_cb;
+std::function<int(struct nn_pollfd*, int, int)> nn_poll_cb;
 }
 
 nanomsg_mock::nanomsg_mock()
@@ -32,8 +36,12 @@ nanomsg_mock::nanomsg_mock()
                          std::placeholders::_2);
   nn_connect_cb = std::bind(&nanomsg_mock::nn_connect, this,
                             std::placeholders::_1, std::placeholders::_2);
+  nn_shutdown_cb = std::bind(&nanomsg_mock::nn_shutdown, this,
+                             std::placeholders::_1, std::placeholders::_2);
   nn_allocmsg_cb = std::bind(&nanomsg_mock::nn_allocmsg, this,
                              std::placeholders::_1, std::placeholders::_2);
+  nn_reallocmsg_cb = std::bind(&nanomsg_mock::nn_reallocmsg, this,
+                               std::placeholders::_1, std::placeholders::_2);
   nn_freemsg_cb =
       std::bind(&nanomsg_mock::nn_freemsg, this, std::placeholders::_1);
   nn_send_cb = std::bind(&nanomsg_mock::nn_send, this, std::placeholders::_1,
@@ -43,9 +51,15 @@ nanomsg_mock::nanomsg_mock()
       std::bind(&nanomsg_mock::nn_getsockopt, this, std::placeholders::_1,
                 std::placeholders::_2, std::placeholders::_3,
                 std::placeholders::_4, std::placeholders::_5);
+  nn_setsockopt_cb =
+      std::bind(&nanomsg_mock::nn_setsockopt, this, std::placeholders::_1,
+                std::placeholders::_2, std::placeholders::_3,
+                std::placeholders::_4, std::placeholders::_5);
   nn_recv_cb = std::bind(&nanomsg_mock::nn_recv, this, std::placeholders::_1,
                          std::placeholders::_2, std::placeholders::_3,
                          std::placeholders::_4);
+  nn_poll_cb = std::bind(&nanomsg_mock::nn_poll, this, std::placeholders::_1,
+                         std::placeholders::_2, std::placeholders::_3);
 }
 
 int nn_socket(int domain, int protocol)
@@ -84,12 +98,24 @@ int nn_connect(int sock, const char* addr)
   return nn_connect_cb(sock, addr);
 }
 
+int nn_shutdown(int sock, int how)
+{
+  assert(nn_shutdown_cb);
+  return nn_shutdown_cb(sock, how);
+}
+
 void* nn_allocmsg(size_t size, int type)
 {
   assert(nn_allocmsg_cb);
   return nn_allocmsg_cb(size, type);
 }
 
+void* nn_reallocmsg(void* msg, size_t size)
+{
+  assert(nn_reallocmsg_cb);
+  return nn_reallocmsg_cb(msg, size);
+}
+
 int nn_freemsg(void* msg)
 {
   assert(nn_freemsg_cb);
@@ -109,8 +135,21 @@ int nn_getsockopt(int s, int level, int option, void* optval,
   return nn_getsockopt_cb(s, level, option, optval, optvallen);
 }
 
+int nn_setsockopt(int s, int level, int option, const void* optval,
+                  size_t optvallen)
+{
+  assert(nn_setsockopt_cb);
+  return nn_setsockopt_cb(s, level, option, optval, optvallen);
+}
+
 int nn_recv(int s, void* buf, size_t len, int flags)
 {
   assert(nn_recv_cb);
   return nn_recv_cb(s, buf, len, flags);
 }
+
+int nn_poll(struct nn_pollfd* fds, int nfds, int timeout)
+{
+  assert(nn_poll_cb);
+  return nn_poll_cb(fds, nfds, timeout);
+}
@@ -13,11 +13,15 @@ struct nanomsg_mock
   MOCK_METHOD1(nn_close, int(int));
   MOCK_METHOD2(nn_bind, int(int, const char*));
   MOCK_METHOD2(nn_connect, int(int, const char*));
+  MOCK_METHOD2(nn_shutdown, int(int, int));
   MOCK_METHOD2(nn_allocmsg, void*(size_t, int));
+  MOCK_METHOD2(nn_reallocmsg, void*(void*, size_t));
   MOCK_METHOD1(nn_freemsg, int(void*));
   MOCK_METHOD4(nn_send, int(int, const void*, size_t, int));
   MOCK_METHOD5(nn_getsockopt, int(int, int, int, void*, size_t*));
+  MOCK_METHOD5(nn_setsockopt, int(int, int, int, const void*, size_t));
   MOCK_METHOD4(nn_recv, int(int, void*, size_t, int));
+  MOCK_METHOD3(nn_poll, int(struct nn_pollfd*, int, int));
 };
 
 #endif // NANOMSG_MOCK_HPP_
@@ -20,6 +20,7 @@ struct native_socket_mock
       std::function<void(const boost::system::error_code&, std::size_t)>;
   MOCK_CONST_METHOD1(async_read_event, void(handler));
   MOCK_CONST_METHOD1(async_write_event, void(handler));
+  MOCK_CONST_METHOD0(cancel, void());
 
   nmpp::native_socket::native_handle_type m_sock;
 };
@@ -0,0 +1,79 @@
+#include <cstdint>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include <nmpp/mpsc_queue.hpp>
+#include <thread>
+#include <vector>
+
+using namespace ::testing;
+
+TEST(mpsc_queue_test, rounds_capacity_up_to_power_of_two)
+{
+  ASSERT_THAT(nmpp::mpsc_queue<int>(3).capacity(), Eq(4u));
+  ASSERT_THAT(nmpp::mpsc_queue<int>(16).capacity(), Eq(16u));
+  ASSERT_THROW(nmpp::mpsc_queue<int>(0), std::logic_error);
+}
+
+TEST(mpsc_queue_test, heap_allocated_queue_starts_a_cache_line)
+{
+  for (auto i = 0; i < 8; ++i)
+  {
+    std::unique_ptr<nmpp::mpsc_queue<int>> queue(new nmpp::mpsc_queue<int>(4));
+    ASSERT_THAT(reinterpret_cast<uintptr_t>(queue.get()) % 64, Eq(0u));
+  }
+}
+
+TEST(mpsc_queue_test, full_queue_keeps_the_rejected_value)
+{
+  nmpp::mpsc_queue<std::unique_ptr<int>> queue(2);
+  ASSERT_TRUE(queue.try_push(std::make_unique<int>(1)));
+  ASSERT_TRUE(queue.try_push(std::make_unique<int>(2)));
+
+  auto rejected = std::make_unique<int>(3);
+  ASSERT_FALSE(queue.try_push(std::move(rejected)));
+  ASSERT_THAT(rejected, NotNull());
+  ASSERT_THAT(queue.size(), Eq(2u));
+
+  std::unique_ptr<int> value;
+  ASSERT_TRUE(queue.try_pop(value));
+  ASSERT_THAT(*value, Eq(1));
+  ASSERT_TRUE(queue.try_push(std::move(rejected)));
+  ASSERT_TRUE(queue.try_pop(value));
+  ASSERT_THAT(*value, Eq(2));
+  ASSERT_TRUE(queue.try_pop(value));
+  ASSERT_THAT(*value, Eq(3));
+  ASSERT_FALSE(queue.try_pop(value));
+}
+
+TEST(mpsc_queue_test, keeps_order_of_every_producer)
+{
+  const int producers = 4;
+  const int count = 20000;
+  nmpp::mpsc_queue<std::pair<int, int>> queue(64);
+  std::vector<std::thread> threads;
+  for (auto p = 0; p < producers; ++p)
+    threads.emplace_back([&queue, p] {
+      for (auto i = 0; i < count; ++i)
+        while (!queue.try_push(std::make_pair(p, i)))
+          std::this_thread::yield();
+    });
+
+  std::vector<int> next(producers, 0);
+  auto in_order = true;
+  for (auto received = 0; received < producers * count;)
+  {
+    std::pair<int, int> value;
+    if (!queue.try_pop(value))
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    in_order = in_order && value.second == next[value.first]++;
+    ++received;
+  }
+  for (auto& t : threads)
+    t.join();
+  ASSERT_TRUE(in_order);
+  ASSERT_TRUE(queue.empty());
+}
@@ -0,0 +1,280 @@
+#include "mocks/async_dispatcher_mock.hpp"
+#include "mocks/nanomsg_heap.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include <boost/asio.hpp>
+#include <chrono>
+#include <functional>
+#include <gtest/gtest.h>
+#include <nmpp/message.hpp>
+#include <nmpp/pacer.hpp>
+#include <string>
+#include <vector>
+
+using namespace ::testing;
+
+namespace
+{
+
+struct manual_clock
+{
+  using duration = std::chrono::nanoseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<manual_clock>;
+  static constexpr bool is_steady = true;
+
+  static time_point now()
+  {
+    return current;
+  }
+
+  static time_point current;
+};
+
+manual_clock::time_point manual_clock::current;
+
+// Records the one wait the pacer keeps pending.
+struct manual_timer
+{
+  using handler = std::function<void(const boost::system::error_code&)>;
+
+  explicit manual_timer(boost::asio::io_service&)
+  {
+    instance = this;
+  }
+
+  void expires_at(manual_clock::time_point deadline)
+  {
+    this->deadline = deadline;
+  }
+
+  void async_wait(handler h)
+  {
+    pending = std::move(h);
+  }
+
+  // Moves the clock to the deadline and completes the wait.
+  void fire()
+  {
+    manual_clock::current = deadline;
+    auto h = std::move(pending);
+    pending = nullptr;
+    h(boost::system::error_code());
+  }
+
+  manual_clock::time_point deadline;
+  handler pending;
+  static manual_timer* instance;
+};
+
+manual_timer* manual_timer::instance = nullptr;
+
+} // namespace
+
+struct pacer_test : Test
+{
+  using async_socket = nmpp::async_socket_impl<async_dispatcher_mock>;
+  using pacer =
+      nmpp::pacer<async_socket, nmpp::message, manual_clock, manual_timer>;
+
+  void SetUp()
+  {
+    manual_clock::current = manual_clock::time_point();
+    EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(1));
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto)).WillOnce(Return(1));
+    EXPECT_CALL(nanomsg, nn_getsockopt(1, NN_SOL_SOCKET, _, _, _))
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(nanomsg, nn_close(1)).WillOnce(Return(0));
+    socket.reset(new async_socket(domain, proto, io));
+    EXPECT_CALL(socket->get_async_dispatcher(), on_send_event(_))
+        .WillRepeatedly(SaveArg<0>(&writable));
+  }
+
+  void post(pacer& p, const std::string& payload)
+  {
+    p.async_send(nmpp::message::from(payload.c_str(), payload.size()),
+                 [this, payload](const std::error_code& ec, size_t) {
+                   completed.push_back(ec ? "!" + payload : payload);
+                 });
+  }
+
+  void become_writable()
+  {
+    auto h = std::move(writable);
+    writable = nullptr;
+    h(std::error_code());
+  }
+
+  manual_timer& timer()
+  {
+    return *manual_timer::instance;
+  }
+
+  // Milliseconds from now until the timer's deadline.
+  double wait_ms()
+  {
+    return std::chrono::duration<double, std::milli>(timer().deadline -
+                                                     manual_clock::now())
+        .count();
+  }
+
+  int domain = 0;
+  int proto = 0;
+  nanomsg_mock nanomsg;
+  nanomsg_heap heap{nanomsg};
+  boost::asio::io_service io;
+  std::unique_ptr<async_socket> socket;
+  async_dispatcher_mock::handler writable;
+  std::vector<std::string> completed;
+};
+
+TEST_F(pacer_test, sends_a_burst_then_paces_at_the_message_rate)
+{
+  pacer p(*socket, io, {10, 2, 0, 0});
+  for (auto i = 0; i < 4; ++i)
+    post(p, "m" + std::to_string(i));
+
+  become_writable();
+  ASSERT_THAT(heap.sent, ElementsAre("m0", "m1"));
+  ASSERT_TRUE(timer().pending);
+  ASSERT_FALSE(writable);
+  ASSERT_THAT(wait_ms(), DoubleNear(100, 1e-3));
+
+  timer().fire();
+  become_writable();
+  ASSERT_THAT(heap.sent, ElementsAre("m0", "m1", "m2"));
+  ASSERT_THAT(wait_ms(), DoubleNear(100, 1e-3));
+
+  timer().fire();
+  become_writable();
+  ASSERT_THAT(completed, ElementsAre("m0", "m1", "m2", "m3"));
+  ASSERT_FALSE(writable);
+  ASSERT_THAT(p.pending(), Eq(0u));
+}
+
+TEST_F(pacer_test, limits_bytes_per_second)
+{
+  pacer p(*socket, io, {0, 0, 100, 100});
+  post(p, std::string(60, 'a'));
+  post(p, std::string(60, 'b'));
+
+  become_writable();
+  ASSERT_THAT(heap.sent.size(), Eq(1u));
+  ASSERT_THAT(wait_ms(), DoubleNear(200, 1e-3));
+
+  timer().fire();
+  become_writable();
+  ASSERT_THAT(heap.sent.size(), Eq(2u));
+}
+
+TEST_F(pacer_test, message_larger_than_burst_waits_for_full_bucket)
+{
+  pacer p(*socket, io, {0, 0, 100, 50});
+  post(p, std::string(10, 'a'));
+  post(p, std::string(150, 'b'));
+  post(p, std::string(10, 'c'));
+
+  become_writable();
+  ASSERT_THAT(heap.sent.size(), Eq(1u));
+  timer().fire();
+  become_writable();
+  ASSERT_THAT(heap.sent.size(), Eq(2u));
+  // 150 bytes from a bucket of 50 leave a debt of 100, plus 10 to send.
+  ASSERT_THAT(wait_ms(), DoubleNear(1100, 1e-3));
+}
+
+TEST_F(pacer_test, reports_delayed_sends_and_token_levels)
+{
+  pacer p(*socket, io, {10, 2, 1000, 1000});
+  auto idle = p.stats();
+  ASSERT_THAT(idle.message_tokens, DoubleEq(2));
+  ASSERT_THAT(idle.byte_tokens, DoubleEq(1000));
+
+  for (auto i = 0; i < 3; ++i)
+    post(p, "abcd");
+  become_writable();
+
+  auto paced = p.stats();
+  ASSERT_THAT(paced.sent, Eq(2u));
+  ASSERT_THAT(paced.bytes, Eq(8u));
+  ASSERT_THAT(paced.delayed, Eq(1u));
+  ASSERT_THAT(paced.pending, Eq(1u));
+  ASSERT_THAT(paced.message_tokens, DoubleEq(0));
+  ASSERT_THAT(paced.byte_tokens, DoubleEq(992));
+
+  manual_clock::current += std::chrono::milliseconds(50);
+  ASSERT_THAT(p.stats().message_tokens, DoubleNear(0.5, 1e-9));
+}
+
+TEST_F(pacer_test, keeps_tokens_when_socket_pushes_back)
+{
+  pacer p(*socket, io, {10, 1, 0, 0});
+  post(p, "first");
+
+  EXPECT_CALL(nanomsg, nn_send(1, _, NN_MSG, NN_DONTWAIT))
+      .WillOnce(Return(-1))
+      .WillRepeatedly(DoDefault());
+  EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(EAGAIN));
+  become_writable();
+  ASSERT_THAT(completed, IsEmpty());
+  ASSERT_TRUE(writable);
+  ASSERT_THAT(p.stats().message_tokens, DoubleEq(1));
+
+  become_writable();
+  ASSERT_THAT(completed, ElementsAre("first"));
+}
+
+TEST_F(pacer_test, sends_everything_when_unlimited)
+{
+  pacer p(*socket, io, {0, 0, 0, 0});
+  for (auto i = 0; i < 100; ++i)
+    post(p, "x");
+  become_writable();
+  ASSERT_THAT(completed.size(), Eq(100u));
+  ASSERT_FALSE(timer().pending);
+}
+
+TEST_F(pacer_test, fails_queued_messages_on_socket_error)
+{
+  pacer p(*socket, io, {10, 1, 0, 0});
+  post(p, "a");
+  post(p, "b");
+  writable(std::make_error_code(std::errc::operation_canceled));
+  ASSERT_THAT(completed, ElementsAre("!a", "!b"));
+}
+
+TEST_F(pacer_test, messages_queued_by_failed_handlers_are_sent)
+{
+  pacer p(*socket, io, {0, 0, 0, 0});
+  p.async_send(nmpp::message::from("a", 1),
+               [&](const std::error_code& ec, size_t) {
+                 completed.push_back(ec ? "!a" : "a");
+                 post(p, "b");
+               });
+  auto failed = std::move(writable);
+  failed(std::make_error_code(std::errc::operation_canceled));
+  ASSERT_THAT(completed, ElementsAre("!a"));
+  ASSERT_THAT(p.pending(), Eq(1u));
+
+  become_writable();
+  ASSERT_THAT(completed, ElementsAre("!a", "b"));
+}
+
+TEST_F(pacer_test, destruction_leaves_pending_wait_harmless)
+{
+  EXPECT_CALL(socket->get_async_dispatcher(), cancel_send()).Times(0);
+  {
+    pacer p(*socket, io, {0, 0, 0, 0});
+    post(p, "a");
+  }
+  writable(std::error_code());
+  ASSERT_THAT(completed, IsEmpty());
+  ASSERT_THAT(heap.allocations, IsEmpty());
+}
+
+TEST_F(pacer_test, rejects_invalid_limits)
+{
+  ASSERT_THROW(pacer(*socket, io, {10, 0, 0, 0}), std::logic_error);
+  ASSERT_THROW(pacer(*socket, io, {0, 0, 10, 0}), std::logic_error);
+  ASSERT_THROW(pacer(*socket, io, {-1, 1, 0, 0}), std::logic_error);
+}
@@ -0,0 +1,184 @@
+#include "mocks/nanomsg_mock.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <nmpp/message.hpp>
+#include <nmpp/pipeline.hpp>
+#include <nmpp/socket.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ::testing;
+
+struct pipeline_test : Test
+{
+  using pipeline = nmpp::pipeline<>;
+
+  void SetUp()
+  {
+    EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(EAGAIN));
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto))
+        .WillOnce(Return(1))
+        .WillOnce(Return(2));
+    EXPECT_CALL(nanomsg, nn_close(_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(nanomsg, nn_allocmsg(_, 0))
+        .WillRepeatedly(Invoke([](size_t size, int) {
+          return std::malloc(size);
+        }));
+    EXPECT_CALL(nanomsg, nn_freemsg(_)).WillRepeatedly(Invoke([](void* buf) {
+      std::free(buf);
+      return 0;
+    }));
+    EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, NN_DONTWAIT))
+        .WillRepeatedly(Invoke([this](int, void* buf, size_t, int) {
+          auto n = next.load();
+          if (n >= count)
+            return -1;
+          auto payload = std::to_string(n);
+          auto chunk = std::malloc(payload.size());
+          std::memcpy(chunk, payload.data(), payload.size());
+          *reinterpret_cast<void**>(buf) = chunk;
+          ++next;
+          return static_cast<int>(payload.size());
+        }));
+    EXPECT_CALL(nanomsg, nn_send(2, _, NN_MSG, NN_DONTWAIT))
+        .WillRepeatedly(Invoke([this](int, const void* buf, size_t, int) {
+          if (!writable.load())
+            return -1;
+          auto msg = *reinterpret_cast<char* const*>(buf);
+          std::lock_guard<std::mutex> lock(mutex);
+          sent.emplace_back(msg, std::strlen(msg));
+          std::free(msg);
+          return static_cast<int>(sent.back().size());
+        }));
+    source.reset(new nmpp::socket(domain, proto));
+    sink.reset(new nmpp::socket(domain, proto));
+  }
+
+  void wait_for_source(uint64_t received)
+  {
+    while (next.load() < received)
+      std::this_thread::yield();
+  }
+
+  int domain = 0;
+  int proto = 0;
+  nanomsg_mock nanomsg;
+  std::unique_ptr<nmpp::socket> source;
+  std::unique_ptr<nmpp::socket> sink;
+  std::atomic<uint64_t> next{0};
+  uint64_t count = 0;
+  std::atomic<bool> writable{true};
+  std::mutex mutex;
+  std::vector<std::string> sent;
+};
+
+// Payloads are sent NUL terminated so the sink can recover their length.
+TEST_F(pipeline_test, passes_messages_through_stages_in_order)
+{
+  count = 1000;
+  pipeline p(*source, *sink, 8);
+  p.add_stage("even", [](pipeline::message_ptr msg) {
+    auto value = std::stoi(std::string(msg->data(), msg->size()));
+    return value % 2 ? nullptr : std::move(msg);
+  });
+  p.add_stage("terminate", [](pipeline::message_ptr msg) {
+    std::string payload(msg->data(), msg->size());
+    return nmpp::message::from(payload.c_str(), payload.size() + 1);
+  });
+
+  p.start();
+  wait_for_source(count);
+  p.stop();
+  ASSERT_FALSE(p.running());
+
+  ASSERT_THAT(sent.size(), Eq(count / 2));
+  for (size_t i = 0; i < sent.size(); ++i)
+    ASSERT_THAT(sent[i], Eq(std::to_string(i * 2)));
+
+  auto stats = p.stats();
+  ASSERT_THAT(stats.size(), Eq(4u));
+  ASSERT_THAT(stats[0].name, Eq("source"));
+  ASSERT_THAT(stats[0].processed, Eq(count));
+  ASSERT_THAT(stats[1].name, Eq("even"));
+  ASSERT_THAT(stats[1].processed, Eq(count / 2));
+  ASSERT_THAT(stats[1].dropped, Eq(count / 2));
+  ASSERT_THAT(stats[1].capacity, Eq(8u));
+  ASSERT_THAT(stats[2].name, Eq("terminate"));
+  ASSERT_THAT(stats[2].processed, Eq(count / 2));
+  ASSERT_THAT(stats[3].name, Eq("sink"));
+  ASSERT_THAT(stats[3].processed, Eq(count / 2));
+  ASSERT_THAT(stats[3].queued, Eq(0u));
+}
+
+TEST_F(pipeline_test, full_queues_push_back_on_the_source)
+{
+  count = 1000;
+  writable = false;
+  pipeline p(*source, *sink, 4);
+  p.add_stage("terminate", [](pipeline::message_ptr msg) {
+    std::string payload(msg->data(), msg->size());
+    return nmpp::message::from(payload.c_str(), payload.size() + 1);
+  });
+
+  p.start();
+  wait_for_source(10);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  // Two queues of four, one message held by the stage, one by the sink and
+  // one by the source.
+  ASSERT_THAT(next.load(), Le(11u));
+  auto stats = p.stats();
+  ASSERT_THAT(stats[1].queued, Eq(4u));
+  ASSERT_THAT(stats[2].queued, Eq(4u));
+
+  writable = true;
+  wait_for_source(count);
+  p.stop();
+  ASSERT_THAT(sent.size(), Eq(count));
+}
+
+TEST_F(pipeline_test, stop_rethrows_stage_error)
+{
+  count = 10;
+  pipeline p(*source, *sink);
+  p.add_stage("fail", [](pipeline::message_ptr) -> pipeline::message_ptr {
+    throw std::runtime_error("stage failed");
+  });
+
+  p.start();
+  while (p.running())
+    std::this_thread::yield();
+  ASSERT_THROW(p.stop(), std::runtime_error);
+  ASSERT_TRUE(sent.empty());
+}
+
+TEST_F(pipeline_test, abort_discards_queued_messages)
+{
+  count = 100;
+  writable = false;
+  pipeline p(*source, *sink, 4);
+
+  p.start();
+  wait_for_source(5);
+  p.abort();
+  ASSERT_FALSE(p.running());
+  ASSERT_TRUE(sent.empty());
+}
+
+TEST_F(pipeline_test, cannot_be_changed_or_started_while_running)
+{
+  pipeline p(*source, *sink);
+  ASSERT_THROW(p.add_stage("empty", nullptr), std::logic_error);
+
+  p.start();
+  ASSERT_THROW(p.add_stage("late", [](pipeline::message_ptr msg) {
+    return msg;
+  }), std::logic_error);
+  ASSERT_THROW(p.start(), std::logic_error);
+  p.stop();
+}
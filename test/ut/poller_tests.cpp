@@ -0,0 +1,140 @@
+#include "mocks/message_mock.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include <gtest/gtest.h>
+#include <nmpp/poller.hpp>
+
+using namespace ::testing;
+
+ACTION_P2(SetRevents, index, events)
+{
+  arg0[index].revents = events;
+}
+
+struct poller_test : Test
+{
+  void SetUp()
+  {
+    EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(1));
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto))
+        .WillOnce(Return(1))
+        .WillOnce(Return(2))
+        .WillOnce(Return(3));
+    EXPECT_CALL(nanomsg, nn_close(_)).Times(3).WillRepeatedly(Return(0));
+    for (int i = 0; i < 3; ++i)
+      sockets.emplace_back(domain, proto);
+  }
+
+  int domain = 0;
+  int proto = 0;
+  nanomsg_mock nanomsg;
+  std::vector<nmpp::socket> sockets;
+  nmpp::poller<> poller;
+};
+
+TEST_F(poller_test, polls_registered_sockets_with_requested_events)
+{
+  poller.add(sockets[0], nmpp::poller<>::in);
+  poller.add(sockets[1], nmpp::poller<>::in | nmpp::poller<>::out);
+  EXPECT_CALL(nanomsg, nn_poll(_, 2, 100))
+      .WillOnce(Invoke([](nn_pollfd* fds, int, int) {
+        EXPECT_THAT(fds[0].fd, Eq(1));
+        EXPECT_THAT(fds[0].events, Eq(NN_POLLIN));
+        EXPECT_THAT(fds[1].fd, Eq(2));
+        EXPECT_THAT(fds[1].events, Eq(NN_POLLIN | NN_POLLOUT));
+        return 0;
+      }));
+  ASSERT_THAT(poller.wait(100), Eq(0u));
+  ASSERT_THAT(poller.ready(), IsEmpty());
+}
+
+TEST_F(poller_test, reports_ready_sockets)
+{
+  for (auto& socket : sockets)
+    poller.add(socket, nmpp::poller<>::in | nmpp::poller<>::out);
+  EXPECT_CALL(nanomsg, nn_poll(_, 3, -1))
+      .WillOnce(DoAll(SetRevents(0, NN_POLLIN), SetRevents(1, 0),
+                      SetRevents(2, NN_POLLOUT), Return(2)));
+  ASSERT_THAT(poller.wait(-1), Eq(2u));
+  ASSERT_THAT(poller.ready()[0].socket, Eq(&sockets[0]));
+  ASSERT_TRUE(poller.ready()[0].readable());
+  ASSERT_FALSE(poller.ready()[0].writable());
+  ASSERT_THAT(poller.ready()[1].socket, Eq(&sockets[2]));
+  ASSERT_TRUE(poller.ready()[1].writable());
+}
+
+TEST_F(poller_test, removed_socket_is_not_polled)
+{
+  poller.add(sockets[0], nmpp::poller<>::in);
+  poller.add(sockets[1], nmpp::poller<>::in);
+  poller.remove(sockets[0]);
+  EXPECT_CALL(nanomsg, nn_poll(_, 1, 0))
+      .WillOnce(Invoke([](nn_pollfd* fds, int, int) {
+        EXPECT_THAT(fds[0].fd, Eq(2));
+        return 0;
+      }));
+  poller.wait(0);
+}
+
+TEST_F(poller_test, modifies_requested_events)
+{
+  poller.add(sockets[0], nmpp::poller<>::in);
+  poller.modify(sockets[0], nmpp::poller<>::out);
+  EXPECT_CALL(nanomsg, nn_poll(_, 1, 0))
+      .WillOnce(Invoke([](nn_pollfd* fds, int, int) {
+        EXPECT_THAT(fds[0].events, Eq(NN_POLLOUT));
+        return 0;
+      }));
+  poller.wait(0);
+}
+
+TEST_F(poller_test, throws_when_socket_registered_twice)
+{
+  poller.add(sockets[0], nmpp::poller<>::in);
+  ASSERT_THROW(poller.add(sockets[0], nmpp::poller<>::in), std::logic_error);
+}
+
+TEST_F(poller_test, throws_when_modifying_unknown_socket)
+{
+  ASSERT_THROW(poller.modify(sockets[0], nmpp::poller<>::in),
+               std::logic_error);
+}
+
+TEST_F(poller_test, throws_when_nn_poll_fails)
+{
+  poller.add(sockets[0], nmpp::poller<>::in);
+  EXPECT_CALL(nanomsg, nn_poll(_, 1, 0)).WillOnce(Return(-1));
+  ASSERT_THROW(poller.wait(0), nmpp::exception);
+}
+
+TEST_F(poller_test, does_not_poll_without_sockets)
+{
+  EXPECT_CALL(nanomsg, nn_poll(_, _, _)).Times(0);
+  ASSERT_THAT(poller.wait(0), Eq(0u));
+}
+
+TEST_F(poller_test, drains_queued_messages_up_to_limit)
+{
+  char data[] = {1, 2, 3};
+  EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, NN_DONTWAIT))
+      .Times(2)
+      .WillRepeatedly(Invoke([&data](int, void* buf, size_t, int) {
+        *reinterpret_cast<void**>(buf) = data;
+        return 3;
+      }));
+  size_t bytes = 0;
+  auto received = nmpp::drain<message_mock>(
+      sockets[0], [&bytes](const message_mock& msg) { bytes += msg.m_length; },
+      2);
+  ASSERT_THAT(received, Eq(2u));
+  ASSERT_THAT(bytes, Eq(6u));
+}
+
+TEST_F(poller_test, drain_stops_when_queue_is_empty)
+{
+  EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, NN_DONTWAIT))
+      .WillOnce(Return(-1));
+  EXPECT_CALL(nanomsg, nn_errno()).WillOnce(Return(EAGAIN));
+  auto received =
+      nmpp::drain<message_mock>(sockets[0], [](const message_mock&) {}, 10);
+  ASSERT_THAT(received, Eq(0u));
+}
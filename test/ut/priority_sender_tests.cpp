@@ -0,0 +1,168 @@
+#include "mocks/async_dispatcher_mock.hpp"
+#include "mocks/nanomsg_heap.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include <boost/asio.hpp>
+#include <gtest/gtest.h>
+#include <nmpp/message.hpp>
+#include <nmpp/priority_sender.hpp>
+#include <string>
+#include <vector>
+
+using namespace ::testing;
+
+struct priority_sender_test : Test
+{
+  using async_socket = nmpp::async_socket_impl<async_dispatcher_mock>;
+
+  void SetUp()
+  {
+    EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(1));
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto)).WillOnce(Return(1));
+    EXPECT_CALL(nanomsg, nn_getsockopt(1, NN_SOL_SOCKET, _, _, _))
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(nanomsg, nn_close(1)).WillOnce(Return(0));
+    socket.reset(new async_socket(domain, proto, io));
+    EXPECT_CALL(socket->get_async_dispatcher(), on_send_event(_))
+        .WillRepeatedly(SaveArg<0>(&writable));
+  }
+
+  void post(nmpp::priority_sender<async_socket>& sender, size_t lane,
+            const std::string& payload)
+  {
+    sender.async_send(lane, nmpp::message::from(payload.c_str(),
+                                                payload.size()),
+                      [this, payload](const std::error_code& ec, size_t) {
+                        completed.push_back(ec ? "!" + payload : payload);
+                      });
+  }
+
+  int domain = 0;
+  int proto = 0;
+  nanomsg_mock nanomsg;
+  nanomsg_heap heap{nanomsg};
+  boost::asio::io_service io;
+  std::unique_ptr<async_socket> socket;
+  async_dispatcher_mock::handler writable;
+  std::vector<std::string> completed;
+};
+
+TEST_F(priority_sender_test, urgent_lane_overtakes_queued_bulk)
+{
+  nmpp::priority_sender<async_socket> sender(*socket, {8, 1});
+  post(sender, 1, "bulk1");
+  post(sender, 1, "bulk2");
+  post(sender, 0, "ctl");
+  writable(std::error_code());
+
+  ASSERT_THAT(heap.sent, ElementsAre("ctl", "bulk1", "bulk2"));
+  ASSERT_THAT(completed, ElementsAre("ctl", "bulk1", "bulk2"));
+  ASSERT_THAT(sender.pending(), Eq(0u));
+}
+
+TEST_F(priority_sender_test, weights_share_bandwidth_between_lanes)
+{
+  nmpp::priority_sender<async_socket> sender(*socket, {2, 1});
+  for (auto i = 0; i < 4; ++i)
+    post(sender, 0, "a" + std::to_string(i));
+  for (auto i = 0; i < 2; ++i)
+    post(sender, 1, "b" + std::to_string(i));
+  writable(std::error_code());
+
+  ASSERT_THAT(heap.sent, ElementsAre("a0", "a1", "b0", "a2", "a3", "b1"));
+}
+
+TEST_F(priority_sender_test, rearms_when_socket_pushes_back)
+{
+  nmpp::priority_sender<async_socket> sender(*socket, {1, 1});
+  post(sender, 0, "first");
+  post(sender, 1, "second");
+
+  EXPECT_CALL(nanomsg, nn_send(1, _, NN_MSG, NN_DONTWAIT))
+      .WillOnce(Invoke([this](int, const void* buf, size_t, int) {
+        auto chunk = *reinterpret_cast<char* const*>(buf);
+        heap.sent.emplace_back(chunk, heap.allocations[chunk]);
+        heap.release(chunk);
+        return 5;
+      }))
+      .WillOnce(Return(-1))
+      .WillRepeatedly(DoDefault());
+  EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(EAGAIN));
+  writable(std::error_code());
+  ASSERT_THAT(completed, ElementsAre("first"));
+  ASSERT_THAT(sender.pending(1), Eq(1u));
+
+  writable(std::error_code());
+  ASSERT_THAT(completed, ElementsAre("first", "second"));
+}
+
+TEST_F(priority_sender_test, limits_sends_per_writable_event)
+{
+  nmpp::priority_sender<async_socket> sender(*socket, {1}, 2);
+  for (auto i = 0; i < 3; ++i)
+    post(sender, 0, std::to_string(i));
+  writable(std::error_code());
+  ASSERT_THAT(heap.sent, SizeIs(2));
+  writable(std::error_code());
+  ASSERT_THAT(heap.sent, SizeIs(3));
+}
+
+TEST_F(priority_sender_test, fails_queued_messages_on_wait_error)
+{
+  nmpp::priority_sender<async_socket> sender(*socket, {1, 1});
+  post(sender, 0, "a");
+  post(sender, 1, "b");
+  writable(std::make_error_code(std::errc::operation_canceled));
+  ASSERT_THAT(completed, ElementsAre("!a", "!b"));
+  ASSERT_THAT(heap.sent, IsEmpty());
+  ASSERT_THAT(heap.allocations, IsEmpty());
+}
+
+TEST_F(priority_sender_test, requeued_during_failure_waits_for_next_event)
+{
+  nmpp::priority_sender<async_socket> sender(*socket, {1});
+  sender.async_send(0, nmpp::message::from("a", 1),
+                    [&](const std::error_code& ec, size_t) {
+                      completed.push_back(ec ? "!a" : "a");
+                      post(sender, 0, "b");
+                    });
+  auto failed = std::move(writable);
+  failed(std::make_error_code(std::errc::operation_canceled));
+  ASSERT_THAT(completed, ElementsAre("!a"));
+  ASSERT_THAT(sender.pending(), Eq(1u));
+
+  writable(std::error_code());
+  ASSERT_THAT(completed, ElementsAre("!a", "b"));
+}
+
+TEST_F(priority_sender_test, destruction_leaves_pending_wait_harmless)
+{
+  EXPECT_CALL(socket->get_async_dispatcher(), cancel_send()).Times(0);
+  {
+    nmpp::priority_sender<async_socket> sender(*socket, {1});
+    post(sender, 0, "a");
+  }
+  writable(std::error_code());
+  ASSERT_THAT(completed, IsEmpty());
+  ASSERT_THAT(heap.allocations, IsEmpty());
+}
+
+TEST_F(priority_sender_test, rejects_invalid_lanes_and_weights)
+{
+  using sender_type = nmpp::priority_sender<async_socket>;
+  ASSERT_THROW(sender_type(*socket, {}), std::logic_error);
+  ASSERT_THROW(sender_type(*socket, {1, 0}), std::logic_error);
+  sender_type sender(*socket, {1});
+  ASSERT_THROW(post(sender, 1, "x"), std::logic_error);
+}
+
+TEST_F(priority_sender_test, connects_with_send_priority)
+{
+  EXPECT_CALL(nanomsg, nn_setsockopt(1, NN_SOL_SOCKET, NN_SNDPRIO, _,
+                                     sizeof(int)))
+      .WillOnce(Invoke([](int, int, int, const void* value, size_t) {
+        return *reinterpret_cast<const int*>(value) == 2 ? 0 : -1;
+      }));
+  EXPECT_CALL(nanomsg, nn_connect(1, StrEq("tcp://host:1")))
+      .WillOnce(Return(7));
+  ASSERT_THAT(nmpp::connect_with_priority(*socket, "tcp://host:1", 2), Eq(7));
+}
@@ -0,0 +1,143 @@
+#include "mocks/nanomsg_heap.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include <chrono>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nmpp/shm_transport.hpp>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+using namespace ::testing;
+
+struct shm_transport_test : Test
+{
+  void SetUp()
+  {
+    EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(1));
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto))
+        .WillOnce(Return(1))
+        .WillOnce(Return(2));
+    EXPECT_CALL(nanomsg, nn_close(_)).Times(2).WillRepeatedly(Return(0));
+    EXPECT_CALL(nanomsg, nn_recv(2, _, NN_MSG, 0))
+        .WillRepeatedly(Invoke([this](int, void* buf, size_t, int) {
+          auto frame = heap.sent.at(delivered++);
+          *reinterpret_cast<void**>(buf) = heap.allocate(frame);
+          return static_cast<int>(frame.size());
+        }));
+  }
+
+  std::string name =
+      "/nmpp_shm_transport_test_" + std::to_string(getpid());
+  int domain = 0;
+  int proto = 0;
+  size_t delivered = 0;
+  nanomsg_mock nanomsg;
+  nanomsg_heap heap{nanomsg};
+};
+
+TEST_F(shm_transport_test, small_payload_travels_inline)
+{
+  auto segment = nmpp::shm_segment::create(name, 2, 128);
+  nmpp::socket tx(domain, proto);
+  nmpp::socket rx(domain, proto);
+  nmpp::shm_sender<> sender(tx, *segment, 16);
+  nmpp::shm_receiver<> receiver(rx, *segment);
+
+  ASSERT_TRUE(sender.try_send("hello", 5));
+  auto msg = receiver.receive();
+  ASSERT_TRUE(msg->valid());
+  ASSERT_FALSE(msg->in_shared_memory());
+  ASSERT_THAT(std::string(msg->data(), msg->size()), Eq("hello"));
+}
+
+TEST_F(shm_transport_test, large_payload_is_read_from_peer_mapping)
+{
+  auto owner = nmpp::shm_segment::create(name, 2, 128);
+  auto peer = nmpp::shm_segment::open(name);
+  ASSERT_THAT(peer->slot_count(), Eq(2u));
+  ASSERT_THAT(peer->slot_capacity(), Eq(128u));
+
+  nmpp::socket tx(domain, proto);
+  nmpp::socket rx(domain, proto);
+  nmpp::shm_sender<> sender(tx, *owner, 16);
+  nmpp::shm_receiver<> receiver(rx, *peer);
+  std::string payload(100, 'x');
+
+  ASSERT_TRUE(sender.try_send(payload.data(), payload.size()));
+  ASSERT_THAT(heap.sent.back().size(), Eq(nmpp::shm_frame::descriptor_size));
+  auto msg = receiver.receive();
+  ASSERT_TRUE(msg->in_shared_memory());
+  ASSERT_THAT(std::string(msg->data(), msg->size()), Eq(payload));
+}
+
+TEST_F(shm_transport_test, slots_are_recycled_when_view_is_released)
+{
+  auto segment = nmpp::shm_segment::create(name, 1, 64);
+  nmpp::socket tx(domain, proto);
+  nmpp::socket rx(domain, proto);
+  nmpp::shm_sender<> sender(tx, *segment, 8);
+  nmpp::shm_receiver<> receiver(rx, *segment);
+  std::string payload(32, 'y');
+
+  ASSERT_TRUE(sender.try_send(payload.data(), payload.size()));
+  ASSERT_FALSE(sender.try_send(payload.data(), payload.size()));
+  ASSERT_THAT(heap.sent.size(), Eq(1u));
+
+  receiver.receive().reset();
+  ASSERT_TRUE(sender.try_send(payload.data(), payload.size()));
+}
+
+TEST_F(shm_transport_test, rejects_stale_descriptor)
+{
+  auto segment = nmpp::shm_segment::create(name, 1, 64);
+  nmpp::socket tx(domain, proto);
+  nmpp::socket rx(domain, proto);
+  nmpp::shm_sender<> sender(tx, *segment, 8);
+  nmpp::shm_receiver<> receiver(rx, *segment);
+  std::string payload(32, 'z');
+
+  ASSERT_TRUE(sender.try_send(payload.data(), payload.size()));
+  receiver.receive().reset();
+  ASSERT_TRUE(sender.try_send(payload.data(), payload.size()));
+  delivered = 0;
+  ASSERT_THROW(receiver.receive(), std::runtime_error);
+}
+
+TEST_F(shm_transport_test, dropped_descriptor_slot_is_reclaimed_after_lease)
+{
+  auto segment = nmpp::shm_segment::create(name, 1, 64);
+  nmpp::socket tx(domain, proto);
+  nmpp::socket rx(domain, proto);
+  nmpp::shm_sender<> sender(tx, *segment, 8, std::chrono::milliseconds(10));
+  nmpp::shm_receiver<> receiver(rx, *segment);
+  std::string payload(32, 'w');
+
+  // The first descriptor is never received, as if the socket dropped it.
+  ASSERT_TRUE(sender.try_send(payload.data(), payload.size()));
+  ASSERT_FALSE(sender.try_send(payload.data(), payload.size()));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ASSERT_TRUE(sender.try_send(payload.data(), payload.size()));
+
+  ASSERT_THROW(receiver.receive(), std::runtime_error);
+  auto msg = receiver.receive();
+  ASSERT_THAT(std::string(msg->data(), msg->size()), Eq(payload));
+}
+
+TEST_F(shm_transport_test, rejects_payload_larger_than_slot)
+{
+  auto segment = nmpp::shm_segment::create(name, 1, 64);
+  nmpp::socket tx(domain, proto);
+  nmpp::socket rx(domain, proto);
+  nmpp::shm_sender<> sender(tx, *segment, 8);
+  std::string payload(65, 'z');
+  ASSERT_THROW(sender.try_send(payload.data(), payload.size()),
+               std::logic_error);
+}
+
+TEST_F(shm_transport_test, open_fails_for_missing_segment)
+{
+  nmpp::socket tx(domain, proto);
+  nmpp::socket rx(domain, proto);
+  ASSERT_THROW(nmpp::shm_segment::open(name), std::system_error);
+}
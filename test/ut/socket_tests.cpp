@@ -4,6 +4,7 @@
 #include <boost/asio.hpp>
 #include <gtest/gtest.h>
 #include <nmpp/socket.hpp>
+#include <string>
 #include <type_traits>
 
 using namespace ::testing;
@@ -160,6 +161,28 @@ TEST_F(socket_operation_test, throws_exception_when_connect_returns_minus_one)
   ASSERT_THROW(socket->connect(endpoint), nmpp::exception);
 }
 
+TEST_F(socket_operation_test, returns_endpoint_id_of_bind_and_connect)
+{
+  std::string endpoint = "tcp://localhost:5000";
+  EXPECT_CALL(nanomsg, nn_bind(1, endpoint.c_str())).WillOnce(Return(3));
+  EXPECT_CALL(nanomsg, nn_connect(1, endpoint.c_str())).WillOnce(Return(4));
+  ASSERT_THAT(socket->bind(endpoint), Eq(3));
+  ASSERT_THAT(socket->connect(endpoint), Eq(4));
+}
+
+TEST_F(socket_operation_test, shuts_down_endpoint)
+{
+  EXPECT_CALL(nanomsg, nn_shutdown(1, 3)).WillOnce(Return(0));
+  socket->shutdown(3);
+}
+
+TEST_F(socket_operation_test, throws_exception_when_shutdown_returns_minus_one)
+{
+  EXPECT_CALL(nanomsg, nn_shutdown(1, 3)).WillOnce(Return(-1));
+  EXPECT_CALL(nanomsg, nn_errno()).WillOnce(Return(1));
+  ASSERT_THROW(socket->shutdown(3), nmpp::exception);
+}
+
 struct socket_send_receive_test : Test
 {
   void SetUp()
@@ -233,6 +256,66 @@ TEST_F(socket_send_receive_test, received_message_has_payload)
   ASSERT_THAT(message->m_message, Eq(data));
 }
 
+TEST_F(socket_send_receive_test, try_send_releases_sent_message)
+{
+  EXPECT_CALL(msg, valid()).WillOnce(Return(true));
+  EXPECT_CALL(msg, data()).WillOnce(Return(data));
+  EXPECT_CALL(msg, release()).WillOnce(Return(data));
+  EXPECT_CALL(nanomsg, nn_send(1, _, NN_MSG, NN_DONTWAIT)).WillOnce(Return(5));
+  ASSERT_TRUE(socket->try_send(msg));
+}
+
+TEST_F(socket_send_receive_test, try_send_keeps_message_when_would_block)
+{
+  EXPECT_CALL(msg, valid()).WillOnce(Return(true));
+  EXPECT_CALL(msg, data()).WillOnce(Return(data));
+  EXPECT_CALL(msg, release()).Times(0);
+  EXPECT_CALL(nanomsg, nn_send(1, _, NN_MSG, NN_DONTWAIT))
+      .WillOnce(Return(-1));
+  EXPECT_CALL(nanomsg, nn_errno()).WillOnce(Return(EAGAIN));
+  ASSERT_FALSE(socket->try_send(msg));
+}
+
+TEST_F(socket_send_receive_test, try_send_throws_on_error)
+{
+  EXPECT_CALL(msg, valid()).WillOnce(Return(true));
+  EXPECT_CALL(msg, data()).WillOnce(Return(data));
+  EXPECT_CALL(nanomsg, nn_send(1, _, NN_MSG, NN_DONTWAIT))
+      .WillOnce(Return(-1));
+  EXPECT_CALL(nanomsg, nn_errno()).WillOnce(Return(EBADF));
+  ASSERT_THROW(socket->try_send(msg), nmpp::exception);
+}
+
+TEST_F(socket_send_receive_test, try_receive_returns_queued_message)
+{
+  EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, NN_DONTWAIT))
+      .WillOnce(DoAll(SetArgVoidPointer(data), Return(5)));
+  auto message = socket->try_receive<message_mock>();
+  ASSERT_THAT(message->m_length, Eq(5));
+  ASSERT_THAT(message->m_message, Eq(data));
+}
+
+TEST_F(socket_send_receive_test, try_receive_returns_null_when_queue_empty)
+{
+  EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, NN_DONTWAIT))
+      .WillOnce(Return(-1));
+  EXPECT_CALL(nanomsg, nn_errno()).WillOnce(Return(EAGAIN));
+  ASSERT_THAT(socket->try_receive<message_mock>(), IsNull());
+}
+
+TEST_F(socket_send_receive_test, try_receive_throws_on_error)
+{
+  EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, NN_DONTWAIT))
+      .WillOnce(Return(-1));
+  EXPECT_CALL(nanomsg, nn_errno()).WillOnce(Return(EBADF));
+  ASSERT_THROW(socket->try_receive<message_mock>(), nmpp::exception);
+}
+
+TEST_F(socket_send_receive_test, exposes_native_handle)
+{
+  ASSERT_THAT(socket->native_handle(), Eq(1));
+}
+
 ACTION_P(SetArgVoidPointee, p)
 {
   *reinterpret_cast<int*>(arg3) = p;
@@ -293,13 +376,52 @@ TEST_F(async_socket_test, async_send_stores_handler)
   static constexpr size_t length = 5;
   char data[length] = {1, 2, 3, 4, 5};
   EXPECT_CALL(*msg, valid()).WillOnce(Return(true));
+  EXPECT_CALL(*msg, data()).WillOnce(Return(data));
   EXPECT_CALL(*msg, release()).WillOnce(Return(data));
   asocket->async_send(std::move(msg), [](const std::error_code&, size_t) {});
 
-  EXPECT_CALL(nanomsg, nn_send(1, _, NN_MSG, 0)).WillOnce(Return(1));
+  EXPECT_CALL(nanomsg, nn_send(1, _, NN_MSG, NN_DONTWAIT)).WillOnce(Return(1));
   handler(std::error_code());
 }
 
+TEST_F(async_socket_test, full_peer_defers_async_sends_in_order)
+{
+  async_dispatcher_mock::handler handler;
+  const async_dispatcher_mock& nsm = asocket->get_async_dispatcher();
+  EXPECT_CALL(nsm, on_send_event(_))
+      .Times(2)
+      .WillRepeatedly(SaveArg<0>(&handler));
+
+  static constexpr size_t length = 5;
+  char first[length] = {1, 2, 3, 4, 5};
+  char second[length] = {6, 7, 8, 9, 10};
+  std::vector<char*> completed;
+  for (auto data : {first, second})
+  {
+    auto msg{std::make_unique<message_mock>()};
+    EXPECT_CALL(*msg, valid()).WillOnce(Return(true));
+    EXPECT_CALL(*msg, data()).WillRepeatedly(Return(data));
+    EXPECT_CALL(*msg, release()).WillOnce(Return(data));
+    asocket->async_send(std::move(msg),
+                        [&completed, data](const std::error_code& ec,
+                                           size_t) {
+                          if (!ec)
+                            completed.push_back(data);
+                        });
+  }
+
+  EXPECT_CALL(nanomsg, nn_send(1, _, NN_MSG, NN_DONTWAIT))
+      .WillOnce(Return(-1))
+      .WillOnce(Return(length))
+      .WillOnce(Return(length));
+  EXPECT_CALL(nanomsg, nn_errno()).WillOnce(Return(EAGAIN));
+  handler(std::error_code());
+  ASSERT_TRUE(completed.empty());
+
+  handler(std::error_code());
+  ASSERT_THAT(completed, ElementsAre(first, second));
+}
+
 struct MessageReceiverMock
 {
   MOCK_METHOD1(handle, void(const message_mock&));
@@ -323,3 +445,255 @@ TEST_F(async_socket_test, async_receive_stores_handler)
   EXPECT_CALL(receiver, handle(_));
   handler(std::error_code());
 }
+
+TEST_F(async_socket_test, async_send_reports_error_without_sending)
+{
+  async_dispatcher_mock::handler handler;
+  const async_dispatcher_mock& nsm = asocket->get_async_dispatcher();
+  EXPECT_CALL(nsm, on_send_event(_)).WillOnce(SaveArg<0>(&handler));
+  auto msg{std::make_unique<message_mock>()};
+  EXPECT_CALL(*msg, valid()).WillOnce(Return(true));
+  EXPECT_CALL(*msg, release()).Times(0);
+
+  std::error_code result;
+  size_t sent = 1;
+  asocket->async_send(std::move(msg),
+                      [&](const std::error_code& ec, size_t bytes) {
+                        result = ec;
+                        sent = bytes;
+                      });
+
+  EXPECT_CALL(nanomsg, nn_send(_, _, _, _)).Times(0);
+  handler(std::make_error_code(std::errc::operation_canceled));
+  ASSERT_THAT(result, Eq(std::errc::operation_canceled));
+  ASSERT_THAT(sent, Eq(0u));
+}
+
+TEST_F(async_socket_test, async_receive_passes_error_code_and_message)
+{
+  async_dispatcher_mock::handler handler;
+  const async_dispatcher_mock& nsm = asocket->get_async_dispatcher();
+  EXPECT_CALL(nsm, on_receive_event(_)).WillOnce(SaveArg<0>(&handler));
+
+  static constexpr size_t length = 5;
+  char data[length] = {1, 2, 3, 4, 5};
+  std::error_code result = std::make_error_code(std::errc::io_error);
+  std::unique_ptr<message_mock> received;
+  asocket->async_receive<message_mock>(
+      [&](const std::error_code& ec, std::unique_ptr<message_mock> msg) {
+        result = ec;
+        received = std::move(msg);
+      });
+
+  EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, 0))
+      .WillOnce(DoAll(SetArgVoidPointer(data), Return(5)));
+  handler(std::error_code());
+  ASSERT_FALSE(result);
+  ASSERT_THAT(received->m_message, Eq(data));
+}
+
+TEST_F(async_socket_test, cancelled_receive_completes_with_null_message)
+{
+  async_dispatcher_mock::handler handler;
+  const async_dispatcher_mock& nsm = asocket->get_async_dispatcher();
+  EXPECT_CALL(nsm, on_receive_event(_)).WillOnce(SaveArg<0>(&handler));
+
+  std::error_code result;
+  auto called = false;
+  asocket->async_receive<message_mock>(
+      [&](const std::error_code& ec, std::unique_ptr<message_mock> msg) {
+        result = ec;
+        called = !msg;
+      });
+
+  EXPECT_CALL(nsm, cancel_receive());
+  asocket->cancel_receive();
+  EXPECT_CALL(nanomsg, nn_recv(_, _, _, _)).Times(0);
+  handler(std::make_error_code(std::errc::operation_canceled));
+  ASSERT_TRUE(called);
+  ASSERT_THAT(result, Eq(std::errc::operation_canceled));
+}
+
+TEST_F(async_socket_test, message_only_receive_handler_is_skipped_on_error)
+{
+  MessageReceiverMock receiver;
+  async_dispatcher_mock::handler handler;
+  const async_dispatcher_mock& nsm = asocket->get_async_dispatcher();
+  EXPECT_CALL(nsm, on_receive_event(_)).WillOnce(SaveArg<0>(&handler));
+  asocket->async_receive<message_mock>(std::bind(&MessageReceiverMock::handle,
+                                                 std::ref(receiver),
+                                                 std::placeholders::_1));
+
+  EXPECT_CALL(receiver, handle(_)).Times(0);
+  handler(std::make_error_code(std::errc::operation_canceled));
+}
+
+struct fake_timers
+{
+  using duration = std::chrono::milliseconds;
+
+  nmpp::timer_id expires_after(duration timeout, std::function<void()> cb)
+  {
+    last_timeout = timeout;
+    callback = cb;
+    return 42;
+  }
+
+  bool cancel(nmpp::timer_id id)
+  {
+    cancelled.push_back(id);
+    return true;
+  }
+
+  duration last_timeout{0};
+  std::function<void()> callback;
+  std::vector<nmpp::timer_id> cancelled;
+};
+
+TEST_F(async_socket_test, expired_receive_deadline_reports_timed_out)
+{
+  fake_timers timers;
+  async_dispatcher_mock::handler handler;
+  const async_dispatcher_mock& nsm = asocket->get_async_dispatcher();
+  EXPECT_CALL(nsm, on_receive_event(_)).WillOnce(SaveArg<0>(&handler));
+
+  std::error_code result;
+  asocket->async_receive<message_mock>(
+      [&](const std::error_code& ec, std::unique_ptr<message_mock>) {
+        result = ec;
+      },
+      timers, std::chrono::milliseconds(50));
+  ASSERT_THAT(timers.last_timeout, Eq(std::chrono::milliseconds(50)));
+
+  EXPECT_CALL(nsm, cancel_receive()).Times(0);
+  timers.callback();
+  ASSERT_THAT(result, Eq(std::errc::timed_out));
+
+  result.clear();
+  EXPECT_CALL(nanomsg, nn_recv(_, _, _, _)).Times(0);
+  handler(std::error_code());
+  ASSERT_FALSE(result);
+}
+
+TEST_F(async_socket_test, queued_receives_share_one_wait_in_order)
+{
+  async_dispatcher_mock::handler handler;
+  const async_dispatcher_mock& nsm = asocket->get_async_dispatcher();
+  EXPECT_CALL(nsm, on_receive_event(_))
+      .Times(2)
+      .WillRepeatedly(SaveArg<0>(&handler));
+
+  static constexpr size_t length = 5;
+  char first[length] = {1, 2, 3, 4, 5};
+  char second[length] = {6, 7, 8, 9, 10};
+  std::vector<std::string> completed;
+  for (auto name : {"first", "second"})
+    asocket->async_receive<message_mock>(
+        [&completed, name](const std::error_code& ec,
+                           std::unique_ptr<message_mock>) {
+          if (!ec)
+            completed.push_back(name);
+        });
+
+  EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, 0))
+      .WillOnce(DoAll(SetArgVoidPointer(first), Return(length)))
+      .WillOnce(DoAll(SetArgVoidPointer(second), Return(length)));
+  auto readable = handler;
+  readable(std::error_code());
+  ASSERT_THAT(completed, ElementsAre("first"));
+  handler(std::error_code());
+  ASSERT_THAT(completed, ElementsAre("first", "second"));
+}
+
+TEST_F(async_socket_test, expired_receive_leaves_the_queue)
+{
+  fake_timers timers;
+  async_dispatcher_mock::handler handler;
+  const async_dispatcher_mock& nsm = asocket->get_async_dispatcher();
+  EXPECT_CALL(nsm, on_receive_event(_)).WillOnce(SaveArg<0>(&handler));
+
+  std::vector<std::error_code> results;
+  asocket->async_receive<message_mock>(
+      [&](const std::error_code& ec, std::unique_ptr<message_mock>) {
+        results.push_back(ec);
+      },
+      timers, std::chrono::milliseconds(50));
+  std::unique_ptr<message_mock> received;
+  asocket->async_receive<message_mock>(
+      [&](const std::error_code& ec, std::unique_ptr<message_mock> msg) {
+        results.push_back(ec);
+        received = std::move(msg);
+      });
+
+  timers.callback();
+  ASSERT_THAT(results, ElementsAre(std::errc::timed_out));
+
+  static constexpr size_t length = 5;
+  char data[length] = {1, 2, 3, 4, 5};
+  EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, 0))
+      .WillOnce(DoAll(SetArgVoidPointer(data), Return(length)));
+  handler(std::error_code());
+  ASSERT_THAT(results, ElementsAre(std::errc::timed_out, std::error_code()));
+  ASSERT_THAT(received->m_message, Eq(data));
+}
+
+TEST_F(async_socket_test, expired_send_deadline_drops_only_its_message)
+{
+  fake_timers timers;
+  async_dispatcher_mock::handler handler;
+  const async_dispatcher_mock& nsm = asocket->get_async_dispatcher();
+  EXPECT_CALL(nsm, on_send_event(_)).WillOnce(SaveArg<0>(&handler));
+  EXPECT_CALL(nsm, cancel_send()).Times(0);
+
+  static constexpr size_t length = 5;
+  char kept[length] = {1, 2, 3, 4, 5};
+  auto msg{std::make_unique<message_mock>()};
+  EXPECT_CALL(*msg, valid()).WillOnce(Return(true));
+  EXPECT_CALL(*msg, release()).Times(0);
+  std::vector<std::error_code> results;
+  asocket->async_send(
+      std::move(msg),
+      [&](const std::error_code& ec, size_t) { results.push_back(ec); },
+      timers, std::chrono::milliseconds(10));
+
+  msg = std::make_unique<message_mock>();
+  EXPECT_CALL(*msg, valid()).WillOnce(Return(true));
+  EXPECT_CALL(*msg, data()).WillOnce(Return(kept));
+  EXPECT_CALL(*msg, release()).WillOnce(Return(kept));
+  asocket->async_send(std::move(msg), [&](const std::error_code& ec, size_t) {
+    results.push_back(ec);
+  });
+
+  timers.callback();
+  ASSERT_THAT(results, ElementsAre(std::errc::timed_out));
+
+  EXPECT_CALL(nanomsg, nn_send(1, _, NN_MSG, NN_DONTWAIT))
+      .WillOnce(Return(length));
+  handler(std::error_code());
+  ASSERT_THAT(results, ElementsAre(std::errc::timed_out, std::error_code()));
+  ASSERT_THAT(timers.cancelled, IsEmpty());
+}
+
+TEST_F(async_socket_test, completed_send_cancels_its_deadline)
+{
+  fake_timers timers;
+  async_dispatcher_mock::handler handler;
+  const async_dispatcher_mock& nsm = asocket->get_async_dispatcher();
+  EXPECT_CALL(nsm, on_send_event(_)).WillOnce(SaveArg<0>(&handler));
+  auto msg{std::make_unique<message_mock>()};
+  static constexpr size_t length = 5;
+  char data[length] = {1, 2, 3, 4, 5};
+  EXPECT_CALL(*msg, valid()).WillOnce(Return(true));
+  EXPECT_CALL(*msg, data()).WillOnce(Return(data));
+  EXPECT_CALL(*msg, release()).WillOnce(Return(data));
+
+  std::error_code result = std::make_error_code(std::errc::io_error);
+  asocket->async_send(std::move(msg),
+                      [&](const std::error_code& ec, size_t) { result = ec; },
+                      timers, std::chrono::milliseconds(10));
+
+  EXPECT_CALL(nanomsg, nn_send(1, _, NN_MSG, NN_DONTWAIT)).WillOnce(Return(5));
+  handler(std::error_code());
+  ASSERT_FALSE(result);
+  ASSERT_THAT(timers.cancelled, ElementsAre(42u));
+}
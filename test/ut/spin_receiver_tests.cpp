@@ -0,0 +1,136 @@
+#include "mocks/message_mock.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <nmpp/spin_receiver.hpp>
+#include <thread>
+
+using namespace ::testing;
+
+struct counting_backoff
+{
+  void idle() noexcept
+  {
+    ++*idles;
+  }
+
+  void reset() noexcept
+  {
+    ++*resets;
+  }
+
+  std::atomic<int>* idles;
+  std::atomic<int>* resets;
+};
+
+struct spin_receiver_test : Test
+{
+  void SetUp()
+  {
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto)).WillOnce(Return(1));
+    EXPECT_CALL(nanomsg, nn_close(1)).WillOnce(Return(0));
+    socket.reset(new nmpp::socket(domain, proto));
+  }
+
+  void wait_for(const std::atomic<int>& value, int expected)
+  {
+    while (value.load() < expected)
+      std::this_thread::yield();
+  }
+
+  using receiver = nmpp::spin_receiver<nmpp::socket, counting_backoff>;
+
+  int domain = 0;
+  int proto = 0;
+  nanomsg_mock nanomsg;
+  std::unique_ptr<nmpp::socket> socket;
+  std::atomic<int> idles{0};
+  std::atomic<int> resets{0};
+  std::atomic<int> received{0};
+  char data[3] = {1, 2, 3};
+};
+
+TEST_F(spin_receiver_test, invokes_handler_for_every_message)
+{
+  std::atomic<int> polls{0};
+  EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, NN_DONTWAIT))
+      .WillRepeatedly(Invoke([&](int, void* buf, size_t, int) {
+        if (++polls % 2)
+          return -1;
+        *reinterpret_cast<void**>(buf) = data;
+        return 3;
+      }));
+  EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(EAGAIN));
+
+  receiver spin(*socket, -1, counting_backoff{&idles, &resets});
+  spin.start<message_mock>([this](const message_mock& msg) {
+    EXPECT_THAT(msg.m_message, Eq(data));
+    ++received;
+  });
+  wait_for(received, 3);
+  spin.stop();
+  ASSERT_FALSE(spin.running());
+  ASSERT_THAT(idles.load(), Ge(3));
+  ASSERT_THAT(resets.load(), Eq(received.load()));
+}
+
+TEST_F(spin_receiver_test, stop_rethrows_receive_error)
+{
+  EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, NN_DONTWAIT))
+      .WillOnce(Return(-1));
+  EXPECT_CALL(nanomsg, nn_errno()).WillOnce(Return(EBADF));
+
+  receiver spin(*socket, -1, counting_backoff{&idles, &resets});
+  spin.start<message_mock>([](const message_mock&) {});
+  while (spin.running())
+    std::this_thread::yield();
+  ASSERT_THROW(spin.stop(), nmpp::exception);
+}
+
+TEST_F(spin_receiver_test, passes_receive_error_to_handler_taking_it)
+{
+  EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, NN_DONTWAIT))
+      .WillOnce(Return(-1));
+  EXPECT_CALL(nanomsg, nn_errno()).WillOnce(Return(EBADF));
+
+  std::error_code error;
+  receiver spin(*socket, -1, counting_backoff{&idles, &resets});
+  spin.start<message_mock>(
+      [&](const std::error_code& ec, std::unique_ptr<message_mock> msg) {
+        error = ec;
+        EXPECT_FALSE(msg);
+        ++received;
+      });
+  wait_for(received, 1);
+  ASSERT_NO_THROW(spin.stop());
+  ASSERT_FALSE(spin.running());
+  ASSERT_THAT(error.value(), Eq(EBADF));
+}
+
+TEST_F(spin_receiver_test, throws_when_started_twice)
+{
+  EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, NN_DONTWAIT))
+      .WillRepeatedly(Return(-1));
+  EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(EAGAIN));
+
+  receiver spin(*socket, -1, counting_backoff{&idles, &resets});
+  spin.start<message_mock>([](const message_mock&) {});
+  ASSERT_THROW(spin.start<message_mock>([](const message_mock&) {}),
+               std::logic_error);
+}
+
+TEST_F(spin_receiver_test, throws_when_cpu_cannot_be_pinned)
+{
+  receiver spin(*socket, CPU_SETSIZE - 1, counting_backoff{&idles, &resets});
+  ASSERT_THROW(spin.start<message_mock>([](const message_mock&) {}),
+               std::system_error);
+  ASSERT_FALSE(spin.running());
+}
+
+TEST_F(spin_receiver_test, rejects_cpu_beyond_cpu_set_size)
+{
+  receiver spin(*socket, CPU_SETSIZE, counting_backoff{&idles, &resets});
+  ASSERT_THROW(spin.start<message_mock>([](const message_mock&) {}),
+               std::logic_error);
+  ASSERT_FALSE(spin.running());
+}
@@ -0,0 +1,87 @@
+#include <cstdint>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include <nmpp/spsc_queue.hpp>
+#include <thread>
+
+using namespace ::testing;
+
+TEST(spsc_queue_test, rounds_capacity_up_to_power_of_two)
+{
+  ASSERT_THAT(nmpp::spsc_queue<int>(1).capacity(), Eq(1u));
+  ASSERT_THAT(nmpp::spsc_queue<int>(5).capacity(), Eq(8u));
+  ASSERT_THAT(nmpp::spsc_queue<int>(64).capacity(), Eq(64u));
+  ASSERT_THROW(nmpp::spsc_queue<int>(0), std::logic_error);
+}
+
+TEST(spsc_queue_test, heap_allocated_queue_starts_a_cache_line)
+{
+  for (auto i = 0; i < 8; ++i)
+  {
+    std::unique_ptr<nmpp::spsc_queue<int>> queue(new nmpp::spsc_queue<int>(4));
+    ASSERT_THAT(reinterpret_cast<uintptr_t>(queue.get()) % 64, Eq(0u));
+  }
+}
+
+TEST(spsc_queue_test, pops_in_push_order_until_empty)
+{
+  nmpp::spsc_queue<int> queue(4);
+  for (auto i = 0; i < 3; ++i)
+    ASSERT_TRUE(queue.try_push(std::move(i)));
+  ASSERT_THAT(queue.size(), Eq(3u));
+
+  int value = -1;
+  for (auto i = 0; i < 3; ++i)
+  {
+    ASSERT_TRUE(queue.try_pop(value));
+    ASSERT_THAT(value, Eq(i));
+  }
+  ASSERT_FALSE(queue.try_pop(value));
+  ASSERT_TRUE(queue.empty());
+}
+
+TEST(spsc_queue_test, full_queue_keeps_the_rejected_value)
+{
+  nmpp::spsc_queue<std::unique_ptr<int>> queue(2);
+  ASSERT_TRUE(queue.try_push(std::make_unique<int>(1)));
+  ASSERT_TRUE(queue.try_push(std::make_unique<int>(2)));
+
+  auto rejected = std::make_unique<int>(3);
+  ASSERT_FALSE(queue.try_push(std::move(rejected)));
+  ASSERT_THAT(rejected, NotNull());
+
+  std::unique_ptr<int> value;
+  ASSERT_TRUE(queue.try_pop(value));
+  ASSERT_THAT(*value, Eq(1));
+  ASSERT_TRUE(queue.try_push(std::move(rejected)));
+  ASSERT_THAT(rejected, IsNull());
+}
+
+TEST(spsc_queue_test, hands_values_between_threads_in_order)
+{
+  const int count = 100000;
+  nmpp::spsc_queue<int> queue(16);
+  std::thread producer([&] {
+    for (auto i = 0; i < count; ++i)
+      while (!queue.try_push(std::move(i)))
+        std::this_thread::yield();
+  });
+
+  auto received = 0;
+  auto in_order = true;
+  while (received < count)
+  {
+    int value;
+    if (!queue.try_pop(value))
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    in_order = in_order && value == received;
+    ++received;
+  }
+  producer.join();
+  ASSERT_TRUE(in_order);
+  ASSERT_TRUE(queue.empty());
+}
@@ -0,0 +1,241 @@
+#include "mocks/async_dispatcher_mock.hpp"
+#include "mocks/nanomsg_heap.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include <atomic>
+#include <boost/asio.hpp>
+#include <gtest/gtest.h>
+#include <nmpp/message.hpp>
+#include <nmpp/submission_queue.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ::testing;
+
+// Counts notifications, the test plays the io thread.
+struct manual_wakeup
+{
+  explicit manual_wakeup(boost::asio::io_service&)
+  {
+  }
+
+  void start(std::function<void()> h)
+  {
+    handler = std::move(h);
+  }
+
+  void notify()
+  {
+    ++notified;
+  }
+
+  std::function<void()> handler;
+  std::atomic<int> notified{0};
+};
+
+struct submission_queue_test : Test
+{
+  using async_socket = nmpp::async_socket_impl<async_dispatcher_mock>;
+  template <typename wakeup_type = manual_wakeup>
+  using queue = nmpp::submission_queue<async_socket, nmpp::message,
+                                       wakeup_type>;
+
+  void SetUp()
+  {
+    EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(EAGAIN));
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto)).WillOnce(Return(1));
+    EXPECT_CALL(nanomsg, nn_getsockopt(1, NN_SOL_SOCKET, _, _, _))
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(nanomsg, nn_close(1)).WillOnce(Return(0));
+    socket.reset(new async_socket(domain, proto, io));
+    EXPECT_CALL(socket->get_async_dispatcher(), on_send_event(_))
+        .WillRepeatedly(Invoke([this](async_dispatcher_mock::handler h) {
+          writable = h;
+          ++waits;
+        }));
+  }
+
+  std::unique_ptr<nmpp::message> make(const std::string& payload)
+  {
+    return nmpp::message::from(payload.c_str(), payload.size());
+  }
+
+  // Runs the pending writable handler, if any.
+  bool make_writable(const std::error_code& ec = std::error_code())
+  {
+    if (!writable)
+      return false;
+    auto handler = std::move(writable);
+    writable = nullptr;
+    handler(ec);
+    return true;
+  }
+
+  int domain = 0;
+  int proto = 0;
+  nanomsg_mock nanomsg;
+  nanomsg_heap heap{nanomsg};
+  boost::asio::io_service io;
+  std::unique_ptr<async_socket> socket;
+  async_dispatcher_mock::handler writable;
+  int waits = 0;
+};
+
+TEST_F(submission_queue_test, coalesces_wakeups_until_drained)
+{
+  queue<> q(*socket, io);
+  auto& wakeup = q.get_wakeup();
+
+  ASSERT_TRUE(q.try_submit(make("a")));
+  ASSERT_TRUE(q.try_submit(make("b")));
+  ASSERT_TRUE(q.try_submit(make("c")));
+  ASSERT_THAT(wakeup.notified.load(), Eq(1));
+  ASSERT_THAT(q.pending(), Eq(3u));
+
+  wakeup.handler();
+  ASSERT_THAT(waits, Eq(1));
+  ASSERT_TRUE(make_writable());
+  ASSERT_THAT(heap.sent, ElementsAre("a", "b", "c"));
+  ASSERT_THAT(q.pending(), Eq(0u));
+  ASSERT_FALSE(writable);
+
+  ASSERT_TRUE(q.try_submit(make("d")));
+  ASSERT_THAT(wakeup.notified.load(), Eq(2));
+}
+
+TEST_F(submission_queue_test, sends_at_most_max_batch_per_writable_event)
+{
+  queue<> q(*socket, io, 16, 2);
+  for (auto payload : {"a", "b", "c"})
+    ASSERT_TRUE(q.try_submit(make(payload)));
+  q.get_wakeup().handler();
+
+  ASSERT_TRUE(make_writable());
+  ASSERT_THAT(heap.sent, ElementsAre("a", "b"));
+  ASSERT_TRUE(make_writable());
+  ASSERT_THAT(heap.sent, ElementsAre("a", "b", "c"));
+  ASSERT_FALSE(writable);
+  ASSERT_THAT(q.get_wakeup().notified.load(), Eq(1));
+}
+
+TEST_F(submission_queue_test, keeps_message_when_socket_pushes_back)
+{
+  queue<> q(*socket, io);
+  ASSERT_TRUE(q.try_submit(make("a")));
+  ASSERT_TRUE(q.try_submit(make("b")));
+  q.get_wakeup().handler();
+
+  EXPECT_CALL(nanomsg, nn_send(1, _, NN_MSG, NN_DONTWAIT))
+      .WillOnce(Return(-1))
+      .RetiresOnSaturation();
+  ASSERT_TRUE(make_writable());
+  ASSERT_TRUE(heap.sent.empty());
+  ASSERT_THAT(q.pending(), Eq(2u));
+
+  ASSERT_TRUE(make_writable());
+  ASSERT_THAT(heap.sent, ElementsAre("a", "b"));
+}
+
+TEST_F(submission_queue_test, reports_unsent_messages_on_wait_error)
+{
+  std::vector<std::string> failed;
+  queue<> q(*socket, io, 16, 64,
+            [&](const std::error_code& ec,
+                std::unique_ptr<nmpp::message> msg) {
+              ASSERT_THAT(ec, Eq(std::errc::operation_canceled));
+              failed.emplace_back(msg->data(), msg->size());
+            });
+  ASSERT_TRUE(q.try_submit(make("a")));
+  ASSERT_TRUE(q.try_submit(make("b")));
+  q.get_wakeup().handler();
+
+  ASSERT_TRUE(
+      make_writable(std::make_error_code(std::errc::operation_canceled)));
+  ASSERT_THAT(failed, ElementsAre("a", "b"));
+  ASSERT_TRUE(heap.sent.empty());
+  ASSERT_THAT(q.pending(), Eq(0u));
+}
+
+TEST_F(submission_queue_test, rejects_submissions_when_full)
+{
+  queue<> q(*socket, io, 2);
+  ASSERT_TRUE(q.try_submit(make("a")));
+  ASSERT_TRUE(q.try_submit(make("b")));
+
+  auto msg = make("c");
+  ASSERT_FALSE(q.try_submit(std::move(msg)));
+  ASSERT_THAT(msg, NotNull());
+  ASSERT_THROW(q.try_submit(nullptr), std::logic_error);
+}
+
+TEST_F(submission_queue_test, drains_submissions_from_many_threads)
+{
+  const int producers = 4;
+  const int count = 500;
+  std::vector<std::vector<std::unique_ptr<nmpp::message>>> messages(
+      producers);
+  for (auto p = 0; p < producers; ++p)
+    for (auto i = 0; i < count; ++i)
+      messages[p].push_back(
+          make(std::to_string(p) + ":" + std::to_string(i)));
+
+  queue<> q(*socket, io, 64, 16);
+  std::vector<std::thread> threads;
+  for (auto p = 0; p < producers; ++p)
+    threads.emplace_back([&q, &messages, p] {
+      for (auto& msg : messages[p])
+        while (!q.try_submit(std::move(msg)))
+          std::this_thread::yield();
+    });
+
+  auto notified = 0;
+  while (heap.sent.size() < producers * count)
+  {
+    if (make_writable())
+      continue;
+    if (q.get_wakeup().notified.load() > notified)
+    {
+      ++notified;
+      q.get_wakeup().handler();
+    }
+    else
+      std::this_thread::yield();
+  }
+  for (auto& t : threads)
+    t.join();
+
+  std::vector<int> next(producers, 0);
+  for (auto& payload : heap.sent)
+  {
+    auto colon = payload.find(':');
+    auto p = std::stoi(payload.substr(0, colon));
+    ASSERT_THAT(std::stoi(payload.substr(colon + 1)), Eq(next[p]++));
+  }
+}
+
+TEST_F(submission_queue_test, eventfd_wakeup_runs_on_io_thread)
+{
+  queue<nmpp::eventfd_wakeup> q(*socket, io);
+  std::thread producer([&] {
+    ASSERT_TRUE(q.try_submit(make("a")));
+    ASSERT_TRUE(q.try_submit(make("b")));
+  });
+  producer.join();
+
+  ASSERT_THAT(io.run_one(), Eq(1u));
+  ASSERT_THAT(waits, Eq(1));
+  ASSERT_TRUE(make_writable());
+  ASSERT_THAT(heap.sent, ElementsAre("a", "b"));
+}
+
+TEST_F(submission_queue_test, posted_wakeup_runs_on_io_thread)
+{
+  queue<nmpp::posted_wakeup> q(*socket, io);
+  ASSERT_TRUE(q.try_submit(make("a")));
+  ASSERT_TRUE(q.try_submit(make("b")));
+
+  ASSERT_THAT(io.poll(), Eq(1u));
+  ASSERT_THAT(waits, Eq(1));
+  ASSERT_TRUE(make_writable());
+  ASSERT_THAT(heap.sent, ElementsAre("a", "b"));
+}
@@ -0,0 +1,169 @@
+#include "mocks/async_dispatcher_mock.hpp"
+#include "mocks/nanomsg_heap.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include <boost/asio.hpp>
+#include <chrono>
+#include <future>
+#include <gtest/gtest.h>
+#include <nmpp/message.hpp>
+#include <nmpp/socket.hpp>
+#include <nmpp/subscription.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ::testing;
+
+struct subscription_test : Test
+{
+  using async_socket = nmpp::async_socket_impl<async_dispatcher_mock>;
+  using subscription = nmpp::subscription<async_socket>;
+
+  void SetUp()
+  {
+    EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(EAGAIN));
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto)).WillOnce(Return(1));
+    EXPECT_CALL(nanomsg, nn_getsockopt(1, NN_SOL_SOCKET, _, _, _))
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(nanomsg, nn_close(1)).WillOnce(Return(0));
+    socket.reset(new async_socket(domain, proto, io));
+    EXPECT_CALL(dispatcher(), on_receive_event(_))
+        .WillRepeatedly(Invoke([this](async_dispatcher_mock::handler h) {
+          readable = h;
+          ++waits;
+        }));
+    EXPECT_CALL(dispatcher(), cancel_receive()).WillRepeatedly(Return());
+  }
+
+  const async_dispatcher_mock& dispatcher()
+  {
+    return socket->get_async_dispatcher();
+  }
+
+  // Queues messages for the next non-blocking receives, then reports an
+  // empty queue.
+  void queue(std::vector<std::string> payloads)
+  {
+    auto& expectation =
+        EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, NN_DONTWAIT))
+            .WillRepeatedly(Return(-1));
+    (void)expectation;
+    for (auto it = payloads.rbegin(); it != payloads.rend(); ++it)
+    {
+      auto payload = *it;
+      EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, NN_DONTWAIT))
+          .WillOnce(Invoke([this, payload](int, void* buf, size_t, int) {
+            *reinterpret_cast<void**>(buf) = heap.allocate(payload);
+            return static_cast<int>(payload.size());
+          }))
+          .RetiresOnSaturation();
+    }
+  }
+
+  int domain = 0;
+  int proto = 0;
+  nanomsg_mock nanomsg;
+  nanomsg_heap heap{nanomsg};
+  boost::asio::io_service io;
+  std::unique_ptr<async_socket> socket;
+  async_dispatcher_mock::handler readable;
+  int waits = 0;
+  std::vector<std::string> received;
+};
+
+TEST_F(subscription_test, drains_queued_messages_and_rearms_once)
+{
+  subscription sub(*socket, [this](const nmpp::message& msg) {
+    received.emplace_back(msg.data(), msg.size());
+  });
+  ASSERT_THAT(waits, Eq(1));
+
+  queue({"a", "b", "c"});
+  readable(std::error_code());
+  ASSERT_THAT(received, ElementsAre("a", "b", "c"));
+  ASSERT_THAT(waits, Eq(2));
+
+  queue({"d"});
+  readable(std::error_code());
+  ASSERT_THAT(received, ElementsAre("a", "b", "c", "d"));
+  ASSERT_THAT(waits, Eq(3));
+}
+
+TEST_F(subscription_test, limits_messages_per_readiness_event)
+{
+  subscription sub(*socket,
+                   [this](const nmpp::message& msg) {
+                     received.emplace_back(msg.data(), msg.size());
+                   },
+                   2);
+  queue({"a", "b", "c"});
+  readable(std::error_code());
+  ASSERT_THAT(received, ElementsAre("a", "b"));
+  readable(std::error_code());
+  ASSERT_THAT(received, ElementsAre("a", "b", "c"));
+}
+
+TEST_F(subscription_test, stop_cancels_wait_and_silences_handler)
+{
+  subscription sub(*socket, [this](const nmpp::message& msg) {
+    received.emplace_back(msg.data(), msg.size());
+  });
+  EXPECT_CALL(dispatcher(), cancel_receive()).Times(1);
+  sub.stop();
+  ASSERT_FALSE(sub.active());
+
+  readable(std::make_error_code(std::errc::operation_canceled));
+  ASSERT_THAT(received, IsEmpty());
+  ASSERT_THAT(waits, Eq(1));
+}
+
+TEST_F(subscription_test, stop_from_handler_ends_subscription)
+{
+  std::unique_ptr<subscription> sub;
+  sub.reset(new subscription(*socket, [&](const nmpp::message& msg) {
+    received.emplace_back(msg.data(), msg.size());
+    sub->stop();
+  }));
+  queue({"a", "b"});
+  readable(std::error_code());
+  ASSERT_THAT(received, ElementsAre("a"));
+  ASSERT_THAT(waits, Eq(1));
+  auto rest = socket->try_receive<nmpp::message>();
+  ASSERT_THAT(std::string(rest->data(), rest->size()), Eq("b"));
+}
+
+TEST_F(subscription_test, error_aware_handler_sees_failure_and_stops)
+{
+  std::error_code result;
+  subscription sub(
+      *socket,
+      [&](const std::error_code& ec, std::unique_ptr<nmpp::message>) {
+        result = ec;
+      });
+  readable(std::make_error_code(std::errc::bad_file_descriptor));
+  ASSERT_THAT(result, Eq(std::errc::bad_file_descriptor));
+  ASSERT_FALSE(sub.active());
+  ASSERT_THAT(waits, Eq(1));
+}
+
+TEST_F(subscription_test, stop_waits_for_running_handler)
+{
+  std::promise<void> entered;
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  subscription sub(*socket, [&](const nmpp::message&) {
+    entered.set_value();
+    released.wait();
+  });
+  queue({"a"});
+  std::thread io_thread([this] { readable(std::error_code()); });
+  entered.get_future().wait();
+
+  auto stopped = std::async(std::launch::async, [&] { sub.stop(); });
+  ASSERT_THAT(stopped.wait_for(std::chrono::milliseconds(50)),
+              Eq(std::future_status::timeout));
+  release.set_value();
+  stopped.wait();
+  io_thread.join();
+  ASSERT_THAT(waits, Eq(1));
+}
@@ -0,0 +1,322 @@
+#include "mocks/async_dispatcher_mock.hpp"
+#include "mocks/nanomsg_heap.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include <boost/asio.hpp>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <gtest/gtest.h>
+#include <nmpp/message.hpp>
+#include <nmpp/survey.hpp>
+#include <string>
+#include <vector>
+
+using namespace ::testing;
+
+namespace
+{
+
+struct manual_clock
+{
+  using duration = std::chrono::nanoseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<manual_clock>;
+  static constexpr bool is_steady = true;
+
+  static time_point now()
+  {
+    return current;
+  }
+
+  static time_point current;
+};
+
+manual_clock::time_point manual_clock::current;
+
+// Records the deadline wait of the running survey.
+struct manual_timer
+{
+  using handler = std::function<void(const boost::system::error_code&)>;
+
+  explicit manual_timer(boost::asio::io_service&)
+  {
+    instance = this;
+  }
+
+  void expires_at(manual_clock::time_point deadline)
+  {
+    this->deadline = deadline;
+  }
+
+  void async_wait(handler h)
+  {
+    pending = std::move(h);
+  }
+
+  void cancel()
+  {
+    if (!pending)
+      return;
+    auto h = std::move(pending);
+    pending = nullptr;
+    h(boost::asio::error::operation_aborted);
+  }
+
+  // Moves the clock to the deadline and completes the wait.
+  void fire()
+  {
+    manual_clock::current = deadline;
+    auto h = std::move(pending);
+    pending = nullptr;
+    h(boost::system::error_code());
+  }
+
+  manual_clock::time_point deadline;
+  handler pending;
+  static manual_timer* instance;
+};
+
+manual_timer* manual_timer::instance = nullptr;
+
+} // namespace
+
+struct survey_test : Test
+{
+  using async_socket = nmpp::async_socket_impl<async_dispatcher_mock>;
+  using surveyor =
+      nmpp::surveyor<async_socket, nmpp::message, manual_clock, manual_timer>;
+  using ms = std::chrono::milliseconds;
+
+  void SetUp()
+  {
+    manual_clock::current = manual_clock::time_point();
+    EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Invoke([this] {
+      return error;
+    }));
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto)).WillOnce(Return(1));
+    EXPECT_CALL(nanomsg, nn_getsockopt(1, NN_SOL_SOCKET, _, _, _))
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(nanomsg, nn_close(1)).WillOnce(Return(0));
+    EXPECT_CALL(nanomsg, nn_setsockopt(1, NN_SURVEYOR, NN_SURVEYOR_DEADLINE,
+                                       _, sizeof(int)))
+        .WillRepeatedly(Invoke([this](int, int, int, const void* value,
+                                      size_t) {
+          deadlines.push_back(*reinterpret_cast<const int*>(value));
+          return 0;
+        }));
+    EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, NN_DONTWAIT))
+        .WillRepeatedly(Invoke([this](int, void* buf, size_t, int) {
+          if (replies.empty())
+            return -1;
+          auto payload = replies.front();
+          replies.pop_front();
+          *reinterpret_cast<void**>(buf) = heap.allocate(payload);
+          return static_cast<int>(payload.size());
+        }));
+    socket.reset(new async_socket(domain, proto, io));
+    EXPECT_CALL(socket->get_async_dispatcher(), on_send_event(_))
+        .WillRepeatedly(SaveArg<0>(&writable));
+    EXPECT_CALL(socket->get_async_dispatcher(), on_receive_event(_))
+        .WillRepeatedly(SaveArg<0>(&readable));
+    EXPECT_CALL(socket->get_async_dispatcher(), cancel_receive())
+        .WillRepeatedly(Invoke([this] { readable = nullptr; }));
+  }
+
+  void survey(surveyor& s, ms deadline, size_t quorum)
+  {
+    s.async_survey(nmpp::message::from("q?", 2), deadline, quorum,
+                   [this](const std::error_code& ec,
+                          surveyor::result_type& result) {
+                     ++completions;
+                     this->ec = ec;
+                     answers.clear();
+                     for (auto& response : result.responses)
+                       answers.emplace_back(response->data(),
+                                            response->size());
+                     this->result = &result;
+                   });
+  }
+
+  void become_writable()
+  {
+    auto h = std::move(writable);
+    writable = nullptr;
+    h(std::error_code());
+  }
+
+  // Replies arrive after delay and the socket becomes readable.
+  void reply(ms delay, std::vector<std::string> payloads)
+  {
+    manual_clock::current += delay;
+    replies.insert(replies.end(), payloads.begin(), payloads.end());
+    auto h = std::move(readable);
+    readable = nullptr;
+    h(std::error_code());
+  }
+
+  manual_timer& timer()
+  {
+    return *manual_timer::instance;
+  }
+
+  static double as_ms(manual_clock::duration d)
+  {
+    return std::chrono::duration<double, std::milli>(d).count();
+  }
+
+  int domain = 0;
+  int proto = 0;
+  int error = EAGAIN;
+  nanomsg_mock nanomsg;
+  nanomsg_heap heap{nanomsg};
+  boost::asio::io_service io;
+  std::unique_ptr<async_socket> socket;
+  async_dispatcher_mock::handler writable;
+  async_dispatcher_mock::handler readable;
+  std::deque<std::string> replies;
+  std::vector<int> deadlines;
+  int completions = 0;
+  std::error_code ec;
+  std::vector<std::string> answers;
+  surveyor::result_type* result = nullptr;
+};
+
+TEST_F(survey_test, completes_early_once_quorum_answered)
+{
+  surveyor s(*socket, io, 8);
+  survey(s, ms(100), 2);
+  ASSERT_THAT(deadlines, ElementsAre(102));
+  become_writable();
+  ASSERT_THAT(heap.sent, ElementsAre("q?"));
+  ASSERT_TRUE(timer().pending);
+  ASSERT_TRUE(readable);
+
+  reply(ms(5), {"a"});
+  ASSERT_THAT(completions, Eq(0));
+  ASSERT_TRUE(readable);
+  reply(ms(10), {"b", "c"});
+
+  ASSERT_THAT(completions, Eq(1));
+  ASSERT_FALSE(ec);
+  ASSERT_THAT(answers, ElementsAre("a", "b"));
+  ASSERT_THAT(as_ms(result->min_latency), DoubleEq(5));
+  ASSERT_THAT(as_ms(result->max_latency), DoubleEq(15));
+  ASSERT_THAT(as_ms(result->mean_latency), DoubleEq(10));
+  ASSERT_THAT(as_ms(result->elapsed), DoubleEq(15));
+  ASSERT_FALSE(timer().pending);
+  ASSERT_FALSE(readable);
+  ASSERT_FALSE(s.running());
+}
+
+TEST_F(survey_test, collects_until_deadline_without_quorum)
+{
+  surveyor s(*socket, io, 8);
+  survey(s, ms(50), 0);
+  become_writable();
+  reply(ms(10), {"a"});
+  reply(ms(10), {"b"});
+  ASSERT_THAT(completions, Eq(0));
+
+  timer().fire();
+  ASSERT_THAT(completions, Eq(1));
+  ASSERT_FALSE(ec);
+  ASSERT_THAT(answers, ElementsAre("a", "b"));
+  ASSERT_THAT(as_ms(result->elapsed), DoubleEq(50));
+  ASSERT_FALSE(readable);
+}
+
+TEST_F(survey_test, times_out_short_of_quorum)
+{
+  surveyor s(*socket, io, 8);
+  survey(s, ms(50), 3);
+  become_writable();
+  reply(ms(10), {"a"});
+  timer().fire();
+  ASSERT_THAT(ec, Eq(std::errc::timed_out));
+  ASSERT_THAT(answers, ElementsAre("a"));
+}
+
+TEST_F(survey_test, socket_deadline_ends_the_survey)
+{
+  surveyor s(*socket, io, 8);
+  survey(s, ms(50), 0);
+  become_writable();
+  error = ETIMEDOUT;
+  reply(ms(60), {"a"});
+  ASSERT_THAT(completions, Eq(1));
+  ASSERT_FALSE(ec);
+  ASSERT_THAT(answers, ElementsAre("a"));
+  ASSERT_FALSE(timer().pending);
+}
+
+TEST_F(survey_test, counts_replies_beyond_capacity)
+{
+  surveyor s(*socket, io, 2);
+  survey(s, ms(50), 0);
+  become_writable();
+  reply(ms(1), {"a", "b", "c", "d"});
+  timer().fire();
+  ASSERT_THAT(answers, ElementsAre("a", "b"));
+  ASSERT_THAT(result->dropped, Eq(2u));
+  // Only the kept replies are still allocated.
+  ASSERT_THAT(heap.allocations.size(), Eq(2u));
+}
+
+TEST_F(survey_test, reuses_the_result_set)
+{
+  surveyor s(*socket, io, 4);
+  survey(s, ms(50), 1);
+  become_writable();
+  reply(ms(1), {"a"});
+  auto first = result;
+  auto storage = result->responses.data();
+
+  survey(s, ms(50), 1);
+  ASSERT_THAT(deadlines, ElementsAre(52));
+  become_writable();
+  reply(ms(3), {"b"});
+  ASSERT_THAT(result, Eq(first));
+  ASSERT_THAT(result->responses.data(), Eq(storage));
+  ASSERT_THAT(answers, ElementsAre("b"));
+  ASSERT_THAT(as_ms(result->max_latency), DoubleEq(3));
+}
+
+TEST_F(survey_test, new_survey_cancels_the_running_one)
+{
+  surveyor s(*socket, io, 4);
+  survey(s, ms(50), 2);
+  become_writable();
+  reply(ms(1), {"a"});
+
+  survey(s, ms(80), 2);
+  ASSERT_THAT(completions, Eq(1));
+  ASSERT_THAT(ec, Eq(std::errc::operation_canceled));
+  ASSERT_THAT(answers, ElementsAre("a"));
+  ASSERT_THAT(deadlines, ElementsAre(52, 82));
+  ASSERT_TRUE(s.running());
+
+  s.cancel();
+  ASSERT_THAT(completions, Eq(2));
+  ASSERT_THAT(ec, Eq(std::errc::operation_canceled));
+  ASSERT_THAT(answers, IsEmpty());
+}
+
+TEST_F(survey_test, reports_send_errors)
+{
+  surveyor s(*socket, io, 4);
+  survey(s, ms(50), 1);
+  writable(std::make_error_code(std::errc::operation_canceled));
+  ASSERT_THAT(completions, Eq(1));
+  ASSERT_THAT(ec, Eq(std::errc::operation_canceled));
+  ASSERT_FALSE(timer().pending);
+}
+
+TEST_F(survey_test, rejects_invalid_surveys)
+{
+  ASSERT_THROW(surveyor(*socket, io, 0), std::logic_error);
+  surveyor s(*socket, io, 2);
+  ASSERT_THROW(survey(s, ms(0), 0), std::logic_error);
+  ASSERT_THROW(survey(s, ms(10), 3), std::logic_error);
+  ASSERT_FALSE(s.running());
+}
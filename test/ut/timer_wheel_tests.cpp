@@ -0,0 +1,147 @@
+#include <chrono>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nmpp/timer_wheel.hpp>
+#include <vector>
+
+using namespace ::testing;
+
+struct timer_wheel_test : Test
+{
+  using clock = std::chrono::steady_clock;
+  using ms = std::chrono::milliseconds;
+
+  clock::time_point at(int millis)
+  {
+    return origin + ms(millis);
+  }
+
+  clock::time_point origin = clock::now();
+  nmpp::timer_wheel<clock> wheel{ms(1), 8, origin};
+  std::vector<int> fired;
+};
+
+TEST_F(timer_wheel_test, fires_timer_once_deadline_passed)
+{
+  wheel.schedule(at(3), [this] { fired.push_back(1); });
+  ASSERT_THAT(wheel.advance(at(2)), Eq(0u));
+  ASSERT_THAT(wheel.advance(at(3)), Eq(1u));
+  ASSERT_THAT(fired, ElementsAre(1));
+  ASSERT_TRUE(wheel.empty());
+}
+
+TEST_F(timer_wheel_test, fires_timers_beyond_one_revolution_in_order)
+{
+  wheel.schedule(at(20), [this] { fired.push_back(20); });
+  wheel.schedule(at(4), [this] { fired.push_back(4); });
+  wheel.schedule(at(12), [this] { fired.push_back(12); });
+  for (auto t = 1; t <= 20; ++t)
+    wheel.advance(at(t));
+  ASSERT_THAT(fired, ElementsAre(4, 12, 20));
+}
+
+TEST_F(timer_wheel_test, fires_everything_due_after_a_long_gap)
+{
+  wheel.schedule(at(5), [this] { fired.push_back(5); });
+  wheel.schedule(at(50), [this] { fired.push_back(50); });
+  wheel.schedule(at(500), [this] { fired.push_back(500); });
+  ASSERT_THAT(wheel.advance(at(100)), Eq(2u));
+  ASSERT_THAT(fired, UnorderedElementsAre(5, 50));
+  ASSERT_THAT(wheel.size(), Eq(1u));
+}
+
+TEST_F(timer_wheel_test, cancelled_timer_does_not_fire)
+{
+  auto id = wheel.schedule(at(2), [this] { fired.push_back(1); });
+  ASSERT_TRUE(wheel.cancel(id));
+  ASSERT_FALSE(wheel.cancel(id));
+  wheel.advance(at(10));
+  ASSERT_THAT(fired, IsEmpty());
+}
+
+TEST_F(timer_wheel_test, stale_id_does_not_cancel_reused_node)
+{
+  auto first = wheel.schedule(at(1), [] {});
+  wheel.advance(at(1));
+  wheel.schedule(at(2), [this] { fired.push_back(2); });
+  ASSERT_FALSE(wheel.cancel(first));
+  wheel.advance(at(2));
+  ASSERT_THAT(fired, ElementsAre(2));
+}
+
+TEST_F(timer_wheel_test, callback_may_cancel_timer_in_same_slot)
+{
+  auto victim = wheel.schedule(at(3), [this] { fired.push_back(2); });
+  wheel.schedule(at(3), [&] {
+    fired.push_back(1);
+    wheel.cancel(victim);
+  });
+  wheel.advance(at(3));
+  ASSERT_THAT(fired, ElementsAre(1));
+  ASSERT_TRUE(wheel.empty());
+}
+
+TEST_F(timer_wheel_test, callback_may_schedule_new_timer)
+{
+  wheel.schedule(at(1), [this] {
+    fired.push_back(1);
+    wheel.schedule(at(2), [this] { fired.push_back(2); });
+  });
+  wheel.advance(at(1));
+  wheel.advance(at(2));
+  ASSERT_THAT(fired, ElementsAre(1, 2));
+}
+
+TEST_F(timer_wheel_test, past_deadline_fires_on_next_tick)
+{
+  wheel.advance(at(5));
+  wheel.schedule(at(1), [this] { fired.push_back(1); });
+  wheel.advance(at(5));
+  ASSERT_THAT(fired, IsEmpty());
+  wheel.advance(at(6));
+  ASSERT_THAT(fired, ElementsAre(1));
+}
+
+TEST_F(timer_wheel_test, next_expiry_is_earliest_pending_tick)
+{
+  ASSERT_THAT(wheel.next_expiry(), Eq(clock::time_point::max()));
+  auto late = wheel.schedule(at(20), [] {});
+  wheel.schedule(at(3), [] {});
+  ASSERT_THAT(wheel.next_expiry(), Eq(at(3)));
+  wheel.advance(at(3));
+  ASSERT_THAT(wheel.next_expiry(), Eq(at(20)));
+  wheel.cancel(late);
+  ASSERT_THAT(wheel.next_expiry(), Eq(clock::time_point::max()));
+}
+
+TEST_F(timer_wheel_test, throws_on_invalid_geometry)
+{
+  ASSERT_THROW(nmpp::timer_wheel<clock>(ms(0), 8), std::logic_error);
+  ASSERT_THROW(nmpp::timer_wheel<clock>(ms(1), 0), std::logic_error);
+}
+
+TEST(asio_timer_wheel_test, runs_callback_from_io_service)
+{
+  boost::asio::io_service io;
+  nmpp::asio_timer_wheel timers(io);
+  auto fired = false;
+  timers.expires_after(std::chrono::milliseconds(2), [&] { fired = true; });
+  io.run();
+  ASSERT_TRUE(fired);
+  ASSERT_THAT(timers.size(), Eq(0u));
+}
+
+TEST(asio_timer_wheel_test, waits_for_earliest_deadline_instead_of_ticking)
+{
+  boost::asio::io_service io;
+  nmpp::asio_timer_wheel timers(io);
+  std::vector<int> fired;
+  timers.expires_after(std::chrono::milliseconds(30),
+                       [&] { fired.push_back(30); });
+  timers.expires_after(std::chrono::milliseconds(10),
+                       [&] { fired.push_back(10); });
+  auto handlers = io.run();
+  ASSERT_THAT(fired, ElementsAre(10, 30));
+  // The wait for 30 ms is moved to 10 ms, then set again for 30 ms.
+  ASSERT_THAT(handlers, Le(3u));
+}
@@ -0,0 +1,163 @@
+#include "mocks/async_dispatcher_mock.hpp"
+#include "mocks/nanomsg_heap.hpp"
+#include "mocks/nanomsg_mock.hpp"
+#include "mocks/native_socket_mock.hpp"
+#include <boost/asio.hpp>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nmpp/async_dispatcher.hpp>
+#include <nmpp/message.hpp>
+#include <nmpp/ring_tracer.hpp>
+#include <nmpp/socket.hpp>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace ::testing;
+
+struct recording_tracer
+{
+  static void record(nmpp::trace_event type, int descriptor) noexcept
+  {
+    events.emplace_back(type, descriptor);
+  }
+
+  static std::vector<std::pair<nmpp::trace_event, int>> events;
+};
+
+std::vector<std::pair<nmpp::trace_event, int>> recording_tracer::events;
+
+ACTION_P(SetArgVoidPointee, p)
+{
+  *reinterpret_cast<int*>(arg3) = p;
+}
+
+struct trace_test : Test
+{
+  void SetUp()
+  {
+    recording_tracer::events.clear();
+    EXPECT_CALL(nanomsg, nn_errno()).WillRepeatedly(Return(1));
+    EXPECT_CALL(nanomsg, nn_socket(domain, proto)).WillOnce(Return(1));
+    EXPECT_CALL(nanomsg, nn_close(1)).WillOnce(Return(0));
+  }
+
+  using event = std::pair<nmpp::trace_event, int>;
+  int domain = 0;
+  int proto = 0;
+  nanomsg_mock nanomsg;
+  nanomsg_heap heap{nanomsg};
+};
+
+TEST_F(trace_test, socket_records_send_and_receive)
+{
+  nmpp::basic_socket<recording_tracer> socket(domain, proto);
+  socket.send(*nmpp::message::from("abc", 3));
+  EXPECT_CALL(nanomsg, nn_recv(1, _, NN_MSG, 0))
+      .WillOnce(Invoke([this](int, void* buf, size_t, int) {
+        *reinterpret_cast<void**>(buf) = heap.allocate("xyz");
+        return 3;
+      }));
+  socket.receive<nmpp::message>();
+
+  ASSERT_THAT(recording_tracer::events,
+              ElementsAre(event(nmpp::trace_event::send_begin, 1),
+                          event(nmpp::trace_event::send_end, 1),
+                          event(nmpp::trace_event::receive_begin, 1),
+                          event(nmpp::trace_event::receive_end, 1)));
+}
+
+TEST_F(trace_test, send_end_is_recorded_when_send_fails)
+{
+  nmpp::basic_socket<recording_tracer> socket(domain, proto);
+  EXPECT_CALL(nanomsg, nn_send(1, _, 3, 0)).WillOnce(Return(-1));
+  ASSERT_THROW(socket.send("abc", 3), nmpp::exception);
+  ASSERT_THAT(recording_tracer::events,
+              ElementsAre(event(nmpp::trace_event::send_begin, 1),
+                          event(nmpp::trace_event::send_end, 1)));
+}
+
+TEST_F(trace_test, async_socket_records_handler_span)
+{
+  boost::asio::io_service io;
+  EXPECT_CALL(nanomsg, nn_getsockopt(1, NN_SOL_SOCKET, NN_RCVFD, _, _))
+      .WillOnce(DoAll(SetArgVoidPointee(100), Return(0)));
+  EXPECT_CALL(nanomsg, nn_getsockopt(1, NN_SOL_SOCKET, NN_SNDFD, _, _))
+      .WillOnce(DoAll(SetArgVoidPointee(101), Return(0)));
+  nmpp::async_socket_impl<async_dispatcher_mock, recording_tracer> socket(
+      domain, proto, io);
+
+  async_dispatcher_mock::handler ready;
+  EXPECT_CALL(socket.get_async_dispatcher(), on_send_event(_))
+      .WillOnce(SaveArg<0>(&ready));
+  auto inside = 0u;
+  socket.async_send(nmpp::message::from("abc", 3),
+                    [&inside](const std::error_code&, size_t) {
+                      inside = recording_tracer::events.size();
+                    });
+  ready(std::error_code());
+
+  ASSERT_THAT(inside, Eq(3u));
+  ASSERT_THAT(recording_tracer::events,
+              ElementsAre(event(nmpp::trace_event::send_begin, 1),
+                          event(nmpp::trace_event::send_end, 1),
+                          event(nmpp::trace_event::handler_begin, 1),
+                          event(nmpp::trace_event::handler_end, 1)));
+}
+
+TEST(async_dispatcher_trace_test, records_readiness_wakeup)
+{
+  recording_tracer::events.clear();
+  boost::asio::io_service io;
+  nmpp::async_dispatcher<native_socket_mock, recording_tracer> dispatcher(
+      5, 6, io);
+  native_socket_mock::handler native_handler;
+  EXPECT_CALL(dispatcher.get_native_send_socket(), async_write_event(_))
+      .WillOnce(SaveArg<0>(&native_handler));
+  dispatcher.on_send_event([](const std::error_code&) {});
+  native_handler(boost::system::error_code(), 0);
+
+  ASSERT_THAT(recording_tracer::events,
+              ElementsAre(std::make_pair(
+                  nmpp::trace_event::readiness_wakeup, 6)));
+}
+
+TEST(ring_tracer_test, keeps_most_recent_events_per_thread)
+{
+  using tracer = nmpp::ring_tracer<4>;
+  for (auto i = 0; i < 6; ++i)
+    tracer::record(nmpp::trace_event::readiness_wakeup, i);
+
+  auto events = tracer::local_events();
+  ASSERT_THAT(events.size(), Eq(4u));
+  ASSERT_THAT(events.front().descriptor, Eq(2));
+  ASSERT_THAT(events.back().descriptor, Eq(5));
+  ASSERT_TRUE(std::is_sorted(
+      events.begin(), events.end(),
+      [](auto& a, auto& b) { return a.tsc < b.tsc; }));
+}
+
+TEST(ring_tracer_test, dumps_chrome_trace_of_all_threads)
+{
+  using tracer = nmpp::ring_tracer<16>;
+  std::thread worker([] {
+    tracer::record(nmpp::trace_event::receive_begin, 7);
+    tracer::record(nmpp::trace_event::receive_end, 7);
+  });
+  worker.join();
+  tracer::record(nmpp::trace_event::handler_begin, 8);
+  tracer::record(nmpp::trace_event::handler_end, 8);
+
+  std::ostringstream out;
+  tracer::dump(out);
+  auto json = out.str();
+  ASSERT_THAT(json, StartsWith("{\"traceEvents\":["));
+  ASSERT_THAT(json, EndsWith("]}"));
+  ASSERT_THAT(json, HasSubstr("\"name\":\"nn_recv\",\"ph\":\"B\""));
+  ASSERT_THAT(json, HasSubstr("\"name\":\"nn_recv\",\"ph\":\"E\""));
+  ASSERT_THAT(json, HasSubstr("\"name\":\"handler\",\"ph\":\"B\""));
+  ASSERT_THAT(json, HasSubstr("\"args\":{\"descriptor\":7}"));
+  ASSERT_THAT(json, HasSubstr("\"tid\":1"));
+  ASSERT_THAT(json, HasSubstr("\"tid\":2"));
+}
@@ -0,0 +1,133 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <linux/io_uring.h>
+#include <nmpp/reactor_dispatcher.hpp>
+#include <nmpp/uring_reactor.hpp>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace ::testing;
+
+namespace
+{
+// Asks the kernel directly, independent of uring_reactor's own setup.
+bool kernel_supports_io_uring()
+{
+  io_uring_params params{};
+  auto ring = syscall(__NR_io_uring_setup, 4, &params);
+  if (ring < 0)
+    return false;
+  ::close(static_cast<int>(ring));
+  return true;
+}
+} // namespace
+
+TEST(uring_reactor_backend_test, uses_io_uring_when_kernel_supports_it)
+{
+  nmpp::uring_reactor reactor;
+  ASSERT_THAT(reactor.uses_io_uring(), Eq(kernel_supports_io_uring()));
+}
+
+// The remaining tests exercise the io_uring path only, the epoll fallback
+// is covered by epoll_reactor_test.
+struct uring_reactor_test : Test
+{
+  void SetUp()
+  {
+    if (!reactor.uses_io_uring())
+      GTEST_SKIP() << "io_uring unavailable, epoll fallback active";
+    receive_fd = eventfd(0, EFD_NONBLOCK);
+    send_fd = eventfd(0, EFD_NONBLOCK);
+  }
+
+  void TearDown()
+  {
+    ::close(receive_fd);
+    ::close(send_fd);
+  }
+
+  void signal(int fd)
+  {
+    uint64_t one = 1;
+    ASSERT_THAT(::write(fd, &one, sizeof(one)), Eq(8));
+  }
+
+  using dispatcher = nmpp::reactor_dispatcher<nmpp::uring_reactor>;
+
+  nmpp::uring_reactor reactor;
+  int receive_fd = -1;
+  int send_fd = -1;
+  int calls = 0;
+};
+
+TEST_F(uring_reactor_test, runs_receive_handler_when_descriptor_is_readable)
+{
+  dispatcher async_dispatcher(receive_fd, send_fd, reactor);
+  async_dispatcher.on_receive_event([this](const std::error_code&) {
+    ++calls;
+  });
+  ASSERT_THAT(reactor.run_one(10), Eq(0u));
+  signal(receive_fd);
+  ASSERT_THAT(reactor.run_one(1000), Eq(1u));
+  ASSERT_THAT(calls, Eq(1));
+}
+
+TEST_F(uring_reactor_test, runs_send_handler_when_descriptor_is_writable)
+{
+  dispatcher async_dispatcher(receive_fd, send_fd, reactor);
+  async_dispatcher.on_send_event([this](const std::error_code&) { ++calls; });
+  ASSERT_THAT(reactor.run_one(1000), Eq(1u));
+  ASSERT_THAT(calls, Eq(1));
+}
+
+TEST_F(uring_reactor_test, rearming_still_readable_descriptor_fires_again)
+{
+  dispatcher async_dispatcher(receive_fd, send_fd, reactor);
+  signal(receive_fd);
+  async_dispatcher.on_receive_event([&](const std::error_code&) {
+    if (++calls < 3)
+      async_dispatcher.on_receive_event([this](const std::error_code&) {
+        ++calls;
+      });
+  });
+  ASSERT_THAT(reactor.run(), Eq(2u));
+  ASSERT_THAT(calls, Eq(2));
+  ASSERT_THAT(reactor.pending(), Eq(0u));
+}
+
+TEST_F(uring_reactor_test, stop_interrupts_run_from_other_thread)
+{
+  dispatcher async_dispatcher(receive_fd, send_fd, reactor);
+  async_dispatcher.on_receive_event([this](const std::error_code&) {
+    ++calls;
+  });
+  std::thread t([this]() { reactor.run(); });
+  reactor.stop();
+  t.join();
+  ASSERT_TRUE(reactor.stopped());
+  ASSERT_THAT(calls, Eq(0));
+}
+
+TEST_F(uring_reactor_test, destroyed_dispatcher_does_not_run_handlers)
+{
+  {
+    dispatcher async_dispatcher(receive_fd, send_fd, reactor);
+    async_dispatcher.on_receive_event([this](const std::error_code&) {
+      ++calls;
+    });
+  }
+  signal(receive_fd);
+  ASSERT_THAT(reactor.pending(), Eq(0u));
+  ASSERT_THAT(reactor.run_one(10), Eq(0u));
+  ASSERT_THAT(calls, Eq(0));
+}
+
+TEST_F(uring_reactor_test, throws_when_receive_on_invalid_descriptor)
+{
+  dispatcher async_dispatcher(-1, send_fd, reactor);
+  ASSERT_THROW(
+      async_dispatcher.on_receive_event([](const std::error_code&) {}),
+      std::logic_error);
+}
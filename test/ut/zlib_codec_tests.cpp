@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include <nmpp/zlib_codec.hpp>
+#include <string>
+#include <vector>
+
+using namespace ::testing;
+
+struct zlib_codec_test : Test
+{
+  std::string round_trip(const std::string& payload)
+  {
+    std::vector<char> compressed(codec.max_compressed_size(payload.size()));
+    auto size = codec.compress(payload.data(), payload.size(),
+                               compressed.data(), compressed.size());
+    EXPECT_NE(size, 0u);
+    std::string restored(payload.size(), '\0');
+    EXPECT_TRUE(codec.decompress(compressed.data(), size, &restored[0],
+                                 restored.size()));
+    return restored;
+  }
+
+  nmpp::zlib_codec codec;
+};
+
+TEST_F(zlib_codec_test, round_trips_payload)
+{
+  std::string payload;
+  for (int i = 0; i < 1000; ++i)
+    payload += "field=" + std::to_string(i) + ";";
+  ASSERT_EQ(round_trip(payload), payload);
+}
+
+TEST_F(zlib_codec_test, round_trips_at_every_level)
+{
+  std::string payload(4096, 'x');
+  for (int level = Z_NO_COMPRESSION; level <= Z_BEST_COMPRESSION; ++level)
+  {
+    codec.set_level(level);
+    ASSERT_EQ(round_trip(payload), payload);
+  }
+}
+
+TEST_F(zlib_codec_test, shrinks_repetitive_payload)
+{
+  std::string payload(4096, 'x');
+  std::vector<char> compressed(codec.max_compressed_size(payload.size()));
+  auto size = codec.compress(payload.data(), payload.size(),
+                             compressed.data(), compressed.size());
+  ASSERT_GT(size, 0u);
+  ASSERT_LT(size, payload.size());
+}
+
+TEST_F(zlib_codec_test, fails_compression_into_small_buffer)
+{
+  std::string payload = "0123456789abcdef";
+  char compressed[2];
+  ASSERT_EQ(codec.compress(payload.data(), payload.size(), compressed,
+                           sizeof(compressed)),
+            0u);
+}
+
+TEST_F(zlib_codec_test, rejects_wrong_original_size)
+{
+  std::string payload(100, 'x');
+  std::vector<char> compressed(codec.max_compressed_size(payload.size()));
+  auto size = codec.compress(payload.data(), payload.size(),
+                             compressed.data(), compressed.size());
+  std::string restored(99, '\0');
+  ASSERT_FALSE(codec.decompress(compressed.data(), size, &restored[0],
+                                restored.size()));
+}
+
+TEST_F(zlib_codec_test, rejects_corrupt_input)
+{
+  std::string garbage = "not a zlib stream";
+  std::string restored(100, '\0');
+  ASSERT_FALSE(codec.decompress(garbage.data(), garbage.size(), &restored[0],
+                                restored.size()));
+}